@@ -0,0 +1,20 @@
+#ifndef CPPAI_BENCH_ALLOCATIONS_H
+#define CPPAI_BENCH_ALLOCATIONS_H
+#include <cstdint>
+
+namespace cppai::bench {
+    struct allocation_count {
+        std::uint64_t calls = 0;
+        std::uint64_t bytes = 0;
+    };
+
+    // Every operator new in the process so far, on all threads. Counting is only compiled into executables
+    // that link allocations.cpp, which replaces the global operator new and delete.
+    allocation_count allocations();
+
+    inline allocation_count operator-(allocation_count a, allocation_count b) {
+        return { a.calls - b.calls, a.bytes - b.bytes };
+    }
+}
+
+#endif
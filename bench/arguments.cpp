@@ -0,0 +1,129 @@
+#include "arguments.h"
+#include <charconv>
+#include <stdexcept>
+
+cppai::bench::arguments::arguments(int argc, char** argv, int first) {
+    for (int i = first; i < argc; ++i) {
+        const std::string_view name{ argv[i] };
+        if (!name.starts_with("--") || name.size() == 2) {
+            throw std::invalid_argument("unexpected argument " + std::string{ name });
+        }
+        std::optional<std::string> value;
+        if (i + 1 < argc && !std::string_view{ argv[i + 1] }.starts_with("--")) {
+            value.emplace(argv[++i]);
+        }
+        values.insert_or_assign(std::string{ name.substr(2) }, std::move(value));
+    }
+}
+
+std::optional<std::string> cppai::bench::arguments::text(std::string_view name) {
+    const auto found = values.find(name);
+    if (found == values.end()) {
+        return std::nullopt;
+    }
+    used.emplace(name);
+    if (!found->second.has_value()) {
+        throw std::invalid_argument("--" + std::string{ name } + " needs a value");
+    }
+    return found->second;
+}
+
+std::string cppai::bench::arguments::text_or(std::string_view name, std::string_view fallback) {
+    return text(name).value_or(std::string{ fallback });
+}
+
+double cppai::bench::arguments::number_or(std::string_view name, double fallback) {
+    const std::optional<std::string> value = text(name);
+    if (!value.has_value()) {
+        return fallback;
+    }
+    double number = 0;
+    const auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), number);
+    if (error != std::errc{} || end != value->data() + value->size()) {
+        throw std::invalid_argument("--" + std::string{ name } + " needs a number, not " + *value);
+    }
+    return number;
+}
+
+std::uint64_t cppai::bench::arguments::count_or(std::string_view name, std::uint64_t fallback) {
+    const std::optional<std::string> value = text(name);
+    if (!value.has_value()) {
+        return fallback;
+    }
+    std::uint64_t number = 0;
+    const auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), number);
+    if (error != std::errc{} || end != value->data() + value->size()) {
+        throw std::invalid_argument("--" + std::string{ name } + " needs a whole number, not " + *value);
+    }
+    return number;
+}
+
+std::chrono::microseconds cppai::bench::arguments::duration_or(std::string_view name, std::chrono::microseconds fallback) {
+    const std::optional<std::string> value = text(name);
+    return value.has_value() ? parse_micros(*value) : fallback;
+}
+
+std::vector<std::string> cppai::bench::arguments::list_or(std::string_view name, std::vector<std::string> fallback) {
+    const std::optional<std::string> value = text(name);
+    if (!value.has_value()) {
+        return fallback;
+    }
+    std::vector<std::string> items;
+    std::string_view rest = *value;
+    while (!rest.empty()) {
+        const std::size_t comma = rest.find(',');
+        items.emplace_back(rest.substr(0, comma));
+        rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+    }
+    return items;
+}
+
+bool cppai::bench::arguments::flag(std::string_view name) {
+    const auto found = values.find(name);
+    if (found == values.end()) {
+        return false;
+    }
+    used.emplace(name);
+    if (found->second.has_value()) {
+        throw std::invalid_argument("--" + std::string{ name } + " takes no value");
+    }
+    return true;
+}
+
+void cppai::bench::arguments::finish() const {
+    for (const auto& [name, value] : values) {
+        if (!used.contains(name)) {
+            throw std::invalid_argument("unknown option --" + name);
+        }
+    }
+}
+
+cppai::bench::mock_options cppai::bench::read_mock_options(arguments& args) {
+    mock_options opts;
+    if (const std::optional<std::string> spec = args.text("latency")) {
+        opts.latency = latency_distribution::parse(*spec);
+    }
+    if (const std::optional<std::string> spec = args.text("generation-latency")) {
+        opts.generation_latency = latency_distribution::parse(*spec);
+    }
+    opts.audio_speed = args.number_or("audio-speed", opts.audio_speed);
+    opts.stream_events = args.count_or("stream-events", opts.stream_events);
+    opts.stream_interval = args.duration_or("stream-interval", opts.stream_interval);
+    opts.stream_fragment = args.count_or("stream-fragment", opts.stream_fragment);
+    opts.rate_limit_fraction = args.number_or("rate-limit", opts.rate_limit_fraction);
+    opts.retry_after = std::chrono::duration_cast<std::chrono::milliseconds>(args.duration_or("retry-after", opts.retry_after));
+    opts.server_error_fraction = args.number_or("server-errors", opts.server_error_fraction);
+    opts.drop_fraction = args.number_or("drop", opts.drop_fraction);
+    opts.gzip = !args.flag("no-gzip");
+    opts.gzip_min_size = args.count_or("gzip-min", opts.gzip_min_size);
+    opts.http2 = !args.flag("no-h2");
+    opts.completion_words = args.count_or("completion-words", opts.completion_words);
+    opts.embedding_dimensions = args.count_or("dimensions", opts.embedding_dimensions);
+    opts.max_input_tokens = args.count_or("max-input-tokens", opts.max_input_tokens);
+    opts.image_bytes = args.count_or("image-bytes", opts.image_bytes);
+    opts.file_bytes = args.count_or("file-bytes", opts.file_bytes);
+    opts.replay_file = args.text_or("replay", opts.replay_file);
+    opts.threads = args.count_or("server-threads", opts.threads);
+    opts.seed = args.count_or("seed", opts.seed);
+    return opts;
+}
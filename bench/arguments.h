@@ -0,0 +1,70 @@
+#ifndef CPPAI_BENCH_ARGUMENTS_H
+#define CPPAI_BENCH_ARGUMENTS_H
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mock_server.h"
+
+namespace cppai::bench {
+    // Command lines of "--name value" options and bare "--flag"s, in any order. Malformed values throw
+    // std::invalid_argument naming the option.
+    class arguments {
+    public:
+        arguments(int argc, char** argv, int first = 1);
+
+        std::optional<std::string> text(std::string_view name);
+
+        std::string text_or(std::string_view name, std::string_view fallback);
+
+        double number_or(std::string_view name, double fallback);
+
+        std::uint64_t count_or(std::string_view name, std::uint64_t fallback);
+
+        std::chrono::microseconds duration_or(std::string_view name, std::chrono::microseconds fallback);
+
+        // A comma-separated list, e.g. "--rates 50,100,200".
+        std::vector<std::string> list_or(std::string_view name, std::vector<std::string> fallback);
+
+        bool flag(std::string_view name);
+
+        // Throws std::invalid_argument for any option nothing asked about, which is most likely a typo.
+        void finish() const;
+
+    private:
+        std::map<std::string, std::optional<std::string>, std::less<>> values;
+        std::set<std::string, std::less<>> used;
+    };
+
+    // The mock_options flags shared by cppai_mock_server and cppai_bench.
+    mock_options read_mock_options(arguments& args);
+
+    inline constexpr std::string_view mock_options_help =
+        "  --latency SPEC          fixed:5ms, uniform:2ms,10ms, exponential:5ms or lognormal:5ms,0.8 (default 0)\n"
+        "  --generation-latency SPEC  added for completions and chat completions (default 0)\n"
+        "  --audio-speed X         transcriptions take 1s per X seconds of audio (default 0: no extra delay)\n"
+        "  --stream-events N       events per streamed completion (default 16)\n"
+        "  --stream-interval D     delay between streamed events (default 0)\n"
+        "  --stream-fragment N     write streamed events N bytes at a time, --stream-interval apart (default 0: whole)\n"
+        "  --rate-limit F          share of requests answered 429 (default 0)\n"
+        "  --retry-after D         retry-after-ms sent with 429s (default 100ms)\n"
+        "  --server-errors F       share of requests answered 500/502/503 (default 0)\n"
+        "  --drop F                share of requests read and left unanswered, closing the connection (default 0)\n"
+        "  --no-gzip               never gzip responses\n"
+        "  --gzip-min N            smallest response body gzipped (default 1024)\n"
+        "  --no-h2                 offer only http/1.1 through ALPN\n"
+        "  --completion-words N    words per completion (default 16)\n"
+        "  --dimensions N          embedding dimensions (default 1536)\n"
+        "  --max-input-tokens N    longest embedding input accepted (default 8191)\n"
+        "  --image-bytes N         size of generated b64_json images (default 262144)\n"
+        "  --file-bytes N          size of the file served by /v1/files/{id}/content (default 8388608)\n"
+        "  --replay FILE           JSON Lines of recorded responses to serve\n"
+        "  --server-threads N      server threads (default 1)\n"
+        "  --seed N                random seed (default 1)\n";
+}
+
+#endif
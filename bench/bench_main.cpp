@@ -0,0 +1,1315 @@
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/json.hpp>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "allocations.h"
+#include "arguments.h"
+#include "embedding.h"
+#include "embedding_batcher.h"
+#include "load.h"
+#include "mock_server.h"
+#include "moderation.h"
+#include "openai.h"
+#include "runtime.h"
+#include "tokenizer.h"
+#include "transcriber.h"
+#include "workload.h"
+
+namespace {
+    constexpr std::string_view usage =
+        "usage: cppai_bench SUITE [options]\n"
+        "Drives the client against a mock server it forks for every run, at fixed open-loop arrival rates.\n"
+        "\n"
+        "suites:\n"
+        "  load        the workload as configured below\n"
+        "  transport   HTTP/1.1 against HTTP/2\n"
+        "  pool        keep-alive pooling on and off\n"
+        "  metrics     the cost of recording per-phase metrics\n"
+        "  gzip        bytes on the wire against CPU, with and without gzip\n"
+        "  dns         a slow resolver with and without the DNS cache, on fresh connections\n"
+        "  cache       deterministic embeddings and chat completions with and without the response cache, at several hit ratios\n"
+        "  transcribe  wall-clock time of a long recording against segment length\n"
+        "  batcher     single-input embeddings, direct and through embedding_batcher at several lingers\n"
+        "  schema      typed structs against the JSON DOM: parse and serialize time and allocations (no server)\n"
+        "  embedding   embeddings parsed into a matrix against the JSON DOM, and top-k search over the matrix (no server)\n"
+        "  tokenizer   BPE tokenizer throughput in MB/s, on one thread and across threads (no server)\n"
+        "  moderation  moderating then generating against moderated_chat, which overlaps the two\n"
+        "  cancel      long generations abandoned mid-flight by a per-call deadline and by partial and total cancellation\n"
+        "  images      b64_json image generations parsed whole against decoded to a sink and to files: peak RSS and MB/s\n"
+        "  upload      multipart transcription uploads of large files streamed from disk: peak RSS and MB/s\n"
+        "\n"
+        "options:\n"
+        "  --rates R,R,...         arrivals per second (default 100)\n"
+        "  --duration D            measured window per run (default 10s)\n"
+        "  --warmup D              unmeasured lead-in per run (default 1s)\n"
+        "  --even                  evenly spaced arrivals instead of a Poisson process\n"
+        "  --shards N              client runtime shards (default 1)\n"
+        "  --workload FILE         JSON Lines workload, e.g. requests.jsonl (default: a small built-in mix)\n"
+        "  --model NAME            model for text lines of the workload (default gpt-4o-mini)\n"
+        "  --transport T           http1 or http2 (default http1)\n"
+        "  --no-pool               open a connection per request\n"
+        "  --metrics               record per-phase metrics\n"
+        "  --max-per-host N        pooled connections per host (default 16)\n"
+        "  --max-attempts N        client attempts per call, including retries (default 3)\n"
+        "suite options:\n"
+        "  gzip:       --inputs N (inputs per embeddings request, default 64), --input-bytes N (default 1024)\n"
+        "  dns:        --resolver-delay D (default 20ms)\n"
+        "  cache:      --hit-ratios F,F,... (shares of calls repeating an earlier request, default 0,0.5,0.9,0.99),\n"
+        "              --hot N (distinct requests the repeats are drawn from, default 256)\n"
+        "  transcribe: --minutes N (default 10), --segments S,S,... (seconds, default 300,120,60,30),\n"
+        "              --concurrency N (default 4); the server defaults to --audio-speed 30\n"
+        "  batcher:    --lingers D,D,... (default 0,500us,2ms,10ms), --max-items N (default 256)\n"
+        "  schema:     --iterations N (default 2000)\n"
+        "  embedding:  --dims N,N,... (default 1536), --batch N,N,... (vectors per parsed response, default 16,2048),\n"
+        "              --corpus N,N,... (vectors searched, default 1000,10000,50000), --k N,N,... (default 1,10,100)\n"
+        "  tokenizer:  --vocab FILE (cl100k_base.tiktoken or a file written by --save), --text FILE,...\n"
+        "              (default: generated prose, code and JSON), --threads N,N,... (default 1,2,4,8),\n"
+        "              --save FILE (writes the mappable vocabulary)\n"
+        "  moderation: --flagged F (share of flagged prompts, default 0.1), --stream; the server defaults to\n"
+        "              --latency fixed:40ms --generation-latency fixed:200ms\n"
+        "  cancel:     --cancel-after DIST (when each call is abandoned, default uniform:1ms,1s), --stream; the\n"
+        "              server defaults to --generation-latency fixed:2s and, for streams, --stream-interval 100ms\n"
+        "  images:     --images N (per call, at most 10, default 10), --runs N (calls per variant, default 5); the\n"
+        "              server defaults to --image-bytes 1572864, about a 1024x1024 PNG\n"
+        "  upload:     --megabytes N,N,... (file sizes, below 512, default 100,300), --runs N (uploads per size,\n"
+        "              default 3)\n"
+        "mock server options:\n";
+
+    // A mock_server in a child process, so its CPU time and allocations stay out of the client's numbers.
+    class server_process {
+    public:
+        explicit server_process(cppai::bench::mock_options opts)
+            : ca{ boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cppai-bench-%%%%%%%%.pem") } {
+            int fds[2];
+            if (pipe(fds) != 0) {
+                throw std::system_error(errno, std::generic_category(), "pipe");
+            }
+            child = fork();
+            if (child < 0) {
+                throw std::system_error(errno, std::generic_category(), "fork");
+            }
+            if (child == 0) {
+                close(fds[0]);
+                serve(std::move(opts), fds[1]);
+            }
+            close(fds[1]);
+            const ssize_t read_size = read(fds[0], &listening, sizeof(listening));
+            close(fds[0]);
+            if (read_size != sizeof(listening) || listening == 0) {
+                stop();
+                throw std::runtime_error("the mock server did not start");
+            }
+        }
+
+        ~server_process() {
+            stop();
+        }
+
+        server_process(const server_process&) = delete;
+
+        server_process& operator=(const server_process&) = delete;
+
+        std::uint16_t port() const {
+            return listening;
+        }
+
+        std::string ca_file() const {
+            return ca.string();
+        }
+
+        cppai::bench::mock_counters counters() const {
+            namespace http = boost::beast::http;
+            boost::asio::io_context ctx;
+            boost::beast::tcp_stream stream{ ctx };
+            stream.connect(boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), listening });
+            http::request<http::empty_body> request{ http::verb::get, "/mock/stats", 11 };
+            request.set(http::field::host, "localhost");
+            http::write(stream, request);
+            boost::beast::flat_buffer buffer;
+            http::response<http::string_body> response;
+            http::read(stream, buffer, response);
+
+            const boost::json::object stats = boost::json::parse(response.body()).as_object();
+            const auto field = [&stats](std::string_view name) { return boost::json::value_to<std::uint64_t>(stats.at(name)); };
+            cppai::bench::mock_counters counters;
+            // Not counting the connection asking.
+            counters.connections = field("connections") - 1;
+            counters.tls_connections = field("tls_connections");
+            counters.h2_connections = field("h2_connections");
+            counters.requests = field("requests");
+            counters.rate_limited = field("rate_limited");
+            counters.server_errors = field("server_errors");
+            counters.replayed = field("replayed");
+            counters.bytes_in = field("bytes_in");
+            counters.bytes_out = field("bytes_out");
+            return counters;
+        }
+
+        // Clients still connected see their connections close, which lets a runtime's shards drain.
+        void stop() {
+            if (child > 0) {
+                kill(child, SIGTERM);
+                waitpid(child, nullptr, 0);
+                child = 0;
+                boost::system::error_code ignored;
+                boost::filesystem::remove(ca, ignored);
+            }
+        }
+
+    private:
+        boost::filesystem::path ca;
+        pid_t child = 0;
+        std::uint16_t listening = 0;
+
+        [[noreturn]] void serve(cppai::bench::mock_options opts, int ready) {
+            // Blocked before the server's threads exist, so they inherit the mask and sigwait gets the signal.
+            sigset_t stopping;
+            sigemptyset(&stopping);
+            sigaddset(&stopping, SIGTERM);
+            pthread_sigmask(SIG_BLOCK, &stopping, nullptr);
+            std::uint16_t port = 0;
+            try {
+                cppai::bench::mock_server server{ std::move(opts) };
+                server.start();
+                std::ofstream{ ca.string() } << server.certificate();
+                port = server.port();
+                [[maybe_unused]] const ssize_t written = write(ready, &port, sizeof(port));
+                int received = 0;
+                sigwait(&stopping, &received);
+                server.stop();
+                _exit(0);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "mock server: " << e.what() << '\n';
+            }
+            if (port == 0) {
+                [[maybe_unused]] const ssize_t written = write(ready, &port, sizeof(port));
+            }
+            _exit(1);
+        }
+    };
+
+    struct client_settings {
+        cppai::transport mode = cppai::transport::http1;
+        bool pool = true;
+        bool record_metrics = false;
+        bool accept_gzip = true;
+        bool gzip_requests = false;
+        std::size_t max_per_host = 16;
+        std::uint16_t max_attempts = 3;
+        // Null for a cache pinned to the server's port.
+        std::shared_ptr<cppai::dns_cache> dns;
+    };
+
+    void apply(cppai::openAI& client, const server_process& server, const client_settings& settings) {
+        client.set_api_key("sk-mock");
+        cppai::backend local;
+        local.host = "localhost";
+        local.port = std::to_string(server.port());
+        local.gzip_requests = settings.gzip_requests;
+        cppai::endpoint_config endpoints;
+        endpoints.backends = { local };
+        endpoints.ca_file = server.ca_file();
+        client.set_endpoints(std::move(endpoints));
+
+        std::shared_ptr<cppai::dns_cache> dns = settings.dns;
+        if (!dns) {
+            dns = std::make_shared<cppai::dns_cache>();
+            dns->pin(local.host, local.port, { boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), server.port() } });
+        }
+        client.set_dns_cache(std::move(dns));
+
+        cppai::pool_options pooling;
+        pooling.enabled = settings.pool;
+        pooling.max_per_host = settings.max_per_host;
+        client.set_pool_options(pooling);
+        cppai::request_policy policy;
+        policy.retries.max_attempts = settings.max_attempts;
+        policy.compression.accept_gzip = settings.accept_gzip;
+        client.set_policy(policy);
+        client.set_transport(settings.mode);
+        client.set_metrics(settings.record_metrics ? std::make_shared<cppai::metrics>() : nullptr);
+    }
+
+    struct bench_context {
+        cppai::bench::mock_options mock;
+        cppai::bench::load_options load;
+        std::vector<double> rates;
+        std::size_t shards = 1;
+        std::string model;
+        std::string workload;
+        client_settings client;
+    };
+
+    struct variant_result {
+        cppai::bench::load_report load;
+        cppai::bench::mock_counters server;
+    };
+
+    using setup_function = std::function<void(cppai::openAI& client, const server_process& server)>;
+
+    variant_result run_variant(const bench_context& ctx, const cppai::bench::mock_options& mock, double rate, const setup_function& setup,
+        const cppai::bench::call_function& call) {
+        // Forked before the runtime starts its threads.
+        server_process server{ mock };
+        variant_result result;
+        cppai::runtime_options runtime_opts;
+        runtime_opts.shards = ctx.shards;
+        cppai::runtime rt{ runtime_opts };
+        rt.configure([&](cppai::openAI& client) { setup(client, server); });
+        cppai::bench::load_options opts = ctx.load;
+        opts.rate = rate;
+        result.load = cppai::bench::run_load(rt, opts, call);
+        result.server = server.counters();
+        server.stop();
+        return result;
+    }
+
+    setup_function settings_setup(client_settings settings) {
+        return [settings = std::move(settings)](cppai::openAI& client, const server_process& server) { apply(client, server, settings); };
+    }
+
+    std::string rate_label(std::string_view name, double rate) {
+        char label[64];
+        std::snprintf(label, sizeof(label), "%.*s @ %g/s", static_cast<int>(name.size()), name.data(), rate);
+        return label;
+    }
+
+    cppai::bench::call_function workload_call(const std::vector<cppai::bench::workload_item>& items) {
+        return [&items](const cppai::openAI& client, std::uint64_t index) { return cppai::bench::issue(client, items[index % items.size()]); };
+    }
+
+    std::vector<cppai::bench::workload_item> workload_items(const bench_context& ctx) {
+        return ctx.workload.empty() ? cppai::bench::default_workload(ctx.model) : cppai::bench::read_workload(ctx.workload, ctx.model);
+    }
+
+    // Runs the workload once per rate for each named variant of the client settings.
+    void compare(const bench_context& ctx, const std::vector<std::pair<std::string, client_settings>>& variants, bool show_server = false) {
+        const std::vector<cppai::bench::workload_item> items = workload_items(ctx);
+        for (const double rate : ctx.rates) {
+            for (const auto& [name, settings] : variants) {
+                const variant_result result = run_variant(ctx, ctx.mock, rate, settings_setup(settings), workload_call(items));
+                cppai::bench::print_report(std::cout, rate_label(name, rate), result.load);
+                if (show_server) {
+                    std::cout << "    server: " << result.server.connections << " connections (" << result.server.h2_connections << " h2), "
+                              << result.server.requests << " requests\n";
+                }
+            }
+        }
+    }
+
+    int run_load_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        args.finish();
+        compare(ctx, { { "load", ctx.client } }, true);
+        return 0;
+    }
+
+    int run_transport_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        args.finish();
+        client_settings http1 = ctx.client;
+        http1.mode = cppai::transport::http1;
+        client_settings http2 = ctx.client;
+        http2.mode = cppai::transport::http2;
+        compare(ctx, { { "http1", http1 }, { "http2", http2 } }, true);
+        return 0;
+    }
+
+    int run_pool_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        args.finish();
+        client_settings pooled = ctx.client;
+        pooled.pool = true;
+        client_settings unpooled = ctx.client;
+        unpooled.pool = false;
+        compare(ctx, { { "pooled", pooled }, { "connection per request", unpooled } }, true);
+        return 0;
+    }
+
+    int run_metrics_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        args.finish();
+        const std::vector<cppai::bench::workload_item> items = workload_items(ctx);
+        client_settings off = ctx.client;
+        off.record_metrics = false;
+        client_settings on = ctx.client;
+        on.record_metrics = true;
+        for (const double rate : ctx.rates) {
+            const variant_result without = run_variant(ctx, ctx.mock, rate, settings_setup(off), workload_call(items));
+            const variant_result with = run_variant(ctx, ctx.mock, rate, settings_setup(on), workload_call(items));
+            cppai::bench::print_report(std::cout, rate_label("metrics off", rate), without.load);
+            cppai::bench::print_report(std::cout, rate_label("metrics on", rate), with.load);
+            const auto per_call = [](const cppai::bench::load_report& report) {
+                return report.cpu_seconds / static_cast<double>(std::max<std::uint64_t>(report.completed + report.failed, 1));
+            };
+            std::printf("    cpu overhead %+.2f%%, p99 %+.2f%%\n", (per_call(with.load) / per_call(without.load) - 1) * 100,
+                (static_cast<double>(with.load.latency.quantile(0.99).count()) /
+                    static_cast<double>(std::max(without.load.latency.quantile(0.99), std::chrono::microseconds(1)).count()) - 1) * 100);
+        }
+        return 0;
+    }
+
+    int run_gzip_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::uint64_t inputs = args.count_or("inputs", 64);
+        const std::uint64_t input_bytes = args.count_or("input-bytes", 1024);
+        args.finish();
+
+        // Embedding batches are the large bodies both ways: long inputs out, float arrays back.
+        std::vector<cppai::bench::workload_item> items;
+        for (std::uint64_t request = 0; request < 16; ++request) {
+            boost::json::array texts;
+            for (std::uint64_t i = 0; i < inputs; ++i) {
+                std::string text = "document " + std::to_string(request * inputs + i) + ":";
+                while (text.size() < input_bytes) {
+                    text.append(" the quick brown fox jumps over the lazy dog");
+                }
+                texts.emplace_back(text);
+            }
+            items.push_back({ "/v1/embeddings", boost::json::object{ { "model", "text-embedding-3-small" }, { "input", std::move(texts) } } });
+        }
+
+        client_settings plain = ctx.client;
+        plain.accept_gzip = false;
+        plain.gzip_requests = false;
+        client_settings compressed = ctx.client;
+        compressed.accept_gzip = true;
+        compressed.gzip_requests = true;
+        for (const double rate : ctx.rates) {
+            for (const auto& [name, settings] : { std::pair{ "identity", plain }, std::pair{ "gzip", compressed } }) {
+                const variant_result result = run_variant(ctx, ctx.mock, rate, settings_setup(settings), workload_call(items));
+                cppai::bench::print_report(std::cout, rate_label(name, rate), result.load);
+                const double requests = static_cast<double>(std::max<std::uint64_t>(result.server.requests, 1));
+                std::printf("    on the wire: %.0f B/req sent, %.0f B/req received\n", static_cast<double>(result.server.bytes_in) / requests,
+                    static_cast<double>(result.server.bytes_out) / requests);
+            }
+        }
+        return 0;
+    }
+
+    boost::asio::awaitable<cppai::dns_answer> slow_resolve(std::chrono::microseconds delay, std::uint16_t port) {
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        co_return cppai::dns_answer{ { boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), port } }, std::nullopt };
+    }
+
+    int run_dns_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::chrono::microseconds delay = args.duration_or("resolver-delay", std::chrono::milliseconds(20));
+        args.finish();
+        const std::vector<cppai::bench::workload_item> items = workload_items(ctx);
+
+        // Every request opens a connection, so every request resolves; only the cache decides whether it waits.
+        cppai::dns_options uncached;
+        uncached.ttl = std::chrono::steady_clock::duration::zero();
+        uncached.min_ttl = std::chrono::steady_clock::duration::zero();
+        for (const double rate : ctx.rates) {
+            for (const auto& [name, options] : { std::pair{ "dns cached", cppai::dns_options{} }, std::pair{ "dns uncached", uncached } }) {
+                const setup_function setup = [&ctx, delay, options](cppai::openAI& client, const server_process& server) {
+                    client_settings settings = ctx.client;
+                    settings.pool = false;
+                    settings.dns = std::make_shared<cppai::dns_cache>(options);
+                    settings.dns->set_resolver([delay, port = server.port()](const std::string&, const std::string&) { return slow_resolve(delay, port); });
+                    apply(client, server, settings);
+                };
+                const variant_result result = run_variant(ctx, ctx.mock, rate, setup, workload_call(items));
+                cppai::bench::print_report(std::cout, rate_label(name, rate), result.load);
+            }
+        }
+        return 0;
+    }
+
+    // 16 kHz mono 16-bit PCM: a tone with 400 ms of silence every 7 seconds, for segments to be cut at.
+    // The request behind key: embeddings for even keys and temperature 0 chat completions for odd ones, both of
+    // which the response cache answers.
+    cppai::bench::workload_item cacheable_item(std::uint64_t key, const std::string& model) {
+        if (key % 2 == 0) {
+            return { "/v1/embeddings", boost::json::object{ { "model", "text-embedding-3-small" }, { "input", "document " + std::to_string(key) } } };
+        }
+        return { "/v1/chat/completions", boost::json::object{ { "model", model }, { "temperature", 0 },
+            { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", "question " + std::to_string(key) } } } } } };
+    }
+
+    // With probability hit_ratio the call repeats one of hot requests seen before; otherwise it is a request
+    // no earlier call made.
+    boost::asio::awaitable<void> cache_call(const cppai::openAI& client, std::uint64_t index, double hit_ratio, std::uint64_t hot, std::uint64_t seed,
+        const std::string& model) {
+        std::mt19937_64 rng{ seed ^ (index * 0x9e3779b97f4a7c15) };
+        const bool repeat = std::uniform_real_distribution<double>{ 0, 1 }(rng) < hit_ratio;
+        const cppai::bench::workload_item item = cacheable_item(repeat ? rng() % hot : hot + index, model);
+        co_await cppai::bench::issue(client, item);
+    }
+
+    int run_cache_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::vector<std::string> ratios = args.list_or("hit-ratios", { "0", "0.5", "0.9", "0.99" });
+        const std::uint64_t hot = std::max<std::uint64_t>(args.count_or("hot", 256), 1);
+        args.finish();
+
+        for (const double rate : ctx.rates) {
+            // Without a cache the hit ratio changes nothing but which requests go out.
+            std::vector<std::pair<std::string, std::optional<double>>> variants = { { "no cache", std::nullopt } };
+            for (const std::string& ratio : ratios) {
+                variants.emplace_back("cache, " + ratio + " repeats", std::stod(ratio));
+            }
+            for (const auto& [name, ratio] : variants) {
+                const std::shared_ptr<cppai::response_cache> cache = ratio.has_value() ? std::make_shared<cppai::response_cache>() : nullptr;
+                const setup_function setup = [&ctx, cache](cppai::openAI& client, const server_process& server) {
+                    apply(client, server, ctx.client);
+                    client.set_cache(cache);
+                };
+                const double hit_ratio = ratio.value_or(0);
+                const cppai::bench::call_function call = [&ctx, hit_ratio, hot](const cppai::openAI& client, std::uint64_t index) {
+                    return cache_call(client, index, hit_ratio, hot, ctx.mock.seed, ctx.model);
+                };
+                const variant_result result = run_variant(ctx, ctx.mock, rate, setup, call);
+                cppai::bench::print_report(std::cout, rate_label(name, rate), result.load);
+                if (cache) {
+                    // Counted over the warmup too, which is when the hot requests are first fetched.
+                    const cppai::cache_counters counters = cache->counters();
+                    const std::uint64_t lookups = counters.hits + counters.misses + counters.coalesced;
+                    std::printf("    cache: %llu hits, %llu misses, %llu coalesced, %.1f%% answered without a request; server saw %llu requests\n",
+                        static_cast<unsigned long long>(counters.hits), static_cast<unsigned long long>(counters.misses),
+                        static_cast<unsigned long long>(counters.coalesced),
+                        static_cast<double>(counters.hits + counters.coalesced) * 100 / static_cast<double>(std::max<std::uint64_t>(lookups, 1)),
+                        static_cast<unsigned long long>(result.server.requests));
+                }
+            }
+        }
+        return 0;
+    }
+
+    void write_recording(const boost::filesystem::path& path, std::chrono::seconds length) {
+        constexpr std::uint32_t sample_rate = 16000;
+        const std::uint32_t samples = static_cast<std::uint32_t>(length.count()) * sample_rate;
+        const std::uint32_t data_size = samples * 2;
+        std::ofstream out{ path.string(), std::ios::binary };
+        const auto u16 = [&out](std::uint16_t value) {
+            const char bytes[] = { static_cast<char>(value & 0xff), static_cast<char>(value >> 8) };
+            out.write(bytes, sizeof(bytes));
+        };
+        const auto u32 = [&u16](std::uint32_t value) {
+            u16(static_cast<std::uint16_t>(value & 0xffff));
+            u16(static_cast<std::uint16_t>(value >> 16));
+        };
+        out.write("RIFF", 4);
+        u32(36 + data_size);
+        out.write("WAVEfmt ", 8);
+        u32(16);
+        u16(1);
+        u16(1);
+        u32(sample_rate);
+        u32(sample_rate * 2);
+        u16(2);
+        u16(16);
+        out.write("data", 4);
+        u32(data_size);
+
+        std::vector<char> block;
+        block.reserve(sample_rate * 2);
+        for (std::uint32_t i = 0; i < samples; ++i) {
+            const bool silent = i % (7 * sample_rate) >= 7 * sample_rate - sample_rate * 2 / 5;
+            const auto value = static_cast<std::int16_t>(silent ? 0 : std::lround(8000 * std::sin(2 * std::numbers::pi * 220 * i / sample_rate)));
+            block.push_back(static_cast<char>(value & 0xff));
+            block.push_back(static_cast<char>((value >> 8) & 0xff));
+            if (block.size() == block.capacity()) {
+                out.write(block.data(), static_cast<std::streamsize>(block.size()));
+                block.clear();
+            }
+        }
+        out.write(block.data(), static_cast<std::streamsize>(block.size()));
+    }
+
+    int run_transcribe_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::uint64_t minutes = args.count_or("minutes", 10);
+        const std::vector<std::string> lengths = args.list_or("segments", { "300", "120", "60", "30" });
+        const std::uint64_t concurrency = args.count_or("concurrency", 4);
+        args.finish();
+
+        cppai::bench::mock_options mock = ctx.mock;
+        if (mock.audio_speed == 0) {
+            mock.audio_speed = 30;
+        }
+        const boost::filesystem::path recording = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cppai-bench-%%%%%%%%.wav");
+        write_recording(recording, std::chrono::minutes(minutes));
+        const cppai::wav_format format = cppai::read_wav_format(recording);
+
+        for (const std::string& length : lengths) {
+            cppai::transcription_options opts;
+            opts.segments.length = std::chrono::seconds(std::stoul(length));
+            opts.concurrency = concurrency;
+            const std::size_t segments = cppai::plan_segments(recording, format, opts.segments).size();
+
+            server_process server{ mock };
+            boost::asio::io_context io{ 1 };
+            cppai::openAI client;
+            apply(client, server, ctx.client);
+            const cppai::chunked_transcriber transcriber{ client, opts };
+            std::optional<cppai::transcript> result;
+            std::string failure;
+            const auto started = std::chrono::steady_clock::now();
+            boost::asio::co_spawn(io, [&]() -> boost::asio::awaitable<cppai::transcript> { co_return co_await transcriber.run(recording, "whisper-1"); },
+                [&](std::exception_ptr error, cppai::transcript text) {
+                    if (!error) {
+                        result = std::move(text);
+                        return;
+                    }
+                    try {
+                        std::rethrow_exception(error);
+                    }
+                    catch (const std::exception& e) {
+                        failure = e.what();
+                    }
+                });
+            io.run();
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+            server.stop();
+
+            std::printf("%-28s %4zu segments  %4llu concurrent  %8.2f s wall  %s\n", (std::to_string(minutes) + " min @ " + length + " s segments").c_str(),
+                segments, static_cast<unsigned long long>(concurrency), elapsed.count(),
+                result.has_value() ? (std::to_string(result->text.size()) + " chars").c_str() : ("failed: " + failure).c_str());
+        }
+        boost::system::error_code ignored;
+        boost::filesystem::remove(recording, ignored);
+        return 0;
+    }
+
+    int run_batcher_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::vector<std::string> lingers = args.list_or("lingers", { "0", "500us", "2ms", "10ms" });
+        const std::uint64_t max_items = args.count_or("max-items", 256);
+        args.finish();
+
+        const std::string model = "text-embedding-3-small";
+        const auto input = [](std::uint64_t index) { return "sentence number " + std::to_string(index) + " to embed"; };
+        for (const double rate : ctx.rates) {
+            const cppai::bench::call_function direct = [&](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+                const cppai::embedding_result result = co_await client.create_embedding_matrix(boost::json::object{ { "model", model }, { "input", input(index) } });
+                if (result.vectors.rows() != 1) {
+                    throw std::runtime_error("expected one embedding");
+                }
+            };
+            cppai::bench::print_report(std::cout, rate_label("direct", rate), run_variant(ctx, ctx.mock, rate, settings_setup(ctx.client), direct).load);
+
+            for (const std::string& linger : lingers) {
+                // One batcher per shard, each bound to that shard's client.
+                std::mutex mtx;
+                std::map<const cppai::openAI*, std::unique_ptr<cppai::embedding_batcher>> batchers;
+                cppai::embedding_batch_options opts;
+                opts.linger = cppai::bench::parse_micros(linger);
+                opts.max_items = max_items;
+                const setup_function setup = [&](cppai::openAI& client, const server_process& server) {
+                    apply(client, server, ctx.client);
+                    std::lock_guard lock{ mtx };
+                    batchers[&client] = std::make_unique<cppai::embedding_batcher>(client, opts);
+                };
+                const cppai::bench::call_function batched = [&](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+                    const std::vector<float> vector = co_await batchers.at(&client)->embed(model, input(index));
+                    if (vector.empty()) {
+                        throw std::runtime_error("empty embedding");
+                    }
+                };
+                const variant_result result = run_variant(ctx, ctx.mock, rate, setup, batched);
+                cppai::bench::print_report(std::cout, rate_label("batched, linger " + linger, rate), result.load);
+                cppai::embedding_batch_counters total;
+                for (const auto& [client, batcher] : batchers) {
+                    const cppai::embedding_batch_counters counters = batcher->counters();
+                    total.calls += counters.calls;
+                    total.batches += counters.batches;
+                    total.splits += counters.splits;
+                }
+                std::printf("    %llu batches, %.1f inputs per batch, %llu splits\n", static_cast<unsigned long long>(total.batches),
+                    static_cast<double>(total.calls) / static_cast<double>(std::max<std::uint64_t>(total.batches, 1)),
+                    static_cast<unsigned long long>(total.splits));
+            }
+        }
+        return 0;
+    }
+
+    // Results go here so the measured work is not optimized away.
+    volatile std::size_t sink = 0;
+
+    template <class F>
+    void measure(std::string_view label, std::uint64_t iterations, F&& body) {
+        for (std::uint64_t i = 0; i < std::max<std::uint64_t>(iterations / 10, 1); ++i) {
+            sink = sink + body();
+        }
+        const cppai::bench::allocation_count before = cppai::bench::allocations();
+        const auto started = std::chrono::steady_clock::now();
+        for (std::uint64_t i = 0; i < iterations; ++i) {
+            sink = sink + body();
+        }
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - started;
+        const cppai::bench::allocation_count allocated = cppai::bench::allocations() - before;
+        const double n = static_cast<double>(std::max<std::uint64_t>(iterations, 1));
+        std::printf("%-44.*s %12.0f ns/op %10.1f allocs/op %12.0f B/op\n", static_cast<int>(label.size()), label.data(), elapsed.count() / n,
+            static_cast<double>(allocated.calls) / n, static_cast<double>(allocated.bytes) / n);
+    }
+
+    int run_schema_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::uint64_t iterations = args.count_or("iterations", 2000);
+        args.finish();
+
+        std::string long_text;
+        while (long_text.size() < 2048) {
+            long_text.append("Explain how connection pooling reduces tail latency for chat completions. ");
+        }
+        cppai::chat_request request;
+        request.model = ctx.model;
+        request.messages = { cppai::chat_message{ "system", "You are a terse assistant." }, cppai::chat_message{ "user", long_text } };
+        request.temperature = 0.2;
+        request.max_tokens = 256;
+        request.stop = std::vector<std::string>{ "\n\n" };
+        request.seed = 7;
+        request.user = "bench";
+        const boost::json::value request_dom = boost::json::parse(cppai::to_json(request));
+
+        const std::string chat_text = boost::json::serialize(boost::json::object{ { "id", "chatcmpl-bench" }, { "object", "chat.completion" },
+            { "created", 1700000000 }, { "model", ctx.model },
+            { "choices", boost::json::array{ boost::json::object{ { "index", 0 }, { "finish_reason", "stop" },
+                { "message", boost::json::object{ { "role", "assistant" }, { "content", long_text.substr(0, 1024) } } } } } },
+            { "usage", boost::json::object{ { "prompt_tokens", 512 }, { "completion_tokens", 256 }, { "total_tokens", 768 } } },
+            { "system_fingerprint", "fp_bench" } });
+
+        boost::json::array items;
+        for (std::size_t i = 0; i < 16; ++i) {
+            boost::json::array values;
+            for (std::size_t j = 0; j < 1536; ++j) {
+                values.emplace_back(std::sin(static_cast<double>(i * 1536 + j)) * 0.05);
+            }
+            items.push_back(boost::json::object{ { "object", "embedding" }, { "index", i }, { "embedding", std::move(values) } });
+        }
+        const std::string embedding_text = boost::json::serialize(boost::json::object{ { "object", "list" }, { "data", std::move(items) },
+            { "model", "text-embedding-3-small" }, { "usage", boost::json::object{ { "prompt_tokens", 64 }, { "total_tokens", 64 } } } });
+
+        measure("serialize chat_request: typed", iterations, [&] { return cppai::to_json(request).size(); });
+        measure("serialize chat_request: json::value", iterations, [&] { return boost::json::serialize(request_dom).size(); });
+        measure("parse chat_response: typed", iterations, [&] { return cppai::parse_typed<cppai::chat_response>(chat_text).choices.size(); });
+        measure("parse chat_response: json::parse", iterations, [&] { return boost::json::parse(chat_text).as_object().size(); });
+        measure("parse chat_response: json_decoder (arena)", iterations, [&] { return cppai::json_decoder{}(200, chat_text).as_object().size(); });
+        measure("parse embeddings: typed", iterations / 10, [&] { return cppai::parse_typed<cppai::embedding_response>(embedding_text).data.size(); });
+        measure("parse embeddings: json::parse", iterations / 10, [&] { return boost::json::parse(embedding_text).as_object().size(); });
+        measure("parse embeddings: json_decoder (arena)", iterations / 10, [&] { return cppai::json_decoder{}(200, embedding_text).as_object().size(); });
+        measure("parse embeddings: embedding_decoder", iterations / 10, [&] { return cppai::embedding_decoder{}(200, embedding_text).vectors.rows(); });
+        return 0;
+    }
+
+    std::string base64_encode(std::string_view bytes) {
+        constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        out.reserve((bytes.size() + 2) / 3 * 4);
+        for (std::size_t i = 0; i < bytes.size(); i += 3) {
+            const std::size_t left = bytes.size() - i;
+            std::uint32_t group = static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[i])) << 16;
+            if (left > 1) {
+                group |= static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[i + 1])) << 8;
+            }
+            if (left > 2) {
+                group |= static_cast<unsigned char>(bytes[i + 2]);
+            }
+            out.push_back(alphabet[(group >> 18) & 63]);
+            out.push_back(alphabet[(group >> 12) & 63]);
+            out.push_back(left > 1 ? alphabet[(group >> 6) & 63] : '=');
+            out.push_back(left > 2 ? alphabet[group & 63] : '=');
+        }
+        return out;
+    }
+
+    // An embeddings response of rows vectors, as float arrays or with encoding_format "base64".
+    std::string embeddings_body(std::size_t rows, std::size_t dims, bool base64) {
+        boost::json::array items;
+        std::vector<float> values(dims);
+        for (std::size_t i = 0; i < rows; ++i) {
+            for (std::size_t j = 0; j < dims; ++j) {
+                values[j] = static_cast<float>(std::sin(static_cast<double>(i * dims + j)) * 0.05);
+            }
+            boost::json::value embedding;
+            if (base64) {
+                embedding = base64_encode(std::string_view{ reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float) });
+            }
+            else {
+                embedding = boost::json::value_from(values);
+            }
+            items.push_back(boost::json::object{ { "object", "embedding" }, { "index", i }, { "embedding", std::move(embedding) } });
+        }
+        return boost::json::serialize(boost::json::object{ { "object", "list" }, { "data", std::move(items) }, { "model", "text-embedding-3-small" },
+            { "usage", boost::json::object{ { "prompt_tokens", rows * 8 }, { "total_tokens", rows * 8 } } } });
+    }
+
+    int run_embedding_suite(bench_context&, cppai::bench::arguments& args) {
+        const std::vector<std::string> dims_list = args.list_or("dims", { "1536" });
+        const std::vector<std::string> batches = args.list_or("batch", { "16", "2048" });
+        const std::vector<std::string> corpora = args.list_or("corpus", { "1000", "10000", "50000" });
+        const std::vector<std::string> ks = args.list_or("k", { "1", "10", "100" });
+        args.finish();
+
+        // Enough iterations for about this many floats per measurement, whatever the shape.
+        constexpr double floats_per_measurement = 2e7;
+        const auto iterations_for = [](std::size_t floats) {
+            return static_cast<std::uint64_t>(std::max(floats_per_measurement / static_cast<double>(std::max<std::size_t>(floats, 1)), 1.0));
+        };
+
+        for (const std::string& dims_text : dims_list) {
+            const std::size_t dims = std::stoul(dims_text);
+            for (const std::string& batch : batches) {
+                const std::size_t rows = std::stoul(batch);
+                const std::string shape = batch + "x" + dims_text;
+                const std::uint64_t iterations = iterations_for(rows * dims);
+                const std::string floats = embeddings_body(rows, dims, false);
+                const std::string encoded = embeddings_body(rows, dims, true);
+                measure("parse " + shape + " floats: json::parse", iterations, [&] { return boost::json::parse(floats).as_object().size(); });
+                measure("parse " + shape + " floats: parse_embeddings", iterations, [&] { return cppai::parse_embeddings(floats, rows).vectors.rows(); });
+                measure("parse " + shape + " base64: parse_embeddings", iterations, [&] { return cppai::parse_embeddings(encoded, rows).vectors.rows(); });
+            }
+
+            std::mt19937_64 rng{ 11 };
+            std::normal_distribution<float> normal;
+            std::vector<float> query(dims);
+            for (float& value : query) {
+                value = normal(rng);
+            }
+            for (const std::string& corpus : corpora) {
+                const std::size_t rows = std::stoul(corpus);
+                cppai::embedding_matrix matrix{ rows, dims };
+                for (std::size_t i = 0; i < rows; ++i) {
+                    for (float& value : matrix.row(i)) {
+                        value = normal(rng);
+                    }
+                }
+                const std::string shape = corpus + "x" + dims_text;
+                const std::uint64_t iterations = iterations_for(rows * dims);
+                // What the kernels replace: one plain loop per row, left to the compiler's own vectorization.
+                measure("scan " + shape + ": scalar dot, for reference", iterations, [&] {
+                    std::size_t best = 0;
+                    float best_score = -std::numeric_limits<float>::infinity();
+                    for (std::size_t i = 0; i < rows; ++i) {
+                        const std::span<const float> row = std::as_const(matrix).row(i);
+                        float score = 0;
+                        for (std::size_t j = 0; j < dims; ++j) {
+                            score += row[j] * query[j];
+                        }
+                        if (score > best_score) {
+                            best = i;
+                            best_score = score;
+                        }
+                    }
+                    return best;
+                });
+                for (const std::string& k : ks) {
+                    const std::size_t count = std::stoul(k);
+                    for (const cppai::similarity metric : { cppai::similarity::dot, cppai::similarity::cosine }) {
+                        const std::string name = metric == cppai::similarity::dot ? "dot" : "cosine";
+                        measure("top_k " + shape + ", k " + k + ", " + name, iterations, [&] { return cppai::top_k(matrix, query, count, metric).front().row; });
+                    }
+                }
+            }
+        }
+        return 0;
+    }
+
+    int run_moderation_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const double flagged_share = args.number_or("flagged", 0.1);
+        const bool stream = args.flag("stream");
+        args.finish();
+
+        cppai::bench::mock_options mock = ctx.mock;
+        const auto unset = [](const cppai::bench::latency_distribution& latency) {
+            return latency.kind == cppai::bench::latency_distribution::shape::fixed && latency.first.count() == 0;
+        };
+        if (unset(mock.latency)) {
+            mock.latency = cppai::bench::latency_distribution::parse("fixed:40ms");
+        }
+        if (unset(mock.generation_latency)) {
+            mock.generation_latency = cppai::bench::latency_distribution::parse("fixed:200ms");
+        }
+
+        // The mock flags any input containing "[violence]".
+        const auto request = [&](std::uint64_t index) {
+            const bool flagged = static_cast<double>((index * 0x9E3779B97F4A7C15ULL) >> 11) / 9007199254740992.0 < flagged_share;
+            std::string prompt = "Prompt " + std::to_string(index) + ": write a short story about a lighthouse keeper.";
+            if (flagged) {
+                prompt.append(" [violence]");
+            }
+            boost::json::object body{ { "model", ctx.model },
+                { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", std::move(prompt) } } } } };
+            if (stream) {
+                body["stream"] = true;
+            }
+            return boost::json::value{ std::move(body) };
+        };
+        const auto ignore = [](const boost::json::value&) {};
+
+        for (const double rate : ctx.rates) {
+            const cppai::bench::call_function sequential = [&](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+                const boost::json::value body = request(index);
+                const boost::json::value verdict = co_await client.create_moderations(
+                    boost::json::object{ { "input", body.as_object().at("messages").as_array().at(0).as_object().at("content") } });
+                if (verdict.as_object().at("results").as_array().at(0).as_object().at("flagged").as_bool()) {
+                    co_return;
+                }
+                if (stream) {
+                    co_await client.chat_completion_stream(body, ignore);
+                }
+                else {
+                    co_await client.chat_completion(body);
+                }
+            };
+            cppai::bench::print_report(std::cout, rate_label("sequential", rate), run_variant(ctx, mock, rate, settings_setup(ctx.client), sequential).load);
+
+            std::mutex mtx;
+            std::map<const cppai::openAI*, std::unique_ptr<cppai::moderated_chat>> pipelines;
+            const setup_function setup = [&](cppai::openAI& client, const server_process& server) {
+                apply(client, server, ctx.client);
+                std::lock_guard lock{ mtx };
+                pipelines[&client] = std::make_unique<cppai::moderated_chat>(client);
+            };
+            const cppai::bench::call_function overlapped = [&](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+                const boost::json::value body = request(index);
+                const cppai::moderated_chat& pipeline = *pipelines.at(&client);
+                if (stream) {
+                    co_await pipeline.chat_completion_stream(body, ignore);
+                }
+                else {
+                    co_await pipeline.chat_completion(body);
+                }
+            };
+            const variant_result result = run_variant(ctx, mock, rate, setup, overlapped);
+            cppai::bench::print_report(std::cout, rate_label("overlapped", rate), result.load);
+            cppai::moderation_counters total;
+            for (const auto& [client, pipeline] : pipelines) {
+                const cppai::moderation_counters counters = pipeline->counters();
+                total.calls += counters.calls;
+                total.flagged += counters.flagged;
+                total.cancelled += counters.cancelled;
+                total.discarded_events += counters.discarded_events;
+                total.latency_saved += counters.latency_saved;
+                total.generation_wasted += counters.generation_wasted;
+            }
+            const auto millis = [](std::chrono::steady_clock::duration total_time, std::uint64_t calls) {
+                return std::chrono::duration<double, std::milli>(total_time).count() / static_cast<double>(std::max<std::uint64_t>(calls, 1));
+            };
+            std::printf("    %llu calls, %llu flagged (%llu generations cancelled, %llu events discarded), %.2f ms saved per call, "
+                        "%.2f ms generation wasted per flagged call\n",
+                static_cast<unsigned long long>(total.calls), static_cast<unsigned long long>(total.flagged),
+                static_cast<unsigned long long>(total.cancelled), static_cast<unsigned long long>(total.discarded_events),
+                millis(total.latency_saved, total.calls), millis(total.generation_wasted, total.flagged));
+        }
+        return 0;
+    }
+
+    // Runs call under a cancellation signal that fires after the given time; returns whether it was cancelled.
+    boost::asio::awaitable<bool> cancel_after(boost::asio::awaitable<void> call, std::chrono::microseconds after, boost::asio::cancellation_type type) {
+        auto executor = co_await boost::asio::this_coro::executor;
+        // Shared with the timer's handler, which may still be queued when this returns.
+        auto stop = std::make_shared<boost::asio::cancellation_signal>();
+        boost::asio::steady_timer timer{ executor, after };
+        timer.async_wait([stop, type](boost::system::error_code error_code) {
+            if (!error_code) {
+                stop->emit(type);
+            }
+        });
+        try {
+            co_await boost::asio::co_spawn(executor, std::move(call), boost::asio::bind_cancellation_slot(stop->slot(), boost::asio::use_awaitable));
+        }
+        catch (const boost::system::system_error& e) {
+            if (e.code() != boost::asio::error::operation_aborted) {
+                throw;
+            }
+            co_return true;
+        }
+        co_return false;
+    }
+
+    int run_cancel_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const cppai::bench::latency_distribution after = cppai::bench::latency_distribution::parse(args.text_or("cancel-after", "uniform:1ms,1s"));
+        const bool stream = args.flag("stream");
+        args.finish();
+
+        cppai::bench::mock_options mock = ctx.mock;
+        if (mock.generation_latency.kind == cppai::bench::latency_distribution::shape::fixed && mock.generation_latency.first.count() == 0) {
+            mock.generation_latency = cppai::bench::latency_distribution::parse("fixed:2s");
+        }
+        if (stream && mock.stream_interval.count() == 0) {
+            mock.stream_interval = std::chrono::milliseconds(100);
+        }
+
+        const auto ignore = [](const boost::json::value&) {};
+        const auto issue = [&](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+            const boost::json::value body = boost::json::object{ { "model", ctx.model }, { "messages", boost::json::array{ boost::json::object{
+                { "role", "user" }, { "content", "Prompt " + std::to_string(index) + ": write a long story about a lighthouse keeper." } } } } };
+            if (stream) {
+                co_await client.chat_completion_stream(body, ignore);
+            }
+            else {
+                co_await client.chat_completion(body);
+            }
+        };
+        const auto delay = [&](std::uint64_t index) {
+            std::mt19937_64 rng{ ctx.mock.seed * 0x9E3779B97F4A7C15ULL + index };
+            return after.sample(rng);
+        };
+
+        // Latency is the time until a call gave up its connection or stream and returned; total cancellation
+        // leaves calls that were already sent to finish.
+        for (const double rate : ctx.rates) {
+            std::atomic<std::uint64_t> cancelled = 0;
+            std::atomic<std::uint64_t> finished = 0;
+            const auto report = [&](std::string_view name, const variant_result& result) {
+                cppai::bench::print_report(std::cout, rate_label(name, rate), result.load);
+                std::printf("    %llu cancelled, %llu finished; server: %llu connections (%llu h2), %llu requests, %.1f KB sent\n",
+                    static_cast<unsigned long long>(cancelled.exchange(0)), static_cast<unsigned long long>(finished.exchange(0)),
+                    static_cast<unsigned long long>(result.server.connections), static_cast<unsigned long long>(result.server.h2_connections),
+                    static_cast<unsigned long long>(result.server.requests), static_cast<double>(result.server.bytes_out) / 1024.0);
+            };
+
+            const cppai::bench::call_function deadline = [&](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+                try {
+                    co_await cppai::with_timeout(issue(client, index), delay(index));
+                }
+                catch (const boost::system::system_error& e) {
+                    if (e.code() != boost::beast::error::timeout) {
+                        throw;
+                    }
+                    ++cancelled;
+                    co_return;
+                }
+                ++finished;
+            };
+            report("deadline", run_variant(ctx, mock, rate, settings_setup(ctx.client), deadline));
+
+            for (const auto& [name, type] : { std::pair{ "partial", boost::asio::cancellation_type::partial },
+                     std::pair{ "total", boost::asio::cancellation_type::total } }) {
+                const cppai::bench::call_function signalled = [&, type](const cppai::openAI& client, std::uint64_t index) -> boost::asio::awaitable<void> {
+                    if (co_await cancel_after(issue(client, index), delay(index), type)) {
+                        ++cancelled;
+                    }
+                    else {
+                        ++finished;
+                    }
+                };
+                report(name, run_variant(ctx, mock, rate, settings_setup(ctx.client), signalled));
+            }
+        }
+        return 0;
+    }
+
+    // Runs body until a second has passed and prints the rate at which it gets through bytes per call.
+    template <class F>
+    void measure_rate(std::string_view label, std::size_t bytes, F&& body) {
+        sink = sink + body();
+        const cppai::bench::allocation_count before = cppai::bench::allocations();
+        const auto started = std::chrono::steady_clock::now();
+        std::uint64_t calls = 0;
+        std::chrono::duration<double> elapsed{ 0 };
+        while (elapsed < std::chrono::seconds(1)) {
+            sink = sink + body();
+            ++calls;
+            elapsed = std::chrono::steady_clock::now() - started;
+        }
+        const cppai::bench::allocation_count allocated = cppai::bench::allocations() - before;
+        std::printf("%-44.*s %10.1f MB/s %12.1f allocs/MB\n", static_cast<int>(label.size()), label.data(),
+            static_cast<double>(bytes) * static_cast<double>(calls) / elapsed.count() / 1e6,
+            static_cast<double>(allocated.calls) / (static_cast<double>(bytes) * static_cast<double>(calls) / 1e6));
+    }
+
+    // A few megabytes mixing prose, code, JSON and text outside ASCII, in the proportions chat traffic has them.
+    std::string generated_text() {
+        constexpr std::string_view samples[] = {
+            "The quick brown fox jumps over the lazy dog, doesn't it? Connection pooling keeps tail latency low. ",
+            "In 2023 the team measured 1,234 requests per second at a p99 of 87.5 ms, well under the 250 ms target.\n\n",
+            "    for (std::size_t i = 0; i < values.size(); ++i) {\n        total += values[i] * weights[i];\n    }\n",
+            "{\"model\": \"gpt-4o-mini\", \"messages\": [{\"role\": \"user\", \"content\": \"Summarize this.\"}], \"temperature\": 0.2}\n",
+            "Les résultats étaient très encourageants. Die Ergebnisse waren sehr ermutigend. 結果は非常に有望でした。 ",
+            "def tokenize(text):\n\treturn [piece for piece in pattern.findall(text) if piece]\n\n",
+        };
+        std::mt19937_64 rng{ 7 };
+        std::string text;
+        while (text.size() < 4 * 1024 * 1024) {
+            text.append(samples[rng() % std::size(samples)]);
+        }
+        return text;
+    }
+
+    int run_tokenizer_suite(bench_context&, cppai::bench::arguments& args) {
+        const std::optional<std::string> vocab = args.text("vocab");
+        const std::vector<std::string> files = args.list_or("text", {});
+        const std::vector<std::string> thread_counts = args.list_or("threads", { "1", "2", "4", "8" });
+        const std::optional<std::string> save = args.text("save");
+        args.finish();
+        if (!vocab.has_value()) {
+            throw std::invalid_argument("the tokenizer suite needs --vocab, e.g. cl100k_base.tiktoken");
+        }
+
+        std::string text;
+        for (const std::string& file : files) {
+            std::ifstream in{ file, std::ios::binary };
+            if (!in) {
+                throw std::runtime_error("cannot open " + file);
+            }
+            text.append(std::istreambuf_iterator<char>{ in }, std::istreambuf_iterator<char>{});
+        }
+        if (text.empty()) {
+            text = generated_text();
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        std::optional<cppai::bpe_tokenizer> tokenizer;
+        try {
+            tokenizer.emplace(cppai::bpe_tokenizer::open(*vocab));
+            std::printf("%-44s %10.2f ms\n", "open mapped vocabulary", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+        }
+        catch (const cppai::tokenizer_error&) {
+            started = std::chrono::steady_clock::now();
+            tokenizer.emplace(cppai::bpe_tokenizer::from_tiktoken(*vocab));
+            std::printf("%-44s %10.2f ms\n", "parse tiktoken vocabulary", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count());
+        }
+        if (save.has_value()) {
+            tokenizer->save(*save);
+        }
+        std::printf("%zu tokens in the vocabulary, %zu bytes of text, %zu tokens\n", tokenizer->vocabulary_size(), text.size(), tokenizer->count(text));
+
+        measure_rate("split into pieces", text.size(), [&] { return cppai::bpe_tokenizer::split(text).size(); });
+        measure_rate("encode", text.size(), [&] { return tokenizer->encode(text).size(); });
+        measure_rate("count", text.size(), [&] { return tokenizer->count(text); });
+
+        // Chat-sized texts, as a batch of prompts would be.
+        std::vector<std::string_view> texts;
+        for (std::size_t offset = 0; offset < text.size(); offset += 4096) {
+            texts.push_back(std::string_view{ text }.substr(offset, 4096));
+        }
+        for (const std::string& threads : thread_counts) {
+            const std::size_t count = std::stoul(threads);
+            measure_rate("count_batch, " + threads + " threads", text.size(), [&] {
+                const std::vector<std::size_t> counts = tokenizer->count_batch(texts, count);
+                return counts.size();
+            });
+        }
+
+        const auto slice = [&text](std::size_t from, std::size_t length) { return std::string_view{ text }.substr(std::min(from, text.size()), length); };
+        const boost::json::array messages = {
+            boost::json::object{ { "role", "system" }, { "content", "You are a terse assistant." } },
+            boost::json::object{ { "role", "user" }, { "content", slice(0, 2000) } },
+            boost::json::object{ { "role", "assistant" }, { "content", slice(2000, 1500) } },
+            boost::json::object{ { "role", "user" }, { "content", slice(3500, 500) } },
+        };
+        std::size_t chat_bytes = 0;
+        for (const boost::json::value& message : messages) {
+            chat_bytes += message.as_object().at("content").as_string().size();
+        }
+        measure_rate("count_chat_tokens", chat_bytes, [&] { return cppai::count_chat_tokens(*tokenizer, messages); });
+        return 0;
+    }
+
+    // A field of /proc/self/status in kB, e.g. VmRSS: or VmHWM:.
+    std::uint64_t status_kb(std::string_view field) {
+        std::ifstream status{ "/proc/self/status" };
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.starts_with(field)) {
+                return std::stoull(line.substr(field.size()));
+            }
+        }
+        return 0;
+    }
+
+    // Awaits call runs times on a fresh io_context and prints the time per call, the rate at which it got
+    // through the bytes each call returns, the growth of peak RSS and the bytes allocated per call.
+    void run_streamed(std::string_view name, std::uint64_t runs, const std::function<boost::asio::awaitable<std::uint64_t>()>& call) {
+        boost::asio::io_context io{ 1 };
+        std::uint64_t bytes = 0;
+        std::string failure;
+        // Writing 5 to clear_refs sets VmHWM back to the current VmRSS, so each variant gets its own peak.
+        std::ofstream{ "/proc/self/clear_refs" } << "5";
+        const std::uint64_t resident = status_kb("VmRSS:");
+        const cppai::bench::allocation_count before = cppai::bench::allocations();
+        const auto started = std::chrono::steady_clock::now();
+        boost::asio::co_spawn(io, [&]() -> boost::asio::awaitable<void> {
+                for (std::uint64_t i = 0; i < runs; ++i) {
+                    bytes += co_await call();
+                }
+            },
+            [&](std::exception_ptr error) {
+                if (!error) {
+                    return;
+                }
+                try {
+                    std::rethrow_exception(error);
+                }
+                catch (const std::exception& e) {
+                    failure = e.what();
+                }
+            });
+        io.run();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        const cppai::bench::allocation_count allocated = cppai::bench::allocations() - before;
+        const std::uint64_t peak = status_kb("VmHWM:");
+        if (!failure.empty()) {
+            std::printf("%-28.*s failed: %s\n", static_cast<int>(name.size()), name.data(), failure.c_str());
+            return;
+        }
+        const double calls = static_cast<double>(std::max<std::uint64_t>(runs, 1));
+        std::printf("%-28.*s %9.1f ms/call %9.1f MB/s %9.1f MB peak RSS growth %9.1f MB allocated/call\n", static_cast<int>(name.size()),
+            name.data(), elapsed.count() * 1e3 / calls, static_cast<double>(bytes) / elapsed.count() / 1e6,
+            static_cast<double>(peak - std::min(peak, resident)) / 1024.0, static_cast<double>(allocated.bytes) / calls / 1e6);
+    }
+
+    int run_images_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::uint64_t images = args.count_or("images", 10);
+        const std::uint64_t runs = args.count_or("runs", 5);
+        args.finish();
+
+        cppai::bench::mock_options mock = ctx.mock;
+        if (mock.image_bytes == cppai::bench::mock_options{}.image_bytes) {
+            mock.image_bytes = 1536 * 1024;
+        }
+        const boost::json::value body = boost::json::object{ { "model", "dall-e-2" }, { "prompt", "A lighthouse at dusk, oil on canvas" },
+            { "n", images }, { "size", "1024x1024" } };
+        boost::json::value dom_body = body;
+        dom_body.as_object()["response_format"] = "b64_json";
+        const boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cppai-bench-%%%%%%%%");
+        boost::filesystem::create_directories(directory);
+
+        server_process server{ mock };
+        cppai::openAI client;
+        apply(client, server, ctx.client);
+        std::string sample;
+
+        const auto total = [](const cppai::image_result& result) {
+            std::uint64_t bytes = 0;
+            for (const std::uint64_t size : result.sizes) {
+                bytes += size;
+            }
+            return bytes;
+        };
+        // The whole-document variant runs last: the heap it grows may stay resident after it is freed.
+        run_streamed("image_sink", runs, [&]() -> boost::asio::awaitable<std::uint64_t> {
+            const cppai::image_result result = co_await client.create_image(body, [](std::size_t, std::string_view bytes) { sink = sink + bytes.size(); });
+            co_return total(result);
+        });
+        run_streamed("directory", runs, [&]() -> boost::asio::awaitable<std::uint64_t> {
+            const cppai::image_result result = co_await client.create_image(body, directory);
+            co_return total(result);
+        });
+        run_streamed("json::value, then decode", runs, [&]() -> boost::asio::awaitable<std::uint64_t> {
+            const boost::json::value reply = co_await client.create_image(dom_body);
+            std::uint64_t bytes = 0;
+            for (const boost::json::value& image : reply.at("data").as_array()) {
+                const boost::json::string& text = image.at("b64_json").as_string();
+                const std::string_view encoded{ text.data(), text.size() };
+                std::vector<unsigned char> decoded(cppai::utility::base64_decoded_size(encoded));
+                bytes += cppai::utility::base64_decode(encoded, decoded.data()).value_or(0);
+                if (sample.empty()) {
+                    sample = encoded;
+                }
+            }
+            co_return bytes;
+        });
+        server.stop();
+        boost::system::error_code ignored;
+        boost::filesystem::remove_all(directory, ignored);
+
+        if (!sample.empty()) {
+            std::vector<unsigned char> decoded(cppai::utility::base64_decoded_size(sample));
+            measure_rate("base64_decode, one image", sample.size(), [&] { return cppai::utility::base64_decode(sample, decoded.data()).value_or(0); });
+        }
+        return 0;
+    }
+    int run_upload_suite(bench_context& ctx, cppai::bench::arguments& args) {
+        const std::vector<std::string> sizes = args.list_or("megabytes", { "100", "300" });
+        const std::uint64_t runs = args.count_or("runs", 3);
+        args.finish();
+
+        server_process server{ ctx.mock };
+        cppai::openAI client;
+        apply(client, server, ctx.client);
+        for (const std::string& size : sizes) {
+            const std::uint64_t megabytes = std::stoull(size);
+            const boost::filesystem::path recording = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cppai-bench-%%%%%%%%.wav");
+            // 16 kHz mono 16-bit PCM is 32 kB a second.
+            write_recording(recording, std::chrono::seconds(megabytes * 1000 * 1000 / 32000));
+            const std::uint64_t bytes = boost::filesystem::file_size(recording);
+
+            run_streamed("transcription, " + size + " MB", runs, [&]() -> boost::asio::awaitable<std::uint64_t> {
+                const boost::json::value reply = co_await client.create_transcription(recording, "whisper-1");
+                sink = sink + reply.at("text").as_string().size();
+                co_return bytes;
+            });
+            // What buffering the file costs before a byte is sent, for comparison; it runs last because the heap
+            // it grows may stay resident after it is freed.
+            run_streamed("read whole, " + size + " MB", runs, [&]() -> boost::asio::awaitable<std::uint64_t> {
+                std::ifstream in{ recording.string(), std::ios::binary };
+                const std::string whole{ std::istreambuf_iterator<char>{ in }, std::istreambuf_iterator<char>{} };
+                co_return whole.size();
+            });
+            boost::system::error_code ignored;
+            boost::filesystem::remove(recording, ignored);
+        }
+        server.stop();
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || std::string_view{ argv[1] } == "--help") {
+        std::cout << usage << cppai::bench::mock_options_help;
+        return argc < 2 ? 1 : 0;
+    }
+    try {
+        cppai::bench::arguments args{ argc, argv, 2 };
+        bench_context ctx;
+        ctx.mock = cppai::bench::read_mock_options(args);
+        for (const std::string& rate : args.list_or("rates", { "100" })) {
+            ctx.rates.push_back(std::stod(rate));
+        }
+        ctx.load.duration = args.duration_or("duration", ctx.load.duration);
+        ctx.load.warmup = args.duration_or("warmup", ctx.load.warmup);
+        ctx.load.poisson = !args.flag("even");
+        ctx.load.seed = ctx.mock.seed;
+        ctx.shards = args.count_or("shards", 1);
+        ctx.model = args.text_or("model", "gpt-4o-mini");
+        ctx.workload = args.text_or("workload", "");
+        const std::string mode = args.text_or("transport", "http1");
+        if (mode != "http1" && mode != "http2") {
+            throw std::invalid_argument("--transport must be http1 or http2");
+        }
+        ctx.client.mode = mode == "http2" ? cppai::transport::http2 : cppai::transport::http1;
+        ctx.client.pool = !args.flag("no-pool");
+        ctx.client.record_metrics = args.flag("metrics");
+        ctx.client.max_per_host = args.count_or("max-per-host", ctx.client.max_per_host);
+        ctx.client.max_attempts = static_cast<std::uint16_t>(args.count_or("max-attempts", ctx.client.max_attempts));
+
+        using suite_function = int (*)(bench_context&, cppai::bench::arguments&);
+        const std::map<std::string_view, suite_function> suites = { { "load", run_load_suite }, { "transport", run_transport_suite },
+            { "pool", run_pool_suite }, { "metrics", run_metrics_suite }, { "gzip", run_gzip_suite }, { "dns", run_dns_suite },
+            { "cache", run_cache_suite }, { "transcribe", run_transcribe_suite }, { "batcher", run_batcher_suite }, { "schema", run_schema_suite },
+            { "embedding", run_embedding_suite }, { "tokenizer", run_tokenizer_suite }, { "moderation", run_moderation_suite },
+            { "cancel", run_cancel_suite }, { "images", run_images_suite }, { "upload", run_upload_suite } };
+        const auto suite = suites.find(argv[1]);
+        if (suite == suites.end()) {
+            throw std::invalid_argument("unknown suite " + std::string{ argv[1] });
+        }
+        return suite->second(ctx, args);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "cppai_bench: " << e.what() << '\n';
+        return 1;
+    }
+}
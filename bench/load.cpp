@@ -0,0 +1,102 @@
+#include "load.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+double cppai::bench::process_cpu_seconds() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    const auto seconds = [](const timeval& time) { return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1e6; };
+    return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+double cppai::bench::load_report::throughput() const {
+    return elapsed.count() > 0 ? static_cast<double>(completed) / elapsed.count() : 0;
+}
+
+cppai::bench::load_report cppai::bench::run_load(runtime& rt, const load_options& opts, const call_function& call) {
+    using clock = std::chrono::steady_clock;
+    boost::asio::io_context scheduler{ 1 };
+    load_report report;
+
+    const clock::time_point start = clock::now();
+    const clock::time_point measure_from = start + opts.warmup;
+    const clock::time_point stop_at = measure_from + opts.duration;
+    clock::time_point last_done = measure_from;
+    double cpu_before = 0;
+    allocation_count allocations_before;
+
+    const auto one = [&](clock::time_point arrival, std::uint64_t index, bool measured) -> boost::asio::awaitable<void> {
+        std::string failure;
+        try {
+            co_await rt.submit([&call, index](const openAI& client) { return call(client, index); });
+        }
+        catch (const std::exception& e) {
+            failure = e.what();
+        }
+        const clock::time_point done = clock::now();
+        if (!measured) {
+            co_return;
+        }
+        last_done = std::max(last_done, done);
+        if (!failure.empty()) {
+            ++report.failed;
+            ++report.errors[failure.substr(0, 120)];
+            co_return;
+        }
+        ++report.completed;
+        const auto micros = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(done - arrival).count());
+        ++report.latency.buckets[histogram_snapshot::bucket_of(micros)];
+        ++report.latency.count;
+        report.latency.sum += micros;
+    };
+
+    boost::asio::co_spawn(scheduler, [&]() -> boost::asio::awaitable<void> {
+        std::mt19937_64 rng{ opts.seed };
+        std::exponential_distribution<double> gap{ opts.rate };
+        const auto even_gap = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / opts.rate));
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor };
+        bool window_open = false;
+        std::uint64_t index = 0;
+        for (clock::time_point arrival = start; arrival < stop_at;) {
+            timer.expires_at(arrival);
+            co_await timer.async_wait(boost::asio::use_awaitable);
+            const bool measured = arrival >= measure_from;
+            if (measured && !window_open) {
+                window_open = true;
+                cpu_before = process_cpu_seconds();
+                allocations_before = allocations();
+            }
+            if (measured) {
+                ++report.sent;
+            }
+            boost::asio::co_spawn(scheduler, one(arrival, index++, measured), boost::asio::detached);
+            arrival += opts.poisson ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(gap(rng))) : even_gap;
+        }
+    }, boost::asio::detached);
+    // Returns once the last arrival was scheduled and every call has finished.
+    scheduler.run();
+
+    report.cpu_seconds = process_cpu_seconds() - cpu_before;
+    report.allocations = allocations() - allocations_before;
+    report.elapsed = last_done - measure_from;
+    return report;
+}
+
+void cppai::bench::print_report(std::ostream& out, std::string_view label, const load_report& report) {
+    const auto millis = [&](double q) { return static_cast<double>(report.latency.quantile(q).count()) / 1000.0; };
+    const double calls = static_cast<double>(std::max<std::uint64_t>(report.completed + report.failed, 1));
+    char line[512];
+    std::snprintf(line, sizeof(line),
+        "%-28.*s sent %7llu  ok %7llu  failed %5llu  %9.1f req/s  p50 %8.2f ms  p99 %8.2f ms  p999 %8.2f ms  cpu %7.1f us/req  "
+        "alloc %7.1f/req %9.0f B/req",
+        static_cast<int>(label.size()), label.data(), static_cast<unsigned long long>(report.sent),
+        static_cast<unsigned long long>(report.completed), static_cast<unsigned long long>(report.failed), report.throughput(), millis(0.5),
+        millis(0.99), millis(0.999), report.cpu_seconds * 1e6 / calls, static_cast<double>(report.allocations.calls) / calls,
+        static_cast<double>(report.allocations.bytes) / calls);
+    out << line << '\n';
+    for (const auto& [message, count] : report.errors) {
+        out << "    " << count << " x " << message << '\n';
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef CPPAI_BENCH_LOAD_H
+#define CPPAI_BENCH_LOAD_H
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "allocations.h"
+#include "metrics.h"
+#include "runtime.h"
+
+namespace cppai::bench {
+    struct load_options {
+        // Arrivals per second.
+        double rate = 100;
+        std::chrono::microseconds duration = std::chrono::seconds(10);
+        // Sent at the same rate before the measured window, to open connections and warm caches.
+        std::chrono::microseconds warmup = std::chrono::seconds(1);
+        // Exponentially distributed gaps between arrivals; evenly spaced ones otherwise.
+        bool poisson = true;
+        std::uint64_t seed = 1;
+    };
+
+    struct load_report {
+        std::uint64_t sent = 0;
+        std::uint64_t completed = 0;
+        std::uint64_t failed = 0;
+        // From the first measured arrival until the last measured call finished.
+        std::chrono::duration<double> elapsed{ 0 };
+        histogram_snapshot latency;
+        // User plus system time of the whole process over the window.
+        double cpu_seconds = 0;
+        allocation_count allocations;
+        // Failure messages and how often each occurred.
+        std::map<std::string, std::uint64_t> errors;
+
+        double throughput() const;
+    };
+
+    using call_function = std::function<boost::asio::awaitable<void>(const openAI& client, std::uint64_t index)>;
+
+    // Starts call(client, index) at fixed open-loop arrival times on the runtime's shards, whether or not earlier
+    // calls have finished, so a client that falls behind shows up as latency instead of a lower request rate.
+    // Each call is timed from its scheduled arrival, not from when it actually started, which keeps queueing
+    // in the client inside the measurement. A call fails by throwing.
+    load_report run_load(runtime& rt, const load_options& opts, const call_function& call);
+
+    // One line of p50/p99/p999 latency, throughput, CPU and allocations per request, then any failures.
+    // Quantiles are histogram bucket bounds, within about 6% of the true value.
+    void print_report(std::ostream& out, std::string_view label, const load_report& report);
+
+    double process_cpu_seconds();
+}
+
+#endif
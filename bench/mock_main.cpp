@@ -0,0 +1,50 @@
+#include <boost/asio.hpp>
+#include <fstream>
+#include <iostream>
+#include "arguments.h"
+#include "mock_server.h"
+
+namespace {
+    constexpr std::string_view usage =
+        "usage: cppai_mock_server [options]\n"
+        "Serves the OpenAI API endpoints cppAI calls, over TLS (h2 or http/1.1) and plaintext HTTP/1.1 on one port.\n"
+        "  --address A             address to bind (default 127.0.0.1)\n"
+        "  --port N                port to bind (default 8443)\n"
+        "  --cert FILE --key FILE  PEM certificate and key (default: a generated one for localhost)\n"
+        "  --ca-out FILE           write the certificate clients should trust to FILE\n";
+}
+
+int main(int argc, char** argv) {
+    try {
+        cppai::bench::arguments args{ argc, argv };
+        if (args.flag("help")) {
+            std::cout << usage << cppai::bench::mock_options_help;
+            return 0;
+        }
+        cppai::bench::mock_options opts = cppai::bench::read_mock_options(args);
+        opts.address = args.text_or("address", opts.address);
+        opts.port = static_cast<std::uint16_t>(args.count_or("port", 8443));
+        opts.cert_file = args.text_or("cert", "");
+        opts.key_file = args.text_or("key", "");
+        const std::string ca_out = args.text_or("ca-out", "");
+        args.finish();
+
+        cppai::bench::mock_server server{ opts };
+        server.start();
+        if (!ca_out.empty()) {
+            std::ofstream{ ca_out } << server.certificate();
+        }
+        std::cout << "listening on " << opts.address << ':' << server.port() << std::endl;
+
+        boost::asio::io_context signals_ctx;
+        boost::asio::signal_set signals{ signals_ctx, SIGINT, SIGTERM };
+        signals.async_wait([](const boost::system::error_code&, int) {});
+        signals_ctx.run();
+        server.stop();
+        return 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "cppai_mock_server: " << e.what() << '\n';
+        return 1;
+    }
+}
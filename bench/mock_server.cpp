@@ -0,0 +1,1438 @@
+#include "mock_server.h"
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/json.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "compression.h"
+#include "hpack.h"
+
+std::chrono::microseconds cppai::bench::parse_micros(std::string_view text) {
+    double value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc{} || value < 0) {
+        throw std::invalid_argument("not a duration: " + std::string{ text });
+    }
+    const std::string_view unit{ end, static_cast<std::size_t>(text.data() + text.size() - end) };
+    double scale = 0;
+    if (unit == "us") {
+        scale = 1;
+    }
+    else if (unit.empty() || unit == "ms") {
+        scale = 1e3;
+    }
+    else if (unit == "s") {
+        scale = 1e6;
+    }
+    else {
+        throw std::invalid_argument("not a duration: " + std::string{ text });
+    }
+    return std::chrono::microseconds{ std::llround(value * scale) };
+}
+
+cppai::bench::latency_distribution cppai::bench::latency_distribution::parse(std::string_view spec) {
+    const std::size_t colon = spec.find(':');
+    latency_distribution result;
+    if (colon == std::string_view::npos) {
+        result.first = parse_micros(spec);
+        return result;
+    }
+    const std::string_view name = spec.substr(0, colon);
+    const std::string_view arguments = spec.substr(colon + 1);
+    const std::size_t comma = arguments.find(',');
+    const std::string_view first = arguments.substr(0, comma);
+    const std::string_view second = comma == std::string_view::npos ? std::string_view{} : arguments.substr(comma + 1);
+
+    if (name == "fixed" && second.empty()) {
+        result.first = parse_micros(first);
+    }
+    else if (name == "uniform" && !second.empty()) {
+        result.kind = shape::uniform;
+        result.first = parse_micros(first);
+        result.second = parse_micros(second);
+        if (result.second < result.first) {
+            throw std::invalid_argument("uniform latency bounds are reversed: " + std::string{ spec });
+        }
+    }
+    else if (name == "exponential" && second.empty()) {
+        result.kind = shape::exponential;
+        result.first = parse_micros(first);
+    }
+    else if (name == "lognormal") {
+        result.kind = shape::lognormal;
+        result.first = parse_micros(first);
+        if (!second.empty()) {
+            const auto [end, error] = std::from_chars(second.data(), second.data() + second.size(), result.sigma);
+            if (error != std::errc{} || end != second.data() + second.size() || result.sigma < 0) {
+                throw std::invalid_argument("not a lognormal sigma: " + std::string{ second });
+            }
+        }
+    }
+    else {
+        throw std::invalid_argument("unknown latency distribution: " + std::string{ spec });
+    }
+    return result;
+}
+
+std::chrono::microseconds cppai::bench::latency_distribution::sample(std::mt19937_64& rng) const {
+    switch (kind) {
+    case shape::uniform:
+        return std::chrono::microseconds{ std::uniform_int_distribution<std::int64_t>{ first.count(), second.count() }(rng) };
+    case shape::exponential:
+        if (first.count() <= 0) {
+            return std::chrono::microseconds{ 0 };
+        }
+        return std::chrono::microseconds{ std::llround(std::exponential_distribution<double>{ 1.0 / static_cast<double>(first.count()) }(rng)) };
+    case shape::lognormal:
+        if (first.count() <= 0) {
+            return std::chrono::microseconds{ 0 };
+        }
+        return std::chrono::microseconds{ std::llround(std::lognormal_distribution<double>{ std::log(static_cast<double>(first.count())), sigma }(rng)) };
+    case shape::fixed:
+        break;
+    }
+    return first;
+}
+
+namespace {
+    constexpr std::size_t max_upload = 512 * 1024 * 1024;
+
+    struct mock_request {
+        std::string method;
+        std::string target;
+        std::string content_type;
+        std::string accept_encoding;
+        std::string content_encoding;
+        std::string range;
+        std::string if_range;
+        std::string body;
+    };
+
+    struct mock_response {
+        unsigned status = 200;
+        std::string content_type = "application/json";
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        // Set for a text/event-stream, whose events are sent interval apart instead of body.
+        std::vector<std::string> events;
+        std::chrono::microseconds interval{ 0 };
+        // With events, nonzero splits each into pieces of this size, sent interval apart.
+        std::size_t fragment = 0;
+        // Nothing is sent; see mock_options::drop_fraction.
+        bool drop = false;
+
+        // The events as written, each piece preceded by interval.
+        std::vector<std::string_view> pieces() const {
+            std::vector<std::string_view> written;
+            for (const std::string& text : events) {
+                const std::size_t size = fragment == 0 ? text.size() : fragment;
+                for (std::size_t at = 0; at < text.size(); at += size) {
+                    written.push_back(std::string_view{ text }.substr(at, size));
+                }
+            }
+            return written;
+        }
+    };
+
+    std::string to_string(boost::beast::string_view text) {
+        return std::string{ text.data(), text.size() };
+    }
+
+    std::string_view path_of(std::string_view target) {
+        return target.substr(0, target.find('?'));
+    }
+
+    std::uint64_t fnv1a(std::string_view text, std::uint64_t hash = 14695981039346656037ull) {
+        for (const char c : text) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::uint64_t xorshift(std::uint64_t& state) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    std::string base64_encode(const unsigned char* data, std::size_t size) {
+        static constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        out.reserve((size + 2) / 3 * 4);
+        std::size_t i = 0;
+        for (; i + 3 <= size; i += 3) {
+            const std::uint32_t group = (std::uint32_t{ data[i] } << 16) | (std::uint32_t{ data[i + 1] } << 8) | data[i + 2];
+            out.push_back(alphabet[group >> 18]);
+            out.push_back(alphabet[(group >> 12) & 63]);
+            out.push_back(alphabet[(group >> 6) & 63]);
+            out.push_back(alphabet[group & 63]);
+        }
+        if (i < size) {
+            const std::uint32_t group = (std::uint32_t{ data[i] } << 16) | (i + 1 < size ? std::uint32_t{ data[i + 1] } << 8 : 0);
+            out.push_back(alphabet[group >> 18]);
+            out.push_back(alphabet[(group >> 12) & 63]);
+            out.push_back(i + 1 < size ? alphabet[(group >> 6) & 63] : '=');
+            out.push_back('=');
+        }
+        return out;
+    }
+
+    // Words picked by seed, so the same prompt always gets the same answer.
+    std::string words(std::uint64_t seed, std::size_t count) {
+        static constexpr std::array<std::string_view, 16> vocabulary = { "the", "model", "returns", "a", "mock", "answer", "for", "every",
+            "request", "with", "plenty", "of", "tokens", "and", "little", "meaning" };
+        std::uint64_t state = seed | 1;
+        std::string out;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (i != 0) {
+                out.push_back(' ');
+            }
+            out.append(vocabulary[xorshift(state) % vocabulary.size()]);
+        }
+        return out;
+    }
+
+    std::int64_t now() {
+        return static_cast<std::int64_t>(std::time(nullptr));
+    }
+
+    mock_response json_response(unsigned status, const boost::json::value& body) {
+        mock_response response;
+        response.status = status;
+        response.body = boost::json::serialize(body);
+        return response;
+    }
+
+    mock_response error_response(unsigned status, std::string_view message, std::string_view type, std::string_view param = {}) {
+        boost::json::object error{ { "message", message }, { "type", type }, { "param", nullptr }, { "code", nullptr } };
+        if (!param.empty()) {
+            error["param"] = param;
+        }
+        return json_response(status, boost::json::object{ { "error", std::move(error) } });
+    }
+
+    boost::json::object usage(std::uint64_t prompt_tokens, std::uint64_t completion_tokens) {
+        return { { "prompt_tokens", prompt_tokens }, { "completion_tokens", completion_tokens }, { "total_tokens", prompt_tokens + completion_tokens } };
+    }
+
+    std::string event(const boost::json::value& data) {
+        return "data: " + boost::json::serialize(data) + "\n\n";
+    }
+
+    std::string gzip(std::string_view input) {
+        // The fastest level keeps the server from becoming what a compression benchmark measures.
+        cppai::gzip_deflater deflater{ 1 };
+        std::string out;
+        std::array<char, 16384> chunk;
+        while (!deflater.done()) {
+            const std::size_t written = deflater.write(input, boost::asio::buffer(chunk), true);
+            out.append(chunk.data(), written);
+        }
+        return out;
+    }
+
+    std::string inflate(std::string_view input) {
+        cppai::gzip_inflater inflater;
+        boost::beast::flat_buffer out;
+        inflater.write(input, out);
+        inflater.finish();
+        return boost::beast::buffers_to_string(out.data());
+    }
+
+    // Seconds of audio in a multipart upload, read from the header of the WAV file inside it.
+    double audio_seconds(std::string_view body) {
+        const std::size_t riff = body.find("RIFF");
+        if (riff == std::string_view::npos || body.size() < riff + 44) {
+            return 0;
+        }
+        const auto* header = reinterpret_cast<const unsigned char*>(body.data() + riff);
+        const std::uint32_t byte_rate = header[28] | (header[29] << 8) | (header[30] << 16) | (std::uint32_t{ header[31] } << 24);
+        if (byte_rate == 0) {
+            return 0;
+        }
+        return static_cast<double>(body.size() - riff - 44) / byte_rate;
+    }
+
+    std::mt19937_64& generator(std::uint64_t seed) {
+        thread_local std::mt19937_64 rng{ seed ^ std::hash<std::thread::id>{}(std::this_thread::get_id()) };
+        return rng;
+    }
+
+    struct counter_cells {
+        std::atomic<std::uint64_t> connections{ 0 };
+        std::atomic<std::uint64_t> tls_connections{ 0 };
+        std::atomic<std::uint64_t> h2_connections{ 0 };
+        std::atomic<std::uint64_t> requests{ 0 };
+        std::atomic<std::uint64_t> rate_limited{ 0 };
+        std::atomic<std::uint64_t> server_errors{ 0 };
+        std::atomic<std::uint64_t> replayed{ 0 };
+        std::atomic<std::uint64_t> bytes_in{ 0 };
+        std::atomic<std::uint64_t> bytes_out{ 0 };
+
+        cppai::bench::mock_counters load() const {
+            cppai::bench::mock_counters out;
+            out.connections = connections.load();
+            out.tls_connections = tls_connections.load();
+            out.h2_connections = h2_connections.load();
+            out.requests = requests.load();
+            out.rate_limited = rate_limited.load();
+            out.server_errors = server_errors.load();
+            out.replayed = replayed.load();
+            out.bytes_in = bytes_in.load();
+            out.bytes_out = bytes_out.load();
+            return out;
+        }
+
+        void reset() {
+            for (std::atomic<std::uint64_t>* cell : { &connections, &tls_connections, &h2_connections, &requests, &rate_limited, &server_errors,
+                     &replayed, &bytes_in, &bytes_out }) {
+                cell->store(0);
+            }
+        }
+    };
+
+    // Everything about a reply except the transport it goes out on.
+    class responder {
+    public:
+        counter_cells cells;
+
+        explicit responder(const cppai::bench::mock_options& opts) : opts{ opts } {
+            if (!opts.replay_file.empty()) {
+                load_replays(opts.replay_file);
+            }
+            std::uint64_t state = opts.seed | 1;
+            std::string image(opts.image_bytes, '\0');
+            static constexpr unsigned char png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+            for (std::size_t i = 0; i < image.size(); ++i) {
+                image[i] = static_cast<char>(i < sizeof(png_signature) ? png_signature[i] : xorshift(state) & 0xff);
+            }
+            image_base64 = base64_encode(reinterpret_cast<const unsigned char*>(image.data()), image.size());
+
+            for (std::size_t line = 0; file_content.size() < opts.file_bytes; ++line) {
+                file_content.append(boost::json::serialize(boost::json::object{ { "prompt", "Line " + std::to_string(line) + ": " + words(line, 12) },
+                    { "completion", " " + words(line + 1, 24) } }));
+                file_content.push_back('\n');
+            }
+            file_etag = "\"mock-" + std::to_string(fnv1a(file_content)) + "\"";
+        }
+
+        boost::asio::awaitable<mock_response> respond(mock_request request) {
+            const std::string_view path = path_of(request.target);
+            if (path == "/mock/stats") {
+                co_return json_response(200, stats());
+            }
+            if (path == "/mock/reset") {
+                cells.reset();
+                co_return json_response(200, boost::json::object{ { "reset", true } });
+            }
+            ++cells.requests;
+            cells.bytes_in += request.body.size();
+
+            // Everything random is drawn before waiting, which may resume on another thread.
+            std::mt19937_64& rng = generator(opts.seed);
+            std::chrono::microseconds delay = opts.latency.sample(rng);
+            if (path == "/v1/chat/completions" || path == "/v1/completions") {
+                delay += opts.generation_latency.sample(rng);
+            }
+            const double draw = std::uniform_real_distribution<double>{ 0, 1 }(rng);
+            const std::uint64_t pick = rng();
+
+            std::optional<mock_response> response;
+            if (boost::beast::iequals(request.content_encoding, "gzip")) {
+                try {
+                    request.body = inflate(request.body);
+                }
+                catch (const std::exception& e) {
+                    response = error_response(400, e.what(), "invalid_request_error");
+                }
+            }
+            if (opts.audio_speed > 0 && path.starts_with("/v1/audio/")) {
+                delay += std::chrono::microseconds{ std::llround(audio_seconds(request.body) / opts.audio_speed * 1e6) };
+            }
+            if (delay.count() > 0) {
+                boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            if (!response.has_value()) {
+                response = answer(request, path, draw, pick);
+            }
+
+            if (opts.gzip && response->events.empty() && response->body.size() >= opts.gzip_min_size
+                && request.accept_encoding.find("gzip") != std::string::npos) {
+                response->body = gzip(response->body);
+                response->headers.emplace_back("content-encoding", "gzip");
+            }
+            std::size_t sent = response->body.size();
+            for (const std::string& text : response->events) {
+                sent += text.size();
+            }
+            cells.bytes_out += sent;
+            co_return std::move(*response);
+        }
+
+    private:
+        struct replay_set {
+            std::vector<mock_response> responses;
+            std::atomic<std::size_t> next{ 0 };
+        };
+
+        const cppai::bench::mock_options& opts;
+        std::map<std::string, replay_set, std::less<>> replays;
+        std::string image_base64;
+        std::string file_content;
+        std::string file_etag;
+
+        void load_replays(const std::string& path) {
+            std::ifstream in{ path };
+            if (!in) {
+                throw std::runtime_error("cannot open replay file " + path);
+            }
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                    continue;
+                }
+                const boost::json::object entry = boost::json::parse(line).as_object();
+                mock_response response;
+                if (const boost::json::value* status = entry.if_contains("status")) {
+                    response.status = boost::json::value_to<unsigned>(*status);
+                }
+                if (const boost::json::value* headers = entry.if_contains("headers")) {
+                    for (const auto& [name, value] : headers->as_object()) {
+                        if (boost::beast::iequals(std::string_view{ name }, "content-type")) {
+                            response.content_type = value.as_string();
+                        }
+                        else {
+                            response.headers.emplace_back(std::string{ name }, std::string{ value.as_string() });
+                        }
+                    }
+                }
+                if (const boost::json::value* body = entry.if_contains("body")) {
+                    response.body = body->is_string() ? std::string{ body->get_string() } : boost::json::serialize(*body);
+                }
+                if (const boost::json::value* events = entry.if_contains("events")) {
+                    response.content_type = "text/event-stream";
+                    response.interval = opts.stream_interval;
+                    response.fragment = opts.stream_fragment;
+                    for (const boost::json::value& data : events->as_array()) {
+                        response.events.push_back(data.is_string() ? "data: " + std::string{ data.get_string() } + "\n\n" : event(data));
+                    }
+                }
+                std::string key{ entry.at("method").as_string() };
+                key.push_back(' ');
+                key.append(path_of(entry.at("target").as_string()));
+                replays[key].responses.push_back(std::move(response));
+            }
+        }
+
+        mock_response answer(const mock_request& request, std::string_view path, double draw, std::uint64_t pick) {
+            if (draw < opts.rate_limit_fraction) {
+                ++cells.rate_limited;
+                mock_response response = error_response(429, "Rate limit reached for requests", "requests");
+                response.headers.emplace_back("retry-after-ms", std::to_string(opts.retry_after.count()));
+                response.headers.emplace_back("x-ratelimit-remaining-requests", "0");
+                return response;
+            }
+            if (draw < opts.rate_limit_fraction + opts.server_error_fraction) {
+                ++cells.server_errors;
+                static constexpr std::array<unsigned, 3> statuses = { 500, 502, 503 };
+                return error_response(statuses[pick % statuses.size()], "The server had an error while processing your request.", "server_error");
+            }
+            if (draw < opts.rate_limit_fraction + opts.server_error_fraction + opts.drop_fraction) {
+                mock_response response;
+                response.drop = true;
+                return response;
+            }
+            if (const mock_response* recorded = replay(request.method, path)) {
+                ++cells.replayed;
+                return *recorded;
+            }
+            try {
+                return route(request, path);
+            }
+            catch (const std::exception& e) {
+                return error_response(400, e.what(), "invalid_request_error");
+            }
+        }
+
+        const mock_response* replay(std::string_view method, std::string_view path) {
+            if (replays.empty()) {
+                return nullptr;
+            }
+            std::string key{ method };
+            key.push_back(' ');
+            key.append(path);
+            const auto found = replays.find(key);
+            if (found == replays.end()) {
+                return nullptr;
+            }
+            replay_set& recorded = found->second;
+            return &recorded.responses[recorded.next.fetch_add(1, std::memory_order_relaxed) % recorded.responses.size()];
+        }
+
+        boost::json::object stats() const {
+            const cppai::bench::mock_counters counters = cells.load();
+            return { { "connections", counters.connections }, { "tls_connections", counters.tls_connections },
+                { "h2_connections", counters.h2_connections }, { "requests", counters.requests }, { "rate_limited", counters.rate_limited },
+                { "server_errors", counters.server_errors }, { "replayed", counters.replayed }, { "bytes_in", counters.bytes_in },
+                { "bytes_out", counters.bytes_out } };
+        }
+
+        static boost::json::object parse_body(const mock_request& request) {
+            return boost::json::parse(request.body).as_object();
+        }
+
+        // The plain fields of a multipart form, as strings; file parts are skipped.
+        static boost::json::object form_fields(const mock_request& request) {
+            boost::json::object fields;
+            const std::string_view body{ request.body };
+            constexpr std::string_view marker = "name=\"";
+            for (std::size_t at = body.find(marker); at != std::string_view::npos; at = body.find(marker, at)) {
+                at += marker.size();
+                const std::size_t name_end = body.find('"', at);
+                if (name_end == std::string_view::npos || body.substr(name_end + 1, 4) != "\r\n\r\n") {
+                    continue;
+                }
+                const std::size_t value_end = body.find("\r\n--", name_end + 5);
+                if (value_end == std::string_view::npos) {
+                    break;
+                }
+                fields[body.substr(at, name_end - at)] = body.substr(name_end + 5, value_end - name_end - 5);
+            }
+            return fields;
+        }
+
+        static std::string string_or(const boost::json::object& body, std::string_view key, std::string_view fallback) {
+            const boost::json::value* found = body.if_contains(key);
+            return found != nullptr && found->is_string() ? std::string{ found->get_string() } : std::string{ fallback };
+        }
+
+        static std::uint64_t count_or(const boost::json::object& body, std::string_view key, std::uint64_t fallback) {
+            const boost::json::value* found = body.if_contains(key);
+            return found != nullptr && found->is_int64() && found->get_int64() > 0 ? static_cast<std::uint64_t>(found->get_int64()) : fallback;
+        }
+
+        mock_response route(const mock_request& request, std::string_view path) const {
+            const bool get = request.method == "GET";
+            const bool post = request.method == "POST";
+            const bool remove = request.method == "DELETE";
+
+            if (get && path == "/v1/models") {
+                boost::json::array data;
+                for (const std::string_view id : { "gpt-4o-mini", "gpt-3.5-turbo", "text-embedding-3-small", "whisper-1" }) {
+                    data.push_back(boost::json::object{ { "id", id }, { "object", "model" }, { "created", 0 }, { "owned_by", "mock" } });
+                }
+                return json_response(200, boost::json::object{ { "object", "list" }, { "data", std::move(data) } });
+            }
+            if (remove && path.starts_with("/v1/models/")) {
+                return json_response(200, boost::json::object{ { "id", path.substr(11) }, { "object", "model" }, { "deleted", true } });
+            }
+            if (post && path == "/v1/completions") {
+                return completion(request, false);
+            }
+            if (post && path == "/v1/chat/completions") {
+                return completion(request, true);
+            }
+            if (post && path == "/v1/edits") {
+                return json_response(200, boost::json::object{ { "object", "edit" }, { "created", now() },
+                    { "choices", boost::json::array{ boost::json::object{ { "text", words(fnv1a(request.body), opts.completion_words) }, { "index", 0 } } } },
+                    { "usage", usage(request.body.size() / 4, opts.completion_words) } });
+            }
+            if (post && path == "/v1/images/generations") {
+                return images(parse_body(request));
+            }
+            if (post && (path == "/v1/images/edits" || path == "/v1/images/variations")) {
+                return images(form_fields(request));
+            }
+            if (post && path == "/v1/embeddings") {
+                return embeddings(parse_body(request));
+            }
+            if (post && (path == "/v1/audio/transcriptions" || path == "/v1/audio/translations")) {
+                // About 150 words a minute.
+                const std::size_t count = std::max<std::size_t>(1, static_cast<std::size_t>(audio_seconds(request.body) * 2.5));
+                return json_response(200, boost::json::object{ { "text", words(fnv1a(request.body), count) } });
+            }
+            if (get && path == "/v1/files") {
+                return json_response(200, boost::json::object{ { "object", "list" }, { "data", boost::json::array{ file_object("file-mock") } } });
+            }
+            if (path.starts_with("/v1/files/")) {
+                const std::string_view rest = path.substr(10);
+                if (get && rest.ends_with("/content")) {
+                    return file_range(request);
+                }
+                if (get) {
+                    return json_response(200, file_object(rest));
+                }
+                if (remove) {
+                    return json_response(200, boost::json::object{ { "id", rest }, { "object", "file" }, { "deleted", true } });
+                }
+            }
+            if (post && path == "/v1/fine-tunes") {
+                return json_response(200, fine_tune("ft-mock", "pending"));
+            }
+            if (get && path == "/v1/fine-tunes") {
+                return json_response(200, boost::json::object{ { "object", "list" }, { "data", boost::json::array{ fine_tune("ft-mock", "succeeded") } } });
+            }
+            if (path.starts_with("/v1/fine-tunes/")) {
+                const std::string_view rest = path.substr(15);
+                const std::string_view id = rest.substr(0, rest.find('/'));
+                if (post && rest.ends_with("/cancel")) {
+                    return json_response(200, fine_tune(id, "cancelled"));
+                }
+                if (get && rest.ends_with("/events")) {
+                    boost::json::array data;
+                    for (const std::string_view message : { "Created fine-tune", "Fine-tune started", "Fine-tune succeeded" }) {
+                        data.push_back(boost::json::object{ { "object", "fine-tune-event" }, { "created_at", now() }, { "level", "info" }, { "message", message } });
+                    }
+                    return json_response(200, boost::json::object{ { "object", "list" }, { "data", std::move(data) } });
+                }
+                if (get) {
+                    return json_response(200, fine_tune(id, "succeeded"));
+                }
+            }
+            if (post && path == "/v1/moderations") {
+                return moderations(parse_body(request));
+            }
+            return error_response(404, "Unknown request URL: " + request.method + ' ' + std::string{ path }, "invalid_request_error");
+        }
+
+        mock_response completion(const mock_request& request, bool chat) const {
+            const boost::json::object body = parse_body(request);
+            const std::string model = string_or(body, "model", "mock");
+            const boost::json::value* stream = body.if_contains("stream");
+            const bool streaming = stream != nullptr && stream->is_bool() && stream->get_bool();
+            const std::uint64_t prompt_tokens = request.body.size() / 4 + 1;
+            const std::uint64_t seed = fnv1a(request.body);
+            const std::string_view object = chat ? (streaming ? "chat.completion.chunk" : "chat.completion") : "text_completion";
+            const std::string id = chat ? "chatcmpl-mock" : "cmpl-mock";
+
+            if (streaming) {
+                mock_response response;
+                response.content_type = "text/event-stream";
+                response.interval = opts.stream_interval;
+                response.fragment = opts.stream_fragment;
+                const auto chunk = [&](boost::json::object choice) {
+                    choice["index"] = 0;
+                    if (!choice.contains("finish_reason")) {
+                        choice["finish_reason"] = nullptr;
+                    }
+                    return event(boost::json::object{ { "id", id }, { "object", object }, { "created", now() }, { "model", model },
+                        { "choices", boost::json::array{ std::move(choice) } } });
+                };
+                if (chat) {
+                    response.events.push_back(chunk({ { "delta", boost::json::object{ { "role", "assistant" }, { "content", "" } } } }));
+                }
+                std::uint64_t state = seed | 1;
+                for (std::size_t i = 0; i < opts.stream_events; ++i) {
+                    const std::string text = words(xorshift(state), 1) + ' ';
+                    response.events.push_back(chat ? chunk({ { "delta", boost::json::object{ { "content", text } } } }) : chunk({ { "text", text } }));
+                }
+                response.events.push_back(chat ? chunk({ { "delta", boost::json::object{} }, { "finish_reason", "stop" } })
+                                               : chunk({ { "text", "" }, { "finish_reason", "stop" } }));
+                response.events.push_back("data: [DONE]\n\n");
+                return response;
+            }
+
+            const std::uint64_t choices = std::min<std::uint64_t>(count_or(body, "n", 1), 16);
+            const std::uint64_t length = std::min<std::uint64_t>(count_or(body, "max_tokens", opts.completion_words), opts.completion_words);
+            boost::json::array data;
+            for (std::uint64_t i = 0; i < choices; ++i) {
+                const std::string text = words(seed + i, length);
+                boost::json::object choice{ { "index", i }, { "finish_reason", length < opts.completion_words ? "length" : "stop" } };
+                if (chat) {
+                    choice["message"] = boost::json::object{ { "role", "assistant" }, { "content", text } };
+                }
+                else {
+                    choice["text"] = text;
+                    choice["logprobs"] = nullptr;
+                }
+                data.push_back(std::move(choice));
+            }
+            return json_response(200, boost::json::object{ { "id", id }, { "object", object }, { "created", now() }, { "model", model },
+                { "choices", std::move(data) }, { "usage", usage(prompt_tokens, length * choices) } });
+        }
+
+        mock_response images(const boost::json::object& body) const {
+            const bool inline_data = string_or(body, "response_format", "url") == "b64_json";
+            boost::json::array data;
+            for (std::uint64_t i = 0, n = std::min<std::uint64_t>(count_or(body, "n", 1), 10); i < n; ++i) {
+                if (inline_data) {
+                    data.push_back(boost::json::object{ { "b64_json", image_base64 } });
+                }
+                else {
+                    data.push_back(boost::json::object{ { "url", "https://mock.invalid/images/" + std::to_string(i) + ".png" } });
+                }
+            }
+            return json_response(200, boost::json::object{ { "created", now() }, { "data", std::move(data) } });
+        }
+
+        mock_response embeddings(const boost::json::object& body) const {
+            // Each input is hashed as it was sent, so equal inputs always get equal vectors.
+            std::vector<std::string> inputs;
+            const boost::json::value& input = body.at("input");
+            if (input.is_string()) {
+                inputs.emplace_back(input.get_string());
+            }
+            else if (const boost::json::array* items = input.if_array(); items != nullptr && !items->empty() && items->front().is_number()) {
+                inputs.push_back(boost::json::serialize(input));
+            }
+            else {
+                for (const boost::json::value& item : input.as_array()) {
+                    inputs.push_back(item.is_string() ? std::string{ item.get_string() } : boost::json::serialize(item));
+                }
+            }
+            if (inputs.empty()) {
+                return error_response(400, "'input' must not be empty", "invalid_request_error", "input");
+            }
+
+            const std::uint64_t dimensions = count_or(body, "dimensions", opts.embedding_dimensions);
+            const bool base64 = string_or(body, "encoding_format", "float") == "base64";
+            std::uint64_t total_tokens = 0;
+            for (const std::string& text : inputs) {
+                const std::uint64_t tokens = text.size() / 4 + 1;
+                if (tokens > opts.max_input_tokens) {
+                    return error_response(400, "This model's maximum context length is " + std::to_string(opts.max_input_tokens)
+                        + " tokens, however you requested " + std::to_string(tokens) + " tokens in your input.", "invalid_request_error", "input");
+                }
+                total_tokens += tokens;
+            }
+
+            boost::json::array data;
+            data.reserve(inputs.size());
+            std::vector<float> vector(dimensions);
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                std::uint64_t state = fnv1a(inputs[i]) | 1;
+                double norm = 0;
+                for (float& value : vector) {
+                    value = static_cast<float>(static_cast<double>(xorshift(state) >> 11) / 4503599627370496.0 - 1.0);
+                    norm += double{ value } * value;
+                }
+                const float scale = norm > 0 ? static_cast<float>(1 / std::sqrt(norm)) : 0.0f;
+                for (float& value : vector) {
+                    value *= scale;
+                }
+                boost::json::object item{ { "object", "embedding" }, { "index", i } };
+                if (base64) {
+                    item["embedding"] = base64_encode(reinterpret_cast<const unsigned char*>(vector.data()), vector.size() * sizeof(float));
+                }
+                else {
+                    boost::json::array values;
+                    values.reserve(vector.size());
+                    for (const float value : vector) {
+                        values.emplace_back(value);
+                    }
+                    item["embedding"] = std::move(values);
+                }
+                data.push_back(std::move(item));
+            }
+            return json_response(200, boost::json::object{ { "object", "list" }, { "data", std::move(data) },
+                { "model", string_or(body, "model", "mock") }, { "usage", boost::json::object{ { "prompt_tokens", total_tokens }, { "total_tokens", total_tokens } } } });
+        }
+
+        // An input containing "[category]" is flagged for that category.
+        mock_response moderations(const boost::json::object& body) const {
+            static constexpr std::array<std::string_view, 5> categories = { "hate", "harassment", "self-harm", "sexual", "violence" };
+            std::vector<std::string> inputs;
+            const boost::json::value& input = body.at("input");
+            if (input.is_string()) {
+                inputs.emplace_back(input.get_string());
+            }
+            else {
+                for (const boost::json::value& item : input.as_array()) {
+                    inputs.emplace_back(item.as_string());
+                }
+            }
+            boost::json::array results;
+            for (const std::string& text : inputs) {
+                boost::json::object flags;
+                boost::json::object scores;
+                bool flagged = false;
+                for (const std::string_view category : categories) {
+                    const bool hit = text.find("[" + std::string{ category } + "]") != std::string::npos;
+                    flagged = flagged || hit;
+                    flags[category] = hit;
+                    scores[category] = hit ? 0.99 : static_cast<double>(fnv1a(category, fnv1a(text)) % 1000) / 100000.0;
+                }
+                results.push_back(boost::json::object{ { "flagged", flagged }, { "categories", std::move(flags) }, { "category_scores", std::move(scores) } });
+            }
+            return json_response(200, boost::json::object{ { "id", "modr-mock" }, { "model", string_or(body, "model", "text-moderation-latest") },
+                { "results", std::move(results) } });
+        }
+
+        boost::json::object file_object(std::string_view id) const {
+            return { { "id", id }, { "object", "file" }, { "bytes", file_content.size() }, { "created_at", now() }, { "filename", "mock.jsonl" },
+                { "purpose", "fine-tune" }, { "status", "processed" } };
+        }
+
+        // Honors "Range: bytes=N-", and If-Range against the ETag, as resumed downloads send them.
+        mock_response file_range(const mock_request& request) const {
+            mock_response response;
+            response.content_type = "application/octet-stream";
+            response.headers.emplace_back("etag", file_etag);
+            response.headers.emplace_back("accept-ranges", "bytes");
+            std::size_t offset = 0;
+            if (request.range.starts_with("bytes=") && (request.if_range.empty() || request.if_range == file_etag)) {
+                const std::string_view spec = std::string_view{ request.range }.substr(6);
+                const auto [end, error] = std::from_chars(spec.data(), spec.data() + spec.size(), offset);
+                if (error != std::errc{} || end == spec.data() + spec.size() || *end != '-') {
+                    return error_response(400, "unsupported Range header", "invalid_request_error");
+                }
+                if (offset >= file_content.size()) {
+                    mock_response unsatisfiable = error_response(416, "range not satisfiable", "invalid_request_error");
+                    unsatisfiable.headers.emplace_back("content-range", "bytes */" + std::to_string(file_content.size()));
+                    return unsatisfiable;
+                }
+                response.status = 206;
+                response.headers.emplace_back("content-range", "bytes " + std::to_string(offset) + '-' + std::to_string(file_content.size() - 1)
+                    + '/' + std::to_string(file_content.size()));
+            }
+            response.body = file_content.substr(offset);
+            return response;
+        }
+
+        static boost::json::object fine_tune(std::string_view id, std::string_view status) {
+            return { { "id", id }, { "object", "fine-tune" }, { "model", "curie" }, { "created_at", now() }, { "status", status },
+                { "fine_tuned_model", nullptr }, { "training_files", boost::json::array{} }, { "result_files", boost::json::array{} } };
+        }
+    };
+
+    template <class Stream>
+    boost::asio::awaitable<void> write_http1(Stream& stream, mock_response response, unsigned version, bool keep_alive) {
+        namespace http = boost::beast::http;
+        if (response.events.empty()) {
+            http::response<http::string_body> message{ static_cast<http::status>(response.status), version };
+            message.set(http::field::server, "cppai-mock");
+            message.set(http::field::content_type, response.content_type);
+            for (const auto& [name, value] : response.headers) {
+                message.set(name, value);
+            }
+            message.keep_alive(keep_alive);
+            message.body() = std::move(response.body);
+            message.prepare_payload();
+            co_await http::async_write(stream, message, boost::asio::use_awaitable);
+            co_return;
+        }
+
+        http::response<http::empty_body> message{ static_cast<http::status>(response.status), version };
+        message.set(http::field::server, "cppai-mock");
+        message.set(http::field::content_type, response.content_type);
+        message.set(http::field::cache_control, "no-cache");
+        for (const auto& [name, value] : response.headers) {
+            message.set(name, value);
+        }
+        message.keep_alive(keep_alive);
+        message.chunked(true);
+        http::response_serializer<http::empty_body> serializer{ message };
+        co_await http::async_write_header(stream, serializer, boost::asio::use_awaitable);
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor };
+        for (const std::string_view text : response.pieces()) {
+            if (response.interval.count() > 0) {
+                timer.expires_after(response.interval);
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            co_await boost::asio::async_write(stream, http::make_chunk(boost::asio::buffer(text)), boost::asio::use_awaitable);
+        }
+        co_await boost::asio::async_write(stream, http::make_chunk_last(), boost::asio::use_awaitable);
+    }
+
+    template <class Stream>
+    boost::asio::awaitable<void> serve_http1(responder& server, Stream& stream, boost::beast::flat_buffer& buffer) {
+        namespace http = boost::beast::http;
+        for (;;) {
+            http::request_parser<http::string_body> parser;
+            parser.body_limit(max_upload);
+            const auto [error_code, read] = co_await http::async_read(stream, buffer, parser, boost::asio::as_tuple(boost::asio::use_awaitable));
+            if (error_code) {
+                // The client closed the connection, or sent something that is not HTTP.
+                co_return;
+            }
+            http::request<http::string_body>& message = parser.get();
+            mock_request request;
+            request.method = to_string(message.method_string());
+            request.target = to_string(message.target());
+            request.content_type = to_string(message[http::field::content_type]);
+            request.accept_encoding = to_string(message[http::field::accept_encoding]);
+            request.content_encoding = to_string(message[http::field::content_encoding]);
+            request.range = to_string(message[http::field::range]);
+            request.if_range = to_string(message[http::field::if_range]);
+            request.body = std::move(message.body());
+            const bool keep_alive = message.keep_alive();
+
+            mock_response response = co_await server.respond(std::move(request));
+            if (response.drop) {
+                co_return;
+            }
+            co_await write_http1(stream, std::move(response), message.version(), keep_alive);
+            if (!keep_alive) {
+                co_return;
+            }
+        }
+    }
+
+    enum : std::uint8_t {
+        frame_data = 0x0, frame_headers = 0x1, frame_rst_stream = 0x3, frame_settings = 0x4, frame_ping = 0x6, frame_goaway = 0x7,
+        frame_continuation = 0x9
+    };
+
+    enum : std::uint8_t {
+        flag_end_stream = 0x1, flag_ack = 0x1, flag_end_headers = 0x4, flag_padded = 0x8, flag_priority = 0x20
+    };
+
+    constexpr std::string_view h2_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    constexpr std::uint32_t h2_default_window = 65535;
+    constexpr std::uint32_t h2_window = 16 * 1024 * 1024;
+    constexpr std::size_t h2_max_frame = 16384;
+
+    void write_u32(unsigned char* out, std::uint32_t value) {
+        out[0] = static_cast<unsigned char>(value >> 24);
+        out[1] = static_cast<unsigned char>(value >> 16);
+        out[2] = static_cast<unsigned char>(value >> 8);
+        out[3] = static_cast<unsigned char>(value);
+    }
+
+    std::uint32_t read_u32(const unsigned char* in) {
+        return (std::uint32_t{ in[0] } << 24) | (std::uint32_t{ in[1] } << 16) | (std::uint32_t{ in[2] } << 8) | in[3];
+    }
+
+    // The server side of HTTP/2, as much of it as the client uses. Everything runs on the connection's strand.
+    // Send windows are not tracked: the client opens 16 MiB stream and 64 MiB connection windows and tops
+    // them up as it reads, far more than the mock ever has in flight.
+    template <class Stream>
+    class h2_connection : public std::enable_shared_from_this<h2_connection<Stream>> {
+    public:
+        h2_connection(responder& server, Stream stream, boost::beast::flat_buffer buffer)
+            : server{ server }, stream{ std::move(stream) }, buffer{ std::move(buffer) }, signal{ this->stream.get_executor() } {}
+
+        boost::asio::awaitable<void> run() {
+            co_await read_exact(h2_preface.size());
+            if (std::string_view{ static_cast<const char*>(buffer.data().data()), h2_preface.size() } != h2_preface) {
+                co_return;
+            }
+            buffer.consume(h2_preface.size());
+
+            unsigned char settings[12];
+            settings[0] = 0;
+            settings[1] = 0x3;
+            write_u32(settings + 2, 1000);
+            settings[6] = 0;
+            settings[7] = 0x4;
+            write_u32(settings + 8, h2_window);
+            queue_frame(frame_settings, 0, 0, settings, sizeof(settings));
+            queue_window_update(0, h2_window - h2_default_window);
+            boost::asio::co_spawn(stream.get_executor(), [self = this->shared_from_this()] { return self->writer(); }, boost::asio::detached);
+
+            try {
+                co_await reader();
+            }
+            catch (...) {
+                close();
+                throw;
+            }
+            close();
+        }
+
+    private:
+        struct incoming {
+            mock_request request;
+            std::vector<unsigned char> block;
+            bool end_stream = false;
+        };
+
+        responder& server;
+        Stream stream;
+        boost::beast::flat_buffer buffer;
+        boost::asio::steady_timer signal;
+        cppai::hpack_decoder decoder;
+        cppai::hpack_encoder encoder;
+        std::deque<std::vector<unsigned char>> outbox;
+        std::unordered_map<std::uint32_t, incoming> streams;
+        // Streams being answered; RST_STREAM takes one out so its reply is dropped.
+        std::unordered_set<std::uint32_t> answering;
+        std::size_t peer_max_frame = h2_max_frame;
+        bool closed = false;
+
+        void close() {
+            closed = true;
+            outbox.clear();
+            signal.cancel();
+        }
+
+        boost::asio::awaitable<void> read_exact(std::size_t size) {
+            if (buffer.size() < size) {
+                co_await boost::asio::async_read(stream, buffer, boost::asio::transfer_at_least(size - buffer.size()), boost::asio::use_awaitable);
+            }
+        }
+
+        boost::asio::awaitable<void> reader() {
+            for (;;) {
+                co_await read_exact(9);
+                const auto* head = static_cast<const unsigned char*>(buffer.data().data());
+                const std::size_t length = (std::size_t{ head[0] } << 16) | (std::size_t{ head[1] } << 8) | head[2];
+                const std::uint8_t type = head[3];
+                const std::uint8_t flags = head[4];
+                const std::uint32_t id = read_u32(head + 5) & 0x7fffffffu;
+                if (length > h2_max_frame) {
+                    co_return;
+                }
+                co_await read_exact(9 + length);
+                const bool more = handle(type, flags, id, static_cast<const unsigned char*>(buffer.data().data()) + 9, length);
+                buffer.consume(9 + length);
+                if (!more) {
+                    co_return;
+                }
+            }
+        }
+
+        boost::asio::awaitable<void> writer() {
+            std::vector<std::vector<unsigned char>> sending;
+            std::vector<boost::asio::const_buffer> buffers;
+            while (!closed) {
+                if (outbox.empty()) {
+                    signal.expires_at(boost::asio::steady_timer::time_point::max());
+                    co_await signal.async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+                    continue;
+                }
+                sending.assign(std::make_move_iterator(outbox.begin()), std::make_move_iterator(outbox.end()));
+                outbox.clear();
+                buffers.clear();
+                for (const std::vector<unsigned char>& frame : sending) {
+                    buffers.push_back(boost::asio::buffer(frame));
+                }
+                co_await boost::asio::async_write(stream, buffers, boost::asio::use_awaitable);
+            }
+        }
+
+        void queue_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t id, const unsigned char* payload, std::size_t size) {
+            if (closed) {
+                return;
+            }
+            std::vector<unsigned char> frame(9 + size);
+            frame[0] = static_cast<unsigned char>(size >> 16);
+            frame[1] = static_cast<unsigned char>(size >> 8);
+            frame[2] = static_cast<unsigned char>(size);
+            frame[3] = type;
+            frame[4] = flags;
+            write_u32(frame.data() + 5, id);
+            if (size != 0) {
+                std::memcpy(frame.data() + 9, payload, size);
+            }
+            outbox.push_back(std::move(frame));
+            signal.cancel();
+        }
+
+        void queue_window_update(std::uint32_t id, std::size_t increment) {
+            unsigned char payload[4];
+            write_u32(payload, static_cast<std::uint32_t>(increment));
+            queue_frame(0x8, 0, id, payload, sizeof(payload));
+        }
+
+        bool handle(std::uint8_t type, std::uint8_t flags, std::uint32_t id, const unsigned char* payload, std::size_t length) {
+            switch (type) {
+            case frame_settings:
+                if ((flags & flag_ack) == 0) {
+                    for (std::size_t i = 0; i + 6 <= length; i += 6) {
+                        if (((payload[i] << 8) | payload[i + 1]) == 0x5) {
+                            peer_max_frame = read_u32(payload + i + 2);
+                        }
+                    }
+                    queue_frame(frame_settings, flag_ack, 0, nullptr, 0);
+                }
+                return true;
+            case frame_ping:
+                if ((flags & flag_ack) == 0 && length == 8) {
+                    queue_frame(frame_ping, flag_ack, 0, payload, length);
+                }
+                return true;
+            case frame_goaway:
+                return false;
+            case frame_rst_stream:
+                streams.erase(id);
+                answering.erase(id);
+                return true;
+            case frame_headers:
+            case frame_continuation:
+                return on_headers(type, flags, id, payload, length);
+            case frame_data:
+                return on_data(flags, id, payload, length);
+            default:
+                // PRIORITY and WINDOW_UPDATE; see the note on send windows.
+                return true;
+            }
+        }
+
+        bool on_headers(std::uint8_t type, std::uint8_t flags, std::uint32_t id, const unsigned char* payload, std::size_t length) {
+            std::size_t begin = 0;
+            std::size_t end = length;
+            if (type == frame_headers) {
+                if ((flags & flag_padded) != 0) {
+                    if (length == 0 || payload[0] >= length) {
+                        return false;
+                    }
+                    begin = 1;
+                    end -= payload[0];
+                }
+                if ((flags & flag_priority) != 0) {
+                    begin += 5;
+                }
+                if (begin > end) {
+                    return false;
+                }
+                streams[id].end_stream = (flags & flag_end_stream) != 0;
+            }
+            const auto found = streams.find(id);
+            if (found == streams.end()) {
+                return false;
+            }
+            incoming& target = found->second;
+            target.block.insert(target.block.end(), payload + begin, payload + end);
+            if ((flags & flag_end_headers) == 0) {
+                return true;
+            }
+
+            std::vector<cppai::hpack_field> fields;
+            decoder.decode(target.block, fields);
+            target.block.clear();
+            for (cppai::hpack_field& field : fields) {
+                if (field.name == ":method") {
+                    target.request.method = std::move(field.value);
+                }
+                else if (field.name == ":path") {
+                    target.request.target = std::move(field.value);
+                }
+                else if (field.name == "content-type") {
+                    target.request.content_type = std::move(field.value);
+                }
+                else if (field.name == "accept-encoding") {
+                    target.request.accept_encoding = std::move(field.value);
+                }
+                else if (field.name == "content-encoding") {
+                    target.request.content_encoding = std::move(field.value);
+                }
+                else if (field.name == "range") {
+                    target.request.range = std::move(field.value);
+                }
+                else if (field.name == "if-range") {
+                    target.request.if_range = std::move(field.value);
+                }
+            }
+            if (target.end_stream) {
+                dispatch(id);
+            }
+            return true;
+        }
+
+        bool on_data(std::uint8_t flags, std::uint32_t id, const unsigned char* payload, std::size_t length) {
+            std::size_t begin = 0;
+            std::size_t end = length;
+            if ((flags & flag_padded) != 0) {
+                if (length == 0 || payload[0] >= length) {
+                    return false;
+                }
+                begin = 1;
+                end -= payload[0];
+            }
+            if (length != 0) {
+                queue_window_update(0, length);
+            }
+            const auto found = streams.find(id);
+            if (found == streams.end()) {
+                return true;
+            }
+            found->second.request.body.append(reinterpret_cast<const char*>(payload + begin), end - begin);
+            if ((flags & flag_end_stream) != 0) {
+                dispatch(id);
+            }
+            else if (length != 0) {
+                queue_window_update(id, length);
+            }
+            return true;
+        }
+
+        void dispatch(std::uint32_t id) {
+            const auto found = streams.find(id);
+            mock_request request = std::move(found->second.request);
+            streams.erase(found);
+            answering.insert(id);
+            boost::asio::co_spawn(stream.get_executor(),
+                [self = this->shared_from_this(), id, request = std::move(request)]() mutable { return self->reply(id, std::move(request)); },
+                boost::asio::detached);
+        }
+
+        boost::asio::awaitable<void> reply(std::uint32_t id, mock_request request) {
+            const mock_response response = co_await server.respond(std::move(request));
+            if (!answering.contains(id)) {
+                co_return;
+            }
+            if (response.drop) {
+                // INTERNAL_ERROR: unlike REFUSED_STREAM it does not tell the client the request went unprocessed.
+                unsigned char code[4];
+                write_u32(code, 0x2);
+                queue_frame(frame_rst_stream, 0, id, code, sizeof(code));
+                answering.erase(id);
+                co_return;
+            }
+
+            std::vector<unsigned char> block;
+            encoder.begin_block(block);
+            encoder.encode(":status", std::to_string(response.status), true, block);
+            encoder.encode("content-type", response.content_type, true, block);
+            std::string name;
+            for (const auto& [field, value] : response.headers) {
+                name.assign(field);
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                encoder.encode(name, value, true, block);
+            }
+            const bool empty = response.body.empty() && response.events.empty();
+            if (response.events.empty()) {
+                encoder.encode("content-length", std::to_string(response.body.size()), false, block);
+            }
+            std::size_t offset = 0;
+            do {
+                const std::size_t size = std::min(block.size() - offset, peer_max_frame);
+                const bool last = offset + size == block.size();
+                const auto flags = static_cast<std::uint8_t>((last ? flag_end_headers : 0) | (offset == 0 && empty ? flag_end_stream : 0));
+                queue_frame(offset == 0 ? frame_headers : frame_continuation, flags, id, block.data() + offset, size);
+                offset += size;
+            } while (offset < block.size());
+            if (empty) {
+                answering.erase(id);
+                co_return;
+            }
+
+            if (response.events.empty()) {
+                queue_data(id, response.body, true);
+            }
+            else {
+                boost::asio::steady_timer timer{ stream.get_executor() };
+                const std::vector<std::string_view> pieces = response.pieces();
+                for (std::size_t i = 0; i < pieces.size(); ++i) {
+                    if (response.interval.count() > 0) {
+                        timer.expires_after(response.interval);
+                        co_await timer.async_wait(boost::asio::use_awaitable);
+                    }
+                    if (!answering.contains(id)) {
+                        co_return;
+                    }
+                    queue_data(id, pieces[i], i + 1 == pieces.size());
+                }
+            }
+            answering.erase(id);
+        }
+
+        void queue_data(std::uint32_t id, std::string_view data, bool end_stream) {
+            const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+            std::size_t offset = 0;
+            do {
+                const std::size_t size = std::min(data.size() - offset, peer_max_frame);
+                const bool last = offset + size == data.size();
+                queue_frame(frame_data, last && end_stream ? flag_end_stream : 0, id, bytes + offset, size);
+                offset += size;
+            } while (offset < data.size());
+        }
+    };
+
+    boost::asio::awaitable<void> serve(responder& server, boost::asio::ssl::context& tls, boost::asio::ip::tcp::socket socket) {
+        using secure_stream = boost::beast::ssl_stream<boost::beast::tcp_stream>;
+        ++server.cells.connections;
+        boost::beast::tcp_stream stream{ std::move(socket) };
+        boost::beast::flat_buffer buffer;
+        try {
+            stream.expires_after(std::chrono::seconds(30));
+            if (!co_await boost::beast::async_detect_ssl(stream, buffer, boost::asio::use_awaitable)) {
+                stream.expires_never();
+                co_await serve_http1(server, stream, buffer);
+                boost::system::error_code ignored;
+                stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ignored);
+                co_return;
+            }
+
+            ++server.cells.tls_connections;
+            secure_stream secure{ std::move(stream), tls };
+            const std::size_t used = co_await secure.async_handshake(boost::asio::ssl::stream_base::server, buffer.data(), boost::asio::use_awaitable);
+            buffer.consume(used);
+            boost::beast::get_lowest_layer(secure).expires_never();
+
+            const unsigned char* selected = nullptr;
+            unsigned int selected_size = 0;
+            SSL_get0_alpn_selected(secure.native_handle(), &selected, &selected_size);
+            if (std::string_view{ reinterpret_cast<const char*>(selected), selected_size } == "h2") {
+                ++server.cells.h2_connections;
+                co_await std::make_shared<h2_connection<secure_stream>>(server, std::move(secure), std::move(buffer))->run();
+                co_return;
+            }
+            co_await serve_http1(server, secure, buffer);
+            co_await secure.async_shutdown(boost::asio::as_tuple(boost::asio::use_awaitable));
+        }
+        catch (const std::exception&) {
+            // Clients drop connections at any point, which ends the session and nothing more.
+        }
+    }
+
+    void check(bool ok, const char* what) {
+        if (!ok) {
+            throw std::runtime_error(std::string{ "cannot create the mock certificate: " } + what);
+        }
+    }
+
+    std::string drain(BIO* bio) {
+        char* data = nullptr;
+        const long size = BIO_get_mem_data(bio, &data);
+        return std::string(data, static_cast<std::size_t>(size));
+    }
+
+    // An ECDSA P-256 key and a day-long certificate for localhost and 127.0.0.1, both in PEM.
+    std::pair<std::string, std::string> self_signed_certificate() {
+        std::unique_ptr<EVP_PKEY_CTX, decltype(&EVP_PKEY_CTX_free)> keygen{ EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr), EVP_PKEY_CTX_free };
+        EVP_PKEY* generated = nullptr;
+        check(keygen != nullptr && EVP_PKEY_keygen_init(keygen.get()) == 1
+            && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keygen.get(), NID_X9_62_prime256v1) == 1 && EVP_PKEY_keygen(keygen.get(), &generated) == 1,
+            "key generation");
+        std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key{ generated, EVP_PKEY_free };
+
+        std::unique_ptr<X509, decltype(&X509_free)> cert{ X509_new(), X509_free };
+        check(cert != nullptr, "X509_new");
+        X509_set_version(cert.get(), 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert.get()), -60);
+        X509_gmtime_adj(X509_getm_notAfter(cert.get()), 24 * 60 * 60);
+        X509_set_pubkey(cert.get(), key.get());
+        X509_NAME* name = X509_get_subject_name(cert.get());
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert.get(), name);
+
+        X509V3_CTX extensions;
+        X509V3_set_ctx_nodb(&extensions);
+        X509V3_set_ctx(&extensions, cert.get(), cert.get(), nullptr, nullptr, 0);
+        const std::pair<int, const char*> wanted[] = { { NID_subject_alt_name, "DNS:localhost,IP:127.0.0.1" }, { NID_basic_constraints, "critical,CA:TRUE" } };
+        for (const auto& [nid, value] : wanted) {
+            X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &extensions, nid, const_cast<char*>(value));
+            check(extension != nullptr && X509_add_ext(cert.get(), extension, -1) == 1, "extensions");
+            X509_EXTENSION_free(extension);
+        }
+        check(X509_sign(cert.get(), key.get(), EVP_sha256()) != 0, "X509_sign");
+
+        std::unique_ptr<BIO, decltype(&BIO_free)> cert_pem{ BIO_new(BIO_s_mem()), BIO_free };
+        std::unique_ptr<BIO, decltype(&BIO_free)> key_pem{ BIO_new(BIO_s_mem()), BIO_free };
+        check(cert_pem != nullptr && key_pem != nullptr && PEM_write_bio_X509(cert_pem.get(), cert.get()) == 1
+            && PEM_write_bio_PrivateKey(key_pem.get(), key.get(), nullptr, nullptr, 0, nullptr, nullptr) == 1, "PEM");
+        return { drain(cert_pem.get()), drain(key_pem.get()) };
+    }
+
+    int select_protocol(SSL*, const unsigned char** out, unsigned char* out_size, const unsigned char* in, unsigned int in_size, void* arg) {
+        const std::string& offered = *static_cast<const std::string*>(arg);
+        unsigned char* selected = nullptr;
+        if (SSL_select_next_proto(&selected, out_size, reinterpret_cast<const unsigned char*>(offered.data()), static_cast<unsigned int>(offered.size()),
+                in, in_size) != OPENSSL_NPN_NEGOTIATED) {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        *out = selected;
+        return SSL_TLSEXT_ERR_OK;
+    }
+}
+
+struct cppai::bench::mock_server::state {
+    boost::asio::io_context ctx;
+    mock_options opts;
+    responder server;
+    boost::asio::ssl::context tls{ boost::asio::ssl::context::tls_server };
+    boost::asio::ip::tcp::acceptor acceptor{ ctx };
+    // ALPN protocols in wire format, most preferred first.
+    std::string protocols;
+    std::string certificate;
+    std::vector<std::thread> threads;
+
+    explicit state(mock_options options)
+        : ctx{ static_cast<int>(std::max<std::size_t>(options.threads, 1)) }, opts{ std::move(options) }, server{ opts } {}
+
+    boost::asio::awaitable<void> accept() {
+        for (;;) {
+            const boost::asio::any_io_executor strand = boost::asio::make_strand(ctx);
+            boost::asio::ip::tcp::socket socket = co_await acceptor.async_accept(strand, boost::asio::use_awaitable);
+            boost::asio::co_spawn(strand, serve(server, tls, std::move(socket)), boost::asio::detached);
+        }
+    }
+};
+
+cppai::bench::mock_server::mock_server(mock_options opts) : impl{ std::make_unique<state>(std::move(opts)) } {
+}
+
+cppai::bench::mock_server::~mock_server() {
+    stop();
+}
+
+void cppai::bench::mock_server::start() {
+    state& s = *impl;
+    if (s.opts.cert_file.empty()) {
+        const auto [cert, key] = self_signed_certificate();
+        s.certificate = cert;
+        s.tls.use_certificate_chain(boost::asio::buffer(cert));
+        s.tls.use_private_key(boost::asio::buffer(key), boost::asio::ssl::context::pem);
+    }
+    else {
+        s.tls.use_certificate_chain_file(s.opts.cert_file);
+        s.tls.use_private_key_file(s.opts.key_file, boost::asio::ssl::context::pem);
+        std::ifstream in{ s.opts.cert_file };
+        std::ostringstream text;
+        text << in.rdbuf();
+        s.certificate = text.str();
+    }
+    s.protocols = s.opts.http2 ? std::string{ "\x02" "h2" "\x08" "http/1.1" } : std::string{ "\x08" "http/1.1" };
+    SSL_CTX_set_alpn_select_cb(s.tls.native_handle(), select_protocol, &s.protocols);
+
+    const boost::asio::ip::tcp::endpoint endpoint{ boost::asio::ip::make_address(s.opts.address), s.opts.port };
+    s.acceptor.open(endpoint.protocol());
+    s.acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+    s.acceptor.bind(endpoint);
+    s.acceptor.listen();
+    boost::asio::co_spawn(s.ctx, s.accept(), boost::asio::detached);
+    for (std::size_t i = 0; i < std::max<std::size_t>(s.opts.threads, 1); ++i) {
+        s.threads.emplace_back([&s] { s.ctx.run(); });
+    }
+}
+
+void cppai::bench::mock_server::stop() {
+    impl->ctx.stop();
+    for (std::thread& thread : impl->threads) {
+        thread.join();
+    }
+    impl->threads.clear();
+}
+
+std::uint16_t cppai::bench::mock_server::port() const {
+    return impl->acceptor.local_endpoint().port();
+}
+
+const std::string& cppai::bench::mock_server::certificate() const {
+    return impl->certificate;
+}
+
+cppai::bench::mock_counters cppai::bench::mock_server::counters() const {
+    return impl->server.cells.load();
+}
+
+void cppai::bench::mock_server::reset_counters() {
+    impl->server.cells.reset();
+}
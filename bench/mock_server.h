@@ -0,0 +1,137 @@
+#ifndef CPPAI_BENCH_MOCK_SERVER_H
+#define CPPAI_BENCH_MOCK_SERVER_H
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace cppai::bench {
+    // How long the server waits before answering a request.
+    struct latency_distribution {
+        enum class shape {
+            fixed,
+            uniform,
+            exponential,
+            lognormal
+        };
+
+        shape kind = shape::fixed;
+        // fixed: the delay; uniform: the lower bound; exponential: the mean; lognormal: the median.
+        std::chrono::microseconds first{ 0 };
+        // uniform: the upper bound.
+        std::chrono::microseconds second{ 0 };
+        // lognormal: the standard deviation of the underlying normal distribution.
+        double sigma = 0.5;
+
+        std::chrono::microseconds sample(std::mt19937_64& rng) const;
+
+        // Reads "fixed:5ms", "uniform:2ms,10ms", "exponential:5ms" or "lognormal:5ms,0.8"; throws
+        // std::invalid_argument otherwise.
+        static latency_distribution parse(std::string_view spec);
+    };
+
+    // Reads "250us", "5ms", "1.5s" or a plain number of milliseconds; throws std::invalid_argument otherwise.
+    std::chrono::microseconds parse_micros(std::string_view text);
+
+    struct mock_options {
+        std::string address = "127.0.0.1";
+        // Zero binds a free port; port() tells which.
+        std::uint16_t port = 0;
+        std::size_t threads = 1;
+        // PEM files; a self-signed certificate for localhost and 127.0.0.1 is generated when they are empty.
+        std::string cert_file;
+        std::string key_file;
+        // Offer h2 through ALPN. TLS and plaintext HTTP/1.1 are always served on the same port.
+        bool http2 = true;
+
+        latency_distribution latency;
+        // Drawn on top of latency for completions and chat completions, so generation can outlast the
+        // other endpoints as it does in production.
+        latency_distribution generation_latency;
+        // Transcriptions and translations also take one second per audio_speed seconds of uploaded audio;
+        // zero leaves them at the plain latency.
+        double audio_speed = 0;
+        // Streamed completions are sent as this many events, interval apart.
+        std::size_t stream_events = 16;
+        std::chrono::microseconds stream_interval{ 0 };
+        // Nonzero writes each event in pieces of this many bytes, stream_interval apart, so clients see
+        // events split inside lines and fields rather than one per read.
+        std::size_t stream_fragment = 0;
+
+        // Shares of requests answered with 429 and with a 500, 502 or 503 instead.
+        double rate_limit_fraction = 0;
+        std::chrono::milliseconds retry_after{ 100 };
+        double server_error_fraction = 0;
+        // Share of requests read in full and never answered: the connection is closed over HTTP/1.1 and the
+        // stream reset over HTTP/2, as when a server dies while handling the request.
+        double drop_fraction = 0;
+
+        // gzip responses of at least gzip_min_size bytes for clients that accept it.
+        bool gzip = true;
+        std::size_t gzip_min_size = 1024;
+
+        std::size_t completion_words = 16;
+        std::size_t embedding_dimensions = 1536;
+        // Embedding inputs estimated above this many tokens are rejected with 400, as the API does.
+        std::size_t max_input_tokens = 8191;
+        std::size_t image_bytes = 256 * 1024;
+        std::size_t file_bytes = 8 * 1024 * 1024;
+
+        // JSON Lines of recorded responses: {"method", "target", "status", "headers", "body", "events"}, where
+        // body is a JSON value or a string and events, if present, are sent as a text/event-stream. Requests
+        // matching method and target (without the query) get the recorded responses in turn.
+        std::string replay_file;
+
+        std::uint64_t seed = 1;
+    };
+
+    struct mock_counters {
+        std::uint64_t connections = 0;
+        std::uint64_t tls_connections = 0;
+        std::uint64_t h2_connections = 0;
+        std::uint64_t requests = 0;
+        std::uint64_t rate_limited = 0;
+        std::uint64_t server_errors = 0;
+        std::uint64_t replayed = 0;
+        // Body bytes as they crossed the wire, i.e. before inflating requests and after gzipping responses.
+        std::uint64_t bytes_in = 0;
+        std::uint64_t bytes_out = 0;
+    };
+
+    // A local stand-in for the OpenAI API that answers every endpoint openAI calls with generated data of
+    // realistic shape and size, after an injected delay. GET /mock/stats returns the counters as JSON and
+    // POST /mock/reset zeroes them; neither is delayed or failed.
+    class mock_server {
+    public:
+        explicit mock_server(mock_options opts = {});
+
+        ~mock_server();
+
+        mock_server(const mock_server&) = delete;
+
+        mock_server& operator=(const mock_server&) = delete;
+
+        // Binds, then serves on threads of its own until stop() or destruction.
+        void start();
+
+        void stop();
+
+        std::uint16_t port() const;
+
+        // The certificate clients should trust, in PEM, e.g. written to a file for endpoint_config::ca_file.
+        const std::string& certificate() const;
+
+        mock_counters counters() const;
+
+        void reset_counters();
+
+    private:
+        struct state;
+
+        std::unique_ptr<state> impl;
+    };
+}
+
+#endif
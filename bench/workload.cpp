@@ -0,0 +1,124 @@
+#include "workload.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+    constexpr std::array<std::string_view, 6> supported_urls = { "/v1/chat/completions", "/v1/completions", "/v1/embeddings", "/v1/moderations",
+        "/v1/edits", "/v1/images/generations" };
+
+    cppai::bench::workload_item chat(const std::string& model, std::string text, bool stream) {
+        boost::json::object body{ { "model", model },
+            { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", std::move(text) } } } } };
+        if (stream) {
+            body["stream"] = true;
+        }
+        return { "/v1/chat/completions", std::move(body) };
+    }
+
+    void check_reply(const boost::json::value& reply) {
+        const boost::json::object* fields = reply.if_object();
+        const boost::json::value* error = fields != nullptr ? fields->if_contains("error") : nullptr;
+        if (error == nullptr) {
+            return;
+        }
+        const boost::json::value* message = error->is_object() ? error->get_object().if_contains("message") : nullptr;
+        throw std::runtime_error(message != nullptr && message->is_string() ? std::string{ message->get_string() } : boost::json::serialize(*error));
+    }
+}
+
+std::vector<cppai::bench::workload_item> cppai::bench::read_workload(const std::string& path, const std::string& model) {
+    std::ifstream in{ path };
+    if (!in) {
+        throw std::runtime_error("cannot open workload " + path);
+    }
+    std::vector<workload_item> items;
+    std::string line;
+    for (std::size_t number = 1; std::getline(in, line); ++number) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        boost::json::error_code error_code;
+        boost::json::value parsed = boost::json::parse(line, error_code);
+        if (error_code || !parsed.is_object()) {
+            throw std::runtime_error(path + ':' + std::to_string(number) + ": not a JSON object");
+        }
+        boost::json::object& fields = parsed.get_object();
+        if (const boost::json::value* url = fields.if_contains("url")) {
+            const std::string_view target = url->as_string();
+            if (std::find(supported_urls.begin(), supported_urls.end(), target) == supported_urls.end()) {
+                throw std::runtime_error(path + ':' + std::to_string(number) + ": unsupported url " + std::string{ target });
+            }
+            items.push_back({ std::string{ target }, fields.at("body") });
+            continue;
+        }
+        std::string text;
+        for (const auto& [key, value] : fields) {
+            if (value.is_string()) {
+                if (!text.empty()) {
+                    text.append("\n\n");
+                }
+                text.append(value.get_string());
+            }
+        }
+        items.push_back(chat(model, std::move(text), false));
+    }
+    if (items.empty()) {
+        throw std::runtime_error("workload " + path + " is empty");
+    }
+    return items;
+}
+
+std::vector<cppai::bench::workload_item> cppai::bench::default_workload(const std::string& model) {
+    return { chat(model, "Summarize the benefits of connection pooling in two sentences.", false),
+        chat(model, "Write a haiku about latency.", true),
+        { "/v1/embeddings", boost::json::object{ { "model", "text-embedding-3-small" }, { "input", "open-loop load generation" } } } };
+}
+
+boost::asio::awaitable<void> cppai::bench::issue(const openAI& client, const workload_item& item) {
+    const boost::json::value* stream = item.body.is_object() ? item.body.get_object().if_contains("stream") : nullptr;
+    if (stream != nullptr && stream->is_bool() && stream->get_bool()) {
+        std::string failure;
+        const auto on_event = [&failure](const boost::json::value& event) {
+            try {
+                check_reply(event);
+            }
+            catch (const std::exception& e) {
+                failure = e.what();
+            }
+        };
+        if (item.url == "/v1/chat/completions") {
+            co_await client.chat_completion_stream(item.body, on_event);
+        }
+        else {
+            co_await client.completion_stream(item.body, on_event);
+        }
+        if (!failure.empty()) {
+            throw std::runtime_error(failure);
+        }
+        co_return;
+    }
+
+    boost::json::value reply;
+    if (item.url == "/v1/chat/completions") {
+        reply = co_await client.chat_completion(item.body);
+    }
+    else if (item.url == "/v1/completions") {
+        reply = co_await client.completion(item.body);
+    }
+    else if (item.url == "/v1/embeddings") {
+        reply = co_await client.create_embedding(item.body);
+    }
+    else if (item.url == "/v1/moderations") {
+        reply = co_await client.create_moderations(item.body);
+    }
+    else if (item.url == "/v1/edits") {
+        reply = co_await client.edit(item.body);
+    }
+    else {
+        reply = co_await client.create_image(item.body);
+    }
+    check_reply(reply);
+}
@@ -0,0 +1,30 @@
+#ifndef CPPAI_BENCH_WORKLOAD_H
+#define CPPAI_BENCH_WORKLOAD_H
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <string>
+#include <vector>
+#include "openai.h"
+
+namespace cppai::bench {
+    struct workload_item {
+        // The API path, e.g. "/v1/chat/completions".
+        std::string url;
+        boost::json::value body;
+    };
+
+    // Reads a JSON Lines workload. Lines with a "url" are requests in the Batch API input format
+    // ({"custom_id", "method", "url", "body"}). Any other object, e.g. a line of requests.jsonl, becomes a chat
+    // completion with the object's string members as the user message. Throws std::runtime_error for an
+    // unreadable file or a url issue() does not know.
+    std::vector<workload_item> read_workload(const std::string& path, const std::string& model);
+
+    // A chat completion, a streamed one and an embedding, for runs without a workload file.
+    std::vector<workload_item> default_workload(const std::string& model);
+
+    // Sends item through the matching openAI call and discards the result. An error reply throws
+    // std::runtime_error, so it counts as a failure.
+    boost::asio::awaitable<void> issue(const openAI& client, const workload_item& item);
+}
+
+#endif
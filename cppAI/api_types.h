@@ -0,0 +1,116 @@
+#ifndef CPPAI_API_TYPES_H
+#define CPPAI_API_TYPES_H
+#include <boost/describe.hpp>
+#include <boost/json.hpp>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "schema.h"
+
+namespace cppai {
+    struct token_usage {
+        std::uint64_t prompt_tokens = 0;
+        std::uint64_t completion_tokens = 0;
+        std::uint64_t total_tokens = 0;
+    };
+
+    BOOST_DESCRIBE_STRUCT(token_usage, (), (prompt_tokens, completion_tokens, total_tokens))
+
+    struct tool_function_call {
+        std::string name;
+        // JSON text as the model wrote it; it is not guaranteed to parse.
+        std::string arguments;
+    };
+
+    BOOST_DESCRIBE_STRUCT(tool_function_call, (), (name, arguments))
+
+    struct tool_call {
+        std::string id;
+        std::string type = "function";
+        tool_function_call function;
+    };
+
+    BOOST_DESCRIBE_STRUCT(tool_call, (), (id, type, function))
+
+    struct chat_message {
+        std::string role;
+        std::optional<std::string> content;
+        std::optional<std::string> name;
+        std::optional<std::string> tool_call_id;
+        std::optional<std::vector<tool_call>> tool_calls;
+        std::optional<std::string> refusal;
+    };
+
+    BOOST_DESCRIBE_STRUCT(chat_message, (), (role, content, name, tool_call_id, tool_calls, refusal))
+
+    struct chat_request {
+        std::string model;
+        std::vector<chat_message> messages;
+        std::optional<double> temperature;
+        std::optional<double> top_p;
+        std::optional<std::uint32_t> n;
+        std::optional<std::uint32_t> max_tokens;
+        std::optional<std::vector<std::string>> stop;
+        std::optional<double> presence_penalty;
+        std::optional<double> frequency_penalty;
+        std::optional<std::map<std::string, std::int32_t>> logit_bias;
+        std::optional<std::int64_t> seed;
+        std::optional<std::string> user;
+        // Free-form parts of the request are left as JSON.
+        std::optional<boost::json::value> response_format;
+        std::optional<boost::json::value> tools;
+        std::optional<boost::json::value> tool_choice;
+    };
+
+    BOOST_DESCRIBE_STRUCT(chat_request, (), (model, messages, temperature, top_p, n, max_tokens, stop, presence_penalty,
+        frequency_penalty, logit_bias, seed, user, response_format, tools, tool_choice))
+
+    struct chat_choice {
+        std::uint32_t index = 0;
+        chat_message message;
+        std::optional<std::string> finish_reason;
+    };
+
+    BOOST_DESCRIBE_STRUCT(chat_choice, (), (index, message, finish_reason))
+
+    struct chat_response {
+        std::string id;
+        std::string object;
+        std::int64_t created = 0;
+        std::string model;
+        std::vector<chat_choice> choices;
+        token_usage usage;
+        std::optional<std::string> system_fingerprint;
+    };
+
+    BOOST_DESCRIBE_STRUCT(chat_response, (), (id, object, created, model, choices, usage, system_fingerprint))
+
+    // Vectors come back as float arrays; for base64 transfer use create_embedding_matrix.
+    struct embedding_request {
+        std::string model;
+        std::vector<std::string> input;
+        std::optional<std::uint32_t> dimensions;
+        std::optional<std::string> user;
+    };
+
+    BOOST_DESCRIBE_STRUCT(embedding_request, (), (model, input, dimensions, user))
+
+    struct embedding_item {
+        std::uint32_t index = 0;
+        std::vector<float> embedding;
+    };
+
+    BOOST_DESCRIBE_STRUCT(embedding_item, (), (index, embedding))
+
+    struct embedding_response {
+        std::string model;
+        std::vector<embedding_item> data;
+        token_usage usage;
+    };
+
+    BOOST_DESCRIBE_STRUCT(embedding_response, (), (model, data, usage))
+}
+
+#endif
@@ -0,0 +1,273 @@
+#include "audio.h"
+#include <boost/beast/core/file.hpp>
+#include <boost/system/system_error.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace {
+    constexpr std::uint16_t format_pcm = 1;
+    constexpr std::uint16_t format_float = 3;
+    constexpr std::uint16_t format_extensible = 0xFFFE;
+
+    [[noreturn]] void not_wav(const char* what) {
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::invalid_argument), what);
+    }
+
+    std::uint16_t read_u16(const unsigned char* bytes) {
+        return static_cast<std::uint16_t>(bytes[0] | bytes[1] << 8);
+    }
+
+    std::uint32_t read_u32(const unsigned char* bytes) {
+        return static_cast<std::uint32_t>(bytes[0]) | static_cast<std::uint32_t>(bytes[1]) << 8
+            | static_cast<std::uint32_t>(bytes[2]) << 16 | static_cast<std::uint32_t>(bytes[3]) << 24;
+    }
+
+    void write_u32(std::string& out, std::uint32_t value) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            out.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    void read_exact(boost::beast::file& file, void* out, std::size_t size) {
+        boost::system::error_code error_code;
+        std::size_t total = 0;
+        while (total < size) {
+            const std::size_t bytes_read = file.read(static_cast<char*>(out) + total, size - total, error_code);
+            if (error_code) {
+                throw boost::system::system_error(error_code);
+            }
+            if (bytes_read == 0) {
+                not_wav("Truncated WAV file");
+            }
+            total += bytes_read;
+        }
+    }
+
+    void seek(boost::beast::file& file, std::uint64_t offset) {
+        boost::system::error_code error_code;
+        file.seek(offset, error_code);
+        if (error_code) {
+            throw boost::system::system_error(error_code);
+        }
+    }
+
+    boost::beast::file open_scan(const boost::filesystem::path& path) {
+        boost::beast::file file;
+        boost::system::error_code error_code;
+        file.open(path.string().c_str(), boost::beast::file_mode::scan, error_code);
+        if (error_code) {
+            throw boost::system::system_error(error_code, path.string());
+        }
+        return file;
+    }
+
+    // A sample scaled to [-1, 1].
+    double sample_at(const unsigned char* bytes, const cppai::wav_format& format) {
+        if (format.encoding == format_float) {
+            if (format.bits_per_sample == 64) {
+                double value;
+                std::memcpy(&value, bytes, sizeof(value));
+                return value;
+            }
+            float value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        switch (format.bits_per_sample) {
+        case 8:
+            return (static_cast<int>(bytes[0]) - 128) / 128.0;
+        case 16:
+            return static_cast<std::int16_t>(read_u16(bytes)) / 32768.0;
+        case 24: {
+            std::int32_t value = bytes[0] | bytes[1] << 8 | bytes[2] << 16;
+            if (value & 0x800000) {
+                value -= 0x1000000;
+            }
+            return value / 8388608.0;
+        }
+        default:
+            return static_cast<std::int32_t>(read_u32(bytes)) / 2147483648.0;
+        }
+    }
+
+    // The frame at the middle of the quietest window in [from, to), or nullopt when none is below threshold_db.
+    std::optional<std::uint64_t> quietest_frame(boost::beast::file& file, const cppai::wav_format& format,
+        std::uint64_t from, std::uint64_t to, std::uint64_t window_frames, double threshold_db) {
+        if (to <= from || window_frames == 0) {
+            return std::nullopt;
+        }
+        std::vector<unsigned char> samples(static_cast<std::size_t>((to - from) * format.block_align));
+        seek(file, format.data_offset + from * format.block_align);
+        read_exact(file, samples.data(), samples.size());
+
+        const std::size_t sample_bytes = format.bits_per_sample / 8;
+        const std::uint64_t windows = (to - from) / window_frames;
+        double best = std::numeric_limits<double>::max();
+        std::uint64_t best_window = 0;
+        for (std::uint64_t window = 0; window < windows; ++window) {
+            const unsigned char* frame = samples.data() + window * window_frames * format.block_align;
+            double sum = 0.0;
+            for (std::uint64_t i = 0; i < window_frames; ++i, frame += format.block_align) {
+                for (std::uint16_t channel = 0; channel < format.channels; ++channel) {
+                    const double sample = sample_at(frame + channel * sample_bytes, format);
+                    sum += sample * sample;
+                }
+            }
+            const double mean_square = sum / static_cast<double>(window_frames * format.channels);
+            if (mean_square < best) {
+                best = mean_square;
+                best_window = window;
+            }
+        }
+        if (windows == 0 || 10.0 * std::log10(std::max(best, 1e-20)) >= threshold_db) {
+            return std::nullopt;
+        }
+        return from + best_window * window_frames + window_frames / 2;
+    }
+
+    std::uint64_t to_frames(std::chrono::milliseconds duration, std::uint32_t sample_rate) {
+        return static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0)) * sample_rate / 1000;
+    }
+}
+
+std::uint64_t cppai::wav_format::frames() const {
+    return block_align == 0 ? 0 : data_size / block_align;
+}
+
+std::chrono::milliseconds cppai::wav_format::duration(std::uint64_t frames) const {
+    return std::chrono::milliseconds{ sample_rate == 0 ? 0 : static_cast<std::int64_t>(frames * 1000 / sample_rate) };
+}
+
+cppai::wav_format cppai::read_wav_format(const boost::filesystem::path& path) {
+    boost::beast::file file = open_scan(path);
+    boost::system::error_code error_code;
+    const std::uint64_t file_size = file.size(error_code);
+    if (error_code) {
+        throw boost::system::system_error(error_code);
+    }
+
+    std::array<unsigned char, 12> riff;
+    read_exact(file, riff.data(), riff.size());
+    if (std::memcmp(riff.data(), "RIFF", 4) != 0 || std::memcmp(riff.data() + 8, "WAVE", 4) != 0) {
+        not_wav("Not a RIFF/WAVE file");
+    }
+
+    wav_format format;
+    std::uint64_t offset = riff.size();
+    while (offset + 8 <= file_size) {
+        std::array<unsigned char, 8> chunk;
+        seek(file, offset);
+        read_exact(file, chunk.data(), chunk.size());
+        const std::uint32_t chunk_size = read_u32(chunk.data() + 4);
+
+        if (std::memcmp(chunk.data(), "fmt ", 4) == 0) {
+            if (chunk_size < 16) {
+                not_wav("Malformed WAV fmt chunk");
+            }
+            format.fmt_chunk.resize(8 + chunk_size);
+            std::memcpy(format.fmt_chunk.data(), chunk.data(), chunk.size());
+            read_exact(file, format.fmt_chunk.data() + 8, chunk_size);
+            const auto* fields = reinterpret_cast<const unsigned char*>(format.fmt_chunk.data() + 8);
+            format.encoding = read_u16(fields);
+            format.channels = read_u16(fields + 2);
+            format.sample_rate = read_u32(fields + 4);
+            format.block_align = read_u16(fields + 12);
+            format.bits_per_sample = read_u16(fields + 14);
+            if (format.encoding == format_extensible && chunk_size >= 40) {
+                // The subformat GUID starts with the plain format tag.
+                format.encoding = read_u16(fields + 24);
+            }
+            // RIFF pads odd chunks to an even size.
+            if (chunk_size % 2 != 0) {
+                format.fmt_chunk.push_back('\0');
+            }
+        }
+        else if (std::memcmp(chunk.data(), "data", 4) == 0) {
+            if (format.fmt_chunk.empty()) {
+                not_wav("WAV data chunk before fmt chunk");
+            }
+            format.data_offset = offset + 8;
+            // Streamed recordings leave the size at zero or 0xFFFFFFFF; the samples run to the end of the file.
+            const std::uint64_t available = file_size - format.data_offset;
+            format.data_size = chunk_size == 0 || chunk_size == 0xFFFFFFFF ? available : std::min<std::uint64_t>(chunk_size, available);
+            break;
+        }
+        offset += 8 + chunk_size + chunk_size % 2;
+    }
+
+    if (format.data_offset == 0) {
+        not_wav("WAV file without a data chunk");
+    }
+    const bool integer = format.encoding == format_pcm
+        && (format.bits_per_sample == 8 || format.bits_per_sample == 16 || format.bits_per_sample == 24 || format.bits_per_sample == 32);
+    const bool floating = format.encoding == format_float && (format.bits_per_sample == 32 || format.bits_per_sample == 64);
+    if (!integer && !floating) {
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::not_supported), "WAV file is not PCM");
+    }
+    if (format.channels == 0 || format.sample_rate == 0 || format.block_align != format.channels * (format.bits_per_sample / 8)) {
+        not_wav("Malformed WAV fmt chunk");
+    }
+    return format;
+}
+
+std::string cppai::wav_header(const wav_format& format, std::uint64_t frames) {
+    const std::uint64_t data_size = frames * format.block_align;
+    std::string header;
+    header.reserve(12 + format.fmt_chunk.size() + 8);
+    header.append("RIFF");
+    write_u32(header, static_cast<std::uint32_t>(std::min<std::uint64_t>(4 + format.fmt_chunk.size() + 8 + data_size, 0xFFFFFFFF)));
+    header.append("WAVE");
+    header.append(format.fmt_chunk);
+    header.append("data");
+    write_u32(header, static_cast<std::uint32_t>(std::min<std::uint64_t>(data_size, 0xFFFFFFFF)));
+    return header;
+}
+
+std::vector<cppai::audio_segment> cppai::plan_segments(const boost::filesystem::path& path, const wav_format& format, const segment_options& options) {
+    const std::uint64_t total = format.frames();
+    const std::uint64_t length = std::max<std::uint64_t>(to_frames(options.length, format.sample_rate), 1);
+    const std::uint64_t overlap = std::min(to_frames(options.overlap, format.sample_rate), length / 2);
+    const std::uint64_t search = std::min(to_frames(options.silence_search, format.sample_rate), length / 2);
+    const std::uint64_t window = std::max<std::uint64_t>(to_frames(options.silence_window, format.sample_rate), 1);
+
+    std::vector<std::uint64_t> cuts{ 0 };
+    std::optional<boost::beast::file> file;
+    while (total - cuts.back() > length + length / 4) {
+        const std::uint64_t nominal = cuts.back() + length;
+        std::uint64_t cut = nominal;
+        if (options.split_at_silence && search != 0) {
+            if (!file.has_value()) {
+                file.emplace(open_scan(path));
+            }
+            cut = quietest_frame(*file, format, nominal - search, nominal, window, options.silence_db).value_or(nominal);
+        }
+        cuts.push_back(cut);
+    }
+    cuts.push_back(total);
+
+    std::vector<audio_segment> segments;
+    segments.reserve(cuts.size() - 1);
+    for (std::size_t i = 0; i + 1 < cuts.size(); ++i) {
+        audio_segment segment;
+        segment.overlap_frames = i == 0 ? 0 : std::min(overlap, cuts[i]);
+        segment.first_frame = cuts[i] - segment.overlap_frames;
+        segment.frames = cuts[i + 1] - segment.first_frame;
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+cppai::audio_slice cppai::make_slice(const boost::filesystem::path& file, const wav_format& format, const audio_segment& segment, std::string filename) {
+    audio_slice slice;
+    slice.file = file;
+    slice.filename = std::move(filename);
+    slice.head = wav_header(format, segment.frames);
+    slice.offset = format.data_offset + segment.first_frame * format.block_align;
+    slice.length = segment.frames * format.block_align;
+    return slice;
+}
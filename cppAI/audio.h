@@ -0,0 +1,70 @@
+#ifndef CPPAI_AUDIO_H
+#define CPPAI_AUDIO_H
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cppai {
+    // Layout of a RIFF/WAVE file holding integer or float PCM.
+    struct wav_format {
+        // 1 for integer PCM, 3 for IEEE float; WAVE_FORMAT_EXTENSIBLE is resolved to its subformat.
+        std::uint16_t encoding = 0;
+        std::uint16_t channels = 0;
+        std::uint32_t sample_rate = 0;
+        std::uint16_t bits_per_sample = 0;
+        std::uint16_t block_align = 0;
+        // The fmt chunk exactly as it appears in the file, header included, for writing slices.
+        std::string fmt_chunk;
+        std::uint64_t data_offset = 0;
+        std::uint64_t data_size = 0;
+
+        std::uint64_t frames() const;
+
+        std::chrono::milliseconds duration(std::uint64_t frames) const;
+    };
+
+    // Throws a system_error when the file is not a WAV file with PCM samples.
+    wav_format read_wav_format(const boost::filesystem::path& file);
+
+    // The header of a WAV file with the same format as the source and room for frames frames.
+    std::string wav_header(const wav_format& format, std::uint64_t frames);
+
+    struct segment_options {
+        std::chrono::milliseconds length{ 60000 };
+        // Each segment but the first also repeats this much of the end of the one before, so a word cut at a
+        // boundary is heard whole at least once.
+        std::chrono::milliseconds overlap{ 1000 };
+        // Boundaries move back to the quietest window within silence_search of the nominal cut, provided it
+        // is quieter than silence_db; otherwise the cut stays where length puts it.
+        bool split_at_silence = true;
+        std::chrono::milliseconds silence_search{ 5000 };
+        std::chrono::milliseconds silence_window{ 30 };
+        double silence_db = -40.0;
+    };
+
+    struct audio_segment {
+        std::uint64_t first_frame = 0;
+        std::uint64_t frames = 0;
+        // Frames at the start that repeat the end of the previous segment.
+        std::uint64_t overlap_frames = 0;
+    };
+
+    // Cuts the recording into segments of about options.length. A remainder shorter than a quarter of
+    // that is folded into the last segment rather than sent on its own.
+    std::vector<audio_segment> plan_segments(const boost::filesystem::path& file, const wav_format& format, const segment_options& options);
+
+    // Part of a file sent as an upload of its own: head, then length bytes from offset.
+    struct audio_slice {
+        boost::filesystem::path file;
+        std::string filename;
+        std::string head;
+        std::uint64_t offset = 0;
+        std::uint64_t length = 0;
+    };
+
+    audio_slice make_slice(const boost::filesystem::path& file, const wav_format& format, const audio_segment& segment, std::string filename);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "balancer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+cppai::backend_lease::backend_lease(std::shared_ptr<balancer> owner, std::size_t index)
+    : owner{ std::move(owner) }, index{ index }, started{ std::chrono::steady_clock::now() } {
+}
+
+cppai::backend_lease::backend_lease(backend_lease&& other) noexcept
+    : owner{ std::move(other.owner) }, index{ other.index }, started{ other.started }, reported{ other.reported } {
+}
+
+cppai::backend_lease::~backend_lease() {
+    if (owner) {
+        owner->release(index);
+    }
+}
+
+const cppai::backend& cppai::backend_lease::target() const {
+    return owner->states[index].target;
+}
+
+const std::string& cppai::backend_lease::authority() const {
+    return owner->states[index].authority;
+}
+
+void cppai::backend_lease::succeeded() {
+    if (!std::exchange(reported, true)) {
+        owner->report(index, true, std::chrono::steady_clock::now() - started);
+    }
+}
+
+void cppai::backend_lease::failed() {
+    if (!std::exchange(reported, true)) {
+        owner->report(index, false, std::chrono::steady_clock::now() - started);
+    }
+}
+
+cppai::balancer::balancer(endpoint_config config) : cfg{ std::move(config) } {
+    if (cfg.backends.empty()) {
+        throw std::invalid_argument("endpoint_config has no backends");
+    }
+    states.reserve(cfg.backends.size());
+    for (const backend& target : cfg.backends) {
+        backend_state& state = states.emplace_back();
+        state.target = target;
+        state.target.weight = std::max<std::uint32_t>(target.weight, 1);
+        state.authority = target.port == "443" ? target.host : target.host + ':' + target.port;
+        backends_identity.append(target.host).append(":").append(target.port).append("\n");
+    }
+}
+
+const cppai::endpoint_config& cppai::balancer::config() const {
+    return cfg;
+}
+
+const std::string& cppai::balancer::identity() const {
+    return backends_identity;
+}
+
+cppai::backend_lease cppai::balancer::pick() {
+    std::lock_guard lock{ mtx };
+    const auto now = std::chrono::steady_clock::now();
+
+    // Backends without a sample yet are scored as if they were as fast as the fastest known one.
+    double baseline_us = std::numeric_limits<double>::max();
+    for (const backend_state& state : states) {
+        if (state.sampled) {
+            baseline_us = std::min(baseline_us, state.latency_us);
+        }
+    }
+    if (baseline_us == std::numeric_limits<double>::max()) {
+        baseline_us = 0.0;
+    }
+
+    // Scanning from a rotating start spreads ties instead of always favouring the first backend.
+    std::size_t best = states.size();
+    double best_score = 0.0;
+    for (std::size_t i = 0; i < states.size(); ++i) {
+        const std::size_t index = (next + i) % states.size();
+        if (states[index].ejected_until > now) {
+            continue;
+        }
+        const double current = score(states[index], baseline_us);
+        if (best == states.size() || current < best_score) {
+            best = index;
+            best_score = current;
+        }
+    }
+    if (best == states.size()) {
+        best = static_cast<std::size_t>(std::min_element(states.begin(), states.end(), [](const backend_state& a, const backend_state& b) {
+            return a.ejected_until < b.ejected_until;
+        }) - states.begin());
+    }
+    next = (next + 1) % states.size();
+    ++states[best].outstanding;
+    return backend_lease{ shared_from_this(), best };
+}
+
+std::vector<cppai::backend_stats> cppai::balancer::stats() const {
+    std::lock_guard lock{ mtx };
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<backend_stats> result;
+    result.reserve(states.size());
+    for (const backend_state& state : states) {
+        result.push_back(backend_stats{ state.target.host, state.target.port, state.outstanding,
+            std::chrono::microseconds{ static_cast<std::int64_t>(state.latency_us) }, state.ejected_until > now, state.ejections });
+    }
+    return result;
+}
+
+void cppai::balancer::report(std::size_t index, bool success, std::chrono::steady_clock::duration elapsed) {
+    std::lock_guard lock{ mtx };
+    const auto now = std::chrono::steady_clock::now();
+    backend_state& state = states[index];
+
+    const double sample_us = std::chrono::duration<double, std::micro>(elapsed).count();
+    if (!state.sampled) {
+        state.latency_us = sample_us;
+        state.sampled = true;
+    }
+    else {
+        const double age = std::chrono::duration<double>(now - state.sampled_at).count();
+        const double decay = std::chrono::duration<double>(cfg.ewma_decay).count();
+        const double kept = decay > 0.0 ? std::exp(-age / decay) : 0.0;
+        state.latency_us = state.latency_us * kept + sample_us * (1.0 - kept);
+    }
+    state.sampled_at = now;
+
+    const outlier_policy& outliers = cfg.outliers;
+    if (success) {
+        state.failures = 0;
+        // A backend that has stayed in rotation for a full max_ejection starts over at the base ejection time.
+        if (state.ejections != 0 && now - state.ejected_until >= outliers.max_ejection) {
+            state.ejections = 0;
+        }
+        return;
+    }
+    if (++state.failures < std::max<std::uint32_t>(outliers.consecutive_failures, 1) || state.ejected_until > now) {
+        return;
+    }
+    const auto ejected = std::count_if(states.begin(), states.end(), [now](const backend_state& other) {
+        return other.ejected_until > now;
+    });
+    if (static_cast<double>(ejected + 1) > outliers.max_ejected_fraction * static_cast<double>(states.size())) {
+        return;
+    }
+    ++state.ejections;
+    state.failures = 0;
+    state.ejected_until = now + std::min(outliers.base_ejection * state.ejections, outliers.max_ejection);
+}
+
+void cppai::balancer::release(std::size_t index) {
+    std::lock_guard lock{ mtx };
+    --states[index].outstanding;
+}
+
+double cppai::balancer::score(const backend_state& state, double baseline_us) const {
+    const double load = static_cast<double>(state.outstanding + 1) / static_cast<double>(state.target.weight);
+    if (cfg.strategy == balance_strategy::least_outstanding) {
+        return load;
+    }
+    return (state.sampled ? state.latency_us : baseline_us) * load + load;
+}
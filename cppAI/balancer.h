@@ -0,0 +1,138 @@
+#ifndef CPPAI_BALANCER_H
+#define CPPAI_BALANCER_H
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cppai {
+    struct backend {
+        std::string host;
+        std::string port = "443";
+        std::uint32_t weight = 1;
+        // The backend accepts Content-Encoding: gzip request bodies. The public API does not, so this is only
+        // for proxies and gateways known to inflate them.
+        bool gzip_requests = false;
+    };
+
+    enum class balance_strategy {
+        // Fewest requests in flight, relative to weight.
+        least_outstanding,
+        // Lowest decayed latency times requests in flight, relative to weight, so a slow gateway sheds
+        // traffic before it starts failing.
+        ewma_latency
+    };
+
+    // A backend that fails consecutive_failures calls in a row (transport errors and 5xx replies) is left
+    // out of rotation for base_ejection times the number of times it has been ejected, up to max_ejection.
+    struct outlier_policy {
+        std::uint32_t consecutive_failures = 5;
+        std::chrono::steady_clock::duration base_ejection = std::chrono::seconds(30);
+        std::chrono::steady_clock::duration max_ejection = std::chrono::minutes(5);
+        // Never eject more than this share of the backends; a single backend is never ejected.
+        double max_ejected_fraction = 0.5;
+    };
+
+    struct endpoint_config {
+        std::vector<backend> backends = { backend{ "api.openai.com" } };
+        balance_strategy strategy = balance_strategy::least_outstanding;
+        // Time constant of the latency average; older samples weigh e^(-age/ewma_decay).
+        std::chrono::steady_clock::duration ewma_decay = std::chrono::seconds(10);
+        outlier_policy outliers;
+        bool verify_peer = true;
+        // Extra PEM trust anchors, e.g. the self-signed certificate of a local stand-in server.
+        std::string ca_file;
+    };
+
+    struct backend_stats {
+        std::string host;
+        std::string port;
+        std::size_t outstanding = 0;
+        std::chrono::microseconds latency{ 0 };
+        bool ejected = false;
+        std::uint32_t ejections = 0;
+    };
+
+    class balancer;
+
+    // Counts one call against a backend from pick() until destruction. The outcome reported through
+    // succeeded() or failed() feeds the latency average and outlier detection; a lease destroyed without
+    // one, as when a hedged copy is cancelled, only gives back its slot. The lease keeps its balancer alive,
+    // so a call outlasts a set_endpoints that replaced it.
+    class backend_lease {
+    public:
+        backend_lease(std::shared_ptr<balancer> owner, std::size_t index);
+
+        backend_lease(backend_lease&& other) noexcept;
+
+        backend_lease& operator=(backend_lease&&) = delete;
+
+        ~backend_lease();
+
+        const backend& target() const;
+
+        // The Host header value: the host name, with the port unless it is 443.
+        const std::string& authority() const;
+
+        void succeeded();
+
+        void failed();
+
+    private:
+        std::shared_ptr<balancer> owner;
+        std::size_t index;
+        std::chrono::steady_clock::time_point started;
+        bool reported = false;
+    };
+
+    // Always owned by a shared_ptr, which every lease it hands out shares.
+    class balancer : public std::enable_shared_from_this<balancer> {
+    public:
+        explicit balancer(endpoint_config config);
+
+        balancer(const balancer&) = delete;
+
+        balancer& operator=(const balancer&) = delete;
+
+        const endpoint_config& config() const;
+
+        // The backends as host:port lines, part of every response cache key along with the credentials.
+        const std::string& identity() const;
+
+        // When every backend is ejected, the one due back soonest is used anyway.
+        backend_lease pick();
+
+        std::vector<backend_stats> stats() const;
+
+    private:
+        friend class backend_lease;
+
+        struct backend_state {
+            backend target;
+            std::string authority;
+            std::size_t outstanding = 0;
+            double latency_us = 0.0;
+            std::chrono::steady_clock::time_point sampled_at;
+            bool sampled = false;
+            std::uint32_t failures = 0;
+            std::uint32_t ejections = 0;
+            std::chrono::steady_clock::time_point ejected_until;
+        };
+
+        mutable std::mutex mtx;
+        endpoint_config cfg;
+        std::string backends_identity;
+        std::vector<backend_state> states;
+        std::size_t next = 0;
+
+        void report(std::size_t index, bool success, std::chrono::steady_clock::duration elapsed);
+
+        void release(std::size_t index);
+
+        double score(const backend_state& state, double baseline_us) const;
+    };
+}
+
+#endif
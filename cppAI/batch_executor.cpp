@@ -0,0 +1,360 @@
+#include "batch_executor.h"
+#include <algorithm>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+
+double cppai::batch_metrics::throughput() const {
+    const double seconds = std::chrono::duration<double>(elapsed).count();
+    return seconds > 0.0 ? static_cast<double>(completed) / seconds : 0.0;
+}
+
+cppai::batch_executor::batch_executor(const openAI& client, batch_options opts) : client{ client }, opts{ std::move(opts) } {
+}
+
+boost::asio::awaitable<void> cppai::batch_executor::run(item_source next, result_handler on_result) {
+    {
+        std::lock_guard lock{ mtx };
+        stats = {};
+        started = refilled = paused_until = std::chrono::steady_clock::now();
+        running = true;
+        request_budget = static_cast<double>(opts.requests_per_minute);
+        token_budget = static_cast<double>(opts.tokens_per_minute);
+    }
+
+    std::mutex source_mtx;
+    const item_source guarded = [&]() {
+        std::lock_guard lock{ source_mtx };
+        return next();
+    };
+
+    auto executor = co_await boost::asio::this_coro::executor;
+    const std::size_t workers = std::max<std::size_t>(opts.concurrency, 1);
+    boost::asio::experimental::concurrent_channel<void(boost::system::error_code, std::exception_ptr)> done{ executor, workers };
+    // Cancelling the run cancels the workers, which are waited for all the same: they use this frame.
+    std::vector<boost::asio::cancellation_signal> stops(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        boost::asio::co_spawn(executor, worker(guarded, on_result),
+            boost::asio::bind_cancellation_slot(stops[i].slot(), [&done](std::exception_ptr error) {
+                done.try_send(boost::system::error_code{}, error);
+            }));
+    }
+
+    std::exception_ptr first_error;
+    for (std::size_t finished = 0; finished < workers;) {
+        bool cancelled = false;
+        try {
+            std::exception_ptr error = co_await done.async_receive(boost::asio::use_awaitable);
+            if (error && !first_error) {
+                first_error = error;
+            }
+            ++finished;
+        }
+        catch (const boost::system::system_error&) {
+            // A job's failure, if that is what stopped the run, says more than the cancellation it caused.
+            if (!first_error) {
+                first_error = std::current_exception();
+            }
+            cancelled = true;
+        }
+        if (cancelled) {
+            co_await boost::asio::this_coro::reset_cancellation_state([](boost::asio::cancellation_type) {
+                return boost::asio::cancellation_type::none;
+            });
+            for (boost::asio::cancellation_signal& stop : stops) {
+                stop.emit(boost::asio::cancellation_type::terminal);
+            }
+        }
+    }
+
+    {
+        std::lock_guard lock{ mtx };
+        stats.elapsed = std::chrono::steady_clock::now() - started;
+        running = false;
+    }
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
+
+boost::asio::awaitable<void> cppai::batch_executor::run(std::vector<batch_item> items, result_handler on_result) {
+    std::size_t index = 0;
+    co_await run([&]() -> std::optional<batch_item> {
+        if (index == items.size()) {
+            return std::nullopt;
+        }
+        return std::move(items[index++]);
+    }, std::move(on_result));
+}
+
+boost::asio::awaitable<void> cppai::batch_executor::run(std::istream& jsonl, result_handler on_result) {
+    std::uint64_t line_no = 0;
+    co_await run([&]() -> std::optional<batch_item> {
+        std::string line;
+        while (std::getline(jsonl, line)) {
+            ++line_no;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+
+            boost::json::value parsed = boost::json::parse(line);
+            batch_item item;
+            boost::json::object* wrapper = parsed.if_object();
+            if (wrapper != nullptr && wrapper->contains("body")) {
+                for (std::string_view id_key : { "request_id", "custom_id", "id" }) {
+                    const boost::json::value* id = wrapper->if_contains(id_key);
+                    if (id != nullptr && id->is_string()) {
+                        item.id.assign(id->as_string().data(), id->as_string().size());
+                        break;
+                    }
+                }
+                item.body = std::move((*wrapper)["body"]);
+            }
+            else {
+                item.body = std::move(parsed);
+            }
+            if (item.id.empty()) {
+                item.id = std::to_string(line_no);
+            }
+            return item;
+        }
+        return std::nullopt;
+    }, std::move(on_result));
+}
+
+cppai::batch_metrics cppai::batch_executor::metrics() const {
+    std::lock_guard lock{ mtx };
+    batch_metrics snapshot = stats;
+    if (running) {
+        snapshot.elapsed = std::chrono::steady_clock::now() - started;
+    }
+    return snapshot;
+}
+
+cppai::batch_executor::result_handler cppai::batch_executor::jsonl_writer(std::ostream& out) {
+    auto out_mtx = std::make_shared<std::mutex>();
+    return [&out, out_mtx](std::string_view id, const boost::json::value& result, std::exception_ptr error) {
+        boost::json::object line;
+        line["id"] = id;
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception& e) {
+                line["error"] = e.what();
+            }
+            catch (...) {
+                line["error"] = "unknown error";
+            }
+        }
+        else {
+            line["response"] = result;
+        }
+        std::lock_guard lock{ *out_mtx };
+        out << boost::json::serialize(line) << '\n';
+    };
+}
+
+boost::asio::awaitable<void> cppai::batch_executor::worker(const item_source& next, const result_handler& on_result) {
+    // Every attempt goes through throttle() and observe(), so the client must not retry behind their back.
+    static const retry_policy single_attempt = [] {
+        retry_policy retries;
+        retries.max_attempts = 1;
+        return retries;
+    }();
+    auto executor = co_await boost::asio::this_coro::executor;
+    for (;;) {
+        std::optional<batch_item> item = next();
+        if (!item.has_value()) {
+            co_return;
+        }
+
+        const std::uint64_t tokens = estimate_tokens(item->body);
+        for (std::uint16_t attempt = 1;; ++attempt) {
+            co_await throttle(tokens);
+            {
+                std::lock_guard lock{ mtx };
+                stats.peak_in_flight = std::max(stats.peak_in_flight, ++stats.in_flight);
+            }
+
+            ::cppai::utility::response_meta meta;
+            boost::json::value result;
+            std::exception_ptr error;
+            try {
+                result = co_await client.post(opts.target, item->body, single_attempt, &meta);
+            }
+            catch (const boost::system::system_error& e) {
+                // The run was cancelled: the item is neither retried nor reported.
+                if (e.code() == boost::asio::error::operation_aborted) {
+                    std::lock_guard lock{ mtx };
+                    --stats.in_flight;
+                    throw;
+                }
+                error = std::current_exception();
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            {
+                std::lock_guard lock{ mtx };
+                --stats.in_flight;
+            }
+            observe(meta);
+
+            const bool retryable = error != nullptr || meta.status == 429 || meta.status >= 500;
+            if (retryable && attempt < opts.max_attempts) {
+                {
+                    std::lock_guard lock{ mtx };
+                    ++stats.retried;
+                }
+                // A retry-after header already paused every worker in observe().
+                if (!meta.retry_after.has_value()) {
+                    boost::asio::steady_timer timer{ executor, backoff(attempt) };
+                    co_await timer.async_wait(boost::asio::use_awaitable);
+                }
+                continue;
+            }
+
+            {
+                std::lock_guard lock{ mtx };
+                if (error || meta.status >= 400) {
+                    ++stats.failed;
+                }
+                else {
+                    ++stats.completed;
+                }
+            }
+            on_result(item->id, result, error);
+            break;
+        }
+    }
+}
+
+boost::asio::awaitable<void> cppai::batch_executor::throttle(std::uint64_t tokens) {
+    boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor };
+    for (;;) {
+        std::chrono::steady_clock::duration wait{};
+        {
+            std::lock_guard lock{ mtx };
+            const auto now = std::chrono::steady_clock::now();
+            refill(now);
+            if (now < paused_until) {
+                wait = paused_until - now;
+            }
+            else {
+                const double rpm = static_cast<double>(opts.requests_per_minute);
+                const double tpm = static_cast<double>(opts.tokens_per_minute);
+                const double needed = std::min(static_cast<double>(tokens), tpm);
+                const bool requests_ok = opts.requests_per_minute == 0 || request_budget >= 1.0;
+                const bool tokens_ok = opts.tokens_per_minute == 0 || token_budget >= needed;
+                if (requests_ok && tokens_ok) {
+                    if (opts.requests_per_minute != 0) {
+                        request_budget -= 1.0;
+                    }
+                    if (opts.tokens_per_minute != 0) {
+                        token_budget -= needed;
+                    }
+                    co_return;
+                }
+
+                double seconds = 0.0;
+                if (!requests_ok) {
+                    seconds = std::max(seconds, (1.0 - request_budget) * 60.0 / rpm);
+                }
+                if (!tokens_ok) {
+                    seconds = std::max(seconds, (needed - token_budget) * 60.0 / tpm);
+                }
+                wait = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+            }
+        }
+
+        const auto before = std::chrono::steady_clock::now();
+        timer.expires_after(wait);
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        std::lock_guard lock{ mtx };
+        stats.throttled += std::chrono::steady_clock::now() - before;
+    }
+}
+
+void cppai::batch_executor::refill(std::chrono::steady_clock::time_point now) {
+    const double minutes = std::chrono::duration<double>(now - refilled).count() / 60.0;
+    refilled = now;
+    request_budget = std::min(static_cast<double>(opts.requests_per_minute),
+        request_budget + minutes * static_cast<double>(opts.requests_per_minute));
+    token_budget = std::min(static_cast<double>(opts.tokens_per_minute),
+        token_budget + minutes * static_cast<double>(opts.tokens_per_minute));
+}
+
+void cppai::batch_executor::observe(const ::cppai::utility::response_meta& meta) {
+    std::lock_guard lock{ mtx };
+    const auto now = std::chrono::steady_clock::now();
+    if (meta.retry_after.has_value()) {
+        paused_until = std::max(paused_until, now + meta.retry_after.value());
+    }
+    if (meta.remaining_requests.has_value()) {
+        request_budget = std::min(request_budget, static_cast<double>(meta.remaining_requests.value()));
+        if (meta.remaining_requests.value() == 0 && meta.reset_requests.has_value()) {
+            paused_until = std::max(paused_until, now + meta.reset_requests.value());
+        }
+    }
+    if (meta.remaining_tokens.has_value()) {
+        token_budget = std::min(token_budget, static_cast<double>(meta.remaining_tokens.value()));
+        if (meta.remaining_tokens.value() == 0 && meta.reset_tokens.has_value()) {
+            paused_until = std::max(paused_until, now + meta.reset_tokens.value());
+        }
+    }
+}
+
+std::chrono::milliseconds cppai::batch_executor::backoff(std::uint16_t attempt) const {
+    return jittered_backoff(attempt, opts.base_backoff, opts.max_backoff);
+}
+
+std::uint64_t cppai::batch_executor::estimate_tokens(const boost::json::value& body) const {
+    // The prompt, counted or at roughly four characters per token for English text, plus whatever completion
+    // budget the request reserves.
+    std::uint64_t chars = 0;
+    std::uint64_t counted = 0;
+    std::vector<const boost::json::value*> pending{ &body };
+    if (const boost::json::object* object = body.if_object(); opts.tokenizer != nullptr && object != nullptr) {
+        if (const boost::json::value* messages = object->if_contains("messages"); messages != nullptr && messages->is_array()) {
+            counted = count_chat_tokens(*opts.tokenizer, messages->get_array());
+            pending.clear();
+        }
+    }
+    while (!pending.empty()) {
+        const boost::json::value* current = pending.back();
+        pending.pop_back();
+        if (current->is_string()) {
+            if (opts.tokenizer != nullptr) {
+                counted += opts.tokenizer->count(current->get_string());
+            }
+            else {
+                chars += current->get_string().size();
+            }
+        }
+        else if (current->is_array()) {
+            for (const boost::json::value& element : current->get_array()) {
+                pending.push_back(&element);
+            }
+        }
+        else if (current->is_object()) {
+            for (const auto& member : current->get_object()) {
+                pending.push_back(&member.value());
+            }
+        }
+    }
+
+    std::uint64_t reserved = 0;
+    if (const boost::json::object* object = body.if_object()) {
+        if (const boost::json::value* max_tokens = object->if_contains("max_tokens"); max_tokens != nullptr && max_tokens->is_number()) {
+            // A negative or fractional max_tokens reserves nothing here; the API rejects that request on its own.
+            boost::json::error_code error_code;
+            const std::uint64_t requested = max_tokens->to_number<std::uint64_t>(error_code);
+            if (!error_code) {
+                reserved = requested;
+            }
+        }
+    }
+    if (opts.tokenizer != nullptr) {
+        return counted + reserved;
+    }
+    return chars / 4 + 1 + reserved;
+}
@@ -0,0 +1,93 @@
+#ifndef CPPAI_BATCH_EXECUTOR_H
+#define CPPAI_BATCH_EXECUTOR_H
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "openai.h"
+#include "tokenizer.h"
+
+namespace cppai {
+    struct batch_options {
+        std::string target = "/v1/chat/completions";
+        std::size_t concurrency = 16;
+        std::uint64_t requests_per_minute = 0;
+        std::uint64_t tokens_per_minute = 0;
+        // Counts prompt tokens against tokens_per_minute exactly; without one, four characters make a token.
+        std::shared_ptr<const bpe_tokenizer> tokenizer;
+        std::uint16_t max_attempts = 5;
+        std::chrono::milliseconds base_backoff{ 500 };
+        std::chrono::milliseconds max_backoff{ 30000 };
+    };
+
+    struct batch_item {
+        std::string id;
+        boost::json::value body;
+    };
+
+    struct batch_metrics {
+        std::uint64_t completed = 0;
+        std::uint64_t failed = 0;
+        std::uint64_t retried = 0;
+        std::size_t in_flight = 0;
+        std::size_t peak_in_flight = 0;
+        std::chrono::steady_clock::duration throttled{};
+        std::chrono::steady_clock::duration elapsed{};
+
+        double throughput() const;
+    };
+
+    class batch_executor {
+    public:
+        using item_source = std::function<std::optional<batch_item>()>;
+        using result_handler = std::function<void(std::string_view id, const boost::json::value& result, std::exception_ptr error)>;
+
+        explicit batch_executor(const openAI& client, batch_options opts = {});
+
+        boost::asio::awaitable<void> run(item_source next, result_handler on_result);
+
+        boost::asio::awaitable<void> run(std::vector<batch_item> items, result_handler on_result);
+
+        boost::asio::awaitable<void> run(std::istream& jsonl, result_handler on_result);
+
+        batch_metrics metrics() const;
+
+        static result_handler jsonl_writer(std::ostream& out);
+
+    private:
+        const openAI& client;
+        batch_options opts;
+
+        mutable std::mutex mtx;
+        batch_metrics stats;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point refilled;
+        std::chrono::steady_clock::time_point paused_until;
+        bool running = false;
+        double request_budget = 0.0;
+        double token_budget = 0.0;
+
+        boost::asio::awaitable<void> worker(const item_source& next, const result_handler& on_result);
+
+        boost::asio::awaitable<void> throttle(std::uint64_t tokens);
+
+        void refill(std::chrono::steady_clock::time_point now);
+
+        void observe(const ::cppai::utility::response_meta& meta);
+
+        std::chrono::milliseconds backoff(std::uint16_t attempt) const;
+
+        std::uint64_t estimate_tokens(const boost::json::value& body) const;
+    };
+}
+
+#endif
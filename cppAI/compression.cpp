@@ -0,0 +1,254 @@
+#include "compression.h"
+#include <boost/beast/zlib.hpp>
+#include <boost/crc.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    // ID1 ID2, CM = deflate, no flags, no mtime, no extra flags, OS unknown.
+    constexpr std::array<unsigned char, 10> gzip_header = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+
+    constexpr unsigned char flag_hcrc = 0x02;
+    constexpr unsigned char flag_extra = 0x04;
+    constexpr unsigned char flag_name = 0x08;
+    constexpr unsigned char flag_comment = 0x10;
+
+    [[noreturn]] void malformed() {
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::protocol_error), "Malformed gzip stream");
+    }
+
+    void write_u32le(unsigned char* out, std::uint32_t value) {
+        for (int i = 0; i < 4; ++i) {
+            out[i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    }
+
+    std::uint32_t read_u32le(const unsigned char* in) {
+        return static_cast<std::uint32_t>(in[0]) | static_cast<std::uint32_t>(in[1]) << 8 | static_cast<std::uint32_t>(in[2]) << 16
+            | static_cast<std::uint32_t>(in[3]) << 24;
+    }
+
+    // Length of the member header at the front of bytes, or zero while it is still incomplete.
+    std::size_t header_length(const std::string& bytes) {
+        if (bytes.size() < gzip_header.size()) {
+            return 0;
+        }
+        const auto* in = reinterpret_cast<const unsigned char*>(bytes.data());
+        if (in[0] != 0x1f || in[1] != 0x8b || in[2] != 8) {
+            malformed();
+        }
+        const unsigned char flags = in[3];
+        std::size_t length = gzip_header.size();
+        if (flags & flag_extra) {
+            if (bytes.size() < length + 2) {
+                return 0;
+            }
+            length += 2 + (static_cast<std::size_t>(in[length]) | static_cast<std::size_t>(in[length + 1]) << 8);
+        }
+        for (const unsigned char flag : { flag_name, flag_comment }) {
+            if (flags & flag) {
+                if (bytes.size() <= length) {
+                    return 0;
+                }
+                const std::size_t end = bytes.find('\0', length);
+                if (end == std::string::npos) {
+                    return 0;
+                }
+                length = end + 1;
+            }
+        }
+        if (flags & flag_hcrc) {
+            length += 2;
+        }
+        return bytes.size() >= length ? length : 0;
+    }
+
+    // deflate_stream allocates a few hundred kilobytes of window and hash tables; finished compressors are
+    // kept per thread and reset instead of being rebuilt for every body.
+    thread_local std::vector<std::unique_ptr<boost::beast::zlib::deflate_stream>> idle_deflaters;
+
+    constexpr std::size_t max_idle_deflaters = 4;
+}
+
+struct cppai::gzip_deflater::state {
+    std::unique_ptr<boost::beast::zlib::deflate_stream> deflater;
+    boost::crc_32_type crc;
+    std::uint32_t size = 0;
+    std::size_t header_written = 0;
+    std::array<unsigned char, 8> trailer{};
+    std::size_t trailer_written = 0;
+    bool deflated = false;
+};
+
+cppai::gzip_deflater::gzip_deflater(int level) : impl{ std::make_unique<state>() } {
+    if (!idle_deflaters.empty()) {
+        impl->deflater = std::move(idle_deflaters.back());
+        idle_deflaters.pop_back();
+    }
+    else {
+        impl->deflater = std::make_unique<boost::beast::zlib::deflate_stream>();
+    }
+    impl->deflater->reset(std::clamp(level, 0, 9), 15, 8, boost::beast::zlib::Strategy::normal);
+}
+
+cppai::gzip_deflater::~gzip_deflater() {
+    if (idle_deflaters.size() < max_idle_deflaters) {
+        idle_deflaters.push_back(std::move(impl->deflater));
+    }
+}
+
+std::size_t cppai::gzip_deflater::write(std::string_view& input, boost::asio::mutable_buffer out, bool finish) {
+    state& current = *impl;
+    auto* first = static_cast<unsigned char*>(out.data());
+    std::size_t produced = 0;
+    const auto drain = [&](const unsigned char* bytes, std::size_t size, std::size_t& written) {
+        const std::size_t count = std::min(size - written, out.size() - produced);
+        std::memcpy(first + produced, bytes + written, count);
+        written += count;
+        produced += count;
+    };
+
+    drain(gzip_header.data(), gzip_header.size(), current.header_written);
+    if (current.header_written < gzip_header.size()) {
+        return produced;
+    }
+    if (!current.deflated) {
+        boost::beast::zlib::z_params params;
+        params.next_in = input.data();
+        params.avail_in = input.size();
+        params.next_out = first + produced;
+        params.avail_out = out.size() - produced;
+        boost::system::error_code error_code;
+        current.deflater->write(params, finish ? boost::beast::zlib::Flush::finish : boost::beast::zlib::Flush::none, error_code);
+
+        const std::size_t consumed = input.size() - params.avail_in;
+        current.crc.process_bytes(input.data(), consumed);
+        current.size += static_cast<std::uint32_t>(consumed);
+        input.remove_prefix(consumed);
+        produced = out.size() - params.avail_out;
+
+        if (error_code == boost::beast::zlib::error::end_of_stream) {
+            current.deflated = true;
+            write_u32le(current.trailer.data(), current.crc.checksum());
+            write_u32le(current.trailer.data() + 4, current.size);
+        }
+        else if (error_code && error_code != boost::beast::zlib::error::need_buffers) {
+            throw boost::system::system_error(error_code);
+        }
+    }
+    if (current.deflated) {
+        drain(current.trailer.data(), current.trailer.size(), current.trailer_written);
+    }
+    return produced;
+}
+
+bool cppai::gzip_deflater::done() const {
+    return impl->deflated && impl->trailer_written == impl->trailer.size();
+}
+
+struct cppai::gzip_inflater::state {
+    enum class stage {
+        header,
+        body,
+        trailer
+    };
+
+    boost::beast::zlib::inflate_stream inflater;
+    boost::crc_32_type crc;
+    std::uint32_t size = 0;
+    stage at = stage::header;
+    // Header and trailer bytes gathered across pieces.
+    std::string framing;
+    // The last bytes handed to the inflater, which may hold the start of the trailer; see below.
+    std::string recent;
+};
+
+cppai::gzip_inflater::gzip_inflater() : impl{ std::make_unique<state>() } {
+    impl->inflater.reset(15);
+}
+
+cppai::gzip_inflater::~gzip_inflater() = default;
+
+void cppai::gzip_inflater::write(std::string_view chunk, boost::beast::flat_buffer& out) {
+    state& current = *impl;
+    while (!chunk.empty() || (current.at == state::stage::trailer && current.framing.size() == 8)) {
+        if (current.at == state::stage::header) {
+            // A stream may hold several members back to back; each starts over with its own header.
+            const std::size_t before = current.framing.size();
+            current.framing.append(chunk.data(), std::min<std::size_t>(chunk.size(), 512));
+            const std::size_t length = header_length(current.framing);
+            if (length == 0) {
+                if (current.framing.size() >= 64 * 1024) {
+                    malformed();
+                }
+                chunk.remove_prefix(current.framing.size() - before);
+                continue;
+            }
+            chunk.remove_prefix(length - before);
+            current.framing.clear();
+            current.crc.reset();
+            current.size = 0;
+            current.inflater.reset(15);
+            current.recent.clear();
+            current.at = state::stage::body;
+            continue;
+        }
+
+        if (current.at == state::stage::body) {
+            const auto room = out.prepare(std::max<std::size_t>(chunk.size() * 4, 16384));
+            boost::beast::zlib::z_params params;
+            params.next_in = chunk.data();
+            params.avail_in = chunk.size();
+            params.next_out = room.data();
+            params.avail_out = room.size();
+            boost::system::error_code error_code;
+            current.inflater.write(params, boost::beast::zlib::Flush::none, error_code);
+
+            const std::size_t produced = room.size() - params.avail_out;
+            current.crc.process_bytes(room.data(), produced);
+            current.size += static_cast<std::uint32_t>(produced);
+            out.commit(produced);
+            const std::size_t consumed = chunk.size() - params.avail_in;
+            current.recent.append(chunk.data() + (consumed - std::min<std::size_t>(consumed, 8)), std::min<std::size_t>(consumed, 8));
+            if (current.recent.size() > 8) {
+                current.recent.erase(0, current.recent.size() - 8);
+            }
+            chunk.remove_prefix(consumed);
+
+            if (error_code == boost::beast::zlib::error::end_of_stream) {
+                // The inflater may have pulled whole bytes past the final block into its bit buffer and keeps
+                // them there. data_type reports how many bits it still holds; those bytes open the trailer.
+                const std::size_t unread = std::min<std::size_t>(static_cast<std::size_t>(params.data_type & 63) / 8, current.recent.size());
+                current.framing.assign(current.recent, current.recent.size() - unread, unread);
+                current.recent.clear();
+                current.at = state::stage::trailer;
+            }
+            else if (error_code && error_code != boost::beast::zlib::error::need_buffers) {
+                throw boost::system::system_error(error_code);
+            }
+            continue;
+        }
+
+        const std::size_t take = std::min<std::size_t>(chunk.size(), 8 - current.framing.size());
+        current.framing.append(chunk.data(), take);
+        chunk.remove_prefix(take);
+        if (current.framing.size() == 8) {
+            const auto* in = reinterpret_cast<const unsigned char*>(current.framing.data());
+            if (read_u32le(in) != current.crc.checksum() || read_u32le(in + 4) != current.size) {
+                malformed();
+            }
+            current.framing.clear();
+            current.at = state::stage::header;
+        }
+    }
+}
+
+void cppai::gzip_inflater::finish() const {
+    // An empty body is let through; some servers label those gzip too.
+    if (impl->at != state::stage::header || !impl->framing.empty()) {
+        malformed();
+    }
+}
@@ -0,0 +1,188 @@
+#ifndef CPPAI_COMPRESSION_H
+#define CPPAI_COMPRESSION_H
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/optional.hpp>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+namespace cppai {
+    // gzip (RFC 1952) compression of raw bytes into a caller's buffer, one piece at a time.
+    class gzip_deflater {
+    public:
+        explicit gzip_deflater(int level);
+
+        ~gzip_deflater();
+
+        gzip_deflater(const gzip_deflater&) = delete;
+
+        gzip_deflater& operator=(const gzip_deflater&) = delete;
+
+        // Compresses from the front of input into out and returns the bytes written; input is advanced past
+        // what was consumed. Pass finish once input holds the last of the data, and keep calling until done().
+        std::size_t write(std::string_view& input, boost::asio::mutable_buffer out, bool finish);
+
+        bool done() const;
+
+    private:
+        struct state;
+
+        std::unique_ptr<state> impl;
+    };
+
+    // Decompresses a gzip stream fed in arbitrary pieces, e.g. as a response body arrives off the socket.
+    // Malformed input throws a system_error.
+    class gzip_inflater {
+    public:
+        gzip_inflater();
+
+        ~gzip_inflater();
+
+        gzip_inflater(const gzip_inflater&) = delete;
+
+        gzip_inflater& operator=(const gzip_inflater&) = delete;
+
+        void write(std::string_view chunk, boost::beast::flat_buffer& out);
+
+        // Throws when the stream stopped short of a member's trailer.
+        void finish() const;
+
+    private:
+        struct state;
+
+        std::unique_ptr<state> impl;
+    };
+
+    // Sends Inner's body gzip-compressed as it is serialized, so the compressed copy never exists in full.
+    // The size is not known up front, so the message has to be chunked (HTTP/2 just sends DATA frames).
+    template <class Inner>
+    struct gzip_body {
+        struct value_type {
+            const typename Inner::value_type* inner = nullptr;
+            int level = 6;
+        };
+
+        class writer {
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, class Fields>
+            writer(const boost::beast::http::header<isRequest, Fields>& header, const value_type& body)
+                : source{ header, *body.inner }, deflater{ body.level } {}
+
+            void init(boost::beast::error_code& error_code) {
+                source.init(error_code);
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& error_code) {
+                std::size_t produced = 0;
+                while (produced < out.size() && !deflater.done()) {
+                    if (!pending && !source_done) {
+                        auto chunk = source.get(error_code);
+                        if (error_code) {
+                            return boost::none;
+                        }
+                        if (chunk) {
+                            pending.emplace(chunk->first);
+                            source_done = !chunk->second;
+                        }
+                        else {
+                            source_done = true;
+                        }
+                    }
+                    std::string_view input;
+                    if (pending) {
+                        for (const boost::asio::const_buffer buffer : boost::beast::buffers_range_ref(*pending)) {
+                            if (buffer.size() != 0) {
+                                input = std::string_view{ static_cast<const char*>(buffer.data()), buffer.size() };
+                                break;
+                            }
+                        }
+                    }
+                    const std::size_t offered = input.size();
+                    // Only the last buffer of the last chunk may finish the stream.
+                    const bool last = source_done && (!pending || offered == boost::beast::buffer_bytes(*pending));
+                    produced += deflater.write(input, boost::asio::mutable_buffer{ out.data() + produced, out.size() - produced }, last);
+                    if (pending) {
+                        pending->consume(offered - input.size());
+                        if (boost::beast::buffer_bytes(*pending) == 0) {
+                            pending.reset();
+                        }
+                    }
+                }
+                if (produced == 0) {
+                    return boost::none;
+                }
+                return std::pair<const_buffers_type, bool>{ const_buffers_type{ out.data(), produced }, !deflater.done() };
+            }
+
+        private:
+            typename Inner::writer source;
+            boost::optional<boost::beast::buffers_suffix<typename Inner::writer::const_buffers_type>> pending;
+            bool source_done = false;
+            gzip_deflater deflater;
+            std::array<char, 16384> out;
+        };
+    };
+
+    // Collects a response body into a flat_buffer, inflating it on the way in when the response carries
+    // Content-Encoding: gzip. A parser switches to it after reading the header.
+    struct gzip_flat_body {
+        struct value_type {
+            boost::beast::flat_buffer buffer;
+        };
+
+        class reader {
+        public:
+            template <bool isRequest, class Fields>
+            reader(boost::beast::http::header<isRequest, Fields>&, value_type& body) : body{ body } {}
+
+            void init(const boost::optional<std::uint64_t>&, boost::beast::error_code& error_code) {
+                error_code = {};
+            }
+
+            template <class ConstBufferSequence>
+            std::size_t put(const ConstBufferSequence& buffers, boost::beast::error_code& error_code) {
+                std::size_t consumed = 0;
+                try {
+                    for (const boost::asio::const_buffer buffer : boost::beast::buffers_range_ref(buffers)) {
+                        inflater.write(std::string_view{ static_cast<const char*>(buffer.data()), buffer.size() }, body.buffer);
+                        consumed += buffer.size();
+                    }
+                }
+                catch (const boost::system::system_error& e) {
+                    error_code = e.code();
+                    return consumed;
+                }
+                error_code = {};
+                return consumed;
+            }
+
+            void finish(boost::beast::error_code& error_code) {
+                try {
+                    inflater.finish();
+                    error_code = {};
+                }
+                catch (const boost::system::system_error& e) {
+                    error_code = e.code();
+                }
+            }
+
+        private:
+            value_type& body;
+            gzip_inflater inflater;
+        };
+    };
+
+    // True when the header names gzip as the only content coding.
+    template <bool isRequest, class Fields>
+    bool gzip_encoded(const boost::beast::http::header<isRequest, Fields>& header) {
+        const auto coding = header[boost::beast::http::field::content_encoding];
+        return boost::beast::iequals(coding, "gzip") || boost::beast::iequals(coding, "x-gzip");
+    }
+}
+
+#endif
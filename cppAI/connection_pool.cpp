@@ -0,0 +1,290 @@
+#include "connection_pool.h"
+#include <algorithm>
+
+cppai::connection_pool::connection::connection(tcp_stream&& tcp, boost::asio::ssl::context& ctx, std::string pool_key,
+    boost::asio::execution_context& owner)
+    : stream{ std::move(tcp), ctx }, key{ std::move(pool_key) }, context{ &owner }, last_used{ std::chrono::steady_clock::now() } {
+}
+
+void cppai::connection_pool::returner::operator()(connection* conn) const {
+    pool->forget(conn);
+}
+
+cppai::connection_pool::connection_pool(pool_options opts) : opts{ opts } {
+}
+
+cppai::connection_pool::~connection_pool() {
+    for (auto& [key, state] : hosts) {
+        for (std::unique_ptr<connection>& conn : state.idle) {
+            close(*conn);
+        }
+        if (state.session != nullptr) {
+            SSL_SESSION_free(state.session);
+        }
+    }
+}
+
+boost::asio::awaitable<cppai::connection_pool::connection_ptr> cppai::connection_pool::acquire(boost::asio::ssl::context& ctx,
+    const std::string& host, const std::string& port, const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline,
+    request_trace* trace) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    boost::asio::execution_context& context = boost::asio::query(executor, boost::asio::execution::context);
+    std::string key = host + ':' + port;
+
+    for (;;) {
+        std::shared_ptr<waiter_channel> waiter;
+        {
+            std::lock_guard lock{ mtx };
+            host_state& state = hosts[key];
+            evict_expired(state, std::chrono::steady_clock::now());
+            // Sockets stay with the io_context that opened them, so a caller on another context never
+            // drives a reactor owned by a different thread.
+            for (;;) {
+                const auto found = std::find_if(state.idle.rbegin(), state.idle.rend(), [&](const std::unique_ptr<connection>& idle) {
+                    return idle->context == &context;
+                });
+                if (found == state.idle.rend()) {
+                    break;
+                }
+                std::unique_ptr<connection> conn = std::move(*found);
+                state.idle.erase(std::next(found).base());
+                if (is_healthy(*conn)) {
+                    co_return connection_ptr{ conn.release(), returner{ this } };
+                }
+                close(*conn);
+                --state.open;
+            }
+            if (!opts.enabled || state.open < opts.max_per_host) {
+                ++state.open;
+                break;
+            }
+            if (!state.idle.empty()) {
+                // Every free slot is held by an idle socket of another io_context: retire the oldest one.
+                close(*state.idle.front());
+                state.idle.pop_front();
+                break;
+            }
+            waiter = std::make_shared<waiter_channel>(executor, 1);
+            state.waiters.push_back(waiter);
+        }
+        try {
+            co_await with_deadline(waiter->async_receive(boost::asio::use_awaitable), deadline);
+        }
+        catch (...) {
+            // wake_one may have picked this waiter just before its deadline or cancellation won; the slot it
+            // was told about goes to the next waiter instead of being lost with this one.
+            std::lock_guard lock{ mtx };
+            host_state& state = hosts[key];
+            state.waiters.remove(waiter);
+            if (waiter->try_receive([](boost::system::error_code) {})) {
+                wake_one(state);
+            }
+            throw;
+        }
+    }
+
+    connection_ptr conn{ new connection{ boost::asio::use_awaitable.as_default_on(boost::beast::tcp_stream(executor)), ctx, std::move(key), context },
+        returner{ this } };
+    co_await connect(*conn, host, port, timeouts, deadline, trace);
+    co_return conn;
+}
+
+boost::asio::awaitable<std::unique_ptr<cppai::connection_pool::connection>> cppai::connection_pool::connect_dedicated(
+    boost::asio::ssl::context& ctx, const std::string& host, const std::string& port, std::string_view alpn,
+    const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline, request_trace* trace) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    boost::asio::execution_context& context = boost::asio::query(executor, boost::asio::execution::context);
+    std::string key = host + ':' + port + '/' + std::string{ alpn };
+
+    auto conn = std::make_unique<connection>(boost::asio::use_awaitable.as_default_on(boost::beast::tcp_stream(executor)), ctx,
+        std::move(key), context);
+    // ALPN is set per connection, so HTTP/1.1 sockets opened from the same ssl::context keep offering only http/1.1.
+    std::string protocols(1, static_cast<char>(alpn.size()));
+    protocols.append(alpn);
+    if (SSL_set_alpn_protos(conn->stream.native_handle(), reinterpret_cast<const unsigned char*>(protocols.data()),
+        static_cast<unsigned int>(protocols.size())) != 0) {
+        throw boost::system::system_error(static_cast<std::int32_t>(ERR_get_error()), boost::asio::ssl::error::get_stream_category());
+    }
+    co_await connect(*conn, host, port, timeouts, deadline, trace);
+
+    const unsigned char* selected = nullptr;
+    unsigned int selected_size = 0;
+    SSL_get0_alpn_selected(conn->stream.native_handle(), &selected, &selected_size);
+    if (std::string_view{ reinterpret_cast<const char*>(selected), selected_size } != alpn) {
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::protocol_not_supported),
+            "ALPN did not select " + std::string{ alpn });
+    }
+    {
+        std::lock_guard lock{ mtx };
+        remember_session(hosts[conn->key], *conn);
+    }
+    co_return conn;
+}
+
+void cppai::connection_pool::release(connection_ptr conn) {
+    if (!options().enabled) {
+        return;
+    }
+
+    std::lock_guard lock{ mtx };
+    host_state& state = hosts[conn->key];
+    remember_session(state, *conn);
+
+    const auto now = std::chrono::steady_clock::now();
+    conn->last_used = now;
+    ++conn->served;
+    state.idle.emplace_back(conn.release());
+    evict_expired(state, now);
+    wake_one(state);
+}
+
+void cppai::connection_pool::discard(connection_ptr conn) {
+    conn.reset();
+}
+
+boost::asio::awaitable<void> cppai::connection_pool::shutdown(connection_ptr conn) {
+    boost::beast::get_lowest_layer(conn->stream).expires_after(std::chrono::seconds(30));
+    auto [error_code] = co_await conn->stream.async_shutdown(boost::asio::as_tuple(boost::asio::use_awaitable));
+    discard(std::move(conn));
+
+    if (error_code == boost::asio::error::eof) {
+        error_code = decltype(error_code){};
+    }
+    else if (error_code == boost::asio::ssl::error::stream_truncated) {
+        error_code = decltype(error_code){};
+    }
+    if (error_code) {
+        throw boost::system::system_error(error_code, "Shutdown exit");
+    }
+}
+
+void cppai::connection_pool::set_options(pool_options new_opts) {
+    std::lock_guard lock{ mtx };
+    opts = new_opts;
+    for (auto& [key, state] : hosts) {
+        if (!opts.enabled) {
+            for (std::unique_ptr<connection>& conn : state.idle) {
+                close(*conn);
+                --state.open;
+            }
+            state.idle.clear();
+        }
+        wake_one(state);
+    }
+}
+
+cppai::pool_options cppai::connection_pool::options() const {
+    std::lock_guard lock{ mtx };
+    return opts;
+}
+
+void cppai::connection_pool::set_dns_cache(std::shared_ptr<dns_cache> cache) {
+    std::lock_guard lock{ mtx };
+    dns = std::move(cache);
+}
+
+std::size_t cppai::connection_pool::idle_count() const {
+    std::lock_guard lock{ mtx };
+    std::size_t count = 0;
+    for (const auto& [key, state] : hosts) {
+        count += state.idle.size();
+    }
+    return count;
+}
+
+boost::asio::awaitable<void> cppai::connection_pool::connect(connection& conn, const std::string& host, const std::string& port,
+    const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline, request_trace* trace) {
+    if (!SSL_set_tlsext_host_name(conn.stream.native_handle(), host.c_str())) {
+        throw::boost::system::system_error(static_cast<std::int32_t>(ERR_get_error()), boost::asio::ssl::error::get_stream_category());
+    }
+    conn.stream.set_verify_callback(boost::asio::ssl::rfc2818_verification(host));
+    std::shared_ptr<dns_cache> resolver;
+    {
+        std::lock_guard lock{ mtx };
+        host_state& state = hosts[conn.key];
+        if (state.session != nullptr) {
+            SSL_set_session(conn.stream.native_handle(), state.session);
+        }
+        resolver = dns;
+    }
+
+    std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+    {
+        const phase_timer timer{ trace, phase::resolve };
+        endpoints = co_await with_deadline(resolver->resolve(host, port), std::min(deadline, deadline_after(timeouts.resolve)));
+    }
+    {
+        const phase_timer timer{ trace, phase::connect };
+        co_await with_deadline(happy_eyeballs_connect(boost::beast::get_lowest_layer(conn.stream).socket(), endpoints, timeouts.connect_stagger),
+            std::min(deadline, deadline_after(timeouts.connect)));
+    }
+    {
+        const phase_timer timer{ trace, phase::handshake };
+        boost::beast::get_lowest_layer(conn.stream).expires_after(phase_budget(timeouts.handshake, deadline));
+        co_await conn.stream.async_handshake(boost::asio::ssl::stream_base::client);
+    }
+    boost::beast::get_lowest_layer(conn.stream).expires_never();
+}
+
+void cppai::connection_pool::remember_session(host_state& state, connection& conn) {
+    SSL_SESSION* session = SSL_get1_session(conn.stream.native_handle());
+    if (session != nullptr && SSL_SESSION_is_resumable(session)) {
+        if (state.session != nullptr) {
+            SSL_SESSION_free(state.session);
+        }
+        state.session = session;
+    }
+    else if (session != nullptr) {
+        SSL_SESSION_free(session);
+    }
+}
+
+void cppai::connection_pool::evict_expired(host_state& state, std::chrono::steady_clock::time_point now) {
+    while (!state.idle.empty() && now - state.idle.front()->last_used > opts.idle_timeout) {
+        close(*state.idle.front());
+        state.idle.pop_front();
+        --state.open;
+    }
+}
+
+void cppai::connection_pool::wake_one(host_state& state) {
+    while (!state.waiters.empty()) {
+        std::shared_ptr<waiter_channel> waiter = std::move(state.waiters.front());
+        state.waiters.pop_front();
+        if (waiter.use_count() > 1 && waiter->try_send(boost::system::error_code{})) {
+            return;
+        }
+    }
+}
+
+void cppai::connection_pool::forget(connection* conn) {
+    std::unique_ptr<connection> owned{ conn };
+    close(*owned);
+    std::lock_guard lock{ mtx };
+    host_state& state = hosts[owned->key];
+    --state.open;
+    wake_one(state);
+}
+
+bool cppai::connection_pool::is_healthy(connection& conn) {
+    auto& socket = boost::beast::get_lowest_layer(conn.stream).socket();
+    if (!socket.is_open() || conn.buffer.size() != 0) {
+        return false;
+    }
+
+    boost::system::error_code error_code;
+    if (socket.available(error_code) != 0 || error_code) {
+        return false;
+    }
+
+    char probe;
+    socket.non_blocking(true, error_code);
+    socket.receive(boost::asio::buffer(&probe, 1), boost::asio::socket_base::message_peek, error_code);
+    const bool healthy = error_code == boost::asio::error::would_block;
+    socket.non_blocking(false, error_code);
+    return healthy;
+}
+
+void cppai::connection_pool::close(connection& conn) {
+    boost::beast::get_lowest_layer(conn.stream).close();
+}
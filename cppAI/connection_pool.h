@@ -0,0 +1,119 @@
+#ifndef CPPAI_CONNECTION_POOL_H
+#define CPPAI_CONNECTION_POOL_H
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "dns_cache.h"
+#include "metrics.h"
+#include "policy.h"
+
+namespace cppai {
+    struct pool_options {
+        bool enabled = true;
+        std::size_t max_per_host = 16;
+        std::chrono::steady_clock::duration idle_timeout = std::chrono::seconds(30);
+    };
+
+    class connection_pool {
+    public:
+        using default_executor = boost::asio::use_awaitable_t<>::executor_with_default<boost::asio::any_io_executor>;
+        using tcp_stream = typename boost::beast::tcp_stream::rebind_executor<default_executor>::other;
+        using stream_type = boost::beast::ssl_stream<tcp_stream>;
+
+        // Larger response buffers are given back to the heap instead of being kept on an idle connection.
+        static constexpr std::size_t max_retained_body = 1024 * 1024;
+
+        struct connection {
+            stream_type stream;
+            boost::beast::flat_buffer buffer;
+            boost::beast::flat_buffer body;
+            std::string key;
+            boost::asio::execution_context* context;
+            std::chrono::steady_clock::time_point last_used;
+            std::size_t served = 0;
+
+            connection(tcp_stream&& tcp, boost::asio::ssl::context& ctx, std::string pool_key, boost::asio::execution_context& owner);
+        };
+
+        struct returner {
+            connection_pool* pool;
+            void operator()(connection* conn) const;
+        };
+
+        using connection_ptr = std::unique_ptr<connection, returner>;
+
+        explicit connection_pool(pool_options opts = {});
+
+        ~connection_pool();
+
+        connection_pool(const connection_pool&) = delete;
+
+        connection_pool& operator=(const connection_pool&) = delete;
+
+        boost::asio::awaitable<connection_ptr> acquire(boost::asio::ssl::context& ctx, const std::string& host, const std::string& port,
+            const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline, request_trace* trace = nullptr);
+
+        // Opens a connection for a protocol negotiated through ALPN, such as "h2". It belongs to the caller and is
+        // not counted against max_per_host. Throws protocol_not_supported when the server selects anything else.
+        boost::asio::awaitable<std::unique_ptr<connection>> connect_dedicated(boost::asio::ssl::context& ctx, const std::string& host,
+            const std::string& port, std::string_view alpn, const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace = nullptr);
+
+        void release(connection_ptr conn);
+
+        void discard(connection_ptr conn);
+
+        boost::asio::awaitable<void> shutdown(connection_ptr conn);
+
+        void set_options(pool_options opts);
+
+        pool_options options() const;
+
+        // Every pool starts on dns_cache::shared().
+        void set_dns_cache(std::shared_ptr<dns_cache> cache);
+
+        std::size_t idle_count() const;
+
+    private:
+        using waiter_channel = boost::asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+        struct host_state {
+            std::deque<std::unique_ptr<connection>> idle;
+            std::size_t open = 0;
+            std::list<std::shared_ptr<waiter_channel>> waiters;
+            SSL_SESSION* session = nullptr;
+        };
+
+        mutable std::mutex mtx;
+        pool_options opts;
+        std::shared_ptr<dns_cache> dns = dns_cache::shared();
+        std::unordered_map<std::string, host_state> hosts;
+
+        boost::asio::awaitable<void> connect(connection& conn, const std::string& host, const std::string& port,
+            const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline, request_trace* trace);
+
+        void remember_session(host_state& state, connection& conn);
+
+        void evict_expired(host_state& state, std::chrono::steady_clock::time_point now);
+
+        void wake_one(host_state& state);
+
+        void forget(connection* conn);
+
+        static bool is_healthy(connection& conn);
+
+        static void close(connection& conn);
+    };
+}
+
+#endif
@@ -0,0 +1,272 @@
+#include "dns_cache.h"
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+
+namespace {
+    using endpoint_list = std::vector<boost::asio::ip::tcp::endpoint>;
+
+    // RFC 8305 section 4: alternate address families, starting with IPv6.
+    endpoint_list interleave(const endpoint_list& endpoints) {
+        endpoint_list v6;
+        endpoint_list v4;
+        for (const boost::asio::ip::tcp::endpoint& endpoint : endpoints) {
+            (endpoint.address().is_v6() ? v6 : v4).push_back(endpoint);
+        }
+        endpoint_list ordered;
+        ordered.reserve(endpoints.size());
+        for (std::size_t i = 0; i < std::max(v6.size(), v4.size()); ++i) {
+            if (i < v6.size()) {
+                ordered.push_back(v6[i]);
+            }
+            if (i < v4.size()) {
+                ordered.push_back(v4[i]);
+            }
+        }
+        return ordered;
+    }
+
+    using connect_socket = boost::asio::use_awaitable_t<>::as_default_on_t<boost::asio::ip::tcp::socket>;
+
+    // Sockets are not default constructible, which the awaitable operators need of their results.
+    using attempt_result = std::optional<connect_socket>;
+
+    boost::asio::awaitable<attempt_result> connect_one(const boost::asio::ip::tcp::endpoint& endpoint, boost::asio::steady_timer* failed) {
+        connect_socket socket{ co_await boost::asio::this_coro::executor };
+        const auto [error_code] = co_await socket.async_connect(endpoint, boost::asio::as_tuple(boost::asio::use_awaitable));
+        if (error_code) {
+            if (failed != nullptr) {
+                failed->cancel();
+            }
+            throw boost::system::system_error(error_code);
+        }
+        co_return attempt_result{ std::move(socket) };
+    }
+
+    boost::asio::awaitable<attempt_result> race(const endpoint_list& ordered, std::size_t index, std::chrono::steady_clock::duration stagger);
+
+    boost::asio::awaitable<attempt_result> start_after(boost::asio::steady_timer& failed, const endpoint_list& ordered, std::size_t index,
+        std::chrono::steady_clock::duration stagger) {
+        co_await failed.async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+        const boost::asio::cancellation_state cancellation = co_await boost::asio::this_coro::cancellation_state;
+        if (cancellation.cancelled() != boost::asio::cancellation_type::none) {
+            throw boost::system::system_error(boost::asio::error::operation_aborted);
+        }
+        co_return co_await race(ordered, index, stagger);
+    }
+
+    boost::asio::awaitable<attempt_result> race(const endpoint_list& ordered, std::size_t index, std::chrono::steady_clock::duration stagger) {
+        using namespace boost::asio::experimental::awaitable_operators;
+        if (index + 1 == ordered.size()) {
+            co_return co_await connect_one(ordered[index], nullptr);
+        }
+        // The timer is the stagger delay; a failing attempt cancels it to start the rest immediately.
+        boost::asio::steady_timer failed{ co_await boost::asio::this_coro::executor, stagger };
+        auto winner = co_await (connect_one(ordered[index], &failed) || start_after(failed, ordered, index + 1, stagger));
+        if (winner.index() == 0) {
+            co_return std::get<0>(std::move(winner));
+        }
+        co_return std::get<1>(std::move(winner));
+    }
+}
+
+cppai::dns_cache::dns_cache(dns_options opts) : opts{ opts } {
+}
+
+std::shared_ptr<cppai::dns_cache> cppai::dns_cache::shared() {
+    static const std::shared_ptr<dns_cache> instance = std::make_shared<dns_cache>();
+    return instance;
+}
+
+void cppai::dns_cache::set_resolver(resolve_function fn) {
+    std::lock_guard lock{ mtx };
+    resolver = std::move(fn);
+}
+
+void cppai::dns_cache::pin(const std::string& host, const std::string& port, std::vector<boost::asio::ip::tcp::endpoint> endpoints) {
+    std::lock_guard lock{ mtx };
+    entry& pinned = entries[host + ':' + port];
+    pinned.endpoints = std::move(endpoints);
+    pinned.pinned = true;
+}
+
+void cppai::dns_cache::unpin(const std::string& host, const std::string& port) {
+    std::lock_guard lock{ mtx };
+    const auto found = entries.find(host + ':' + port);
+    if (found != entries.end() && found->second.pinned) {
+        entries.erase(found);
+    }
+}
+
+void cppai::dns_cache::clear() {
+    std::lock_guard lock{ mtx };
+    std::erase_if(entries, [](const auto& item) {
+        return !item.second.pinned;
+    });
+}
+
+boost::asio::awaitable<std::vector<boost::asio::ip::tcp::endpoint>> cppai::dns_cache::resolve(const std::string& host, const std::string& port) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    const std::string key = host + ':' + port;
+
+    std::shared_ptr<flight> current;
+    std::shared_ptr<waiter_channel> waiter;
+    std::shared_ptr<dns_cache> refresher;
+    std::vector<boost::asio::ip::tcp::endpoint> cached;
+    {
+        std::lock_guard lock{ mtx };
+        const auto now = std::chrono::steady_clock::now();
+        const auto found = entries.find(key);
+        if (found != entries.end() && (found->second.pinned || now < found->second.expires)) {
+            entry& hit = found->second;
+            const auto lifetime = std::chrono::duration_cast<std::chrono::steady_clock::duration>((hit.expires - hit.fetched) * opts.refresh_at);
+            if (!hit.pinned && !hit.refreshing && now >= hit.fetched + lifetime) {
+                refresher = weak_from_this().lock();
+                hit.refreshing = refresher != nullptr;
+            }
+            cached = hit.endpoints;
+        }
+        else {
+            std::shared_ptr<flight>& slot = flights[key];
+            if (slot) {
+                waiter = std::make_shared<waiter_channel>(executor, 1);
+                slot->waiters.push_back(waiter);
+            }
+            else {
+                slot = std::make_shared<flight>();
+            }
+            current = slot;
+        }
+    }
+
+    if (!current) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        if (refresher) {
+            boost::asio::co_spawn(executor, refresh(refresher, key, host, port), boost::asio::detached);
+        }
+        co_return cached;
+    }
+
+    if (waiter) {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        co_await waiter->async_receive(boost::asio::use_awaitable);
+        {
+            std::lock_guard lock{ mtx };
+            // A lookup abandoned by its caller is no answer for the callers that were waiting on it.
+            if (!current->abandoned) {
+                if (current->error) {
+                    std::rethrow_exception(current->error);
+                }
+                co_return current->result;
+            }
+        }
+        co_return co_await resolve(host, port);
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    dns_answer answer;
+    std::exception_ptr error;
+    bool abandoned = false;
+    try {
+        answer = co_await fetch(host, port);
+    }
+    catch (const boost::system::system_error& e) {
+        error = std::current_exception();
+        abandoned = e.code() == boost::asio::error::operation_aborted;
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+
+    std::vector<std::shared_ptr<waiter_channel>> waiters;
+    {
+        std::lock_guard lock{ mtx };
+        if (!error) {
+            current->result = answer.endpoints;
+        }
+        current->error = error;
+        current->abandoned = abandoned;
+        waiters = std::move(current->waiters);
+        flights.erase(key);
+    }
+    if (!error) {
+        store(key, answer);
+    }
+    for (const std::shared_ptr<waiter_channel>& waiting : waiters) {
+        waiting->try_send(boost::system::error_code{});
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    co_return std::move(answer.endpoints);
+}
+
+cppai::dns_counters cppai::dns_cache::counters() const {
+    return dns_counters{ hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed),
+        coalesced.load(std::memory_order_relaxed), refreshes.load(std::memory_order_relaxed) };
+}
+
+boost::asio::awaitable<cppai::dns_answer> cppai::dns_cache::fetch(const std::string& host, const std::string& port) const {
+    resolve_function custom;
+    {
+        std::lock_guard lock{ mtx };
+        custom = resolver;
+    }
+    dns_answer answer;
+    if (custom) {
+        answer = co_await custom(host, port);
+    }
+    else {
+        auto system = boost::asio::use_awaitable.as_default_on(boost::asio::ip::tcp::resolver(co_await boost::asio::this_coro::executor));
+        for (const auto& result : co_await system.async_resolve(host, port)) {
+            answer.endpoints.push_back(result.endpoint());
+        }
+    }
+    if (answer.endpoints.empty()) {
+        throw boost::system::system_error(boost::asio::error::host_not_found, host);
+    }
+    co_return answer;
+}
+
+boost::asio::awaitable<void> cppai::dns_cache::refresh(std::shared_ptr<dns_cache> self, std::string key, std::string host, std::string port) {
+    std::optional<dns_answer> answer;
+    try {
+        answer = co_await fetch(host, port);
+    }
+    catch (const boost::system::system_error&) {
+        // The current answer stays valid until it expires; the lookup after that resolves in the foreground.
+    }
+    if (answer.has_value()) {
+        refreshes.fetch_add(1, std::memory_order_relaxed);
+        store(key, std::move(answer.value()));
+        co_return;
+    }
+    std::lock_guard lock{ mtx };
+    if (const auto found = entries.find(key); found != entries.end()) {
+        found->second.refreshing = false;
+    }
+}
+
+void cppai::dns_cache::store(const std::string& key, dns_answer answer) {
+    const auto ttl = std::clamp(answer.ttl.value_or(opts.ttl), opts.min_ttl, opts.max_ttl);
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard lock{ mtx };
+    entry& stored = entries[key];
+    if (stored.pinned) {
+        return;
+    }
+    stored.endpoints = std::move(answer.endpoints);
+    stored.fetched = now;
+    stored.expires = now + ttl;
+    stored.refreshing = false;
+}
+
+boost::asio::awaitable<boost::asio::ip::tcp::socket> cppai::happy_eyeballs_connect(const std::vector<boost::asio::ip::tcp::endpoint>& endpoints,
+    std::chrono::steady_clock::duration stagger) {
+    const endpoint_list ordered = interleave(endpoints);
+    if (ordered.empty()) {
+        throw boost::system::system_error(boost::asio::error::host_not_found);
+    }
+    attempt_result winner = co_await race(ordered, 0, stagger);
+    co_return boost::asio::ip::tcp::socket{ std::move(winner.value()) };
+}
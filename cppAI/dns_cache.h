@@ -0,0 +1,117 @@
+#ifndef CPPAI_DNS_CACHE_H
+#define CPPAI_DNS_CACHE_H
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cppai {
+    struct dns_answer {
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+        // Empty when the source carries no TTL, as with getaddrinfo; dns_options::ttl applies then.
+        std::optional<std::chrono::steady_clock::duration> ttl;
+    };
+
+    struct dns_options {
+        std::chrono::steady_clock::duration ttl = std::chrono::seconds(60);
+        std::chrono::steady_clock::duration min_ttl = std::chrono::seconds(1);
+        std::chrono::steady_clock::duration max_ttl = std::chrono::minutes(30);
+        // A lookup past this fraction of an entry's lifetime still returns the cached answer but starts a
+        // background refresh, so hot names never expire in front of a caller.
+        double refresh_at = 0.75;
+    };
+
+    struct dns_counters {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t coalesced = 0;
+        std::uint64_t refreshes = 0;
+    };
+
+    // Caches resolved addresses per host:port across every client sharing it. Concurrent misses for the same
+    // name wait on a single lookup.
+    class dns_cache : public std::enable_shared_from_this<dns_cache> {
+    public:
+        using resolve_function = std::function<boost::asio::awaitable<dns_answer>(const std::string& host, const std::string& port)>;
+
+        explicit dns_cache(dns_options opts = {});
+
+        // The process-wide cache every openAI instance starts with.
+        static std::shared_ptr<dns_cache> shared();
+
+        // Replaces the system resolver, e.g. with one that reports real TTLs or a deliberately slow stand-in.
+        void set_resolver(resolve_function fn);
+
+        // Answers host:port with fixed endpoints until unpinned, like curl --resolve. Points a client at a
+        // local server without touching TLS names or Host headers.
+        void pin(const std::string& host, const std::string& port, std::vector<boost::asio::ip::tcp::endpoint> endpoints);
+
+        void unpin(const std::string& host, const std::string& port);
+
+        void clear();
+
+        boost::asio::awaitable<std::vector<boost::asio::ip::tcp::endpoint>> resolve(const std::string& host, const std::string& port);
+
+        dns_counters counters() const;
+
+    private:
+        using waiter_channel = boost::asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+        struct entry {
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+            std::chrono::steady_clock::time_point fetched;
+            std::chrono::steady_clock::time_point expires;
+            bool pinned = false;
+            bool refreshing = false;
+        };
+
+        struct flight {
+            std::vector<std::shared_ptr<waiter_channel>> waiters;
+            std::vector<boost::asio::ip::tcp::endpoint> result;
+            std::exception_ptr error;
+            bool abandoned = false;
+        };
+
+        mutable std::mutex mtx;
+        dns_options opts;
+        resolve_function resolver;
+        std::unordered_map<std::string, entry> entries;
+        std::unordered_map<std::string, std::shared_ptr<flight>> flights;
+
+        std::atomic<std::uint64_t> hits{ 0 };
+        std::atomic<std::uint64_t> misses{ 0 };
+        std::atomic<std::uint64_t> coalesced{ 0 };
+        std::atomic<std::uint64_t> refreshes{ 0 };
+
+        boost::asio::awaitable<dns_answer> fetch(const std::string& host, const std::string& port) const;
+
+        boost::asio::awaitable<void> refresh(std::shared_ptr<dns_cache> self, std::string key, std::string host, std::string port);
+
+        void store(const std::string& key, dns_answer answer);
+    };
+
+    // Happy Eyeballs v2 (RFC 8305): addresses are interleaved by family, IPv6 first, and each attempt gets
+    // stagger to finish before the next one starts alongside it. A failed attempt starts the next at once.
+    // The first socket to connect wins and is returned; the rest are cancelled.
+    boost::asio::awaitable<boost::asio::ip::tcp::socket> happy_eyeballs_connect(const std::vector<boost::asio::ip::tcp::endpoint>& endpoints,
+        std::chrono::steady_clock::duration stagger);
+
+    // Moves the winner into socket, whose executor may be any that the winner's converts to, such as the
+    // use_awaitable defaulted one under connection_pool's streams.
+    template <class Executor>
+    boost::asio::awaitable<void> happy_eyeballs_connect(boost::asio::basic_stream_socket<boost::asio::ip::tcp, Executor>& socket,
+        const std::vector<boost::asio::ip::tcp::endpoint>& endpoints, std::chrono::steady_clock::duration stagger) {
+        socket = co_await happy_eyeballs_connect(endpoints, stagger);
+    }
+}
+
+#endif
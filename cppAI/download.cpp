@@ -0,0 +1,48 @@
+#include "download.h"
+
+cppai::jsonl_parser::jsonl_parser(line_handler on_line) : on_line{ std::move(on_line) } {
+}
+
+void cppai::jsonl_parser::write(std::string_view chunk) {
+    while (!chunk.empty()) {
+        const std::size_t end = chunk.find('\n');
+        std::string_view line = chunk.substr(0, end);
+        if (end != std::string_view::npos && !line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        // Leading whitespace never starts a value on its own, so a line of blanks stays "empty".
+        if (!has_data) {
+            const std::size_t first = line.find_first_not_of(" \t\r");
+            line.remove_prefix(first == std::string_view::npos ? line.size() : first);
+        }
+        if (!line.empty()) {
+            json_parser.write(line.data(), line.size());
+            has_data = true;
+        }
+        if (end == std::string_view::npos) {
+            return;
+        }
+        end_line();
+        chunk.remove_prefix(end + 1);
+    }
+}
+
+void cppai::jsonl_parser::finish() {
+    end_line();
+}
+
+std::uint64_t cppai::jsonl_parser::lines() const {
+    return count;
+}
+
+void cppai::jsonl_parser::end_line() {
+    if (!has_data) {
+        return;
+    }
+    json_parser.finish();
+    const boost::json::value line = json_parser.release();
+    json_parser.reset();
+    has_data = false;
+    ++count;
+    on_line(line);
+}
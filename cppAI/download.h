@@ -0,0 +1,69 @@
+#ifndef CPPAI_DOWNLOAD_H
+#define CPPAI_DOWNLOAD_H
+#include <boost/json.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+namespace cppai {
+    // Receives a download's bytes in order as they come off the socket; throwing stops the download.
+    using download_sink = std::function<void(std::string_view chunk)>;
+
+    struct download_options {
+        // First byte to fetch; anything but zero is sent as a Range request.
+        std::uint64_t offset = 0;
+        // A transport error part way through the body is retried from the first byte not yet delivered,
+        // with a Range request and, when the file has a strong ETag, If-Range. Servers that ignore Range resend
+        // from the start and the delivered part is skipped if the ETag proves it is the same file; otherwise
+        // the download fails with download_error. Attempts are bounded by retry_policy::max_attempts.
+        bool resume = true;
+        // Size of the single read buffer; memory use stays at this regardless of the file's size.
+        std::size_t buffer_size = 64 * 1024;
+        // With the path overload: keep an existing file and fetch only what follows its current size.
+        bool continue_partial = false;
+    };
+
+    struct download_result {
+        std::uint32_t status = 0;
+        // Bytes handed to the sink, not counting options.offset.
+        std::uint64_t bytes = 0;
+        std::uint16_t attempts = 0;
+        // Set instead of any sink calls when the server answered with an error document.
+        std::optional<boost::json::value> error;
+    };
+
+    // A resumed download found a different file than the bytes already handed to the sink came from.
+    class download_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Splits JSON Lines into one value per line while bytes arrive. Each line goes through a
+    // boost::json::stream_parser, so only the line being parsed is held in memory; blank lines are skipped.
+    class jsonl_parser {
+    public:
+        using line_handler = std::function<void(const boost::json::value&)>;
+
+        explicit jsonl_parser(line_handler on_line);
+
+        void write(std::string_view chunk);
+
+        // Completes a last line that has no trailing newline.
+        void finish();
+
+        std::uint64_t lines() const;
+
+    private:
+        line_handler on_line;
+        boost::json::stream_parser json_parser;
+        bool has_data = false;
+        std::uint64_t count = 0;
+
+        void end_line();
+    };
+}
+
+#endif
@@ -0,0 +1,612 @@
+#include "embedding.h"
+#include <boost/json/basic_parser_impl.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <optional>
+#include "simd.h"
+#include "utility.h"
+
+namespace {
+    using dot_fn = float (*)(const float*, const float*, std::size_t);
+    using dot_norm_fn = void (*)(const float*, const float*, std::size_t, float&, float&);
+
+    struct kernel_set {
+        dot_fn dot;
+        dot_norm_fn dot_norm;
+    };
+
+    float scalar_dot(const float* a, const float* b, std::size_t n) {
+        float acc[4] = {};
+        std::size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc[0] += a[i] * b[i];
+            acc[1] += a[i + 1] * b[i + 1];
+            acc[2] += a[i + 2] * b[i + 2];
+            acc[3] += a[i + 3] * b[i + 3];
+        }
+        for (; i < n; ++i) {
+            acc[0] += a[i] * b[i];
+        }
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+
+    void scalar_dot_norm(const float* row, const float* query, std::size_t n, float& dot, float& norm) {
+        float products = 0.0f;
+        float squares = 0.0f;
+        for (std::size_t i = 0; i < n; ++i) {
+            products += row[i] * query[i];
+            squares += row[i] * row[i];
+        }
+        dot = products;
+        norm = squares;
+    }
+
+#if defined(CPPAI_X86)
+    CPPAI_TARGET("avx2,fma") float horizontal_sum(__m256 v) {
+        const __m128 halves = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        const __m128 pairs = _mm_add_ps(halves, _mm_movehl_ps(halves, halves));
+        return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 0x55)));
+    }
+
+    CPPAI_TARGET("avx2,fma") float avx2_dot(const float* a, const float* b, std::size_t n) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(b + i + 16), acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 24), _mm256_loadu_ps(b + i + 24), acc3);
+        }
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        }
+        float sum = horizontal_sum(_mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3)));
+        for (; i < n; ++i) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    CPPAI_TARGET("avx2,fma") void avx2_dot_norm(const float* row, const float* query, std::size_t n, float& dot, float& norm) {
+        __m256 products0 = _mm256_setzero_ps();
+        __m256 products1 = _mm256_setzero_ps();
+        __m256 squares0 = _mm256_setzero_ps();
+        __m256 squares1 = _mm256_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m256 r0 = _mm256_loadu_ps(row + i);
+            const __m256 r1 = _mm256_loadu_ps(row + i + 8);
+            products0 = _mm256_fmadd_ps(r0, _mm256_loadu_ps(query + i), products0);
+            products1 = _mm256_fmadd_ps(r1, _mm256_loadu_ps(query + i + 8), products1);
+            squares0 = _mm256_fmadd_ps(r0, r0, squares0);
+            squares1 = _mm256_fmadd_ps(r1, r1, squares1);
+        }
+        float products = horizontal_sum(_mm256_add_ps(products0, products1));
+        float squares = horizontal_sum(_mm256_add_ps(squares0, squares1));
+        for (; i < n; ++i) {
+            products += row[i] * query[i];
+            squares += row[i] * row[i];
+        }
+        dot = products;
+        norm = squares;
+    }
+
+    CPPAI_TARGET("avx512f") float avx512_dot(const float* a, const float* b, std::size_t n) {
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+        }
+        for (; i + 16 <= n; i += 16) {
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        }
+        if (i < n) {
+            const __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+            acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, a + i), _mm512_maskz_loadu_ps(tail, b + i), acc1);
+        }
+        return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    }
+
+    CPPAI_TARGET("avx512f") void avx512_dot_norm(const float* row, const float* query, std::size_t n, float& dot, float& norm) {
+        __m512 products = _mm512_setzero_ps();
+        __m512 squares = _mm512_setzero_ps();
+        std::size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            const __m512 r = _mm512_loadu_ps(row + i);
+            products = _mm512_fmadd_ps(r, _mm512_loadu_ps(query + i), products);
+            squares = _mm512_fmadd_ps(r, r, squares);
+        }
+        if (i < n) {
+            const __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+            const __m512 r = _mm512_maskz_loadu_ps(tail, row + i);
+            products = _mm512_fmadd_ps(r, _mm512_maskz_loadu_ps(tail, query + i), products);
+            squares = _mm512_fmadd_ps(r, r, squares);
+        }
+        dot = _mm512_reduce_add_ps(products);
+        norm = _mm512_reduce_add_ps(squares);
+    }
+
+    struct cpu_features {
+        bool avx2 = false;
+        bool avx512 = false;
+    };
+
+    cpu_features detect_cpu() {
+        cpu_features features;
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return features;
+        }
+        __cpuid(info, 1);
+        const bool fma = (info[2] & (1 << 12)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave) {
+            return features;
+        }
+        const unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        features.avx2 = fma && (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+        features.avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+#else
+        __builtin_cpu_init();
+        features.avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        features.avx512 = __builtin_cpu_supports("avx512f");
+#endif
+        return features;
+    }
+#endif
+
+    const kernel_set& kernels() {
+        static const kernel_set chosen = []() {
+#if defined(CPPAI_X86)
+            const cpu_features features = detect_cpu();
+            if (features.avx512) {
+                return kernel_set{ avx512_dot, avx512_dot_norm };
+            }
+            if (features.avx2) {
+                return kernel_set{ avx2_dot, avx2_dot_norm };
+            }
+#endif
+            return kernel_set{ scalar_dot, scalar_dot_norm };
+        }();
+        return chosen;
+    }
+
+    std::size_t padded(std::size_t dims) {
+        return (dims + cppai::embedding_matrix::lane_floats - 1) / cppai::embedding_matrix::lane_floats * cppai::embedding_matrix::lane_floats;
+    }
+}
+
+cppai::embedding_matrix::embedding_matrix(std::size_t rows, std::size_t dims)
+    : row_count{ rows }, dimensions{ dims }, row_stride{ padded(dims) }, values(rows * padded(dims), 0.0f) {
+}
+
+std::size_t cppai::embedding_matrix::rows() const {
+    return row_count;
+}
+
+std::size_t cppai::embedding_matrix::dims() const {
+    return dimensions;
+}
+
+std::size_t cppai::embedding_matrix::stride() const {
+    return row_stride;
+}
+
+std::span<const float> cppai::embedding_matrix::row(std::size_t i) const {
+    return { values.data() + i * row_stride, dimensions };
+}
+
+std::span<float> cppai::embedding_matrix::row(std::size_t i) {
+    return { values.data() + i * row_stride, dimensions };
+}
+
+const float* cppai::embedding_matrix::data() const {
+    return values.data();
+}
+
+void cppai::embedding_matrix::reserve(std::size_t rows) {
+    values.reserve(rows * row_stride);
+}
+
+float* cppai::embedding_matrix::append_row() {
+    values.resize(values.size() + row_stride, 0.0f);
+    return values.data() + row_count++ * row_stride;
+}
+
+struct cppai::embedding_parser::state {
+    struct handler {
+        static constexpr std::size_t max_object_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_array_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_key_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_string_size = static_cast<std::size_t>(-1);
+
+        struct frame {
+            bool object;
+            std::string key;
+        };
+
+        std::size_t expected_rows;
+        embedding_result result;
+        std::vector<frame> frames;
+        std::string key_text;
+        std::string string_text;
+        std::vector<float> first_row;
+        std::vector<std::size_t> indices;
+        std::optional<std::size_t> item_index;
+        float* current = nullptr;
+        std::size_t filled = 0;
+        bool error_body = false;
+        std::string error_message;
+        std::string error_type;
+        std::string failure;
+
+        explicit handler(std::size_t expected_rows) : expected_rows{ expected_rows } {}
+
+        bool top_field(std::string_view name) const {
+            return frames.size() == 1 && frames[0].key == name;
+        }
+
+        bool nested_field(std::string_view parent, std::string_view name) const {
+            return frames.size() == 2 && frames[0].key == parent && frames[1].object && frames[1].key == name;
+        }
+
+        bool in_item() const {
+            return frames.size() >= 3 && frames[0].key == "data" && !frames[1].object && frames[2].object;
+        }
+
+        bool item_field(std::string_view name) const {
+            return frames.size() == 3 && in_item() && frames[2].key == name;
+        }
+
+        bool in_vector() const {
+            return frames.size() == 4 && in_item() && frames[2].key == "embedding" && !frames[3].object;
+        }
+
+        bool fail(std::string message, boost::json::error_code& ec) {
+            failure = std::move(message);
+            ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+            return false;
+        }
+
+        float* next_row(std::size_t dims) {
+            if (result.vectors.dims() == 0 && result.vectors.rows() == 0) {
+                result.vectors = embedding_matrix{ 0, dims };
+                result.vectors.reserve(expected_rows);
+            }
+            return result.vectors.append_row();
+        }
+
+        bool begin_vector(boost::json::error_code&) {
+            filled = 0;
+            current = result.vectors.rows() != 0 ? result.vectors.append_row() : nullptr;
+            first_row.clear();
+            return true;
+        }
+
+        bool push(float value, boost::json::error_code& ec) {
+            if (current == nullptr) {
+                first_row.push_back(value);
+                return true;
+            }
+            if (filled == result.vectors.dims()) {
+                return fail("embedding rows have different lengths", ec);
+            }
+            current[filled++] = value;
+            return true;
+        }
+
+        bool end_vector(boost::json::error_code& ec) {
+            if (current == nullptr) {
+                std::copy(first_row.begin(), first_row.end(), next_row(first_row.size()));
+                return true;
+            }
+            if (filled != result.vectors.dims()) {
+                return fail("embedding rows have different lengths", ec);
+            }
+            return true;
+        }
+
+        bool decode_vector(std::string_view encoded, boost::json::error_code& ec) {
+            const std::size_t bytes = ::cppai::utility::base64_decoded_size(encoded);
+            if (bytes % sizeof(float) != 0) {
+                return fail("base64 embedding is not a whole number of floats", ec);
+            }
+            const std::size_t dims = bytes / sizeof(float);
+            if (result.vectors.rows() != 0 && dims != result.vectors.dims()) {
+                return fail("embedding rows have different lengths", ec);
+            }
+            float* row = next_row(dims);
+            if (!::cppai::utility::base64_decode(encoded, reinterpret_cast<unsigned char*>(row)).has_value()) {
+                return fail("malformed base64 embedding", ec);
+            }
+            if constexpr (std::endian::native == std::endian::big) {
+                for (std::size_t i = 0; i < dims; ++i) {
+                    const std::uint32_t bits = std::bit_cast<std::uint32_t>(row[i]);
+                    row[i] = std::bit_cast<float>((bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24));
+                }
+            }
+            return true;
+        }
+
+        bool on_document_begin(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_document_end(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_object_begin(boost::json::error_code&) {
+            if (top_field("error")) {
+                error_body = true;
+            }
+            frames.push_back(frame{ true, {} });
+            if (frames.size() == 3 && in_item()) {
+                item_index.reset();
+            }
+            return true;
+        }
+
+        bool on_object_end(std::size_t, boost::json::error_code&) {
+            if (frames.size() == 3 && in_item()) {
+                indices.push_back(item_index.value_or(indices.size()));
+            }
+            frames.pop_back();
+            return true;
+        }
+
+        bool on_array_begin(boost::json::error_code& ec) {
+            frames.push_back(frame{ false, {} });
+            return in_vector() ? begin_vector(ec) : true;
+        }
+
+        bool on_array_end(std::size_t, boost::json::error_code& ec) {
+            const bool ok = in_vector() ? end_vector(ec) : true;
+            frames.pop_back();
+            return ok;
+        }
+
+        bool on_key_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            key_text.append(part.data(), part.size());
+            return true;
+        }
+
+        bool on_key(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            key_text.append(part.data(), part.size());
+            frames.back().key.swap(key_text);
+            key_text.clear();
+            return true;
+        }
+
+        bool on_string_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            string_text.append(part.data(), part.size());
+            return true;
+        }
+
+        bool on_string(boost::json::string_view part, std::size_t, boost::json::error_code& ec) {
+            std::string_view text{ part.data(), part.size() };
+            if (!string_text.empty()) {
+                string_text.append(part.data(), part.size());
+                text = string_text;
+            }
+            bool ok = true;
+            if (item_field("embedding")) {
+                ok = decode_vector(text, ec);
+            }
+            else if (top_field("model")) {
+                result.model.assign(text);
+            }
+            else if (nested_field("error", "message")) {
+                error_message.assign(text);
+            }
+            else if (nested_field("error", "type")) {
+                error_type.assign(text);
+            }
+            string_text.clear();
+            return ok;
+        }
+
+        bool on_number_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_unsigned(std::uint64_t value, boost::json::error_code& ec) {
+            if (in_vector()) {
+                return push(static_cast<float>(value), ec);
+            }
+            if (item_field("index")) {
+                item_index = static_cast<std::size_t>(value);
+            }
+            else if (nested_field("usage", "prompt_tokens")) {
+                result.prompt_tokens = value;
+            }
+            else if (nested_field("usage", "total_tokens")) {
+                result.total_tokens = value;
+            }
+            return true;
+        }
+
+        bool on_int64(std::int64_t value, boost::json::string_view, boost::json::error_code& ec) {
+            if (in_vector()) {
+                return push(static_cast<float>(value), ec);
+            }
+            return value < 0 ? true : on_unsigned(static_cast<std::uint64_t>(value), ec);
+        }
+
+        bool on_uint64(std::uint64_t value, boost::json::string_view, boost::json::error_code& ec) {
+            return on_unsigned(value, ec);
+        }
+
+        bool on_double(double value, boost::json::string_view, boost::json::error_code& ec) {
+            return in_vector() ? push(static_cast<float>(value), ec) : true;
+        }
+
+        bool on_bool(bool, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_null(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_comment_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_comment(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+    };
+
+    boost::json::basic_parser<handler> parser;
+    std::uint32_t status;
+
+    state(std::size_t expected_rows, std::uint32_t status) : parser{ boost::json::parse_options{}, expected_rows }, status{ status } {}
+
+    [[noreturn]] void raise(boost::json::error_code error_code) {
+        if (!parser.handler().failure.empty()) {
+            throw embedding_error(parser.handler().failure);
+        }
+        throw boost::system::system_error(error_code);
+    }
+};
+
+cppai::embedding_error::embedding_error(const std::string& message, std::uint32_t status, std::string type)
+    : std::runtime_error{ message }, code{ status }, kind{ std::move(type) } {
+}
+
+std::uint32_t cppai::embedding_error::status() const {
+    return code;
+}
+
+const std::string& cppai::embedding_error::type() const {
+    return kind;
+}
+
+cppai::embedding_parser::embedding_parser(std::size_t expected_rows, std::uint32_t status)
+    : impl{ std::make_unique<state>(expected_rows, status) } {
+}
+
+cppai::embedding_parser::~embedding_parser() = default;
+
+void cppai::embedding_parser::write(std::string_view chunk) {
+    boost::json::error_code error_code;
+    impl->parser.write_some(true, chunk.data(), chunk.size(), error_code);
+    if (error_code) {
+        impl->raise(error_code);
+    }
+}
+
+cppai::embedding_result cppai::embedding_parser::finish() {
+    boost::json::error_code error_code;
+    impl->parser.write_some(false, nullptr, 0, error_code);
+    if (error_code) {
+        impl->raise(error_code);
+    }
+
+    state::handler& parsed = impl->parser.handler();
+    if (parsed.error_body) {
+        throw embedding_error(parsed.error_message.empty() ? "embeddings request failed" : parsed.error_message, impl->status, parsed.error_type);
+    }
+
+    // The API returns items in index order; anything else is put back in order with one extra copy.
+    embedding_result result = std::move(parsed.result);
+    bool ordered = parsed.indices.size() == result.vectors.rows();
+    for (std::size_t i = 0; ordered && i < parsed.indices.size(); ++i) {
+        ordered = parsed.indices[i] == i;
+    }
+    if (!ordered && parsed.indices.size() == result.vectors.rows()) {
+        embedding_matrix sorted{ result.vectors.rows(), result.vectors.dims() };
+        std::vector<bool> seen(sorted.rows());
+        for (std::size_t i = 0; i < parsed.indices.size(); ++i) {
+            if (parsed.indices[i] >= sorted.rows()) {
+                throw embedding_error("embedding index out of range");
+            }
+            // A repeated index would leave another row as zeros.
+            if (seen[parsed.indices[i]]) {
+                throw embedding_error("duplicate embedding index");
+            }
+            seen[parsed.indices[i]] = true;
+            std::copy_n(result.vectors.row(i).data(), result.vectors.dims(), sorted.row(parsed.indices[i]).data());
+        }
+        result.vectors = std::move(sorted);
+    }
+    return result;
+}
+
+cppai::embedding_result cppai::parse_embeddings(std::string_view body, std::size_t expected_rows, std::uint32_t status) {
+    embedding_parser parser{ expected_rows, status };
+    parser.write(body);
+    return parser.finish();
+}
+
+float cppai::dot(std::span<const float> a, std::span<const float> b) {
+    return kernels().dot(a.data(), b.data(), std::min(a.size(), b.size()));
+}
+
+float cppai::cosine(std::span<const float> a, std::span<const float> b) {
+    const std::size_t n = std::min(a.size(), b.size());
+    float products = 0.0f;
+    float squares = 0.0f;
+    kernels().dot_norm(a.data(), b.data(), n, products, squares);
+    const float query_squares = kernels().dot(b.data(), b.data(), n);
+    const float denominator = std::sqrt(squares) * std::sqrt(query_squares);
+    return denominator > 0.0f ? products / denominator : 0.0f;
+}
+
+std::vector<cppai::embedding_match> cppai::top_k(const embedding_matrix& matrix, std::span<const float> query, std::size_t k,
+    similarity metric) {
+    if (query.size() != matrix.dims()) {
+        throw std::invalid_argument("query length does not match the matrix dimensions");
+    }
+    k = std::min(k, matrix.rows());
+    if (k == 0) {
+        return {};
+    }
+
+    // Pad the query like the rows so the kernels always see whole registers.
+    std::vector<float, aligned_allocator<float, embedding_matrix::alignment>> padded_query(matrix.stride(), 0.0f);
+    std::copy(query.begin(), query.end(), padded_query.begin());
+    const kernel_set& kernel = kernels();
+    const float query_norm = std::sqrt(kernel.dot(padded_query.data(), padded_query.data(), matrix.stride()));
+
+    const auto better = [](const embedding_match& lhs, const embedding_match& rhs) {
+        return lhs.score > rhs.score;
+    };
+    std::vector<embedding_match> best;
+    best.reserve(k + 1);
+    for (std::size_t i = 0; i < matrix.rows(); ++i) {
+        const float* row = matrix.data() + i * matrix.stride();
+        float score = 0.0f;
+        if (metric == similarity::dot) {
+            score = kernel.dot(row, padded_query.data(), matrix.stride());
+        }
+        else {
+            float squares = 0.0f;
+            kernel.dot_norm(row, padded_query.data(), matrix.stride(), score, squares);
+            const float denominator = std::sqrt(squares) * query_norm;
+            score = denominator > 0.0f ? score / denominator : 0.0f;
+        }
+
+        if (best.size() < k) {
+            best.push_back(embedding_match{ i, score });
+            std::push_heap(best.begin(), best.end(), better);
+        }
+        else if (score > best.front().score) {
+            std::pop_heap(best.begin(), best.end(), better);
+            best.back() = embedding_match{ i, score };
+            std::push_heap(best.begin(), best.end(), better);
+        }
+    }
+    std::sort_heap(best.begin(), best.end(), better);
+    return best;
+}
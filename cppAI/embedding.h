@@ -0,0 +1,143 @@
+#ifndef CPPAI_EMBEDDING_H
+#define CPPAI_EMBEDDING_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppai {
+    template <class T, std::size_t Alignment>
+    struct aligned_allocator {
+        using value_type = T;
+
+        template <class U>
+        struct rebind {
+            using other = aligned_allocator<U, Alignment>;
+        };
+
+        aligned_allocator() = default;
+
+        template <class U>
+        aligned_allocator(const aligned_allocator<U, Alignment>&) noexcept {}
+
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ Alignment }));
+        }
+
+        void deallocate(T* p, std::size_t) noexcept {
+            ::operator delete(p, std::align_val_t{ Alignment });
+        }
+
+        template <class U>
+        bool operator==(const aligned_allocator<U, Alignment>&) const noexcept {
+            return true;
+        }
+    };
+
+    // Row-major float matrix. Every row starts on a 64-byte boundary and is zero-padded to a multiple of
+    // 16 floats, so the similarity kernels run over whole vector registers without a scalar tail.
+    class embedding_matrix {
+    public:
+        static constexpr std::size_t alignment = 64;
+        static constexpr std::size_t lane_floats = alignment / sizeof(float);
+
+        embedding_matrix() = default;
+
+        embedding_matrix(std::size_t rows, std::size_t dims);
+
+        std::size_t rows() const;
+
+        std::size_t dims() const;
+
+        std::size_t stride() const;
+
+        std::span<const float> row(std::size_t i) const;
+
+        std::span<float> row(std::size_t i);
+
+        const float* data() const;
+
+        void reserve(std::size_t rows);
+
+        float* append_row();
+
+    private:
+        std::size_t row_count = 0;
+        std::size_t dimensions = 0;
+        std::size_t row_stride = 0;
+        std::vector<float, aligned_allocator<float, alignment>> values;
+    };
+
+    struct embedding_result {
+        std::string model;
+        embedding_matrix vectors;
+        std::uint64_t prompt_tokens = 0;
+        std::uint64_t total_tokens = 0;
+    };
+
+    class embedding_error : public std::runtime_error {
+    public:
+        explicit embedding_error(const std::string& message, std::uint32_t status = 0, std::string type = {});
+
+        // The HTTP status of an API error reply; 0 when the response itself could not be used, e.g. a malformed
+        // one or one with the wrong number of rows.
+        std::uint32_t status() const;
+
+        // The reply's error.type, e.g. "invalid_request_error"; empty when it had none.
+        const std::string& type() const;
+
+    private:
+        std::uint32_t code;
+        std::string kind;
+    };
+
+    enum class similarity {
+        dot,
+        cosine
+    };
+
+    struct embedding_match {
+        std::size_t row;
+        float score;
+    };
+
+    // Streams an embeddings response into an embedding_result without building a JSON tree. Handles both
+    // float arrays and encoding_format "base64"; an API error body is thrown as embedding_error.
+    class embedding_parser {
+    public:
+        // status is the reply's HTTP status, which the embedding_error thrown for an error body carries.
+        explicit embedding_parser(std::size_t expected_rows = 0, std::uint32_t status = 0);
+
+        ~embedding_parser();
+
+        embedding_parser(const embedding_parser&) = delete;
+
+        embedding_parser& operator=(const embedding_parser&) = delete;
+
+        void write(std::string_view chunk);
+
+        embedding_result finish();
+
+    private:
+        struct state;
+
+        std::unique_ptr<state> impl;
+    };
+
+    embedding_result parse_embeddings(std::string_view body, std::size_t expected_rows = 0, std::uint32_t status = 0);
+
+    float dot(std::span<const float> a, std::span<const float> b);
+
+    float cosine(std::span<const float> a, std::span<const float> b);
+
+    // Brute-force search; results are ordered by descending score.
+    std::vector<embedding_match> top_k(const embedding_matrix& matrix, std::span<const float> query, std::size_t k,
+        similarity metric = similarity::cosine);
+}
+
+#endif
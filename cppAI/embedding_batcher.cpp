@@ -0,0 +1,154 @@
+#include "embedding_batcher.h"
+#include <algorithm>
+#include <span>
+
+cppai::embedding_batcher::embedding_batcher(const openAI& client, embedding_batch_options defaults) : client{ client }, defaults{ std::move(defaults) } {
+}
+
+void cppai::embedding_batcher::configure(const std::string& model, embedding_batch_options opts) {
+    std::lock_guard lock{ mtx };
+    queue_for(model).opts = std::move(opts);
+}
+
+boost::asio::awaitable<std::vector<float>> cppai::embedding_batcher::embed(std::string model, std::string input) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    auto current = std::make_shared<call>();
+    current->tokens = input.size() / 4 + 1;
+    current->input = std::move(input);
+    current->waiter = std::make_shared<waiter_channel>(executor, 1);
+
+    std::vector<batch> ready;
+    std::optional<std::uint32_t> dimensions;
+    std::optional<std::pair<std::uint64_t, std::chrono::microseconds>> arm;
+    {
+        std::lock_guard lock{ mtx };
+        ++stats.calls;
+        model_queue& queue = queue_for(model);
+        dimensions = queue.opts.dimensions;
+        if (!queue.calls.empty() && queue.tokens + current->tokens > queue.opts.max_tokens) {
+            ready.push_back(take(queue));
+        }
+        queue.calls.push_back(current);
+        queue.tokens += current->tokens;
+        if (queue.calls.size() >= std::max<std::size_t>(queue.opts.max_items, 1)) {
+            ready.push_back(take(queue));
+        }
+        else if (queue.calls.size() == 1) {
+            arm.emplace(queue.generation, queue.opts.linger);
+        }
+    }
+
+    // co_spawn may start running right here, so only once the lock is released.
+    for (batch& full : ready) {
+        boost::asio::co_spawn(executor, send(model, dimensions, std::move(full)), boost::asio::detached);
+    }
+    if (arm.has_value()) {
+        boost::asio::co_spawn(executor, linger(model, arm->first, arm->second), boost::asio::detached);
+    }
+
+    co_await current->waiter->async_receive(boost::asio::use_awaitable);
+    if (current->error) {
+        std::rethrow_exception(current->error);
+    }
+    co_return std::move(current->vector);
+}
+
+cppai::embedding_batch_counters cppai::embedding_batcher::counters() const {
+    std::lock_guard lock{ mtx };
+    return stats;
+}
+
+cppai::embedding_batcher::model_queue& cppai::embedding_batcher::queue_for(const std::string& model) {
+    auto [it, inserted] = queues.try_emplace(model);
+    if (inserted) {
+        it->second.opts = defaults;
+    }
+    return it->second;
+}
+
+cppai::embedding_batcher::batch cppai::embedding_batcher::take(model_queue& queue) {
+    batch calls = std::move(queue.calls);
+    queue.calls.clear();
+    queue.tokens = 0;
+    ++queue.generation;
+    return calls;
+}
+
+boost::asio::awaitable<void> cppai::embedding_batcher::linger(std::string model, std::uint64_t generation, std::chrono::microseconds delay) {
+    boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+    co_await timer.async_wait(boost::asio::use_awaitable);
+
+    batch calls;
+    std::optional<std::uint32_t> dimensions;
+    {
+        std::lock_guard lock{ mtx };
+        model_queue& queue = queue_for(model);
+        if (queue.generation != generation || queue.calls.empty()) {
+            co_return;
+        }
+        dimensions = queue.opts.dimensions;
+        calls = take(queue);
+    }
+    co_await send(std::move(model), dimensions, std::move(calls));
+}
+
+boost::asio::awaitable<void> cppai::embedding_batcher::send(std::string model, std::optional<std::uint32_t> dimensions, batch calls) {
+    boost::json::object request_body;
+    request_body["model"] = model;
+    boost::json::array& inputs = request_body["input"].emplace_array();
+    inputs.reserve(calls.size());
+    for (const std::shared_ptr<call>& pending : calls) {
+        inputs.emplace_back(pending->input);
+    }
+    if (dimensions.has_value()) {
+        request_body["dimensions"] = dimensions.value();
+    }
+    {
+        std::lock_guard lock{ mtx };
+        ++stats.batches;
+    }
+
+    std::exception_ptr error;
+    // Only a 400 blames the inputs; a bad key, a rate limit or a server error would fail every half alike, and
+    // splitting would multiply the requests while the service is refusing them.
+    bool rejected = false;
+    try {
+        embedding_result result = co_await client.create_embedding_matrix(request_body);
+        if (result.vectors.rows() != calls.size()) {
+            throw embedding_error("embeddings response does not match the batch");
+        }
+        for (std::size_t i = 0; i < calls.size(); ++i) {
+            const std::span<const float> row = result.vectors.row(i);
+            calls[i]->vector.assign(row.begin(), row.end());
+        }
+    }
+    catch (const embedding_error& e) {
+        error = std::current_exception();
+        rejected = e.status() == 400;
+    }
+    catch (...) {
+        // Transport errors and timeouts were already retried by the client's retry policy.
+        error = std::current_exception();
+    }
+
+    // An input over the model's context length, or otherwise invalid, fails the whole request with a 400.
+    if (rejected && calls.size() > 1) {
+        {
+            std::lock_guard lock{ mtx };
+            ++stats.splits;
+        }
+        const std::size_t half = calls.size() / 2;
+        co_await send(model, dimensions, batch(calls.begin(), calls.begin() + half));
+        co_await send(std::move(model), dimensions, batch(calls.begin() + half, calls.end()));
+        co_return;
+    }
+
+    if (error) {
+        std::lock_guard lock{ mtx };
+        stats.failed += calls.size();
+    }
+    for (const std::shared_ptr<call>& pending : calls) {
+        pending->error = error;
+        pending->waiter->try_send(boost::system::error_code{});
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef CPPAI_EMBEDDING_BATCHER_H
+#define CPPAI_EMBEDDING_BATCHER_H
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "openai.h"
+
+namespace cppai {
+    struct embedding_batch_options {
+        // The endpoint takes up to 2048 inputs per request.
+        std::size_t max_items = 256;
+        // How long the first call of a batch waits for others to join it.
+        std::chrono::microseconds linger{ 2000 };
+        // Estimated at four characters per token; a call that would go over starts the next batch.
+        std::uint64_t max_tokens = 100000;
+        std::optional<std::uint32_t> dimensions;
+    };
+
+    struct embedding_batch_counters {
+        std::uint64_t calls = 0;
+        std::uint64_t batches = 0;
+        // Rejected batches retried as two halves to find the inputs at fault.
+        std::uint64_t splits = 0;
+        std::uint64_t failed = 0;
+    };
+
+    // Coalesces single-input embedding calls made concurrently, from any thread, into requests with an
+    // input array: a batch goes out once it holds max_items inputs or max_tokens, or linger after its first
+    // call. Each caller gets the row at its own index. When the API rejects a batch as invalid (400), it is
+    // split in half until the inputs at fault fail alone and the rest still get their vectors; any other
+    // error fails every call in the batch with it. The batcher must outlive the calls made through it.
+    class embedding_batcher {
+    public:
+        explicit embedding_batcher(const openAI& client, embedding_batch_options defaults = {});
+
+        embedding_batcher(const embedding_batcher&) = delete;
+
+        embedding_batcher& operator=(const embedding_batcher&) = delete;
+
+        // Options for one model; others use the defaults. Applies to batches started afterwards.
+        void configure(const std::string& model, embedding_batch_options opts);
+
+        boost::asio::awaitable<std::vector<float>> embed(std::string model, std::string input);
+
+        embedding_batch_counters counters() const;
+
+    private:
+        using waiter_channel = boost::asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+        struct call {
+            std::string input;
+            std::uint64_t tokens = 0;
+            std::shared_ptr<waiter_channel> waiter;
+            std::vector<float> vector;
+            std::exception_ptr error;
+        };
+
+        using batch = std::vector<std::shared_ptr<call>>;
+
+        struct model_queue {
+            embedding_batch_options opts;
+            batch calls;
+            std::uint64_t tokens = 0;
+            // Bumped whenever the queue is taken, so a linger timer for an earlier batch does nothing.
+            std::uint64_t generation = 0;
+        };
+
+        const openAI& client;
+        embedding_batch_options defaults;
+
+        mutable std::mutex mtx;
+        std::unordered_map<std::string, model_queue> queues;
+        embedding_batch_counters stats;
+
+        model_queue& queue_for(const std::string& model);
+
+        static batch take(model_queue& queue);
+
+        boost::asio::awaitable<void> linger(std::string model, std::uint64_t generation, std::chrono::microseconds delay);
+
+        boost::asio::awaitable<void> send(std::string model, std::optional<std::uint32_t> dimensions, batch calls);
+    };
+}
+
+#endif
@@ -0,0 +1,10 @@
+#include "endpoints.h"
+
+std::string cppai::endpoint::resolve(std::string_view id) const {
+    std::string resolved{ target };
+    const std::size_t placeholder = resolved.find("{id}");
+    if (placeholder != std::string::npos) {
+        resolved.replace(placeholder, 4, id);
+    }
+    return resolved;
+}
@@ -0,0 +1,64 @@
+#ifndef CPPAI_ENDPOINTS_H
+#define CPPAI_ENDPOINTS_H
+#include <boost/beast/http/verb.hpp>
+#include <string>
+#include <string_view>
+
+namespace cppai {
+    enum class body_kind {
+        none,
+        json,
+        multipart
+    };
+
+    enum class cache_mode {
+        never,
+        // Only requests that pin the output, e.g. temperature 0; see openAI::deterministic.
+        deterministic,
+        always
+    };
+
+    struct endpoint {
+        boost::beast::http::verb method;
+        // "{id}" stands for the id a call is made with.
+        std::string_view target;
+        body_kind body = body_kind::none;
+        // Multipart bodies append their boundary parameter.
+        std::string_view content_type;
+        cache_mode cache = cache_mode::never;
+
+        std::string resolve(std::string_view id) const;
+    };
+
+    // Every call the client makes is one of these; the public functions only add how the body is built.
+    namespace endpoints {
+        inline constexpr endpoint list_models{ boost::beast::http::verb::get, "/v1/models" };
+        inline constexpr endpoint delete_model{ boost::beast::http::verb::delete_, "/v1/models/{id}" };
+        inline constexpr endpoint completions{ boost::beast::http::verb::post, "/v1/completions", body_kind::json, "application/json",
+            cache_mode::deterministic };
+        inline constexpr endpoint chat_completions{ boost::beast::http::verb::post, "/v1/chat/completions", body_kind::json, "application/json",
+            cache_mode::deterministic };
+        inline constexpr endpoint edits{ boost::beast::http::verb::post, "/v1/edits", body_kind::json, "application/json" };
+        inline constexpr endpoint image_generations{ boost::beast::http::verb::post, "/v1/images/generations", body_kind::json, "application/json" };
+        inline constexpr endpoint image_edits{ boost::beast::http::verb::post, "/v1/images/edits", body_kind::multipart, "multipart/form-data" };
+        inline constexpr endpoint image_variations{ boost::beast::http::verb::post, "/v1/images/variations", body_kind::multipart,
+            "multipart/form-data" };
+        inline constexpr endpoint embeddings{ boost::beast::http::verb::post, "/v1/embeddings", body_kind::json, "application/json",
+            cache_mode::always };
+        inline constexpr endpoint audio_transcriptions{ boost::beast::http::verb::post, "/v1/audio/transcriptions", body_kind::multipart,
+            "multipart/form-data" };
+        inline constexpr endpoint audio_translations{ boost::beast::http::verb::post, "/v1/audio/translations", body_kind::multipart,
+            "multipart/form-data" };
+        inline constexpr endpoint list_files{ boost::beast::http::verb::get, "/v1/files" };
+        inline constexpr endpoint delete_file{ boost::beast::http::verb::delete_, "/v1/files/{id}" };
+        inline constexpr endpoint file_content{ boost::beast::http::verb::get, "/v1/files/{id}/content" };
+        inline constexpr endpoint create_fine_tune{ boost::beast::http::verb::post, "/v1/fine-tunes", body_kind::json, "application/json" };
+        inline constexpr endpoint list_fine_tunes{ boost::beast::http::verb::get, "/v1/fine-tunes" };
+        inline constexpr endpoint retrieve_fine_tune{ boost::beast::http::verb::get, "/v1/fine-tunes/{id}" };
+        inline constexpr endpoint cancel_fine_tune{ boost::beast::http::verb::post, "/v1/fine-tunes/{id}/cancel" };
+        inline constexpr endpoint fine_tune_events{ boost::beast::http::verb::get, "/v1/fine-tunes/{id}/events" };
+        inline constexpr endpoint moderations{ boost::beast::http::verb::post, "/v1/moderations", body_kind::json, "application/json" };
+    }
+}
+
+#endif
@@ -0,0 +1,377 @@
+#include "hpack.h"
+#include <boost/system/system_error.hpp>
+#include <array>
+#include <utility>
+
+namespace {
+    struct huffman_code {
+        std::uint32_t code;
+        std::uint8_t bits;
+    };
+
+    // RFC 7541 Appendix B, indexed by symbol; entry 256 is EOS.
+    constexpr huffman_code huffman_codes[257] = {
+        { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 }, { 0xfffffe4, 28 }, { 0xfffffe5, 28 },
+        { 0xfffffe6, 28 }, { 0xfffffe7, 28 }, { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+        { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 }, { 0xfffffed, 28 }, { 0xfffffee, 28 },
+        { 0xfffffef, 28 }, { 0xffffff0, 28 }, { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+        { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 }, { 0xffffff8, 28 }, { 0xffffff9, 28 },
+        { 0xffffffa, 28 }, { 0xffffffb, 28 }, { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+        { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 }, { 0x3fa, 10 }, { 0x3fb, 10 },
+        { 0xf9, 8 }, { 0x7fb, 11 }, { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+        { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 }, { 0x1a, 6 }, { 0x1b, 6 },
+        { 0x1c, 6 }, { 0x1d, 6 }, { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+        { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 }, { 0x1ffa, 13 }, { 0x21, 6 },
+        { 0x5d, 7 }, { 0x5e, 7 }, { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+        { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 }, { 0x67, 7 }, { 0x68, 7 },
+        { 0x69, 7 }, { 0x6a, 7 }, { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+        { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 }, { 0xfc, 8 }, { 0x73, 7 },
+        { 0xfd, 8 }, { 0x1ffb, 13 }, { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+        { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 }, { 0x24, 6 }, { 0x5, 5 },
+        { 0x25, 6 }, { 0x26, 6 }, { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+        { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 }, { 0x2b, 6 }, { 0x76, 7 },
+        { 0x2c, 6 }, { 0x8, 5 }, { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+        { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 }, { 0x7fc, 11 }, { 0x3ffd, 14 },
+        { 0x1ffd, 13 }, { 0xffffffc, 28 }, { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+        { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 }, { 0x3fffd6, 22 }, { 0x7fffda, 23 },
+        { 0x7fffdb, 23 }, { 0x7fffdc, 23 }, { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+        { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 }, { 0xffffee, 24 }, { 0x7fffe1, 23 },
+        { 0x7fffe2, 23 }, { 0x7fffe3, 23 }, { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+        { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 }, { 0x3fffda, 22 }, { 0x1fffdd, 21 },
+        { 0xfffe9, 20 }, { 0x3fffdb, 22 }, { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+        { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 }, { 0x1fffdf, 21 }, { 0x3fffdf, 22 },
+        { 0x7fffeb, 23 }, { 0x7fffec, 23 }, { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+        { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 }, { 0xfffea, 20 }, { 0x3fffe2, 22 },
+        { 0x3fffe3, 22 }, { 0x3fffe4, 22 }, { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+        { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 }, { 0x3fffe7, 22 }, { 0x7ffff2, 23 },
+        { 0x3fffe8, 22 }, { 0x1ffffec, 25 }, { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+        { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 }, { 0x7fff2, 19 }, { 0x1fffe3, 21 },
+        { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 }, { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+        { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 }, { 0xffffffd, 28 }, { 0x7ffffe3, 27 },
+        { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 }, { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+        { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 }, { 0x3fffea, 22 }, { 0x3fffeb, 22 },
+        { 0x1ffffee, 25 }, { 0x1ffffef, 25 }, { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+        { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 }, { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 },
+        { 0x7ffffe9, 27 }, { 0x7ffffea, 27 }, { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+        { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 }, { 0x3fffffff, 30 }
+    };
+
+    struct static_entry {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    // RFC 7541 Appendix A; HPACK index i refers to static_table[i - 1].
+    constexpr static_entry static_table[] = {
+        { ":authority", "" }, { ":method", "GET" }, { ":method", "POST" }, { ":path", "/" }, { ":path", "/index.html" },
+        { ":scheme", "http" }, { ":scheme", "https" }, { ":status", "200" }, { ":status", "204" }, { ":status", "206" },
+        { ":status", "304" }, { ":status", "400" }, { ":status", "404" }, { ":status", "500" }, { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" }, { "accept-language", "" }, { "accept-ranges", "" }, { "accept", "" },
+        { "access-control-allow-origin", "" }, { "age", "" }, { "allow", "" }, { "authorization", "" }, { "cache-control", "" },
+        { "content-disposition", "" }, { "content-encoding", "" }, { "content-language", "" }, { "content-length", "" },
+        { "content-location", "" }, { "content-range", "" }, { "content-type", "" }, { "cookie", "" }, { "date", "" },
+        { "etag", "" }, { "expect", "" }, { "expires", "" }, { "from", "" }, { "host", "" }, { "if-match", "" },
+        { "if-modified-since", "" }, { "if-none-match", "" }, { "if-range", "" }, { "if-unmodified-since", "" },
+        { "last-modified", "" }, { "link", "" }, { "location", "" }, { "max-forwards", "" }, { "proxy-authenticate", "" },
+        { "proxy-authorization", "" }, { "range", "" }, { "referer", "" }, { "refresh", "" }, { "retry-after", "" },
+        { "server", "" }, { "set-cookie", "" }, { "strict-transport-security", "" }, { "transfer-encoding", "" },
+        { "user-agent", "" }, { "vary", "" }, { "via", "" }, { "www-authenticate", "" }
+    };
+
+    constexpr std::size_t static_size = std::size(static_table);
+
+    constexpr std::size_t entry_overhead = 32;
+
+    [[noreturn]] void malformed() {
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::protocol_error),
+            "Malformed HPACK header block");
+    }
+
+    std::size_t entry_size(std::string_view name, std::string_view value) {
+        return name.size() + value.size() + entry_overhead;
+    }
+
+    // Binary tree over the code table, walked one bit at a time. Node 0 is the root.
+    struct huffman_tree {
+        struct node {
+            std::array<std::int16_t, 2> next{ -1, -1 };
+            std::int16_t symbol = -1;
+        };
+
+        std::vector<node> nodes;
+
+        huffman_tree() {
+            nodes.reserve(2 * std::size(huffman_codes));
+            nodes.emplace_back();
+            for (std::size_t symbol = 0; symbol < std::size(huffman_codes); ++symbol) {
+                std::size_t at = 0;
+                for (int bit = huffman_codes[symbol].bits - 1; bit >= 0; --bit) {
+                    const std::size_t branch = (huffman_codes[symbol].code >> bit) & 1;
+                    if (nodes[at].next[branch] < 0) {
+                        nodes[at].next[branch] = static_cast<std::int16_t>(nodes.size());
+                        nodes.emplace_back();
+                    }
+                    at = static_cast<std::size_t>(nodes[at].next[branch]);
+                }
+                nodes[at].symbol = static_cast<std::int16_t>(symbol);
+            }
+        }
+    };
+
+    void huffman_decode(std::span<const unsigned char> input, std::string& out) {
+        static const huffman_tree tree;
+        std::size_t at = 0;
+        std::size_t pending = 0;
+        bool all_ones = true;
+        for (const unsigned char byte : input) {
+            for (int bit = 7; bit >= 0; --bit) {
+                const std::size_t branch = (byte >> bit) & 1;
+                const std::int16_t next = tree.nodes[at].next[branch];
+                if (next < 0) {
+                    malformed();
+                }
+                at = static_cast<std::size_t>(next);
+                ++pending;
+                all_ones = all_ones && branch == 1;
+                if (const std::int16_t symbol = tree.nodes[at].symbol; symbol >= 0) {
+                    if (symbol == 256) {
+                        malformed();
+                    }
+                    out.push_back(static_cast<char>(symbol));
+                    at = 0;
+                    pending = 0;
+                    all_ones = true;
+                }
+            }
+        }
+        // Only a prefix of EOS, shorter than a byte, may pad the last code (RFC 7541 section 5.2).
+        if (pending >= 8 || !all_ones) {
+            malformed();
+        }
+    }
+
+    std::size_t huffman_size(std::string_view input) {
+        std::size_t bits = 0;
+        for (const char c : input) {
+            bits += huffman_codes[static_cast<unsigned char>(c)].bits;
+        }
+        return (bits + 7) / 8;
+    }
+
+    void huffman_encode(std::string_view input, std::vector<unsigned char>& out) {
+        std::uint64_t accumulator = 0;
+        std::size_t count = 0;
+        for (const char c : input) {
+            const huffman_code& code = huffman_codes[static_cast<unsigned char>(c)];
+            accumulator = (accumulator << code.bits) | code.code;
+            count += code.bits;
+            while (count >= 8) {
+                count -= 8;
+                out.push_back(static_cast<unsigned char>(accumulator >> count));
+            }
+        }
+        if (count > 0) {
+            out.push_back(static_cast<unsigned char>((accumulator << (8 - count)) | (0xff >> count)));
+        }
+    }
+
+    void encode_integer(std::uint64_t value, std::uint8_t prefix_bits, std::uint8_t flags, std::vector<unsigned char>& out) {
+        const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+        if (value < max_prefix) {
+            out.push_back(static_cast<unsigned char>(flags | value));
+            return;
+        }
+        out.push_back(static_cast<unsigned char>(flags | max_prefix));
+        value -= max_prefix;
+        while (value >= 128) {
+            out.push_back(static_cast<unsigned char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    std::uint64_t decode_integer(const unsigned char*& at, const unsigned char* end, std::uint8_t prefix_bits) {
+        const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+        std::uint64_t value = *at++ & max_prefix;
+        if (value < max_prefix) {
+            return value;
+        }
+        for (unsigned shift = 0;; shift += 7) {
+            if (at == end || shift > 56) {
+                malformed();
+            }
+            const unsigned char byte = *at++;
+            value += static_cast<std::uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    std::string decode_string(const unsigned char*& at, const unsigned char* end) {
+        if (at == end) {
+            malformed();
+        }
+        const bool huffman = (*at & 0x80) != 0;
+        const std::uint64_t length = decode_integer(at, end, 7);
+        if (length > static_cast<std::uint64_t>(end - at)) {
+            malformed();
+        }
+        std::string text;
+        if (huffman) {
+            text.reserve(length * 8 / 5);
+            huffman_decode({ at, static_cast<std::size_t>(length) }, text);
+        }
+        else {
+            text.assign(reinterpret_cast<const char*>(at), static_cast<std::size_t>(length));
+        }
+        at += length;
+        return text;
+    }
+
+    void encode_string(std::string_view text, std::vector<unsigned char>& out) {
+        const std::size_t compressed = huffman_size(text);
+        if (compressed < text.size()) {
+            encode_integer(compressed, 7, 0x80, out);
+            huffman_encode(text, out);
+        }
+        else {
+            encode_integer(text.size(), 7, 0x00, out);
+            out.insert(out.end(), text.begin(), text.end());
+        }
+    }
+}
+
+cppai::hpack_decoder::hpack_decoder(std::size_t max_table_size) : capacity{ max_table_size }, limit{ max_table_size } {
+}
+
+void cppai::hpack_decoder::decode(std::span<const unsigned char> block, std::vector<hpack_field>& out) {
+    const unsigned char* at = block.data();
+    const unsigned char* const end = at + block.size();
+    while (at != end) {
+        const unsigned char first = *at;
+        if (first & 0x80) {
+            out.push_back(lookup(decode_integer(at, end, 7)));
+        }
+        else if ((first & 0xc0) == 0x40) {
+            const std::uint64_t index = decode_integer(at, end, 6);
+            hpack_field field;
+            field.name = index != 0 ? lookup(index).name : decode_string(at, end);
+            field.value = decode_string(at, end);
+            out.push_back(field);
+            insert(std::move(field));
+        }
+        else if ((first & 0xe0) == 0x20) {
+            const std::uint64_t size = decode_integer(at, end, 5);
+            if (size > limit) {
+                malformed();
+            }
+            capacity = static_cast<std::size_t>(size);
+            evict();
+        }
+        else {
+            // Literal without indexing (0000) or never indexed (0001): neither touches the table.
+            const std::uint64_t index = decode_integer(at, end, 4);
+            hpack_field field;
+            field.name = index != 0 ? lookup(index).name : decode_string(at, end);
+            field.value = decode_string(at, end);
+            out.push_back(std::move(field));
+        }
+    }
+}
+
+const cppai::hpack_field& cppai::hpack_decoder::lookup(std::uint64_t index) const {
+    static const std::vector<hpack_field> fixed = [] {
+        std::vector<hpack_field> fields;
+        for (const static_entry& entry : static_table) {
+            fields.push_back(hpack_field{ std::string{ entry.name }, std::string{ entry.value } });
+        }
+        return fields;
+    }();
+    if (index == 0 || index > static_size + table.size()) {
+        malformed();
+    }
+    if (index <= static_size) {
+        return fixed[index - 1];
+    }
+    return table[index - static_size - 1];
+}
+
+void cppai::hpack_decoder::insert(hpack_field field) {
+    table_size += entry_size(field.name, field.value);
+    table.push_front(std::move(field));
+    evict();
+}
+
+void cppai::hpack_decoder::evict() {
+    while (table_size > capacity) {
+        table_size -= entry_size(table.back().name, table.back().value);
+        table.pop_back();
+    }
+}
+
+cppai::hpack_encoder::hpack_encoder(std::size_t max_table_size) : capacity{ max_table_size } {
+}
+
+void cppai::hpack_encoder::set_max_table_size(std::size_t size) {
+    if (size == capacity) {
+        return;
+    }
+    capacity = size;
+    pending_update = true;
+    evict();
+}
+
+void cppai::hpack_encoder::begin_block(std::vector<unsigned char>& out) {
+    if (pending_update) {
+        encode_integer(capacity, 5, 0x20, out);
+        pending_update = false;
+    }
+}
+
+void cppai::hpack_encoder::encode(std::string_view name, std::string_view value, bool index, std::vector<unsigned char>& out) {
+    std::size_t name_index = 0;
+    for (std::size_t i = 0; i < static_size; ++i) {
+        if (static_table[i].name != name) {
+            continue;
+        }
+        if (static_table[i].value == value) {
+            encode_integer(i + 1, 7, 0x80, out);
+            return;
+        }
+        if (name_index == 0) {
+            name_index = i + 1;
+        }
+    }
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        if (table[i].name != name) {
+            continue;
+        }
+        if (table[i].value == value) {
+            encode_integer(static_size + i + 1, 7, 0x80, out);
+            return;
+        }
+        if (name_index == 0) {
+            name_index = static_size + i + 1;
+        }
+    }
+
+    encode_integer(name_index, index ? 6 : 4, index ? 0x40 : 0x00, out);
+    if (name_index == 0) {
+        encode_string(name, out);
+    }
+    encode_string(value, out);
+
+    if (index) {
+        table_size += entry_size(name, value);
+        table.push_front(hpack_field{ std::string{ name }, std::string{ value } });
+        evict();
+    }
+}
+
+void cppai::hpack_encoder::evict() {
+    while (table_size > capacity) {
+        table_size -= entry_size(table.back().name, table.back().value);
+        table.pop_back();
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef CPPAI_HPACK_H
+#define CPPAI_HPACK_H
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppai {
+    struct hpack_field {
+        std::string name;
+        std::string value;
+    };
+
+    // HPACK (RFC 7541) header block decoder with its own dynamic table. Every header block received on a
+    // connection must pass through the same decoder, in order. Malformed blocks throw system_error.
+    class hpack_decoder {
+    public:
+        explicit hpack_decoder(std::size_t max_table_size = 4096);
+
+        void decode(std::span<const unsigned char> block, std::vector<hpack_field>& out);
+
+    private:
+        std::deque<hpack_field> table;
+        std::size_t table_size = 0;
+        std::size_t capacity;
+        std::size_t limit;
+
+        const hpack_field& lookup(std::uint64_t index) const;
+
+        void insert(hpack_field field);
+
+        void evict();
+    };
+
+    // Encoder side. Fields sent with indexing enter the dynamic table, so a header repeated on every request
+    // (authorization, organization, user agent) shrinks to a single byte after its first use.
+    class hpack_encoder {
+    public:
+        explicit hpack_encoder(std::size_t max_table_size = 4096);
+
+        void set_max_table_size(std::size_t size);
+
+        void begin_block(std::vector<unsigned char>& out);
+
+        void encode(std::string_view name, std::string_view value, bool index, std::vector<unsigned char>& out);
+
+    private:
+        std::deque<hpack_field> table;
+        std::size_t table_size = 0;
+        std::size_t capacity;
+        bool pending_update = false;
+
+        void evict();
+    };
+}
+
+#endif
@@ -0,0 +1,785 @@
+#include "http2.h"
+#include "compression.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace {
+    enum : std::uint8_t {
+        frame_data = 0x0, frame_headers = 0x1, frame_priority = 0x2, frame_rst_stream = 0x3, frame_settings = 0x4,
+        frame_push_promise = 0x5, frame_ping = 0x6, frame_goaway = 0x7, frame_window_update = 0x8, frame_continuation = 0x9
+    };
+
+    enum : std::uint8_t {
+        flag_end_stream = 0x1, flag_ack = 0x1, flag_end_headers = 0x4, flag_padded = 0x8, flag_priority = 0x20
+    };
+
+    enum : std::uint16_t {
+        setting_header_table_size = 0x1, setting_enable_push = 0x2, setting_max_concurrent_streams = 0x3,
+        setting_initial_window_size = 0x4, setting_max_frame_size = 0x5, setting_max_header_list_size = 0x6
+    };
+
+    constexpr std::string_view client_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+    constexpr std::size_t frame_header_size = 9;
+
+    // Receive windows are large enough that an embedding batch never stalls waiting for WINDOW_UPDATE.
+    constexpr std::uint32_t local_stream_window = 16 * 1024 * 1024;
+    constexpr std::uint32_t local_connection_window = 64 * 1024 * 1024;
+    constexpr std::uint32_t default_window = 65535;
+
+    constexpr std::size_t local_max_frame = 16384;
+
+    // Caps a header block both as received across CONTINUATION frames and once decoded.
+    constexpr std::uint32_t local_max_header_list = 64 * 1024;
+
+    // Writers stop producing DATA frames while this much is queued for the socket.
+    constexpr std::size_t outbox_limit = 256 * 1024;
+
+    constexpr std::uint32_t error_cancel = 0x8;
+    constexpr std::uint32_t error_enhance_your_calm = 0xb;
+
+    std::uint32_t read_u32(const unsigned char* at) {
+        return (std::uint32_t{ at[0] } << 24) | (std::uint32_t{ at[1] } << 16) | (std::uint32_t{ at[2] } << 8) | at[3];
+    }
+
+    void write_u32(unsigned char* at, std::uint32_t value) {
+        at[0] = static_cast<unsigned char>(value >> 24);
+        at[1] = static_cast<unsigned char>(value >> 16);
+        at[2] = static_cast<unsigned char>(value >> 8);
+        at[3] = static_cast<unsigned char>(value);
+    }
+
+    [[noreturn]] void protocol_violation(const char* what) {
+        throw boost::system::system_error(boost::system::errc::make_error_code(boost::system::errc::protocol_error), what);
+    }
+
+    // Strips the pad length octet and trailing padding of a PADDED frame.
+    std::pair<std::size_t, std::size_t> unpadded(std::uint8_t flags, const unsigned char* payload, std::size_t length) {
+        if ((flags & flag_padded) == 0) {
+            return { 0, length };
+        }
+        if (length == 0 || std::size_t{ payload[0] } + 1 > length) {
+            protocol_violation("HTTP/2 padding exceeds frame");
+        }
+        return { 1, length - 1 - payload[0] };
+    }
+}
+
+struct cppai::h2_session::stream {
+    std::uint32_t id = 0;
+    boost::asio::steady_timer signal;
+    h2_response response;
+    std::int64_t send_window = 0;
+    std::size_t received_unacked = 0;
+    bool headers_done = false;
+    bool ended = false;
+    // Closed by the peer's RST_STREAM, which must not be answered with one (RFC 7540 section 5.4.2).
+    bool reset = false;
+    bool released = false;
+    boost::system::error_code error;
+    // Set when the response is gzip-encoded; DATA is inflated into the body as it arrives.
+    std::optional<gzip_inflater> inflater;
+
+    explicit stream(const strand_type& strand) : signal{ strand } {}
+};
+
+cppai::h2_session::h2_session(std::unique_ptr<connection_pool::connection> conn)
+    : conn{ std::move(conn) }, session_strand{ boost::asio::any_io_executor{ this->conn->stream.get_executor() } },
+    writer_signal{ session_strand } {
+}
+
+cppai::h2_session::~h2_session() = default;
+
+void cppai::h2_session::start() {
+    boost::asio::co_spawn(session_strand, run(shared_from_this()), boost::asio::detached);
+}
+
+void cppai::h2_session::close() {
+    boost::asio::post(session_strand, [self = shared_from_this()]() {
+        self->fail(boost::asio::error::operation_aborted);
+    });
+}
+
+const cppai::h2_session::strand_type& cppai::h2_session::strand() const {
+    return session_strand;
+}
+
+bool cppai::h2_session::usable() const {
+    return open_flag.load(std::memory_order_acquire);
+}
+
+std::size_t cppai::h2_session::active_streams() const {
+    return active.load(std::memory_order_relaxed);
+}
+
+std::size_t cppai::h2_session::max_streams() const {
+    return peer_max_streams.load(std::memory_order_relaxed);
+}
+
+boost::asio::awaitable<std::shared_ptr<cppai::h2_session::stream>> cppai::h2_session::open(std::chrono::steady_clock::time_point deadline) {
+    auto opened = std::make_shared<stream>(session_strand);
+    for (;;) {
+        if (failure || !usable()) {
+            throw boost::system::system_error(failure ? failure : boost::asio::error::connection_aborted);
+        }
+        if (active.load(std::memory_order_relaxed) < max_streams() && next_stream_id < 0x7fffffff) {
+            break;
+        }
+        co_await wait(opened, deadline, true);
+    }
+    active.fetch_add(1, std::memory_order_relaxed);
+    co_return opened;
+}
+
+void cppai::h2_session::send_headers(const std::shared_ptr<stream>& target, const boost::beast::http::request_header<pooled_fields>& header,
+    bool end_stream) {
+    // Stream ids must reach the wire in increasing order, so the id is taken in the same step that queues HEADERS.
+    target->id = next_stream_id;
+    next_stream_id += 2;
+    target->send_window = peer_initial_window;
+    streams.emplace(target->id, target);
+
+    std::vector<unsigned char> block;
+    encoder.begin_block(block);
+    const auto method = header.method_string();
+    const auto authority = header[boost::beast::http::field::host];
+    const auto path = header.target();
+    encoder.encode(":method", std::string_view{ method.data(), method.size() }, true, block);
+    encoder.encode(":scheme", "https", true, block);
+    encoder.encode(":authority", std::string_view{ authority.data(), authority.size() }, true, block);
+    encoder.encode(":path", std::string_view{ path.data(), path.size() }, true, block);
+
+    std::string name;
+    for (const auto& field : header) {
+        switch (field.name()) {
+        case boost::beast::http::field::host:
+        case boost::beast::http::field::connection:
+        case boost::beast::http::field::keep_alive:
+        case boost::beast::http::field::proxy_connection:
+        case boost::beast::http::field::transfer_encoding:
+        case boost::beast::http::field::upgrade:
+        case boost::beast::http::field::te:
+            continue;
+        default:
+            break;
+        }
+        const auto field_name = field.name_string();
+        const auto value = field.value();
+        name.assign(field_name.data(), field_name.size());
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        // Authorization and the other fixed headers are indexed once and cost one byte per request afterwards;
+        // content-length changes every time and would only churn the table.
+        encoder.encode(name, std::string_view{ value.data(), value.size() }, field.name() != boost::beast::http::field::content_length, block);
+    }
+
+    std::size_t offset = 0;
+    do {
+        const std::size_t size = std::min(block.size() - offset, peer_max_frame);
+        const bool first = offset == 0;
+        const bool last = offset + size == block.size();
+        const std::uint8_t flags = static_cast<std::uint8_t>((last ? flag_end_headers : 0) | (first && end_stream ? flag_end_stream : 0));
+        queue_frame(first ? frame_headers : frame_continuation, flags, target->id, block.data() + offset, size);
+        offset += size;
+    } while (offset < block.size());
+}
+
+boost::asio::awaitable<void> cppai::h2_session::send_data(std::shared_ptr<stream> target, boost::asio::const_buffer data,
+    std::chrono::steady_clock::time_point deadline) {
+    const auto* at = static_cast<const unsigned char*>(data.data());
+    std::size_t remaining = data.size();
+    while (remaining > 0) {
+        check(*target);
+        const std::int64_t window = std::min(send_window, target->send_window);
+        if (window <= 0 || outbox_bytes >= outbox_limit) {
+            co_await wait(target, deadline, true);
+            continue;
+        }
+        const std::size_t size = std::min({ remaining, static_cast<std::size_t>(window), peer_max_frame });
+        queue_frame(frame_data, 0, target->id, at, size);
+        send_window -= static_cast<std::int64_t>(size);
+        target->send_window -= static_cast<std::int64_t>(size);
+        at += size;
+        remaining -= size;
+    }
+}
+
+void cppai::h2_session::end_stream(stream& target) {
+    check(target);
+    queue_frame(frame_data, flag_end_stream, target.id, nullptr, 0);
+}
+
+boost::asio::awaitable<cppai::h2_response> cppai::h2_session::receive(std::shared_ptr<stream> target,
+    std::chrono::steady_clock::time_point deadline, request_trace* trace) {
+    const auto sent = std::chrono::steady_clock::now();
+    while (!target->headers_done && !target->ended) {
+        check(*target);
+        co_await wait(target, deadline, false);
+    }
+    const auto headers = std::chrono::steady_clock::now();
+    while (!target->ended) {
+        check(*target);
+        co_await wait(target, deadline, false);
+    }
+    if (!target->headers_done) {
+        protocol_violation("HTTP/2 stream ended without a response");
+    }
+    if (trace != nullptr) {
+        trace->record(phase::first_byte, headers - sent);
+        trace->record(phase::body, std::chrono::steady_clock::now() - headers);
+    }
+    h2_response response = std::move(target->response);
+    release(*target);
+    co_return response;
+}
+
+void cppai::h2_session::abandon(stream& target) {
+    if (target.released) {
+        return;
+    }
+    if (target.id != 0 && !target.ended && !target.reset && !failure) {
+        unsigned char payload[4];
+        write_u32(payload, error_cancel);
+        queue_frame(frame_rst_stream, 0, target.id, payload, sizeof(payload));
+    }
+    release(target);
+}
+
+void cppai::h2_session::release(stream& target) {
+    if (target.released) {
+        return;
+    }
+    target.released = true;
+    if (target.id != 0) {
+        streams.erase(target.id);
+    }
+    active.fetch_sub(1, std::memory_order_relaxed);
+    wake_blocked();
+    if (!usable() && streams.empty() && !failure) {
+        // GOAWAY was received and the last stream it allowed has finished.
+        fail(boost::asio::error::shut_down);
+    }
+}
+
+void cppai::h2_session::check(const stream& target) const {
+    if (target.error) {
+        throw boost::system::system_error(target.error);
+    }
+    if (failure && !target.ended) {
+        throw boost::system::system_error(failure);
+    }
+}
+
+boost::asio::awaitable<void> cppai::h2_session::wait(const std::shared_ptr<stream>& target, std::chrono::steady_clock::time_point deadline,
+    bool session_wide) {
+    // Wakers cancel the stream's timer; running into the deadline instead means the call timed out.
+    if (session_wide) {
+        blocked.push_back(target);
+    }
+    target->signal.expires_at(deadline);
+    const auto [error_code] = co_await target->signal.async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+    if (!error_code) {
+        throw boost::system::system_error(boost::beast::error::timeout);
+    }
+    const boost::asio::cancellation_state cancellation = co_await boost::asio::this_coro::cancellation_state;
+    if (cancellation.cancelled() != boost::asio::cancellation_type::none) {
+        throw boost::system::system_error(boost::asio::error::operation_aborted);
+    }
+}
+
+void cppai::h2_session::wake_blocked() {
+    std::vector<std::weak_ptr<stream>> woken;
+    woken.swap(blocked);
+    for (const std::weak_ptr<stream>& waiter : woken) {
+        if (const std::shared_ptr<stream> target = waiter.lock()) {
+            target->signal.cancel();
+        }
+    }
+}
+
+void cppai::h2_session::queue_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream_id, const void* payload, std::size_t size) {
+    std::vector<unsigned char> frame(frame_header_size + size);
+    frame[0] = static_cast<unsigned char>(size >> 16);
+    frame[1] = static_cast<unsigned char>(size >> 8);
+    frame[2] = static_cast<unsigned char>(size);
+    frame[3] = type;
+    frame[4] = flags;
+    write_u32(frame.data() + 5, stream_id & 0x7fffffff);
+    if (size != 0) {
+        std::memcpy(frame.data() + frame_header_size, payload, size);
+    }
+    outbox_bytes += frame.size();
+    outbox.push_back(std::move(frame));
+    writer_signal.cancel();
+}
+
+void cppai::h2_session::queue_window_update(std::uint32_t stream_id, std::size_t increment) {
+    unsigned char payload[4];
+    write_u32(payload, static_cast<std::uint32_t>(increment) & 0x7fffffff);
+    queue_frame(frame_window_update, 0, stream_id, payload, sizeof(payload));
+}
+
+boost::asio::awaitable<void> cppai::h2_session::run(std::shared_ptr<h2_session> self) {
+    std::vector<unsigned char> preface(client_preface.begin(), client_preface.end());
+    outbox_bytes += preface.size();
+    outbox.push_back(std::move(preface));
+
+    unsigned char settings[18];
+    settings[0] = 0;
+    settings[1] = setting_enable_push;
+    write_u32(settings + 2, 0);
+    settings[6] = 0;
+    settings[7] = setting_initial_window_size;
+    write_u32(settings + 8, local_stream_window);
+    settings[12] = 0;
+    settings[13] = setting_max_header_list_size;
+    write_u32(settings + 14, local_max_header_list);
+    queue_frame(frame_settings, 0, 0, settings, sizeof(settings));
+    queue_window_update(0, local_connection_window - default_window);
+
+    boost::asio::co_spawn(session_strand, write_loop(self), boost::asio::detached);
+
+    boost::beast::flat_buffer& buffer = conn->buffer;
+    try {
+        for (;;) {
+            while (buffer.size() < frame_header_size) {
+                buffer.commit(co_await conn->stream.async_read_some(buffer.prepare(64 * 1024), boost::asio::use_awaitable));
+            }
+            const auto* head = static_cast<const unsigned char*>(buffer.data().data());
+            const frame_header header{ (std::uint32_t{ head[0] } << 16) | (std::uint32_t{ head[1] } << 8) | head[2], head[3], head[4],
+                read_u32(head + 5) & 0x7fffffff };
+            if (header.length > local_max_frame) {
+                protocol_violation("HTTP/2 frame exceeds SETTINGS_MAX_FRAME_SIZE");
+            }
+            while (buffer.size() < frame_header_size + header.length) {
+                buffer.commit(co_await conn->stream.async_read_some(buffer.prepare(64 * 1024), boost::asio::use_awaitable));
+            }
+            handle_frame(header, static_cast<const unsigned char*>(buffer.data().data()) + frame_header_size);
+            buffer.consume(frame_header_size + header.length);
+        }
+    }
+    catch (const boost::system::system_error& e) {
+        if (goaway_error == 0) {
+            fail(e.code());
+            co_return;
+        }
+        // The writer closes the connection once the GOAWAY saying why has gone out.
+        open_flag.store(false, std::memory_order_release);
+        unsigned char payload[8];
+        write_u32(payload, 0);
+        write_u32(payload + 4, goaway_error);
+        queue_frame(frame_goaway, 0, 0, payload, sizeof(payload));
+        closing = e.code();
+    }
+}
+
+boost::asio::awaitable<void> cppai::h2_session::write_loop(std::shared_ptr<h2_session> self) {
+    std::vector<std::vector<unsigned char>> batch;
+    std::vector<boost::asio::const_buffer> buffers;
+    while (!failure) {
+        if (outbox.empty()) {
+            if (closing) {
+                fail(closing);
+                co_return;
+            }
+            writer_signal.expires_at(std::chrono::steady_clock::time_point::max());
+            co_await writer_signal.async_wait(boost::asio::as_tuple(boost::asio::use_awaitable));
+            continue;
+        }
+
+        // Everything queued since the last write goes out as one TLS write.
+        batch.clear();
+        buffers.clear();
+        std::size_t batch_bytes = 0;
+        while (!outbox.empty()) {
+            batch_bytes += outbox.front().size();
+            batch.push_back(std::move(outbox.front()));
+            outbox.pop_front();
+            buffers.emplace_back(batch.back().data(), batch.back().size());
+        }
+        const auto [error_code, written] = co_await boost::asio::async_write(conn->stream, buffers,
+            boost::asio::as_tuple(boost::asio::use_awaitable));
+        outbox_bytes -= batch_bytes;
+        if (error_code) {
+            fail(error_code);
+            co_return;
+        }
+        wake_blocked();
+    }
+}
+
+void cppai::h2_session::handle_frame(const frame_header& header, const unsigned char* payload) {
+    if (header_stream != 0 && header.type != frame_continuation) {
+        protocol_violation("HTTP/2 header block interrupted");
+    }
+
+    switch (header.type) {
+    case frame_data:
+        handle_data(header, payload);
+        break;
+    case frame_headers: {
+        if (header.stream_id == 0) {
+            protocol_violation("HTTP/2 HEADERS on stream 0");
+        }
+        auto [offset, size] = unpadded(header.flags, payload, header.length);
+        if (header.flags & flag_priority) {
+            if (size < 5) {
+                protocol_violation("HTTP/2 HEADERS priority truncated");
+            }
+            offset += 5;
+            size -= 5;
+        }
+        if (size > local_max_header_list) {
+            calm_down("HTTP/2 header block too large");
+        }
+        header_fragment.assign(payload + offset, payload + offset + size);
+        header_stream = header.stream_id;
+        header_end_stream = (header.flags & flag_end_stream) != 0;
+        if (header.flags & flag_end_headers) {
+            finish_headers();
+        }
+        break;
+    }
+    case frame_continuation:
+        if (header.stream_id != header_stream || header_stream == 0) {
+            protocol_violation("HTTP/2 unexpected CONTINUATION");
+        }
+        if (header_fragment.size() + header.length > local_max_header_list) {
+            calm_down("HTTP/2 header block too large");
+        }
+        header_fragment.insert(header_fragment.end(), payload, payload + header.length);
+        if (header.flags & flag_end_headers) {
+            finish_headers();
+        }
+        break;
+    case frame_rst_stream: {
+        if (header.length != 4) {
+            protocol_violation("HTTP/2 RST_STREAM size");
+        }
+        // REFUSED_STREAM and the rest surface as connection_reset, which the retry policy treats as a transport error.
+        if (const auto found = streams.find(header.stream_id); found != streams.end()) {
+            found->second->error = boost::asio::error::connection_reset;
+            found->second->reset = true;
+            found->second->signal.cancel();
+        }
+        break;
+    }
+    case frame_settings:
+        handle_settings(header, payload);
+        break;
+    case frame_push_promise:
+        protocol_violation("HTTP/2 PUSH_PROMISE with push disabled");
+    case frame_ping:
+        if (header.length != 8) {
+            protocol_violation("HTTP/2 PING size");
+        }
+        if ((header.flags & flag_ack) == 0) {
+            queue_frame(frame_ping, flag_ack, 0, payload, 8);
+        }
+        break;
+    case frame_goaway: {
+        if (header.length < 8) {
+            protocol_violation("HTTP/2 GOAWAY size");
+        }
+        // Streams above last_stream_id were never processed and are safe to send again elsewhere.
+        const std::uint32_t last_stream_id = read_u32(payload) & 0x7fffffff;
+        open_flag.store(false, std::memory_order_release);
+        for (auto& [id, target] : streams) {
+            if (id > last_stream_id) {
+                target->error = boost::asio::error::connection_reset;
+                target->signal.cancel();
+            }
+        }
+        wake_blocked();
+        if (streams.empty()) {
+            fail(boost::asio::error::shut_down);
+        }
+        break;
+    }
+    case frame_window_update: {
+        if (header.length != 4) {
+            protocol_violation("HTTP/2 WINDOW_UPDATE size");
+        }
+        const std::uint32_t increment = read_u32(payload) & 0x7fffffff;
+        if (header.stream_id == 0) {
+            send_window += increment;
+            wake_blocked();
+        }
+        else if (const auto found = streams.find(header.stream_id); found != streams.end()) {
+            found->second->send_window += increment;
+            found->second->signal.cancel();
+        }
+        break;
+    }
+    default:
+        // PRIORITY and unknown frame types carry nothing a client needs.
+        break;
+    }
+}
+
+void cppai::h2_session::handle_data(const frame_header& header, const unsigned char* payload) {
+    if (header.stream_id == 0) {
+        protocol_violation("HTTP/2 DATA on stream 0");
+    }
+    const auto [offset, size] = unpadded(header.flags, payload, header.length);
+
+    // Padding counts against flow control too. Bodies are buffered as they arrive, so credit is returned at once.
+    received_unacked += header.length;
+    if (received_unacked >= local_connection_window / 2) {
+        queue_window_update(0, received_unacked);
+        received_unacked = 0;
+    }
+
+    const auto found = streams.find(header.stream_id);
+    if (found == streams.end()) {
+        return;
+    }
+    stream& target = *found->second;
+    if (target.inflater && !target.error) {
+        try {
+            target.inflater->write(std::string_view{ reinterpret_cast<const char*>(payload + offset), size }, target.response.body);
+            if (header.flags & flag_end_stream) {
+                target.inflater->finish();
+            }
+        }
+        catch (const boost::system::system_error& e) {
+            target.error = e.code();
+            target.signal.cancel();
+        }
+    }
+    else if (!target.inflater) {
+        auto buffer = target.response.body.prepare(size);
+        if (size != 0) {
+            std::memcpy(buffer.data(), payload + offset, size);
+        }
+        target.response.body.commit(size);
+    }
+
+    if (header.flags & flag_end_stream) {
+        target.ended = true;
+        target.signal.cancel();
+        return;
+    }
+    target.received_unacked += header.length;
+    if (target.received_unacked >= local_stream_window / 2) {
+        queue_window_update(target.id, target.received_unacked);
+        target.received_unacked = 0;
+    }
+}
+
+void cppai::h2_session::handle_settings(const frame_header& header, const unsigned char* payload) {
+    if (header.stream_id != 0 || header.length % 6 != 0) {
+        protocol_violation("HTTP/2 SETTINGS malformed");
+    }
+    if (header.flags & flag_ack) {
+        return;
+    }
+    for (std::size_t at = 0; at < header.length; at += 6) {
+        const std::uint16_t id = static_cast<std::uint16_t>((payload[at] << 8) | payload[at + 1]);
+        const std::uint32_t value = read_u32(payload + at + 2);
+        switch (id) {
+        case setting_header_table_size:
+            encoder.set_max_table_size(std::min<std::size_t>(value, 4096));
+            break;
+        case setting_max_concurrent_streams:
+            peer_max_streams.store(value, std::memory_order_relaxed);
+            break;
+        case setting_initial_window_size: {
+            if (value > 0x7fffffff) {
+                protocol_violation("HTTP/2 SETTINGS_INITIAL_WINDOW_SIZE too large");
+            }
+            const std::int64_t delta = std::int64_t{ value } - peer_initial_window;
+            peer_initial_window = value;
+            for (auto& [stream_id, target] : streams) {
+                target->send_window += delta;
+            }
+            break;
+        }
+        case setting_max_frame_size:
+            if (value < 16384 || value > 16777215) {
+                protocol_violation("HTTP/2 SETTINGS_MAX_FRAME_SIZE out of range");
+            }
+            peer_max_frame = value;
+            break;
+        default:
+            break;
+        }
+    }
+    queue_frame(frame_settings, flag_ack, 0, nullptr, 0);
+    wake_blocked();
+}
+
+void cppai::h2_session::finish_headers() {
+    // Every block goes through the decoder, even for streams already given up on, to keep the table in step.
+    std::vector<hpack_field> fields;
+    decoder.decode(header_fragment, fields);
+    const std::uint32_t id = header_stream;
+    header_stream = 0;
+    header_fragment.clear();
+
+    // Sized as SETTINGS_MAX_HEADER_LIST_SIZE counts it, which also catches a small block that decodes into a huge one.
+    std::size_t list_size = 0;
+    for (const hpack_field& field : fields) {
+        if (field.name.empty()) {
+            protocol_violation("HTTP/2 empty header name");
+        }
+        list_size += field.name.size() + field.value.size() + 32;
+    }
+    if (list_size > local_max_header_list) {
+        calm_down("HTTP/2 header list too large");
+    }
+
+    const auto found = streams.find(id);
+    if (found == streams.end()) {
+        return;
+    }
+    stream& target = *found->second;
+    if (!target.headers_done) {
+        std::uint32_t status = 0;
+        for (const hpack_field& field : fields) {
+            if (field.name == ":status") {
+                std::from_chars(field.value.data(), field.value.data() + field.value.size(), status);
+            }
+        }
+        if (status == 0) {
+            protocol_violation("HTTP/2 response without :status");
+        }
+        if (status < 200) {
+            return;
+        }
+        target.response.header.version(20);
+        target.response.header.result(status);
+        for (const hpack_field& field : fields) {
+            if (field.name.front() != ':') {
+                target.response.header.insert(field.name, field.value);
+            }
+        }
+        if (gzip_encoded(target.response.header)) {
+            target.inflater.emplace();
+        }
+        target.headers_done = true;
+    }
+    if (header_end_stream) {
+        target.ended = true;
+    }
+    target.signal.cancel();
+}
+
+void cppai::h2_session::calm_down(const char* what) {
+    goaway_error = error_enhance_your_calm;
+    protocol_violation(what);
+}
+
+void cppai::h2_session::fail(boost::system::error_code error_code) {
+    if (failure) {
+        return;
+    }
+    failure = error_code;
+    open_flag.store(false, std::memory_order_release);
+    for (auto& [id, target] : streams) {
+        target->signal.cancel();
+    }
+    wake_blocked();
+    writer_signal.cancel();
+    boost::system::error_code ignored;
+    boost::beast::get_lowest_layer(conn->stream).socket().close(ignored);
+}
+
+cppai::h2_pool::h2_pool(connection_pool& connections) : connections{ connections } {
+}
+
+cppai::h2_pool::~h2_pool() {
+    for (auto& [key, state] : contexts) {
+        for (const std::shared_ptr<h2_session>& session : state.sessions) {
+            session->close();
+        }
+    }
+}
+
+boost::asio::awaitable<std::shared_ptr<cppai::h2_session>> cppai::h2_pool::acquire(boost::asio::ssl::context& ctx, const std::string& host,
+    const std::string& port, const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline, request_trace* trace) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    boost::asio::execution_context& context = boost::asio::query(executor, boost::asio::execution::context);
+    const std::pair<std::string, boost::asio::execution_context*> key{ host + ':' + port, &context };
+
+    for (;;) {
+        std::shared_ptr<waiter_channel> waiter;
+        {
+            std::lock_guard lock{ mtx };
+            if (unsupported.contains(key.first)) {
+                co_return nullptr;
+            }
+            context_state& state = contexts[key];
+            std::erase_if(state.sessions, [](const std::shared_ptr<h2_session>& session) {
+                return !session->usable();
+            });
+            std::shared_ptr<h2_session> best;
+            for (const std::shared_ptr<h2_session>& session : state.sessions) {
+                if (!best || session->active_streams() < best->active_streams()) {
+                    best = session;
+                }
+            }
+            // A new session is opened only once the least loaded one has run out of stream slots.
+            const bool room = state.sessions.size() + state.connecting < max_sessions;
+            if (best && (best->active_streams() < best->max_streams() || !room)) {
+                co_return best;
+            }
+            if (room) {
+                ++state.connecting;
+                break;
+            }
+            waiter = std::make_shared<waiter_channel>(executor, 1);
+            state.waiters.push_back(waiter);
+        }
+        co_await with_deadline(waiter->async_receive(boost::asio::use_awaitable), deadline);
+    }
+
+    std::shared_ptr<h2_session> session;
+    std::exception_ptr error;
+    bool refused = false;
+    try {
+        session = std::make_shared<h2_session>(co_await connections.connect_dedicated(ctx, host, port, "h2", timeouts, deadline, trace));
+        session->start();
+    }
+    catch (const boost::system::system_error& e) {
+        error = std::current_exception();
+        refused = e.code() == boost::system::errc::protocol_not_supported;
+    }
+
+    std::lock_guard lock{ mtx };
+    context_state& state = contexts[key];
+    --state.connecting;
+    if (session) {
+        state.sessions.push_back(session);
+    }
+    wake_all(state);
+    if (refused) {
+        unsupported.insert(key.first);
+        co_return nullptr;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    co_return session;
+}
+
+std::size_t cppai::h2_pool::session_count() const {
+    std::lock_guard lock{ mtx };
+    std::size_t count = 0;
+    for (const auto& [key, state] : contexts) {
+        count += state.sessions.size();
+    }
+    return count;
+}
+
+void cppai::h2_pool::wake_all(context_state& state) {
+    for (const std::shared_ptr<waiter_channel>& waiter : state.waiters) {
+        waiter->try_send(boost::system::error_code{});
+    }
+    state.waiters.clear();
+}
@@ -0,0 +1,223 @@
+#ifndef CPPAI_HTTP2_H
+#define CPPAI_HTTP2_H
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <boost/beast.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "connection_pool.h"
+#include "hpack.h"
+#include "pooled.h"
+
+namespace cppai {
+    struct h2_response {
+        boost::beast::http::response_header<pooled_fields> header;
+        boost::beast::flat_buffer body;
+    };
+
+    // One TLS connection carrying any number of concurrent requests as HTTP/2 streams (RFC 7540). All session
+    // state belongs to the strand; callers run exchange() on it through co_spawn.
+    class h2_session : public std::enable_shared_from_this<h2_session> {
+    public:
+        using strand_type = boost::asio::strand<boost::asio::any_io_executor>;
+
+        explicit h2_session(std::unique_ptr<connection_pool::connection> conn);
+
+        ~h2_session();
+
+        h2_session(const h2_session&) = delete;
+
+        h2_session& operator=(const h2_session&) = delete;
+
+        // Sends the connection preface and starts the frame reader and writer.
+        void start();
+
+        // Fails every open stream and closes the socket.
+        void close();
+
+        const strand_type& strand() const;
+
+        // False once the connection failed or the server sent GOAWAY; streams already open run to completion.
+        bool usable() const;
+
+        std::size_t active_streams() const;
+
+        std::size_t max_streams() const;
+
+        template <class Body>
+        boost::asio::awaitable<h2_response> exchange(const api_request<Body>& request, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace = nullptr) {
+            // A coroutine started by co_spawn accepts terminal cancellation only; partial resets the stream as well.
+            co_await accept_cancellation(boost::asio::enable_partial_cancellation());
+            std::shared_ptr<stream> opened = co_await open(deadline);
+            try {
+                const phase_timer write_timer{ trace, phase::write };
+                const auto payload = request.payload_size();
+                const bool has_body = !payload || *payload != 0;
+                send_headers(opened, request.base(), !has_body);
+                if (has_body) {
+                    // Body::writer yields the same buffers http::async_write would; each becomes one or more DATA frames.
+                    typename Body::writer writer{ request.base(), request.body() };
+                    boost::beast::error_code error_code;
+                    writer.init(error_code);
+                    for (bool more = !error_code; more;) {
+                        auto chunk = writer.get(error_code);
+                        if (error_code || !chunk) {
+                            break;
+                        }
+                        for (const boost::asio::const_buffer buffer : boost::beast::buffers_range(chunk->first)) {
+                            co_await send_data(opened, buffer, deadline);
+                        }
+                        more = chunk->second;
+                    }
+                    if (error_code) {
+                        throw boost::system::system_error(error_code);
+                    }
+                    end_stream(*opened);
+                }
+            }
+            catch (...) {
+                abandon(*opened);
+                throw;
+            }
+            try {
+                co_return co_await receive(opened, deadline, trace);
+            }
+            catch (...) {
+                abandon(*opened);
+                throw;
+            }
+        }
+
+    private:
+        struct stream;
+
+        struct frame_header {
+            std::uint32_t length;
+            std::uint8_t type;
+            std::uint8_t flags;
+            std::uint32_t stream_id;
+        };
+
+        std::unique_ptr<connection_pool::connection> conn;
+        strand_type session_strand;
+        boost::asio::steady_timer writer_signal;
+        hpack_encoder encoder;
+        hpack_decoder decoder;
+
+        std::deque<std::vector<unsigned char>> outbox;
+        std::size_t outbox_bytes = 0;
+        std::unordered_map<std::uint32_t, std::shared_ptr<stream>> streams;
+        std::vector<std::weak_ptr<stream>> blocked;
+        std::uint32_t next_stream_id = 1;
+
+        std::int64_t send_window = 65535;
+        std::int64_t peer_initial_window = 65535;
+        std::size_t peer_max_frame = 16384;
+        std::size_t received_unacked = 0;
+
+        std::vector<unsigned char> header_fragment;
+        std::uint32_t header_stream = 0;
+        bool header_end_stream = false;
+
+        boost::system::error_code failure;
+        boost::system::error_code closing;
+        std::uint32_t goaway_error = 0;
+        std::atomic<bool> open_flag{ true };
+        std::atomic<std::size_t> active{ 0 };
+        std::atomic<std::size_t> peer_max_streams{ 100 };
+
+        boost::asio::awaitable<std::shared_ptr<stream>> open(std::chrono::steady_clock::time_point deadline);
+
+        void send_headers(const std::shared_ptr<stream>& target, const boost::beast::http::request_header<pooled_fields>& header, bool end_stream);
+
+        boost::asio::awaitable<void> send_data(std::shared_ptr<stream> target, boost::asio::const_buffer data,
+            std::chrono::steady_clock::time_point deadline);
+
+        void end_stream(stream& target);
+
+        boost::asio::awaitable<h2_response> receive(std::shared_ptr<stream> target, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace);
+
+        void abandon(stream& target);
+
+        void release(stream& target);
+
+        void check(const stream& target) const;
+
+        boost::asio::awaitable<void> wait(const std::shared_ptr<stream>& target, std::chrono::steady_clock::time_point deadline, bool session_wide);
+
+        void wake_blocked();
+
+        void queue_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream_id, const void* payload, std::size_t size);
+
+        void queue_window_update(std::uint32_t stream_id, std::size_t increment);
+
+        boost::asio::awaitable<void> run(std::shared_ptr<h2_session> self);
+
+        boost::asio::awaitable<void> write_loop(std::shared_ptr<h2_session> self);
+
+        void handle_frame(const frame_header& header, const unsigned char* payload);
+
+        void handle_data(const frame_header& header, const unsigned char* payload);
+
+        void handle_settings(const frame_header& header, const unsigned char* payload);
+
+        void finish_headers();
+
+        // Ends the connection as a protocol error, telling the peer ENHANCE_YOUR_CALM first.
+        [[noreturn]] void calm_down(const char* what);
+
+        void fail(boost::system::error_code error_code);
+    };
+
+    // Keeps a few h2 sessions per backend and io_context and spreads calls across them by open stream count.
+    class h2_pool {
+    public:
+        static constexpr std::size_t max_sessions = 4;
+
+        explicit h2_pool(connection_pool& connections);
+
+        ~h2_pool();
+
+        h2_pool(const h2_pool&) = delete;
+
+        h2_pool& operator=(const h2_pool&) = delete;
+
+        // Returns nullptr when the server does not speak h2, after which the caller should use HTTP/1.1 with it.
+        boost::asio::awaitable<std::shared_ptr<h2_session>> acquire(boost::asio::ssl::context& ctx, const std::string& host,
+            const std::string& port, const timeout_policy& timeouts, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace = nullptr);
+
+        std::size_t session_count() const;
+
+    private:
+        using waiter_channel = boost::asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+        struct context_state {
+            std::vector<std::shared_ptr<h2_session>> sessions;
+            std::size_t connecting = 0;
+            std::list<std::shared_ptr<waiter_channel>> waiters;
+        };
+
+        connection_pool& connections;
+        mutable std::mutex mtx;
+        std::map<std::pair<std::string, boost::asio::execution_context*>, context_state> contexts;
+        std::unordered_set<std::string> unsupported;
+
+        static void wake_all(context_state& state);
+    };
+}
+
+#endif
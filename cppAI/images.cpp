@@ -0,0 +1,446 @@
+#include "images.h"
+#include <boost/filesystem/operations.hpp>
+#include <boost/json/basic_parser_impl.hpp>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include "utility.h"
+
+namespace {
+    // Base64 handed over in pieces of any size. Whole quads are decoded straight from each piece, a slice at a
+    // time; only a quad split across pieces is copied.
+    class base64_stream {
+    public:
+        static constexpr std::size_t slice = 48 * 1024;
+
+        void begin(std::size_t image) {
+            index = image;
+            carried = 0;
+            padded = false;
+            decoded = 0;
+        }
+
+        void write(std::string_view text, const cppai::image_sink& sink) {
+            if (carried != 0) {
+                const std::size_t taken = std::min(4 - carried, text.size());
+                std::memcpy(carry + carried, text.data(), taken);
+                carried += taken;
+                text.remove_prefix(taken);
+                if (carried < 4) {
+                    return;
+                }
+                carried = 0;
+                decode(std::string_view{ carry, 4 }, sink);
+            }
+            const std::size_t whole = text.size() / 4 * 4;
+            for (std::size_t at = 0; at < whole; at += slice) {
+                decode(text.substr(at, std::min(slice, whole - at)), sink);
+            }
+            carried = text.size() - whole;
+            std::memcpy(carry, text.data() + whole, carried);
+        }
+
+        std::uint64_t finish(const cppai::image_sink& sink) {
+            if (carried != 0) {
+                decode(std::string_view{ carry, carried }, sink);
+                carried = 0;
+            }
+            return decoded;
+        }
+
+    private:
+        std::size_t index = 0;
+        char carry[4];
+        std::size_t carried = 0;
+        bool padded = false;
+        std::uint64_t decoded = 0;
+        std::vector<unsigned char> out = std::vector<unsigned char>(slice / 4 * 3);
+
+        void decode(std::string_view text, const cppai::image_sink& sink) {
+            if (padded) {
+                throw cppai::image_error("b64_json continues after its padding");
+            }
+            const std::optional<std::size_t> size = cppai::utility::base64_decode(text, out.data());
+            if (!size.has_value()) {
+                throw cppai::image_error("malformed base64 in b64_json");
+            }
+            padded = text.back() == '=';
+            decoded += size.value();
+            if (size.value() != 0) {
+                sink(index, std::string_view{ reinterpret_cast<const char*>(out.data()), size.value() });
+            }
+        }
+    };
+}
+
+struct cppai::image_extractor::state {
+    struct handler {
+        static constexpr std::size_t max_object_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_array_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_key_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_string_size = static_cast<std::size_t>(-1);
+
+        struct frame {
+            bool object;
+            std::string key;
+            std::size_t index = 0;
+            // Members left out of the metadata.
+            std::size_t skipped = 0;
+        };
+
+        image_sink sink;
+        boost::json::value_stack metadata;
+        std::vector<frame> frames;
+        std::string key_text;
+        base64_stream image;
+        std::vector<std::uint64_t> sizes;
+        std::exception_ptr error;
+        bool in_string = false;
+        bool in_image = false;
+
+        explicit handler(image_sink sink) : sink{ std::move(sink) } {
+            metadata.reset();
+        }
+
+        // The value under data[i].b64_json, whose key was held back in on_key.
+        bool image_value() const {
+            return frames.size() == 3 && frames[0].object && frames[0].key == "data" && !frames[1].object && frames[2].object
+                && frames[2].key == "b64_json";
+        }
+
+        void begin_value() {
+            if (image_value()) {
+                // Not a string after all, so it is kept like any other member.
+                metadata.push_key("b64_json");
+                --frames.back().skipped;
+            }
+        }
+
+        bool end_value() {
+            if (!frames.empty() && !frames.back().object) {
+                ++frames.back().index;
+            }
+            return true;
+        }
+
+        bool fail(boost::json::error_code& ec) {
+            error = std::current_exception();
+            ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+            return false;
+        }
+
+        bool image_part(std::string_view part, boost::json::error_code& ec) {
+            try {
+                if (!in_string) {
+                    in_string = true;
+                    in_image = image_value();
+                    if (in_image) {
+                        const std::size_t index = frames[1].index;
+                        if (sizes.size() <= index) {
+                            sizes.resize(index + 1);
+                        }
+                        image.begin(index);
+                    }
+                }
+                if (in_image) {
+                    image.write(part, sink);
+                }
+                else {
+                    metadata.push_chars(part);
+                }
+            }
+            catch (...) {
+                return fail(ec);
+            }
+            return true;
+        }
+
+        bool on_document_begin(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_document_end(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_object_begin(boost::json::error_code&) {
+            begin_value();
+            frames.push_back(frame{ true, {} });
+            return true;
+        }
+
+        bool on_object_end(std::size_t n, boost::json::error_code&) {
+            metadata.push_object(n - frames.back().skipped);
+            frames.pop_back();
+            return end_value();
+        }
+
+        bool on_array_begin(boost::json::error_code&) {
+            begin_value();
+            frames.push_back(frame{ false, {} });
+            return true;
+        }
+
+        bool on_array_end(std::size_t n, boost::json::error_code&) {
+            metadata.push_array(n);
+            frames.pop_back();
+            return end_value();
+        }
+
+        bool on_key_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            key_text.append(part.data(), part.size());
+            return true;
+        }
+
+        bool on_key(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            key_text.append(part.data(), part.size());
+            frames.back().key.swap(key_text);
+            key_text.clear();
+            if (image_value()) {
+                ++frames.back().skipped;
+            }
+            else {
+                metadata.push_key(frames.back().key);
+            }
+            return true;
+        }
+
+        bool on_string_part(boost::json::string_view part, std::size_t, boost::json::error_code& ec) {
+            return image_part(std::string_view{ part.data(), part.size() }, ec);
+        }
+
+        bool on_string(boost::json::string_view part, std::size_t, boost::json::error_code& ec) {
+            if (!image_part(std::string_view{ part.data(), part.size() }, ec)) {
+                return false;
+            }
+            in_string = false;
+            if (in_image) {
+                in_image = false;
+                try {
+                    sizes[frames[1].index] = image.finish(sink);
+                }
+                catch (...) {
+                    return fail(ec);
+                }
+            }
+            else {
+                metadata.push_string({});
+            }
+            return end_value();
+        }
+
+        bool on_number_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_int64(std::int64_t value, boost::json::string_view, boost::json::error_code&) {
+            begin_value();
+            metadata.push_int64(value);
+            return end_value();
+        }
+
+        bool on_uint64(std::uint64_t value, boost::json::string_view, boost::json::error_code&) {
+            begin_value();
+            metadata.push_uint64(value);
+            return end_value();
+        }
+
+        bool on_double(double value, boost::json::string_view, boost::json::error_code&) {
+            begin_value();
+            metadata.push_double(value);
+            return end_value();
+        }
+
+        bool on_bool(bool value, boost::json::error_code&) {
+            begin_value();
+            metadata.push_bool(value);
+            return end_value();
+        }
+
+        bool on_null(boost::json::error_code&) {
+            begin_value();
+            metadata.push_null();
+            return end_value();
+        }
+
+        bool on_comment_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_comment(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+    };
+
+    boost::json::basic_parser<handler> parser;
+
+    explicit state(image_sink sink) : parser{ boost::json::parse_options{}, std::move(sink) } {}
+
+    void check(const boost::json::error_code& error_code) {
+        if (parser.handler().error) {
+            std::rethrow_exception(parser.handler().error);
+        }
+        if (error_code) {
+            throw boost::system::system_error(error_code);
+        }
+    }
+};
+
+cppai::image_extractor::image_extractor(image_sink sink) : impl{ std::make_unique<state>(std::move(sink)) } {
+}
+
+cppai::image_extractor::~image_extractor() = default;
+
+cppai::image_extractor::image_extractor(image_extractor&& other) noexcept = default;
+
+cppai::image_extractor& cppai::image_extractor::operator=(image_extractor&& other) noexcept = default;
+
+void cppai::image_extractor::write(std::string_view chunk) {
+    boost::json::error_code error_code;
+    impl->parser.write_some(true, chunk.data(), chunk.size(), error_code);
+    impl->check(error_code);
+}
+
+boost::json::value cppai::image_extractor::finish() {
+    boost::json::error_code error_code;
+    impl->parser.write_some(false, nullptr, 0, error_code);
+    impl->check(error_code);
+    return impl->parser.handler().metadata.release();
+}
+
+const std::vector<std::uint64_t>& cppai::image_extractor::sizes() const {
+    return impl->parser.handler().sizes;
+}
+
+cppai::image_decoder::reader::reader(std::uint32_t status, const image_sink& sink) : status{ status }, extractor{ sink } {
+}
+
+void cppai::image_decoder::reader::write(std::string_view chunk) {
+    extractor.write(chunk);
+}
+
+cppai::image_result cppai::image_decoder::reader::finish() {
+    image_result result;
+    result.status = status;
+    result.metadata = extractor.finish();
+    result.sizes = extractor.sizes();
+    return result;
+}
+
+cppai::image_decoder::reader cppai::image_decoder::begin(std::uint32_t status) const {
+    return reader{ status, sink };
+}
+
+cppai::image_result cppai::image_decoder::operator()(std::uint32_t status, std::string_view body) const {
+    reader decoding = begin(status);
+    decoding.write(body);
+    return decoding.finish();
+}
+
+cppai::image_files::image_files(boost::filesystem::path directory, std::string extension)
+    : directory{ std::move(directory) }, extension{ std::move(extension) } {
+}
+
+cppai::image_files::~image_files() {
+    discard();
+}
+
+void cppai::image_files::write(std::size_t index, std::string_view bytes) {
+    if (files.size() <= index) {
+        files.resize(index + 1);
+        staged.resize(index + 1);
+    }
+    if (!files[index]) {
+        staged[index] = final_path(index);
+        staged[index] += ".tmp";
+        files[index] = std::make_unique<boost::beast::file>();
+        boost::beast::error_code error_code;
+        files[index]->open(staged[index].string().c_str(), boost::beast::file_mode::write, error_code);
+        if (error_code) {
+            files[index].reset();
+            throw boost::system::system_error(error_code, staged[index].string());
+        }
+    }
+    while (!bytes.empty()) {
+        boost::beast::error_code error_code;
+        bytes.remove_prefix(files[index]->write(bytes.data(), bytes.size(), error_code));
+        if (error_code) {
+            throw boost::system::system_error(error_code, staged[index].string());
+        }
+    }
+}
+
+std::vector<boost::filesystem::path> cppai::image_files::commit() {
+    // Every image is closed before the first rename, so a failed flush leaves the directory as it was.
+    for (std::size_t index = 0; index < files.size(); ++index) {
+        if (!files[index]) {
+            continue;
+        }
+        boost::beast::error_code error_code;
+        files[index]->close(error_code);
+        if (error_code) {
+            throw boost::system::system_error(error_code, staged[index].string());
+        }
+    }
+
+    // Files being replaced are moved aside until every rename has succeeded, so a failure can put them back.
+    std::vector<boost::filesystem::path> written;
+    std::vector<boost::filesystem::path> set_aside(files.size());
+    std::vector<std::size_t> renamed;
+    try {
+        for (std::size_t index = 0; index < files.size(); ++index) {
+            if (!files[index]) {
+                continue;
+            }
+            const boost::filesystem::path target = final_path(index);
+            if (boost::filesystem::exists(target)) {
+                const boost::filesystem::path aside = directory / boost::filesystem::unique_path(target.filename().string() + "-%%%%-%%%%.old");
+                boost::filesystem::rename(target, aside);
+                set_aside[index] = aside;
+            }
+            boost::filesystem::rename(staged[index], target);
+            renamed.push_back(index);
+            written.push_back(target);
+        }
+    }
+    catch (...) {
+        // Staged files go back under their .tmp names, where discard removes them.
+        boost::system::error_code ignored;
+        for (auto index = renamed.rbegin(); index != renamed.rend(); ++index) {
+            boost::filesystem::rename(final_path(*index), staged[*index], ignored);
+        }
+        for (std::size_t index = 0; index < set_aside.size(); ++index) {
+            if (!set_aside[index].empty()) {
+                boost::filesystem::rename(set_aside[index], final_path(index), ignored);
+            }
+        }
+        throw;
+    }
+
+    boost::system::error_code ignored;
+    for (const boost::filesystem::path& aside : set_aside) {
+        if (!aside.empty()) {
+            boost::filesystem::remove(aside, ignored);
+        }
+    }
+    for (std::unique_ptr<boost::beast::file>& file : files) {
+        file.reset();
+    }
+    return written;
+}
+
+void cppai::image_files::discard() noexcept {
+    for (std::size_t index = 0; index < files.size(); ++index) {
+        if (!files[index]) {
+            continue;
+        }
+        boost::beast::error_code error_code;
+        files[index]->close(error_code);
+        files[index].reset();
+        boost::filesystem::remove(staged[index], error_code);
+    }
+}
+
+boost::filesystem::path cppai::image_files::final_path(std::size_t index) const {
+    return directory / ("image-" + std::to_string(index) + extension);
+}
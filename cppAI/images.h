@@ -0,0 +1,112 @@
+#ifndef CPPAI_IMAGES_H
+#define CPPAI_IMAGES_H
+#include <boost/beast/core/file.hpp>
+#include <boost/json.hpp>
+#include <boost/nowide/filesystem.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppai {
+    // Receives each image's decoded bytes in order as they come off the socket. index is the image's position
+    // in the response's data array; throwing stops the call.
+    using image_sink = std::function<void(std::size_t index, std::string_view bytes)>;
+
+    struct image_result {
+        std::uint32_t status = 0;
+        // The response without its b64_json values, e.g. created and each image's revised_prompt; an error
+        // status leaves the error document whole.
+        boost::json::value metadata;
+        // Decoded bytes handed to the sink per image.
+        std::vector<std::uint64_t> sizes;
+        // With the directory overloads, the file each image went to.
+        std::vector<boost::filesystem::path> files;
+    };
+
+    class image_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Parses an image response while it arrives, building the metadata and decoding every b64_json string
+    // into the sink a piece at a time, so no image is ever held whole, encoded or decoded.
+    class image_extractor {
+    public:
+        explicit image_extractor(image_sink sink);
+
+        ~image_extractor();
+
+        image_extractor(image_extractor&& other) noexcept;
+
+        image_extractor& operator=(image_extractor&& other) noexcept;
+
+        void write(std::string_view chunk);
+
+        // Throws when the document or an image stopped short.
+        boost::json::value finish();
+
+        const std::vector<std::uint64_t>& sizes() const;
+
+    private:
+        struct state;
+
+        std::unique_ptr<state> impl;
+    };
+
+    // Unlike the other decoders, begin() lets it see the body while it is read; a body that arrives whole,
+    // e.g. over HTTP/2, goes through operator().
+    struct image_decoder {
+        using result_type = image_result;
+
+        class reader {
+        public:
+            reader(std::uint32_t status, const image_sink& sink);
+
+            void write(std::string_view chunk);
+
+            image_result finish();
+
+        private:
+            std::uint32_t status;
+            image_extractor extractor;
+        };
+
+        image_sink sink;
+
+        reader begin(std::uint32_t status) const;
+
+        result_type operator()(std::uint32_t status, std::string_view body) const;
+    };
+
+    // Writes image i to directory/image-<i><extension>, opening each file when its first bytes arrive. Images
+    // are written under a .tmp name and only renamed by commit, so a failed call neither leaves partial images
+    // behind nor replaces files already in the directory; anything not committed is removed on destruction.
+    class image_files {
+    public:
+        image_files(boost::filesystem::path directory, std::string extension);
+
+        ~image_files();
+
+        void write(std::size_t index, std::string_view bytes);
+
+        // Moves every image to its final name and returns those names. Either all of them land or, on an error,
+        // none do and any files they were replacing are restored.
+        std::vector<boost::filesystem::path> commit();
+
+        void discard() noexcept;
+
+    private:
+        boost::filesystem::path directory;
+        std::string extension;
+        std::vector<std::unique_ptr<boost::beast::file>> files;
+        std::vector<boost::filesystem::path> staged;
+
+        boost::filesystem::path final_path(std::size_t index) const;
+    };
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+namespace {
+    // Written only by the owning thread, so a relaxed load and store replaces a locked increment. Readers on
+    // other threads may see a slightly stale value, never a torn one.
+    struct cell {
+        std::atomic<std::uint64_t> value{ 0 };
+
+        void add(std::uint64_t n) {
+            value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        std::uint64_t load() const {
+            return value.load(std::memory_order_relaxed);
+        }
+    };
+
+    struct histogram_cells {
+        std::array<cell, cppai::histogram_snapshot::bucket_count> buckets;
+        cell count;
+        cell sum;
+
+        void record(std::chrono::nanoseconds elapsed) {
+            const auto micros = static_cast<std::uint64_t>(std::max<std::int64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), 0));
+            buckets[cppai::histogram_snapshot::bucket_of(micros)].add(1);
+            count.add(1);
+            sum.add(micros);
+        }
+
+        void read_into(cppai::histogram_snapshot& out) const {
+            for (std::size_t i = 0; i < buckets.size(); ++i) {
+                out.buckets[i] += buckets[i].load();
+            }
+            out.count += count.load();
+            out.sum += sum.load();
+        }
+    };
+
+    constexpr std::uint32_t max_status = 600;
+
+    struct endpoint_cells {
+        std::array<histogram_cells, cppai::phase_count> phases;
+        cell requests;
+        cell retries;
+        cell transport_errors;
+        cell bytes_out;
+        cell bytes_in;
+        std::array<cell, max_status> statuses;
+    };
+
+    std::atomic<std::uint64_t> next_metrics_id{ 1 };
+
+    constexpr std::array<std::string_view, cppai::phase_count> phase_names = {
+        "resolve", "connect", "handshake", "write", "first_byte", "body", "decode", "total"
+    };
+
+    constexpr double bucket_bounds[] = {
+        0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0, 120.0, 300.0
+    };
+
+    void append_labels(std::string& out, std::string_view target, std::string_view extra_name = {}, std::string_view extra_value = {}) {
+        out += "{target=\"";
+        for (const char c : target) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        out += '"';
+        if (!extra_name.empty()) {
+            out += ',';
+            out += extra_name;
+            out += "=\"";
+            out += extra_value;
+            out += '"';
+        }
+        out += '}';
+    }
+
+    void append_counter(std::string& out, const cppai::metrics_snapshot& snapshot, std::string_view prefix, std::string_view name,
+        std::string_view help, std::uint64_t cppai::endpoint_snapshot::* field) {
+        const std::string family = std::string{ prefix } + '_' + std::string{ name };
+        out += "# HELP " + family + ' ' + std::string{ help } + '\n';
+        out += "# TYPE " + family + " counter\n";
+        for (const auto& [target, endpoint] : snapshot) {
+            out += family;
+            append_labels(out, target);
+            out += ' ' + std::to_string(endpoint.*field) + '\n';
+        }
+    }
+}
+
+struct cppai::metrics::shard {
+    // Guards the shape of the map against snapshot(). The owning thread only takes it to add a new endpoint.
+    mutable std::mutex mtx;
+    std::map<std::string, std::unique_ptr<endpoint_cells>, std::less<>> endpoints;
+};
+
+struct cppai::metrics::state {
+    std::uint64_t id = next_metrics_id.fetch_add(1, std::memory_order_relaxed);
+    span_callback on_span;
+    mutable std::mutex mtx;
+    std::vector<std::unique_ptr<shard>> shards;
+};
+
+std::string_view cppai::phase_name(phase p) {
+    return phase_names[static_cast<std::size_t>(p)];
+}
+
+void cppai::histogram_snapshot::merge(const histogram_snapshot& other) {
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+}
+
+std::chrono::microseconds cppai::histogram_snapshot::quantile(double q) const {
+    if (count == 0) {
+        return std::chrono::microseconds::zero();
+    }
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::chrono::microseconds{ upper_bound(i) };
+        }
+    }
+    return std::chrono::microseconds{ upper_bound(bucket_count - 1) };
+}
+
+std::size_t cppai::histogram_snapshot::bucket_of(std::uint64_t micros) {
+    if (micros < 32) {
+        return static_cast<std::size_t>(micros);
+    }
+    const auto shift = static_cast<std::size_t>(std::bit_width(micros) - 5);
+    const std::size_t bucket = 32 + (shift - 1) * 16 + static_cast<std::size_t>((micros >> shift) - 16);
+    return std::min(bucket, bucket_count - 1);
+}
+
+std::uint64_t cppai::histogram_snapshot::upper_bound(std::size_t bucket) {
+    if (bucket < 32) {
+        return bucket;
+    }
+    const std::size_t shift = (bucket - 32) / 16 + 1;
+    const std::uint64_t mantissa = (bucket - 32) % 16 + 16;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void cppai::request_trace::record(phase p, std::chrono::steady_clock::duration elapsed) {
+    phases[static_cast<std::size_t>(p)] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+    recorded |= static_cast<std::uint16_t>(1u << static_cast<unsigned>(p));
+}
+
+bool cppai::request_trace::has(phase p) const {
+    return (recorded & (1u << static_cast<unsigned>(p))) != 0;
+}
+
+cppai::metrics::metrics() : impl{ std::make_unique<state>() } {
+}
+
+cppai::metrics::~metrics() = default;
+
+void cppai::metrics::set_span_callback(span_callback callback) {
+    impl->on_span = std::move(callback);
+}
+
+void cppai::metrics::record(std::string_view target, std::string_view method, const request_trace& trace, std::uint32_t status,
+    std::uint16_t attempt, boost::system::error_code error) {
+    thread_local std::string label_buffer;
+    const std::string_view endpoint_label = label(target, label_buffer);
+
+    shard& local = local_shard();
+    auto found = local.endpoints.find(endpoint_label);
+    if (found == local.endpoints.end()) {
+        std::lock_guard lock{ local.mtx };
+        found = local.endpoints.emplace(std::string{ endpoint_label }, std::make_unique<endpoint_cells>()).first;
+    }
+    endpoint_cells& cells = *found->second;
+
+    cells.requests.add(1);
+    cells.bytes_out.add(trace.bytes_out);
+    cells.bytes_in.add(trace.bytes_in);
+    if (status != 0) {
+        cells.statuses[std::min(status, max_status - 1)].add(1);
+    }
+    else if (error) {
+        cells.transport_errors.add(1);
+    }
+    for (std::size_t p = 0; p < phase_count; ++p) {
+        if (trace.has(static_cast<phase>(p))) {
+            cells.phases[p].record(trace.phases[p]);
+        }
+    }
+
+    if (impl->on_span) {
+        request_span span;
+        span.target = endpoint_label;
+        span.method = method;
+        span.start = trace.start;
+        for (std::size_t p = 0; p < phase_count; ++p) {
+            if (trace.has(static_cast<phase>(p))) {
+                span.phases[p] = trace.phases[p];
+            }
+        }
+        span.status = status;
+        span.attempt = attempt;
+        span.bytes_out = trace.bytes_out;
+        span.bytes_in = trace.bytes_in;
+        span.error = error;
+        impl->on_span(span);
+    }
+}
+
+void cppai::metrics::record_retry(std::string_view target) {
+    thread_local std::string label_buffer;
+    const std::string_view endpoint_label = label(target, label_buffer);
+
+    shard& local = local_shard();
+    auto found = local.endpoints.find(endpoint_label);
+    if (found == local.endpoints.end()) {
+        std::lock_guard lock{ local.mtx };
+        found = local.endpoints.emplace(std::string{ endpoint_label }, std::make_unique<endpoint_cells>()).first;
+    }
+    found->second->retries.add(1);
+}
+
+cppai::metrics_snapshot cppai::metrics::snapshot() const {
+    metrics_snapshot merged;
+    std::lock_guard lock{ impl->mtx };
+    for (const std::unique_ptr<shard>& source : impl->shards) {
+        std::lock_guard shard_lock{ source->mtx };
+        for (const auto& [name, cells] : source->endpoints) {
+            auto found = merged.find(name);
+            if (found == merged.end()) {
+                found = merged.emplace(name, endpoint_snapshot{}).first;
+            }
+            endpoint_snapshot& out = found->second;
+            for (std::size_t p = 0; p < phase_count; ++p) {
+                cells->phases[p].read_into(out.phases[p]);
+            }
+            out.requests += cells->requests.load();
+            out.retries += cells->retries.load();
+            out.transport_errors += cells->transport_errors.load();
+            out.bytes_out += cells->bytes_out.load();
+            out.bytes_in += cells->bytes_in.load();
+            for (std::uint32_t status = 0; status < max_status; ++status) {
+                if (const std::uint64_t n = cells->statuses[status].load(); n != 0) {
+                    out.statuses[status] += n;
+                }
+            }
+        }
+    }
+    return merged;
+}
+
+std::string_view cppai::metrics::label(std::string_view target, std::string& out) {
+    out.clear();
+    target = target.substr(0, target.find('?'));
+    std::size_t segment_no = 0;
+    while (!target.empty()) {
+        const std::size_t start = target.front() == '/' ? 1 : 0;
+        const std::size_t slash = target.find('/', start);
+        const std::string_view segment = target.substr(start, slash == std::string_view::npos ? std::string_view::npos : slash - start);
+        out += '/';
+        // Route words are lower-case letters and dashes; anything else past the version is an object id.
+        const bool route_word = std::all_of(segment.begin(), segment.end(), [](char c) {
+            return (c >= 'a' && c <= 'z') || c == '-' || c == '_';
+        });
+        if (segment_no == 0 || route_word) {
+            out += segment;
+        }
+        else {
+            out += "{id}";
+        }
+        ++segment_no;
+        if (slash == std::string_view::npos) {
+            break;
+        }
+        target.remove_prefix(slash);
+    }
+    return out;
+}
+
+cppai::metrics::shard& cppai::metrics::local_shard() {
+    // Instance ids are never reused, so an entry left behind by a destroyed metrics object is never matched.
+    thread_local std::vector<std::pair<std::uint64_t, shard*>> owned;
+    for (const auto& [id, local] : owned) {
+        if (id == impl->id) {
+            return *local;
+        }
+    }
+    std::lock_guard lock{ impl->mtx };
+    shard* local = impl->shards.emplace_back(std::make_unique<shard>()).get();
+    owned.emplace_back(impl->id, local);
+    return *local;
+}
+
+std::string cppai::prometheus_text(const metrics_snapshot& snapshot, std::string_view prefix) {
+    std::string out;
+    const std::string latency = std::string{ prefix } + "_request_phase_seconds";
+    out += "# HELP " + latency + " Time spent in each phase of an API request.\n";
+    out += "# TYPE " + latency + " histogram\n";
+    for (const auto& [target, endpoint] : snapshot) {
+        for (std::size_t p = 0; p < phase_count; ++p) {
+            const histogram_snapshot& histogram = endpoint.phases[p];
+            if (histogram.count == 0) {
+                continue;
+            }
+            const std::string_view name = phase_names[p];
+            // Fine buckets are folded into the first standard boundary at or above their upper edge.
+            std::size_t bucket = 0;
+            std::uint64_t cumulative = 0;
+            for (const double bound : bucket_bounds) {
+                const auto bound_micros = static_cast<std::uint64_t>(bound * 1e6);
+                while (bucket < histogram_snapshot::bucket_count && histogram_snapshot::upper_bound(bucket) <= bound_micros) {
+                    cumulative += histogram.buckets[bucket++];
+                }
+                std::string le = std::to_string(bound);
+                le.erase(le.find_last_not_of('0') + 1);
+                if (le.back() == '.') {
+                    le.pop_back();
+                }
+                out += latency + "_bucket";
+                append_labels(out, target, "phase", name);
+                out.insert(out.size() - 1, ",le=\"" + le + '"');
+                out += ' ' + std::to_string(cumulative) + '\n';
+            }
+            out += latency + "_bucket";
+            append_labels(out, target, "phase", name);
+            out.insert(out.size() - 1, ",le=\"+Inf\"");
+            out += ' ' + std::to_string(histogram.count) + '\n';
+            out += latency + "_sum";
+            append_labels(out, target, "phase", name);
+            out += ' ' + std::to_string(static_cast<double>(histogram.sum) / 1e6) + '\n';
+            out += latency + "_count";
+            append_labels(out, target, "phase", name);
+            out += ' ' + std::to_string(histogram.count) + '\n';
+        }
+    }
+
+    append_counter(out, snapshot, prefix, "requests_total", "Attempts sent, including retries and hedges.", &endpoint_snapshot::requests);
+    append_counter(out, snapshot, prefix, "retries_total", "Attempts repeated by the retry policy.", &endpoint_snapshot::retries);
+    append_counter(out, snapshot, prefix, "transport_errors_total", "Attempts that failed before a status arrived.",
+        &endpoint_snapshot::transport_errors);
+    append_counter(out, snapshot, prefix, "request_body_bytes_total", "Request body bytes sent.", &endpoint_snapshot::bytes_out);
+    append_counter(out, snapshot, prefix, "response_body_bytes_total", "Response body bytes received.", &endpoint_snapshot::bytes_in);
+
+    const std::string responses = std::string{ prefix } + "_responses_total";
+    out += "# HELP " + responses + " Responses by HTTP status code.\n";
+    out += "# TYPE " + responses + " counter\n";
+    for (const auto& [target, endpoint] : snapshot) {
+        for (const auto& [status, n] : endpoint.statuses) {
+            out += responses;
+            append_labels(out, target, "code", std::to_string(status));
+            out += ' ' + std::to_string(n) + '\n';
+        }
+    }
+    return out;
+}
@@ -0,0 +1,151 @@
+#ifndef CPPAI_METRICS_H
+#define CPPAI_METRICS_H
+#include <boost/system/error_code.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace cppai {
+    enum class phase : std::uint8_t {
+        resolve,
+        connect,
+        handshake,
+        write,
+        first_byte,
+        body,
+        decode,
+        total
+    };
+
+    inline constexpr std::size_t phase_count = 8;
+
+    std::string_view phase_name(phase p);
+
+    // Log-linear latency histogram in microseconds with 16 buckets per power of two, so every value is
+    // reported within about 6% of what was recorded. Values beyond 2^32 us land in the last bucket.
+    struct histogram_snapshot {
+        static constexpr std::size_t bucket_count = 464;
+
+        std::array<std::uint64_t, bucket_count> buckets{};
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+
+        void merge(const histogram_snapshot& other);
+
+        // Upper bound of the bucket holding the q-th quantile; zero for an empty histogram.
+        std::chrono::microseconds quantile(double q) const;
+
+        static std::size_t bucket_of(std::uint64_t micros);
+
+        static std::uint64_t upper_bound(std::size_t bucket);
+    };
+
+    struct endpoint_snapshot {
+        std::array<histogram_snapshot, phase_count> phases;
+        std::uint64_t requests = 0;
+        std::uint64_t retries = 0;
+        std::uint64_t transport_errors = 0;
+        std::uint64_t bytes_out = 0;
+        std::uint64_t bytes_in = 0;
+        std::map<std::uint32_t, std::uint64_t> statuses;
+    };
+
+    // Keyed by endpoint label, e.g. "/v1/embeddings" or "/v1/files/{id}/content".
+    using metrics_snapshot = std::map<std::string, endpoint_snapshot, std::less<>>;
+
+    // Phase timings and body sizes of one attempt, filled in as it moves through the pool and the client.
+    struct request_trace {
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        std::array<std::chrono::nanoseconds, phase_count> phases{};
+        std::uint16_t recorded = 0;
+        std::uint64_t bytes_out = 0;
+        std::uint64_t bytes_in = 0;
+
+        void record(phase p, std::chrono::steady_clock::duration elapsed);
+
+        bool has(phase p) const;
+    };
+
+    // Times the enclosing scope into a trace; does nothing when trace is null, which is the case whenever
+    // no metrics sink is attached.
+    class phase_timer {
+    public:
+        phase_timer(request_trace* trace, phase p)
+            : trace{ trace }, measured{ p }, started{ trace != nullptr ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{} } {}
+
+        ~phase_timer() {
+            if (trace != nullptr) {
+                trace->record(measured, std::chrono::steady_clock::now() - started);
+            }
+        }
+
+        phase_timer(const phase_timer&) = delete;
+
+        phase_timer& operator=(const phase_timer&) = delete;
+
+    private:
+        request_trace* trace;
+        phase measured;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // One finished attempt in the shape of an OpenTelemetry client span.
+    struct request_span {
+        std::string_view target;
+        std::string_view method;
+        std::chrono::system_clock::time_point start;
+        std::array<std::optional<std::chrono::nanoseconds>, phase_count> phases;
+        std::uint32_t status = 0;
+        std::uint16_t attempt = 1;
+        std::uint64_t bytes_out = 0;
+        std::uint64_t bytes_in = 0;
+        boost::system::error_code error;
+    };
+
+    // Request metrics shared by any number of clients and threads. Each thread records into its own
+    // histograms and counters without locks or atomic read-modify-writes; snapshot() merges them.
+    class metrics {
+    public:
+        using span_callback = std::function<void(const request_span&)>;
+
+        metrics();
+
+        ~metrics();
+
+        metrics(const metrics&) = delete;
+
+        metrics& operator=(const metrics&) = delete;
+
+        // Called on the recording thread for every attempt; must be set before requests start.
+        void set_span_callback(span_callback callback);
+
+        void record(std::string_view target, std::string_view method, const request_trace& trace, std::uint32_t status,
+            std::uint16_t attempt, boost::system::error_code error);
+
+        void record_retry(std::string_view target);
+
+        metrics_snapshot snapshot() const;
+
+        // Collapses per-object path segments (file, fine-tune and model ids) into "{id}" and drops the query.
+        static std::string_view label(std::string_view target, std::string& out);
+
+    private:
+        struct shard;
+        struct state;
+
+        std::unique_ptr<state> impl;
+
+        shard& local_shard();
+    };
+
+    // Prometheus text exposition format (version 0.0.4).
+    std::string prometheus_text(const metrics_snapshot& snapshot, std::string_view prefix = "cppai");
+}
+
+#endif
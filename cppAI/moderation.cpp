@@ -0,0 +1,227 @@
+#include "moderation.h"
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+#include <exception>
+
+namespace {
+    // Thrown by the moderation branch so the generation branch is cancelled; caught before run() returns.
+    struct prompt_flagged : std::exception {
+        const char* what() const noexcept override {
+            return "prompt flagged";
+        }
+    };
+
+    std::string text_of(const boost::json::value& content) {
+        if (content.is_string()) {
+            return std::string{ content.get_string() };
+        }
+        std::string text;
+        if (const boost::json::array* parts = content.if_array()) {
+            for (const boost::json::value& part : *parts) {
+                const boost::json::object* fields = part.if_object();
+                const boost::json::value* part_text = fields != nullptr ? fields->if_contains("text") : nullptr;
+                if (part_text != nullptr && part_text->is_string()) {
+                    if (!text.empty()) {
+                        text.push_back('\n');
+                    }
+                    text.append(part_text->get_string());
+                }
+            }
+        }
+        return text;
+    }
+
+    cppai::moderation_verdict read_verdict(boost::json::value response) {
+        const boost::json::object* fields = response.if_object();
+        if (fields == nullptr) {
+            throw cppai::moderation_error("Moderation response is not an object");
+        }
+        if (const boost::json::value* error = fields->if_contains("error")) {
+            const boost::json::value* message = error->is_object() ? error->get_object().if_contains("message") : nullptr;
+            throw cppai::moderation_error(message != nullptr && message->is_string() ? std::string{ message->get_string() } : boost::json::serialize(*error));
+        }
+        const boost::json::value* results = fields->if_contains("results");
+        if (results == nullptr || !results->is_array()) {
+            throw cppai::moderation_error("Moderation response has no results");
+        }
+
+        cppai::moderation_verdict verdict;
+        for (const boost::json::value& result : results->get_array()) {
+            const boost::json::object* outcome = result.if_object();
+            if (outcome == nullptr) {
+                continue;
+            }
+            if (const boost::json::value* flagged = outcome->if_contains("flagged"); flagged != nullptr && flagged->is_bool() && flagged->get_bool()) {
+                verdict.flagged = true;
+            }
+            const boost::json::value* categories = outcome->if_contains("categories");
+            if (categories == nullptr || !categories->is_object()) {
+                continue;
+            }
+            for (const auto& [name, hit] : categories->get_object()) {
+                const std::string category{ name };
+                if (hit.is_bool() && hit.get_bool() && std::find(verdict.categories.begin(), verdict.categories.end(), category) == verdict.categories.end()) {
+                    verdict.categories.push_back(category);
+                }
+            }
+        }
+        verdict.response = std::move(response);
+        return verdict;
+    }
+}
+
+struct cppai::moderated_chat::run_state {
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    moderated_reply reply;
+    bool generation_done = false;
+
+    // Streams only; events may arrive on whichever thread runs the generation branch.
+    std::mutex mtx;
+    sse_parser::event_handler on_chunk;
+    bool released = false;
+    std::vector<boost::json::value> held;
+
+    void deliver(const boost::json::value& event) {
+        std::lock_guard lock{ mtx };
+        if (released) {
+            on_chunk(event);
+        }
+        else {
+            held.push_back(event);
+        }
+    }
+
+    void release() {
+        std::lock_guard lock{ mtx };
+        released = true;
+        if (on_chunk) {
+            for (const boost::json::value& event : held) {
+                on_chunk(event);
+            }
+        }
+        held.clear();
+    }
+};
+
+std::chrono::steady_clock::duration cppai::moderated_reply::latency_saved() const {
+    // A flagged prompt would not have been sent for generation at all.
+    const std::chrono::steady_clock::duration sequential = verdict.flagged ? moderation_time : moderation_time + generation_time;
+    return std::max(sequential - elapsed, std::chrono::steady_clock::duration::zero());
+}
+
+std::chrono::steady_clock::duration cppai::moderated_reply::generation_wasted() const {
+    return verdict.flagged ? generation_time : std::chrono::steady_clock::duration::zero();
+}
+
+cppai::moderated_chat::moderated_chat(const openAI& client, moderation_options opts) : client{ client }, opts{ std::move(opts) } {
+}
+
+boost::asio::awaitable<cppai::moderated_reply> cppai::moderated_chat::chat_completion(const boost::json::value& request_body) const {
+    run_state state;
+    co_return co_await run(request_body, state);
+}
+
+boost::asio::awaitable<cppai::moderated_reply> cppai::moderated_chat::chat_completion_stream(const boost::json::value& request_body,
+    sse_parser::event_handler on_chunk) const {
+    run_state state;
+    state.on_chunk = std::move(on_chunk);
+    co_return co_await run(request_body, state);
+}
+
+cppai::moderation_counters cppai::moderated_chat::counters() const {
+    std::lock_guard lock{ mtx };
+    return stats;
+}
+
+boost::json::value cppai::moderated_chat::moderation_request(const boost::json::value& request_body) const {
+    boost::json::array inputs;
+    const boost::json::object* body = request_body.if_object();
+    const boost::json::value* messages = body != nullptr ? body->if_contains("messages") : nullptr;
+    if (messages != nullptr && messages->is_array()) {
+        for (const boost::json::value& message : messages->get_array()) {
+            const boost::json::object* fields = message.if_object();
+            const boost::json::value* role = fields != nullptr ? fields->if_contains("role") : nullptr;
+            const boost::json::value* content = fields != nullptr ? fields->if_contains("content") : nullptr;
+            if (role == nullptr || !role->is_string() || role->get_string() != "user" || content == nullptr) {
+                continue;
+            }
+            if (!opts.all_user_messages) {
+                inputs.clear();
+            }
+            inputs.emplace_back(text_of(*content));
+        }
+    }
+    if (inputs.empty()) {
+        return nullptr;
+    }
+
+    boost::json::object request{ { "input", std::move(inputs) } };
+    if (opts.model.has_value()) {
+        request["model"] = opts.model.value();
+    }
+    return request;
+}
+
+boost::asio::awaitable<void> cppai::moderated_chat::moderate(const boost::json::value& request, run_state& state) const {
+    // Nothing a user wrote, so nothing to hold back.
+    if (request.is_null()) {
+        state.release();
+        co_return;
+    }
+    const auto begun = std::chrono::steady_clock::now();
+    boost::json::value response = co_await client.create_moderations(request);
+    state.reply.moderation_time = std::chrono::steady_clock::now() - begun;
+    state.reply.verdict = read_verdict(std::move(response));
+    if (state.reply.verdict.flagged) {
+        throw prompt_flagged{};
+    }
+    state.release();
+}
+
+boost::asio::awaitable<void> cppai::moderated_chat::generate(const boost::json::value& request_body, run_state& state) const {
+    const auto begun = std::chrono::steady_clock::now();
+    try {
+        if (state.on_chunk) {
+            co_await client.chat_completion_stream(request_body, [&state](const boost::json::value& event) { state.deliver(event); });
+        }
+        else {
+            state.reply.completion = co_await client.chat_completion(request_body);
+        }
+    }
+    catch (...) {
+        state.reply.generation_time = std::chrono::steady_clock::now() - begun;
+        throw;
+    }
+    state.reply.generation_time = std::chrono::steady_clock::now() - begun;
+    state.generation_done = true;
+}
+
+boost::asio::awaitable<cppai::moderated_reply> cppai::moderated_chat::run(const boost::json::value& request_body, run_state& state) const {
+    using namespace boost::asio::experimental::awaitable_operators;
+    const boost::json::value request = moderation_request(request_body);
+    {
+        std::lock_guard lock{ mtx };
+        ++stats.calls;
+    }
+
+    try {
+        co_await (moderate(request, state) && generate(request_body, state));
+    }
+    catch (const prompt_flagged&) {
+        // && has already cancelled the generation and waited for it to wind down.
+        state.reply.cancelled = !state.generation_done;
+        state.reply.completion = nullptr;
+        std::lock_guard lock{ state.mtx };
+        state.reply.discarded_events = state.held.size();
+        state.held.clear();
+    }
+    state.reply.elapsed = std::chrono::steady_clock::now() - state.started;
+
+    std::lock_guard lock{ mtx };
+    stats.flagged += state.reply.verdict.flagged ? 1 : 0;
+    stats.cancelled += state.reply.cancelled ? 1 : 0;
+    stats.discarded_events += state.reply.discarded_events;
+    stats.latency_saved += state.reply.latency_saved();
+    stats.generation_wasted += state.reply.generation_wasted();
+    co_return std::move(state.reply);
+}
@@ -0,0 +1,100 @@
+#ifndef CPPAI_MODERATION_H
+#define CPPAI_MODERATION_H
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "openai.h"
+
+namespace cppai {
+    struct moderation_options {
+        // The moderation model; the API's default when empty.
+        std::optional<std::string> model;
+        // Moderate every user message of the request instead of only the newest, whose predecessors were
+        // already checked when they were sent.
+        bool all_user_messages = false;
+    };
+
+    struct moderation_verdict {
+        bool flagged = false;
+        // The categories any moderated input was flagged for.
+        std::vector<std::string> categories;
+        boost::json::value response;
+    };
+
+    struct moderated_reply {
+        moderation_verdict verdict;
+        // The completion once the prompt passed; null when it was flagged, and for streams, whose events went to
+        // the handler.
+        boost::json::value completion;
+        std::chrono::steady_clock::duration moderation_time{};
+        // Until the completion finished or was cancelled.
+        std::chrono::steady_clock::duration generation_time{};
+        std::chrono::steady_clock::duration elapsed{};
+        // Whether a flagged prompt's generation was still running and got cancelled.
+        bool cancelled = false;
+        // Stream events received for a flagged prompt and never released.
+        std::size_t discarded_events = 0;
+
+        // Against moderating first and generating after: the part of moderation hidden behind generation.
+        std::chrono::steady_clock::duration latency_saved() const;
+
+        // Generation done for a prompt that was then flagged.
+        std::chrono::steady_clock::duration generation_wasted() const;
+    };
+
+    struct moderation_counters {
+        std::uint64_t calls = 0;
+        std::uint64_t flagged = 0;
+        std::uint64_t cancelled = 0;
+        std::uint64_t discarded_events = 0;
+        std::chrono::steady_clock::duration latency_saved{};
+        std::chrono::steady_clock::duration generation_wasted{};
+    };
+
+    class moderation_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Runs create_moderations on a request's user prompt alongside the completion instead of before it. Output
+    // is held back until the verdict is in: a completion is returned, and stream events are passed on, only
+    // for a prompt that passed. A flagged prompt cancels the generation still in flight, so it stops holding a
+    // connection and spending tokens. A failed moderation call fails the whole call, never releasing output
+    // that was not checked.
+    class moderated_chat {
+    public:
+        explicit moderated_chat(const openAI& client, moderation_options opts = {});
+
+        boost::asio::awaitable<moderated_reply> chat_completion(const boost::json::value& request_body) const;
+
+        // Events that arrive before the verdict are buffered and replayed in order once the prompt passes.
+        boost::asio::awaitable<moderated_reply> chat_completion_stream(const boost::json::value& request_body, sse_parser::event_handler on_chunk) const;
+
+        moderation_counters counters() const;
+
+    private:
+        struct run_state;
+
+        const openAI& client;
+        moderation_options opts;
+
+        mutable std::mutex mtx;
+        mutable moderation_counters stats;
+
+        boost::json::value moderation_request(const boost::json::value& request_body) const;
+
+        boost::asio::awaitable<void> moderate(const boost::json::value& request, run_state& state) const;
+
+        boost::asio::awaitable<void> generate(const boost::json::value& request_body, run_state& state) const;
+
+        boost::asio::awaitable<moderated_reply> run(const boost::json::value& request_body, run_state& state) const;
+    };
+}
+
+#endif
@@ -0,0 +1,143 @@
+#include "multipart_body.h"
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <random>
+
+cppai::multipart_body::value_type::value_type() {
+    static constexpr char hex[] = "0123456789abcdef";
+    std::random_device device;
+    std::uniform_int_distribution<std::uint32_t> digit{ 0, 15 };
+    boundary_str = "cppai-";
+    for (std::uint8_t i = 0; i < 24; ++i) {
+        boundary_str.push_back(hex[digit(device)]);
+    }
+}
+
+void cppai::multipart_body::value_type::add_field(std::string_view name, std::string_view value) {
+    std::string part;
+    part.append("--").append(boundary_str).append("\r\n")
+        .append("Content-Disposition: form-data; name=\"").append(name).append("\"\r\n")
+        .append("\r\n")
+        .append(value).append("\r\n");
+    append_text(part);
+}
+
+void cppai::multipart_body::value_type::add_field(std::string_view name, double value) {
+    std::array<char, 32> digits;
+    const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+    add_field(name, std::string_view{ digits.data(), static_cast<std::size_t>(result.ptr - digits.data()) });
+}
+
+void cppai::multipart_body::value_type::add_file(std::string_view name, const boost::filesystem::path& file, std::string_view content_type) {
+    std::string part;
+    part.append("--").append(boundary_str).append("\r\n")
+        .append("Content-Disposition: form-data; name=\"").append(name).append("\"; filename=\"").append(file.filename().string()).append("\"\r\n")
+        .append("Content-Type: ").append(content_type).append("\r\n")
+        .append("\r\n");
+    append_text(part);
+    segments.back().file = file.string();
+    segments.back().file_size = boost::filesystem::file_size(file);
+    append_text("\r\n");
+}
+
+void cppai::multipart_body::value_type::add_file_slice(std::string_view name, std::string_view filename, std::string_view head,
+    const boost::filesystem::path& file, std::uint64_t offset, std::uint64_t length, std::string_view content_type) {
+    std::string part;
+    part.append("--").append(boundary_str).append("\r\n")
+        .append("Content-Disposition: form-data; name=\"").append(name).append("\"; filename=\"").append(filename).append("\"\r\n")
+        .append("Content-Type: ").append(content_type).append("\r\n")
+        .append("\r\n")
+        .append(head);
+    append_text(part);
+    segments.back().file = file.string();
+    segments.back().file_offset = offset;
+    segments.back().file_size = length;
+    append_text("\r\n");
+}
+
+void cppai::multipart_body::value_type::close() {
+    append_text("--" + boundary_str + "--\r\n");
+}
+
+const std::string& cppai::multipart_body::value_type::boundary() const {
+    return boundary_str;
+}
+
+std::string cppai::multipart_body::value_type::content_type() const {
+    return "multipart/form-data; boundary=" + boundary_str;
+}
+
+std::uint64_t cppai::multipart_body::value_type::size() const {
+    std::uint64_t total = 0;
+    for (const segment& seg : segments) {
+        total += seg.text.size() + seg.file_size;
+    }
+    return total;
+}
+
+void cppai::multipart_body::value_type::append_text(std::string_view text) {
+    if (segments.empty() || !segments.back().file.empty()) {
+        segments.emplace_back();
+    }
+    segments.back().text.append(text);
+}
+
+std::uint64_t cppai::multipart_body::size(const value_type& body) {
+    return body.size();
+}
+
+void cppai::multipart_body::writer::init(boost::beast::error_code& ec) {
+    ec = {};
+    const bool has_files = std::any_of(body.segments.begin(), body.segments.end(),
+        [](const value_type::segment& seg) { return !seg.file.empty(); });
+    if (has_files) {
+        chunk = std::make_unique<char[]>(chunk_size);
+    }
+}
+
+boost::optional<std::pair<cppai::multipart_body::writer::const_buffers_type, bool>> cppai::multipart_body::writer::get(boost::beast::error_code& ec) {
+    ec = {};
+    while (index < body.segments.size()) {
+        const value_type::segment& seg = body.segments[index];
+        const bool last = index + 1 == body.segments.size();
+
+        if (!text_sent) {
+            text_sent = true;
+            if (!seg.file.empty()) {
+                file.open(seg.file.c_str(), boost::beast::file_mode::scan, ec);
+                if (!ec && seg.file_offset != 0) {
+                    file.seek(seg.file_offset, ec);
+                }
+                if (ec) {
+                    return boost::none;
+                }
+                remaining = seg.file_size;
+            }
+            if (!seg.text.empty()) {
+                return std::make_pair(const_buffers_type{ seg.text.data(), seg.text.size() }, !last || remaining != 0);
+            }
+        }
+
+        if (remaining != 0) {
+            const std::size_t bytes_read = file.read(chunk.get(), static_cast<std::size_t>(std::min<std::uint64_t>(remaining, chunk_size)), ec);
+            if (ec) {
+                return boost::none;
+            }
+            if (bytes_read == 0) {
+                ec = boost::asio::error::eof;
+                return boost::none;
+            }
+            remaining -= bytes_read;
+            return std::make_pair(const_buffers_type{ chunk.get(), bytes_read }, !last || remaining != 0);
+        }
+
+        if (file.is_open()) {
+            file.close(ec);
+        }
+        ++index;
+        text_sent = false;
+    }
+    return boost::none;
+}
@@ -0,0 +1,83 @@
+#ifndef CPPAI_MULTIPART_BODY_H
+#define CPPAI_MULTIPART_BODY_H
+#include <boost/beast.hpp>
+#include <boost/nowide/filesystem.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace cppai {
+    // Beast body for multipart/form-data requests. Files are streamed in fixed-size chunks while the
+    // message is serialized, so memory use does not depend on the size of the uploaded files.
+    struct multipart_body {
+        static constexpr std::size_t chunk_size = 64 * 1024;
+
+        class value_type {
+        public:
+            value_type();
+
+            void add_field(std::string_view name, std::string_view value);
+
+            void add_field(std::string_view name, double value);
+
+            void add_file(std::string_view name, const boost::filesystem::path& file, std::string_view content_type);
+
+            // One file part made of head followed by length bytes of file from offset on, e.g. a fresh WAV header
+            // in front of a slice of a longer recording's samples. Nothing is copied until the body is written.
+            void add_file_slice(std::string_view name, std::string_view filename, std::string_view head, const boost::filesystem::path& file,
+                std::uint64_t offset, std::uint64_t length, std::string_view content_type);
+
+            void close();
+
+            const std::string& boundary() const;
+
+            std::string content_type() const;
+
+            std::uint64_t size() const;
+
+        private:
+            friend struct multipart_body;
+
+            struct segment {
+                std::string text;
+                std::string file;
+                std::uint64_t file_offset = 0;
+                std::uint64_t file_size = 0;
+            };
+
+            std::string boundary_str;
+            std::vector<segment> segments;
+
+            void append_text(std::string_view text);
+        };
+
+        static std::uint64_t size(const value_type& body);
+
+        class writer {
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, class Fields>
+            writer(const boost::beast::http::header<isRequest, Fields>&, const value_type& body) : body{ body } {
+            }
+
+            void init(boost::beast::error_code& ec);
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec);
+
+        private:
+            const value_type& body;
+            std::size_t index = 0;
+            bool text_sent = false;
+            boost::beast::file file;
+            std::uint64_t remaining = 0;
+            std::unique_ptr<char[]> chunk;
+        };
+    };
+}
+
+#endif
@@ -1,498 +1,1110 @@
 #include "openai.h"
 
-cppai::openAI::openAI() : ssl_ctx{ boost::asio::ssl::context::tlsv12_client } {
+cppai::openAI::openAI() : ssl_ctx{ boost::asio::ssl::context::tlsv12_client }, pool{ std::make_unique<connection_pool>() },
+    h2{ std::make_unique<h2_pool>(*pool) }, backends{ std::make_shared<balancer>(endpoint_config{}) },
+    backends_mtx{ std::make_unique<std::mutex>() },
+    latencies{ std::make_unique<latency_tracker>() } {
+    // Each connection checks the certificate against its own backend's name; see connection_pool::connect.
     ssl_ctx.set_default_verify_paths();
-    ssl_ctx.set_verify_callback(boost::asio::ssl::rfc2818_verification("api.openai.com"));
+    ssl_ctx.set_verify_mode(boost::asio::ssl::verify_peer);
+    rebuild_header_block();
 }
 
 void cppai::openAI::set_api_key(std::string_view api_key) {
     key = api_key;
+    rebuild_header_block();
 }
 
 void cppai::openAI::set_organization_id(std::string_view org_id) {
     organization_id = org_id;
+    rebuild_header_block();
+}
+
+void cppai::openAI::set_pool_options(pool_options opts) {
+    pool->set_options(opts);
+}
+
+void cppai::openAI::set_policy(request_policy new_policy) {
+    policy = std::move(new_policy);
+    rebuild_header_block();
+}
+
+void cppai::openAI::set_cache(std::shared_ptr<response_cache> new_cache) {
+    cache = std::move(new_cache);
+}
+
+void cppai::openAI::set_transport(transport mode) {
+    transport_mode = mode;
+}
+
+void cppai::openAI::set_metrics(std::shared_ptr<metrics> sink) {
+    metrics_sink = std::move(sink);
+}
+
+void cppai::openAI::set_dns_cache(std::shared_ptr<dns_cache> cache) {
+    pool->set_dns_cache(std::move(cache));
+}
+
+void cppai::openAI::set_endpoints(endpoint_config config) {
+    ssl_ctx.set_verify_mode(config.verify_peer ? boost::asio::ssl::verify_peer : boost::asio::ssl::verify_none);
+    if (!config.ca_file.empty()) {
+        ssl_ctx.load_verify_file(config.ca_file);
+    }
+    auto replacement = std::make_shared<balancer>(std::move(config));
+    std::lock_guard lock{ *backends_mtx };
+    backends = std::move(replacement);
+}
+
+std::vector<cppai::backend_stats> cppai::openAI::endpoint_stats() const {
+    return current_backends()->stats();
+}
+
+std::shared_ptr<cppai::balancer> cppai::openAI::current_backends() const {
+    std::lock_guard lock{ *backends_mtx };
+    return backends;
+}
+
+namespace {
+    void add_image_fields(cppai::multipart_body::value_type& form, const ::cppai::utility::img_req& opt_vals) {
+        if (opt_vals.n.has_value()) {
+            form.add_field("n", std::to_string(opt_vals.n.value()));
+        }
+        if (opt_vals.size.has_value()) {
+            form.add_field("size", opt_vals.size.value());
+        }
+        if (opt_vals.user.has_value()) {
+            form.add_field("user", opt_vals.user.value());
+        }
+        if (opt_vals.response_format.has_value()) {
+            form.add_field("response_format", opt_vals.response_format.value());
+        }
+    }
+
+    // Form-encoded calls only take the fields of img_req, so their images are PNG.
+    constexpr std::string_view form_image_extension = ".png";
+
+    // Asks for base64 images unless the request chose a format; gpt-image models answer in base64 alone and
+    // reject the field.
+    boost::json::value b64_request(const boost::json::value& request_body) {
+        boost::json::value body = request_body;
+        if (boost::json::object* fields = body.if_object(); fields != nullptr && !fields->contains("response_format")) {
+            const boost::json::value* model = fields->if_contains("model");
+            if (model == nullptr || !model->is_string() || !model->get_string().starts_with("gpt-image")) {
+                (*fields)["response_format"] = "b64_json";
+            }
+        }
+        return body;
+    }
+
+    std::string image_extension(const boost::json::value& request_body) {
+        const boost::json::object* fields = request_body.if_object();
+        const boost::json::value* format = fields != nullptr ? fields->if_contains("output_format") : nullptr;
+        if (format != nullptr && format->is_string()) {
+            return "." + std::string{ format->get_string() };
+        }
+        return std::string{ form_image_extension };
+    }
+
+    cppai::image_sink files_sink(const std::shared_ptr<cppai::image_files>& files) {
+        return [files](std::size_t index, std::string_view bytes) {
+            files->write(index, bytes);
+        };
+    }
+
+    boost::asio::awaitable<cppai::image_result> with_files(boost::asio::awaitable<cppai::image_result> call,
+        std::shared_ptr<cppai::image_files> files) {
+        cppai::image_result result;
+        try {
+            result = co_await std::move(call);
+            result.files = files->commit();
+        }
+        catch (...) {
+            files->discard();
+            throw;
+        }
+        co_return result;
+    }
+
+    cppai::multipart_body::value_type image_form(const boost::filesystem::path& image, const std::optional<std::string_view>& prompt,
+        ::cppai::utility::img_req opt_vals, bool b64) {
+        boost::nowide::nowide_filesystem();
+        if (b64 && !opt_vals.response_format.has_value()) {
+            opt_vals.response_format = "b64_json";
+        }
+
+        cppai::multipart_body::value_type form;
+        form.add_file("image", image, "image/*");
+        // Only an edit, which is what takes a prompt, takes a mask.
+        if (prompt.has_value()) {
+            if (opt_vals.mask.has_value()) {
+                form.add_file("mask", opt_vals.mask.value(), "image/*");
+            }
+            form.add_field("prompt", prompt.value());
+        }
+        add_image_fields(form, opt_vals);
+        return form;
+    }
+
+    void add_audio_fields(cppai::multipart_body::value_type& form, std::string_view model, const ::cppai::utility::audio_req& opt_vals) {
+        form.add_field("model", model);
+        if (opt_vals.prompt.has_value()) {
+            form.add_field("prompt", opt_vals.prompt.value());
+        }
+        if (opt_vals.temp.has_value()) {
+            form.add_field("temperature", opt_vals.temp.value());
+        }
+        if (opt_vals.lang.has_value()) {
+            form.add_field("language", opt_vals.lang.value());
+        }
+    }
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::model_list() const {
-    boost::beast::http::request<boost::beast::http::string_body> model_list_req;
-    model_list_req.method(boost::beast::http::verb::get);
-    model_list_req.set(boost::beast::http::field::host, host);
-    model_list_req.version(http_ver);
-    model_list_req.target("/v1/models");
-    model_list_req.set(boost::beast::http::field::organization, organization_id);
-    model_list_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    model_list_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    model_list_req.prepare_payload();
-    boost::json::value model_list_res = co_await client(std::move(model_list_req));
-    co_return model_list_res;
+    return call(endpoints::list_models);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::completion(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> chat_req;
-    chat_req.method(boost::beast::http::verb::post);
-    chat_req.set(boost::beast::http::field::host, host);
-    chat_req.version(http_ver);
-    chat_req.target("/v1/completions");
-    chat_req.set(boost::beast::http::field::organization, organization_id);
-    chat_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    chat_req.set(boost::beast::http::field::content_type, "application/json");
-    chat_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    chat_req.body() = boost::json::serialize(request_body);
-    chat_req.prepare_payload();
-    boost::json::value chat_res = co_await client(std::move(chat_req));
-    co_return chat_res;
+    return call_json(endpoints::completions, request_body);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::chat_completion(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> chat_req;
-    chat_req.method(boost::beast::http::verb::post);
-    chat_req.set(boost::beast::http::field::host, host);
-    chat_req.version(http_ver);
-    chat_req.target("/v1/chat/completions");
-    chat_req.set(boost::beast::http::field::organization, organization_id);
-    chat_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    chat_req.set(boost::beast::http::field::content_type, "application/json");
-    chat_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    chat_req.body() = boost::json::serialize(request_body);
-    chat_req.prepare_payload();
-    boost::json::value chat_res = co_await client(std::move(chat_req));
-    co_return chat_res;
+    return call_json(endpoints::chat_completions, request_body);
+}
+
+boost::asio::awaitable<cppai::chat_response> cppai::openAI::chat_completion(const chat_request& request_body) const {
+    return call_json(endpoints::chat_completions, request_body, typed_decoder<chat_response>{});
+}
+
+boost::asio::awaitable<cppai::extracted_fields> cppai::openAI::chat_completion_fields(const boost::json::value& request_body,
+    std::vector<std::string> pointers) const {
+    return call_json(endpoints::chat_completions, request_body, field_decoder{ std::move(pointers) });
+}
+
+boost::asio::awaitable<void> cppai::openAI::completion_stream(const boost::json::value& request_body, sse_parser::event_handler on_chunk) const {
+    return call_stream(endpoints::completions, request_body, std::move(on_chunk));
+}
+
+boost::asio::awaitable<void> cppai::openAI::chat_completion_stream(const boost::json::value& request_body, sse_parser::event_handler on_chunk) const {
+    return call_stream(endpoints::chat_completions, request_body, std::move(on_chunk));
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::edit(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> edit_req;
-    edit_req.method(boost::beast::http::verb::post);
-    edit_req.set(boost::beast::http::field::host, host);
-    edit_req.version(http_ver);
-    edit_req.target("/v1/edits");
-    edit_req.set(boost::beast::http::field::organization, organization_id);
-    edit_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    edit_req.set(boost::beast::http::field::content_type, "application/json");
-    edit_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    edit_req.body() = boost::json::serialize(request_body);
-    edit_req.prepare_payload();
-    boost::json::value edit_res = co_await client(std::move(edit_req));
-    co_return edit_res;
+    return call_json(endpoints::edits, request_body);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_image(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> img_create_req;
-    img_create_req.method(boost::beast::http::verb::post);
-    img_create_req.set(boost::beast::http::field::host, host);
-    img_create_req.version(http_ver);
-    img_create_req.target("/v1/images/generations");
-    img_create_req.set(boost::beast::http::field::organization, organization_id);
-    img_create_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    img_create_req.set(boost::beast::http::field::content_type, "application/json");
-    img_create_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    img_create_req.body() = boost::json::serialize(request_body);
-    img_create_req.prepare_payload();
-    boost::json::value img_create_res = co_await client(std::move(img_create_req));
-    co_return img_create_res;
+    return call_json(endpoints::image_generations, request_body);
+}
+
+boost::asio::awaitable<cppai::image_result> cppai::openAI::create_image(const boost::json::value& request_body, image_sink sink) const {
+    const boost::json::value body = b64_request(request_body);
+    co_return co_await call_json(endpoints::image_generations, body, image_decoder{ std::move(sink) });
+}
+
+boost::asio::awaitable<cppai::image_result> cppai::openAI::create_image(const boost::json::value& request_body,
+    const boost::filesystem::path& directory) const {
+    auto files = std::make_shared<image_files>(directory, image_extension(request_body));
+    return with_files(create_image(request_body, files_sink(files)), files);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::image_edit(boost::filesystem::path image, std::string_view prompt,
     ::cppai::utility::img_req_builder&& opt_params) const {
-    ::cppai::utility::img_req opt_vals = std::move(opt_params.req);
-    boost::nowide::nowide_filesystem();
-    boost::nowide::ifstream img_stream{ image, std::ios_base::binary };
-    boost::nowide::ifstream mask_stream;
-    if (opt_vals.mask.has_value()) {
-        mask_stream.open(opt_vals.mask.value(), std::ios_base::binary);
-    }
-
-    boost::beast::http::request<boost::beast::http::string_body> img_edit_req;
-    img_edit_req.method(boost::beast::http::verb::post);
-    img_edit_req.set(boost::beast::http::field::host, host);
-    img_edit_req.version(http_ver);
-    img_edit_req.target("/v1/images/edits");
-    img_edit_req.set(boost::beast::http::field::organization, organization_id);
-    img_edit_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    img_edit_req.set(boost::beast::http::field::content_type, "multipart/form-data; boundary=boundary");
-    img_edit_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-    const std::string boundary = "boundary";
-    std::stringstream body_stream;
-    body_stream << "--" << boundary << "\r\n"
-        << "Content-Disposition: form-data; name=\"image\"; filename=\"" << image.filename().string() << "\"\r\n"
-        << "Content-Type: image/*\r\n\r\n"
-        << img_stream.rdbuf() << "\r\n"
-        << "--" << boundary << "\r\n";
-    if (opt_vals.mask.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"mask\"; filename=\"" << opt_vals.mask.value().string() << "\"\r\n"
-            << "Content-Type: image/*\r\n\r\n"
-            << mask_stream.rdbuf() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-    body_stream << "Content-Disposition: form-data; name=\"prompt\"\r\n\r\n"
-        << prompt << "\r\n"
-        << "--" << boundary << "\r\n";
-    if (opt_vals.n.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"n\"\r\n\r\n"
-            << opt_vals.n.value() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-    if (opt_vals.size.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"size\"\r\n\r\n"
-            << opt_vals.size.value() << "\r\n"
-            << "--" << boundary << "--\r\n";
-    }
-    if (opt_vals.user.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"user\"\r\n\r\n"
-            << opt_vals.user.value() << "\r\n"
-            << "--" << boundary << "--\r\n";
-    }
-
-    img_edit_req.body() = body_stream.str();
-    img_edit_req.set(boost::beast::http::field::content_length, std::to_string(img_edit_req.body().size()));
-    img_edit_req.prepare_payload();
-
-    boost::json::value img_edit_res = co_await client(std::move(img_edit_req));
-    co_return img_edit_res;
+    return call_form(endpoints::image_edits, image_form(image, prompt, std::move(opt_params.req), false));
+}
+
+boost::asio::awaitable<cppai::image_result> cppai::openAI::image_edit(boost::filesystem::path image, std::string_view prompt, image_sink sink,
+    ::cppai::utility::img_req_builder&& opt_params) const {
+    return call_form(endpoints::image_edits, image_form(image, prompt, std::move(opt_params.req), true), image_decoder{ std::move(sink) });
+}
+
+boost::asio::awaitable<cppai::image_result> cppai::openAI::image_edit(boost::filesystem::path image, std::string_view prompt,
+    const boost::filesystem::path& directory, ::cppai::utility::img_req_builder&& opt_params) const {
+    auto files = std::make_shared<image_files>(directory, std::string{ form_image_extension });
+    return with_files(image_edit(std::move(image), prompt, files_sink(files), std::move(opt_params)), files);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_img_variation(boost::filesystem::path image, ::cppai::utility::img_req_builder&& opt_params) const {
-    ::cppai::utility::img_req opt_vals = std::move(opt_params.req);
-    boost::nowide::nowide_filesystem();
-    boost::nowide::ifstream img_stream{ image, std::ios_base::binary };
-    boost::beast::http::request<boost::beast::http::string_body> img_var_req;
-    img_var_req.method(boost::beast::http::verb::post);
-    img_var_req.set(boost::beast::http::field::host, host);
-    img_var_req.version(http_ver);
-    img_var_req.target("/v1/images/variations");
-    img_var_req.set(boost::beast::http::field::organization, organization_id);
-    img_var_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    img_var_req.set(boost::beast::http::field::content_type, "multipart/form-data; boundary=boundary");
-    img_var_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-    const std::string boundary = "boundary";
-    std::stringstream body_stream;
-    body_stream << "--" << boundary << "\r\n"
-        << "Content-Disposition: form-data; name=\"image\"; filename=\"" << image.filename().string() << "\"\r\n"
-        << "Content-Type: image/*\r\n"
-        << "\r\n"
-        << img_stream.rdbuf() << "\r\n"
-        << "--" << boundary;
-    if (opt_vals.n.has_value()) {
-        body_stream << "\r\n"
-            << "Content-Disposition: form-data; name=\"n\"\r\n"
-            << "\r\n"
-            << opt_vals.n.value() << "\r\n"
-            << "--" << boundary;
-    }
-    if (opt_vals.size.has_value()) {
-        body_stream << "\r\n"
-            << "Content-Disposition: form-data; name=\"size\"\r\n"
-            << "\r\n"
-            << opt_vals.size.value() << "\r\n"
-            << "--" << boundary << "--";
-    }
-    if (opt_vals.user.has_value()) {
-        body_stream << "\r\n"
-            << "Content-Disposition: form-data; name=\"user\"\r\n"
-            << "\r\n"
-            << opt_vals.user.value() << "\r\n"
-            << "--" << boundary << "--";
-    }
-
-
-    img_var_req.body() = body_stream.str();
-    img_var_req.set(boost::beast::http::field::content_length, std::to_string(img_var_req.body().size()));
-    img_var_req.prepare_payload();
-
-    boost::json::value img_var_res = co_await client(std::move(img_var_req));
-    co_return img_var_res;
+    return call_form(endpoints::image_variations, image_form(image, std::nullopt, std::move(opt_params.req), false));
+}
+
+boost::asio::awaitable<cppai::image_result> cppai::openAI::create_img_variation(boost::filesystem::path image, image_sink sink,
+    ::cppai::utility::img_req_builder&& opt_params) const {
+    return call_form(endpoints::image_variations, image_form(image, std::nullopt, std::move(opt_params.req), true),
+        image_decoder{ std::move(sink) });
+}
+
+boost::asio::awaitable<cppai::image_result> cppai::openAI::create_img_variation(boost::filesystem::path image,
+    const boost::filesystem::path& directory, ::cppai::utility::img_req_builder&& opt_params) const {
+    auto files = std::make_shared<image_files>(directory, std::string{ form_image_extension });
+    return with_files(create_img_variation(std::move(image), files_sink(files), std::move(opt_params)), files);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_embedding(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> embedded_req;
-    embedded_req.method(boost::beast::http::verb::post);
-    embedded_req.set(boost::beast::http::field::host, host);
-    embedded_req.version(http_ver);
-    embedded_req.target("/v1/embeddings");
-    embedded_req.set(boost::beast::http::field::organization, organization_id);
-    embedded_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    embedded_req.set(boost::beast::http::field::content_type, "application/json");
-    embedded_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    embedded_req.body() = boost::json::serialize(request_body);
-    embedded_req.prepare_payload();
-    boost::json::value embedded_res = co_await client(std::move(embedded_req));
-    co_return embedded_res;
+    return call_json(endpoints::embeddings, request_body);
+}
+
+boost::asio::awaitable<cppai::embedding_response> cppai::openAI::create_embedding(const embedding_request& request_body) const {
+    return call_json(endpoints::embeddings, request_body, typed_decoder<embedding_response>{});
+}
+
+boost::asio::awaitable<cppai::embedding_result> cppai::openAI::create_embedding_matrix(const boost::json::value& request_body) const {
+    return call_json(endpoints::embeddings, request_body, embedding_decoder{});
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_transcription(boost::filesystem::path file, std::string_view model,
     ::cppai::utility::audio_req_builder&& opt_params) const {
-    ::cppai::utility::audio_req opt_vals = std::move(opt_params.req);
     boost::nowide::nowide_filesystem();
-    boost::nowide::ifstream file_stream{ file, std::ios_base::binary };
-    boost::beast::http::request<boost::beast::http::string_body> trnscrp_req;
-    trnscrp_req.method(boost::beast::http::verb::post);
-    trnscrp_req.set(boost::beast::http::field::host, host);
-    trnscrp_req.version(http_ver);
-    trnscrp_req.target("/v1/audio/transcriptions");
-    trnscrp_req.set(boost::beast::http::field::organization, organization_id);
-    trnscrp_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    trnscrp_req.set(boost::beast::http::field::content_type, "multipart/form-data; boundary=boundary");
-    trnscrp_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-    const std::string boundary = "boundary";
-    std::stringstream body_stream;
-    body_stream << "--" << boundary << "\r\n"
-        << "Content-Disposition: form-data; name=\"file\"; filename=\"" << file.filename().string() << "\"\r\n"
-        << "Content-Type: application/octet-stream\r\n"
-        << "\r\n" << file_stream.rdbuf() << "\r\n"
-        << "--" << boundary << "\r\n"
-        << "Content-Disposition: form-data; name=\"model\"\r\n"
-        << "\r\n" << model << "\r\n"
-        << "--" << boundary << "\r\n";
-    if (opt_vals.prompt.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"prompt\"\r\n"
-            << "\r\n" << opt_vals.prompt.value() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-    if (opt_vals.temp.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"temperature\"\r\n"
-            << "\r\n" << opt_vals.temp.value() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-    if (opt_vals.lang.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"language\"\r\n"
-            << "\r\n" << opt_vals.lang.value() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-
-
-    trnscrp_req.body() = body_stream.str();
-    trnscrp_req.set(boost::beast::http::field::content_length, std::to_string(trnscrp_req.body().size()));
-    trnscrp_req.prepare_payload();
-
-    boost::json::value trnscrp_res = co_await client(std::move(trnscrp_req));
-    co_return trnscrp_res;
+
+    multipart_body::value_type form;
+    form.add_file("file", file, "application/octet-stream");
+    add_audio_fields(form, model, opt_params.req);
+    return call_form(endpoints::audio_transcriptions, std::move(form));
+}
+
+boost::asio::awaitable<boost::json::value> cppai::openAI::create_transcription(const audio_slice& audio, std::string_view model,
+    ::cppai::utility::audio_req_builder&& opt_params) const {
+    boost::nowide::nowide_filesystem();
+
+    multipart_body::value_type form;
+    form.add_file_slice("file", audio.filename, audio.head, audio.file, audio.offset, audio.length, "audio/wav");
+    add_audio_fields(form, model, opt_params.req);
+    return call_form(endpoints::audio_transcriptions, std::move(form));
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_translation(boost::filesystem::path file, std::string_view model,
     ::cppai::utility::audio_req_builder&& opt_params) const {
-    ::cppai::utility::audio_req opt_vals = std::move(opt_params.req);
     boost::nowide::nowide_filesystem();
-    boost::nowide::ifstream file_stream{ file, std::ios_base::binary };
-    boost::beast::http::request<boost::beast::http::string_body> translate_req;
-    translate_req.method(boost::beast::http::verb::post);
-    translate_req.set(boost::beast::http::field::host, host);
-    translate_req.version(http_ver);
-    translate_req.target("/v1/audio/translations");
-    translate_req.set(boost::beast::http::field::organization, organization_id);
-    translate_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    translate_req.set(boost::beast::http::field::content_type, "multipart/form-data; boundary=boundary");
-    translate_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-    const std::string boundary = "boundary";
-    std::stringstream body_stream;
-    body_stream << "--" << boundary << "\r\n"
-        << "Content-Disposition: form-data; name=\"file\"; filename=\"" << file.filename().string() << "\"\r\n"
-        << "Content-Type: application/octet-stream\r\n"
-        << "\r\n" << file_stream.rdbuf() << "\r\n"
-        << "--" << boundary << "\r\n"
-        << "Content-Disposition: form-data; name=\"model\"\r\n"
-        << "\r\n" << model << "\r\n"
-        << "--" << boundary << "\r\n";
-    if (opt_vals.prompt.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"prompt\"\r\n"
-            << "\r\n" << opt_vals.prompt.value() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-    if (opt_vals.temp.has_value()) {
-        body_stream << "Content-Disposition: form-data; name=\"temperature\"\r\n"
-            << "\r\n" << opt_vals.temp.value() << "\r\n"
-            << "--" << boundary << "\r\n";
-    }
-
-    translate_req.body() = body_stream.str();
-    translate_req.set(boost::beast::http::field::content_length, std::to_string(translate_req.body().size()));
-    translate_req.prepare_payload();
-
-    boost::json::value translate_res = co_await client(std::move(translate_req));
-    co_return translate_res;
+
+    multipart_body::value_type form;
+    form.add_file("file", file, "application/octet-stream");
+    add_audio_fields(form, model, opt_params.req);
+    return call_form(endpoints::audio_translations, std::move(form));
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::files_list() const {
-    boost::beast::http::request<boost::beast::http::string_body> files_list_req;
-    files_list_req.method(boost::beast::http::verb::get);
-    files_list_req.set(boost::beast::http::field::host, host);
-    files_list_req.version(http_ver);
-    files_list_req.target("/v1/files");
-    files_list_req.set(boost::beast::http::field::organization, organization_id);
-    files_list_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    files_list_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    files_list_req.prepare_payload();
-    boost::json::value files_res = co_await client(std::move(files_list_req));
-    co_return files_res;
+    return call(endpoints::list_files);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::delete_file(std::string_view id) const {
-    boost::beast::http::request<boost::beast::http::string_body> file_del_req;
-    file_del_req.method(boost::beast::http::verb::delete_);
-    file_del_req.set(boost::beast::http::field::host, host);
-    file_del_req.version(http_ver);
-    file_del_req.target("/v1/files/" + std::string{ id });
-    file_del_req.set(boost::beast::http::field::organization, organization_id);
-    file_del_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    file_del_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    file_del_req.prepare_payload();
-    boost::json::value file_del_res = co_await client(std::move(file_del_req));
-    co_return file_del_res;
+    return call(endpoints::delete_file, id);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::retrieve_file(std::string_view id) const {
-    boost::beast::http::request<boost::beast::http::string_body> file_ret_req;
-    file_ret_req.method(boost::beast::http::verb::get);
-    file_ret_req.set(boost::beast::http::field::host, host);
-    file_ret_req.version(http_ver);
-    file_ret_req.target("/v1/files/" + std::string{ id } + "/content");
-    file_ret_req.set(boost::beast::http::field::organization, organization_id);
-    file_ret_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    file_ret_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    file_ret_req.prepare_payload();
-    boost::json::value file_ret_res = co_await client(std::move(file_ret_req));
-    co_return file_ret_res;
+    return call(endpoints::file_content, id);
+}
+
+boost::asio::awaitable<cppai::download_result> cppai::openAI::download_file(std::string_view id, download_sink sink,
+    download_options opts) const {
+    api_request<json_body> download_req = request_for<json_body>(endpoints::file_content, id);
+    download_req.prepare_payload();
+    download_result download_res = co_await download_client(std::move(download_req), sink, opts);
+    co_return download_res;
+}
+
+boost::asio::awaitable<cppai::download_result> cppai::openAI::download_file(std::string_view id, const boost::filesystem::path& path,
+    download_options opts) const {
+    boost::beast::error_code error_code;
+    const bool append = opts.continue_partial && boost::filesystem::exists(path);
+    boost::beast::file out;
+    out.open(path.string().c_str(), append ? boost::beast::file_mode::append : boost::beast::file_mode::write, error_code);
+    if (!error_code && append) {
+        opts.offset = out.size(error_code);
+    }
+    if (error_code) {
+        throw boost::system::system_error(error_code, path.string());
+    }
+    download_result download_res = co_await download_file(id, [&out](std::string_view chunk) {
+        while (!chunk.empty()) {
+            boost::beast::error_code write_error;
+            chunk.remove_prefix(out.write(chunk.data(), chunk.size(), write_error));
+            if (write_error) {
+                throw boost::system::system_error(write_error);
+            }
+        }
+    }, opts);
+    co_return download_res;
+}
+
+boost::asio::awaitable<cppai::download_result> cppai::openAI::download_jsonl(std::string_view id, jsonl_parser::line_handler on_line,
+    download_options opts) const {
+    // Line boundaries are only known from the start of the file; resumes after a dropped connection are fine
+    // since the parser carries over.
+    opts.offset = 0;
+    opts.continue_partial = false;
+    jsonl_parser lines{ std::move(on_line) };
+    download_result download_res = co_await download_file(id, [&lines](std::string_view chunk) {
+        lines.write(chunk);
+    }, opts);
+    if (!download_res.error) {
+        lines.finish();
+    }
+    co_return download_res;
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_fine_tune(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> fine_tune_req;
-    fine_tune_req.method(boost::beast::http::verb::post);
-    fine_tune_req.set(boost::beast::http::field::host, host);
-    fine_tune_req.version(http_ver);
-    fine_tune_req.target("/v1/fine-tunes");
-    fine_tune_req.set(boost::beast::http::field::organization, organization_id);
-    fine_tune_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    fine_tune_req.set(boost::beast::http::field::content_type, "application/json");
-    fine_tune_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    fine_tune_req.body() = boost::json::serialize(request_body);
-    fine_tune_req.prepare_payload();
-    boost::json::value fine_tune_res = co_await client(std::move(fine_tune_req));
-    co_return fine_tune_res;
+    return call_json(endpoints::create_fine_tune, request_body);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::list_fine_tunes() const {
-    boost::beast::http::request<boost::beast::http::string_body> fn_list_req;
-    fn_list_req.method(boost::beast::http::verb::get);
-    fn_list_req.set(boost::beast::http::field::host, host);
-    fn_list_req.version(http_ver);
-    fn_list_req.target("/v1/fine-tunes");
-    fn_list_req.set(boost::beast::http::field::organization, organization_id);
-    fn_list_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    fn_list_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    fn_list_req.prepare_payload();
-    boost::json::value fn_list_res = co_await client(std::move(fn_list_req));
-    co_return fn_list_res;
+    return call(endpoints::list_fine_tunes);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::retrieve_fine_tune(std::string_view id) const {
-    boost::beast::http::request<boost::beast::http::string_body> ftune_ret_req;
-    ftune_ret_req.method(boost::beast::http::verb::get);
-    ftune_ret_req.set(boost::beast::http::field::host, host);
-    ftune_ret_req.version(http_ver);
-    ftune_ret_req.target("/v1/fine-tunes/" + std::string{ id });
-    ftune_ret_req.set(boost::beast::http::field::organization, organization_id);
-    ftune_ret_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    ftune_ret_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    ftune_ret_req.prepare_payload();
-    boost::json::value ftune_ret_res = co_await client(std::move(ftune_ret_req));
-    co_return ftune_ret_res;
+    return call(endpoints::retrieve_fine_tune, id);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::cancel_fine_tune(std::string_view id) const {
-    boost::beast::http::request<boost::beast::http::string_body> ftune_cancel_req;
-    ftune_cancel_req.method(boost::beast::http::verb::post);
-    ftune_cancel_req.set(boost::beast::http::field::host, host);
-    ftune_cancel_req.version(http_ver);
-    ftune_cancel_req.target("/v1/fine-tunes/" + std::string{ id } + "/cancel");
-    ftune_cancel_req.set(boost::beast::http::field::organization, organization_id);
-    ftune_cancel_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    ftune_cancel_req.set(boost::beast::http::field::content_type, "application/json");
-    ftune_cancel_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    ftune_cancel_req.prepare_payload();
-    boost::json::value ftune_cancel_res = co_await client(std::move(ftune_cancel_req));
-    co_return ftune_cancel_res;
+    return call(endpoints::cancel_fine_tune, id);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::fine_tune_events(std::string_view id) const {
-    boost::beast::http::request<boost::beast::http::string_body> ftune_events_req;
-    ftune_events_req.method(boost::beast::http::verb::get);
-    ftune_events_req.set(boost::beast::http::field::host, host);
-    ftune_events_req.version(http_ver);
-    ftune_events_req.target("/v1/fine-tunes/" + std::string{ id } + "/events");
-    ftune_events_req.set(boost::beast::http::field::organization, organization_id);
-    ftune_events_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    ftune_events_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    ftune_events_req.prepare_payload();
-    boost::json::value ftune_events_res = co_await client(std::move(ftune_events_req));
-    co_return ftune_events_res;
+    return call(endpoints::fine_tune_events, id);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::delete_fine_tune(std::string_view id) const {
-    boost::beast::http::request<boost::beast::http::string_body> ftune_del_req;
-    ftune_del_req.method(boost::beast::http::verb::delete_);
-    ftune_del_req.set(boost::beast::http::field::host, host);
-    ftune_del_req.version(http_ver);
-    ftune_del_req.target("/v1/models/" + std::string{ id });
-    ftune_del_req.set(boost::beast::http::field::organization, organization_id);
-    ftune_del_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    ftune_del_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    ftune_del_req.prepare_payload();
-    boost::json::value ftune_del_res = co_await client(std::move(ftune_del_req));
-    co_return ftune_del_res;
+    return call(endpoints::delete_model, id);
 }
 
 boost::asio::awaitable<boost::json::value> cppai::openAI::create_moderations(const boost::json::value& request_body) const {
-    boost::beast::http::request<boost::beast::http::string_body> moderations_req;
-    moderations_req.method(boost::beast::http::verb::post);
-    moderations_req.set(boost::beast::http::field::host, host);
-    moderations_req.version(http_ver);
-    moderations_req.target("/v1/moderations");
-    moderations_req.set(boost::beast::http::field::organization, organization_id);
-    moderations_req.set(boost::beast::http::field::authorization, "Bearer " + key);
-    moderations_req.set(boost::beast::http::field::content_type, "application/json");
-    moderations_req.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-    moderations_req.body() = boost::json::serialize(request_body);
-    moderations_req.prepare_payload();
-    boost::json::value moderations_res = co_await client(std::move(moderations_req));
-    co_return moderations_res;
+    return call_json(endpoints::moderations, request_body);
+}
+
+boost::asio::awaitable<boost::json::value> cppai::openAI::post(std::string_view target, const boost::json::value& request_body,
+    ::cppai::utility::response_meta* meta) const {
+    return call_json(endpoint{ boost::beast::http::verb::post, target, body_kind::json, "application/json" }, request_body, json_decoder{}, meta);
 }
 
-boost::asio::awaitable<boost::json::value> cppai::openAI::client(boost::beast::http::request<boost::beast::http::string_body>&& request) const {
-    auto resolver = boost::asio::use_awaitable.as_default_on(boost::asio::ip::tcp::resolver(co_await boost::asio::this_coro::executor));
-    boost::beast::ssl_stream<tcp_stream> stream{
-    boost::asio::use_awaitable.as_default_on(boost::beast::tcp_stream(co_await boost::asio::this_coro::executor)), ssl_ctx };
+boost::asio::awaitable<boost::json::value> cppai::openAI::post(std::string_view target, const boost::json::value& request_body,
+    boost::json::storage_ptr storage, ::cppai::utility::response_meta* meta) const {
+    return call_json(endpoint{ boost::beast::http::verb::post, target, body_kind::json, "application/json" }, request_body,
+        json_decoder{ std::move(storage) }, meta);
+}
 
-    if (!SSL_set_tlsext_host_name(stream.native_handle(), host.c_str())) {
-        throw::boost::system::system_error(static_cast<std::int32_t>(ERR_get_error()), boost::asio::ssl::error::get_stream_category());
+boost::asio::awaitable<boost::json::value> cppai::openAI::post(std::string_view target, const boost::json::value& request_body,
+    const retry_policy& retries, ::cppai::utility::response_meta* meta) const {
+    return call_json(endpoint{ boost::beast::http::verb::post, target, body_kind::json, "application/json" }, request_body, json_decoder{},
+        meta, &retries);
+}
+
+boost::asio::awaitable<cppai::extracted_fields> cppai::openAI::post_fields(std::string_view target, const boost::json::value& request_body,
+    std::vector<std::string> pointers, ::cppai::utility::response_meta* meta) const {
+    return call_json(endpoint{ boost::beast::http::verb::post, target, body_kind::json, "application/json" }, request_body,
+        field_decoder{ std::move(pointers) }, meta);
+}
+
+void cppai::openAI::rebuild_header_block() {
+    // The headers shared by every call are built once here; requests start as a copy of this block. Host is
+    // set per attempt since it depends on the backend picked.
+    header_block = {};
+    header_block.version(http_ver);
+    if (!organization_id.empty()) {
+        header_block.set(boost::beast::http::field::organization, organization_id);
     }
+    header_block.set(boost::beast::http::field::authorization, "Bearer " + key);
+    header_block.set(boost::beast::http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    if (policy.compression.accept_gzip) {
+        header_block.set(boost::beast::http::field::accept_encoding, "gzip");
+    }
+}
 
-    boost::asio::ip::tcp::resolver::results_type endpoints;
-    endpoints = co_await resolver.async_resolve(host, port);
-    co_await boost::beast::get_lowest_layer(stream).async_connect(endpoints);
-    co_await stream.async_handshake(boost::asio::ssl::stream_base::client);
+template <class Body, class... BodyArgs>
+cppai::api_request<Body> cppai::openAI::request_for(const endpoint& target, std::string_view id, BodyArgs&&... body) const {
+    api_request<Body> request{ header_block, std::forward<BodyArgs>(body)... };
+    request.method(target.method);
+    request.target(target.resolve(id));
+    if (target.body == body_kind::json) {
+        request.set(boost::beast::http::field::content_type, boost::beast::string_view{ target.content_type.data(), target.content_type.size() });
+    }
+    return request;
+}
 
-    co_await boost::beast::http::async_write(stream, request);
-    boost::beast::flat_buffer buffer;
-    boost::beast::http::response<boost::beast::http::dynamic_body> response;
-    co_await boost::beast::http::async_read(stream, buffer, response);
+template <class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::call(endpoint target, std::string_view id, Decoder decode) const {
+    api_request<json_body> request = request_for<json_body>(target, id);
+    request.prepare_payload();
+    co_return co_await client(std::move(request), std::move(decode));
+}
 
-    boost::beast::get_lowest_layer(stream).expires_after(std::chrono::seconds(30));
+template <class Payload, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::call_json(endpoint target, const Payload& payload, Decoder decode,
+    ::cppai::utility::response_meta* meta, const retry_policy* retries) const {
+    api_request<json_body> request = request_for<json_body>(target);
+    if constexpr (std::is_same_v<Payload, boost::json::value>) {
+        serialize_into(payload, request.body());
+    }
+    else {
+        write_json(payload, request.body());
+    }
+    request.prepare_payload();
 
-    boost::beast::get_lowest_layer(stream).cancel();
+    if constexpr (std::is_same_v<Payload, boost::json::value> && std::is_same_v<Decoder, json_decoder>) {
+        if (target.cache != cache_mode::never && meta == nullptr && retries == nullptr && !decode.storage.has_value()) {
+            const bool cacheable = target.cache == cache_mode::always || deterministic(payload);
+            co_return co_await cached_client(std::move(request), payload, cacheable);
+        }
+    }
+    co_return co_await client(std::move(request), std::move(decode), meta, retries);
+}
+
+template <class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::call_form(endpoint target, multipart_body::value_type form,
+    Decoder decode) const {
+    form.close();
+    std::string content_type{ target.content_type };
+    content_type.append("; boundary=").append(form.boundary());
+    api_request<multipart_body> request = request_for<multipart_body>(target, {}, std::move(form));
+    request.set(boost::beast::http::field::content_type, content_type);
+    request.prepare_payload();
+    co_return co_await client(std::move(request), std::move(decode));
+}
+
+boost::asio::awaitable<void> cppai::openAI::call_stream(endpoint target, const boost::json::value& payload, sse_parser::event_handler on_chunk) const {
+    boost::json::value stream_body = payload;
+    stream_body.as_object()["stream"] = true;
+
+    api_request<json_body> request = request_for<json_body>(target);
+    serialize_into(stream_body, request.body());
+    request.prepare_payload();
+    co_await stream_client(std::move(request), on_chunk);
+}
+
+template <class RequestBody, class ResponseBody>
+boost::asio::awaitable<cppai::connection_pool::connection_ptr> cppai::openAI::send(api_request<RequestBody>& request, const backend& target,
+    std::optional<api_response_parser<ResponseBody>>& parser, std::chrono::steady_clock::time_point deadline, request_trace* trace) const {
+    request.keep_alive(pool->options().enabled);
+
+    for (;;) {
+        connection_pool::connection_ptr conn = co_await pool->acquire(ssl_ctx, target.host, target.port, policy.timeouts, deadline, trace);
+        // From here on the server may act on the request, so total cancellation is no longer possible.
+        co_await accept_cancellation(boost::asio::enable_partial_cancellation());
+        const bool reused = conn->served != 0;
+        parser.emplace();
+
+        boost::system::error_code error_code;
+        {
+            const phase_timer timer{ trace, phase::write };
+            boost::beast::get_lowest_layer(conn->stream).expires_after(phase_budget(policy.timeouts.write, deadline));
+            std::tie(error_code, std::ignore) = co_await boost::beast::http::async_write(conn->stream, request,
+                boost::asio::as_tuple(boost::asio::use_awaitable));
+        }
+        if (error_code) {
+            conn.reset();
+            // The server closed an idle keep-alive socket before it took the request: resend on a fresh connection.
+            if (reused && (error_code == boost::asio::error::eof || error_code == boost::asio::error::connection_reset
+                || error_code == boost::asio::error::broken_pipe || error_code == boost::asio::ssl::error::stream_truncated)) {
+                continue;
+            }
+            throw boost::system::system_error(error_code);
+        }
+
+        {
+            const phase_timer timer{ trace, phase::first_byte };
+            boost::beast::get_lowest_layer(conn->stream).expires_after(phase_budget(policy.timeouts.read, deadline));
+            std::tie(error_code, std::ignore) = co_await boost::beast::http::async_read_header(conn->stream, conn->buffer, *parser,
+                boost::asio::as_tuple(boost::asio::use_awaitable));
+        }
+        if (error_code) {
+            // The whole request went out, so the server may have acted on it; whether to send it again is up to
+            // the retry policy.
+            conn.reset();
+            throw boost::system::system_error(error_code);
+        }
+        co_return conn;
+    }
+}
+
+boost::asio::awaitable<void> cppai::openAI::finish(connection_pool::connection_ptr conn, bool keep_alive) const {
+    boost::beast::get_lowest_layer(conn->stream).expires_never();
+    if (keep_alive && pool->options().enabled) {
+        pool->release(std::move(conn));
+    }
+    else {
+        co_await pool->shutdown(std::move(conn));
+    }
+}
 
-    auto [error_code] = co_await stream.async_shutdown(boost::asio::as_tuple(boost::asio::use_awaitable));
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::attempt(api_request<RequestBody>& request, const Decoder& decode,
+    ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const {
+    backend_lease lease = current_backends()->pick();
+    request.set(boost::beast::http::field::host, lease.authority());
 
-    if (error_code == boost::asio::error::eof) {
-        error_code = decltype(error_code){};
+    typename Decoder::result_type result;
+    try {
+        bool compress = false;
+        if constexpr (std::is_same_v<RequestBody, json_body>) {
+            compress = lease.target().gzip_requests && request.body().size() >= policy.compression.min_size
+                && request.count(boost::beast::http::field::content_encoding) == 0;
+        }
+        if (compress) {
+            // The gzip body deflates the JSON as it is written; the request itself stays plain for retries.
+            api_request<gzip_body<RequestBody>> compressed{ request.base(),
+                typename gzip_body<RequestBody>::value_type{ &request.body(), policy.compression.level } };
+            compressed.set(boost::beast::http::field::content_encoding, "gzip");
+            compressed.chunked(true);
+            result = co_await transport_attempt(compressed, lease.target(), decode, meta, deadline, trace);
+        }
+        else {
+            result = co_await transport_attempt(request, lease.target(), decode, meta, deadline, trace);
+        }
     }
-    else if (error_code == boost::asio::ssl::error::stream_truncated) {
-        error_code = decltype(error_code){};
+    catch (const boost::system::system_error& e) {
+        // A cancelled hedge copy says nothing about the backend's health.
+        if (e.code() != boost::asio::error::operation_aborted) {
+            lease.failed();
+        }
+        throw;
+    }
+    if (meta.status >= 500) {
+        lease.failed();
     }
     else {
-        throw boost::system::system_error(error_code, "Shutdown exit");
+        lease.succeeded();
+    }
+    co_return result;
+}
+
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::transport_attempt(api_request<RequestBody>& request, const backend& target,
+    const Decoder& decode, ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const {
+    std::shared_ptr<h2_session> session;
+    if (transport_mode == transport::http2) {
+        session = co_await h2->acquire(ssl_ctx, target.host, target.port, policy.timeouts, deadline, trace);
+    }
+    if (session) {
+        co_return co_await h2_attempt(std::move(session), request, decode, meta, deadline, trace);
+    }
+    co_return co_await http1_attempt(request, target, decode, meta, deadline, trace);
+}
+
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::http1_attempt(api_request<RequestBody>& request, const backend& target,
+    const Decoder& decode, ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const {
+    std::optional<api_response_parser<flat_body>> parser;
+    connection_pool::connection_ptr conn = co_await send(request, target, parser, deadline, trace);
+    meta = ::cppai::utility::read_response_meta(parser->get().base());
+
+    // A decoder with begin() takes the body a chunk at a time as it is read, so it is never held whole.
+    if constexpr (requires { decode.begin(meta.status); }) {
+        api_response_parser<boost::beast::http::buffer_body> reading{ std::move(*parser) };
+        reading.body_limit(boost::none);
+        auto decoding = decode.begin(meta.status);
+        std::optional<gzip_inflater> inflater;
+        boost::beast::flat_buffer inflated;
+        if (gzip_encoded(reading.get().base())) {
+            inflater.emplace();
+        }
+
+        std::array<char, 16384> chunk;
+        {
+            const phase_timer timer{ trace, phase::body };
+            while (!reading.is_done()) {
+                reading.get().body().data = chunk.data();
+                reading.get().body().size = chunk.size();
+                boost::beast::get_lowest_layer(conn->stream).expires_after(phase_budget(policy.timeouts.read, deadline));
+                boost::system::error_code error_code;
+                std::tie(error_code, std::ignore) = co_await boost::beast::http::async_read(conn->stream, conn->buffer, reading,
+                    boost::asio::as_tuple(boost::asio::use_awaitable));
+                if (error_code == boost::beast::http::error::need_buffer) {
+                    error_code = {};
+                }
+                if (error_code) {
+                    throw boost::system::system_error(error_code);
+                }
+
+                std::string_view received{ chunk.data(), chunk.size() - reading.get().body().size };
+                if (trace != nullptr) {
+                    trace->bytes_in += received.size();
+                }
+                if (inflater) {
+                    inflated.clear();
+                    inflater->write(received, inflated);
+                    received = std::string_view{ static_cast<const char*>(inflated.data().data()), inflated.size() };
+                }
+                decoding.write(received);
+            }
+            if (inflater) {
+                inflater->finish();
+            }
+        }
+
+        typename Decoder::result_type result = decoding.finish();
+        co_await finish(std::move(conn), reading.get().keep_alive());
+        co_return result;
+    }
+
+    // The body is read into the connection's own buffer, whose capacity carries over from the last response,
+    // and decoded where it lies. A gzip body is inflated into that buffer as it arrives.
+    boost::beast::flat_buffer body;
+    bool keep_alive = false;
+    {
+        const phase_timer timer{ trace, phase::body };
+        boost::beast::get_lowest_layer(conn->stream).expires_after(phase_budget(policy.timeouts.read, deadline));
+        if (gzip_encoded(parser->get().base())) {
+            api_response_parser<gzip_flat_body> inflating{ std::move(*parser) };
+            inflating.body_limit(std::numeric_limits<std::uint64_t>::max());
+            inflating.get().body().buffer = std::move(conn->body);
+            co_await boost::beast::http::async_read(conn->stream, conn->buffer, inflating);
+            body = std::move(inflating.get().body().buffer);
+            keep_alive = inflating.get().keep_alive();
+        }
+        else {
+            parser->body_limit(std::numeric_limits<std::uint64_t>::max());
+            parser->get().body() = std::move(conn->body);
+            co_await boost::beast::http::async_read(conn->stream, conn->buffer, *parser);
+            body = std::move(parser->get().body());
+            keep_alive = parser->get().keep_alive();
+        }
+    }
+
+    if (trace != nullptr) {
+        trace->bytes_in += body.size();
+    }
+    typename Decoder::result_type result;
+    {
+        const phase_timer timer{ trace, phase::decode };
+        result = decode(meta.status, std::string_view{ static_cast<const char*>(body.data().data()), body.size() });
+    }
+    body.clear();
+    if (body.capacity() > connection_pool::max_retained_body) {
+        body.shrink_to_fit();
+    }
+    conn->body = std::move(body);
+
+    co_await finish(std::move(conn), keep_alive);
+    co_return result;
+}
+
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::h2_attempt(std::shared_ptr<h2_session> session,
+    api_request<RequestBody>& request, const Decoder& decode, ::cppai::utility::response_meta& meta,
+    std::chrono::steady_clock::time_point deadline, request_trace* trace) const {
+    // The exchange runs on the session's strand; only the finished response crosses back to this coroutine.
+    // co_spawn passes cancellation on to it, and a cancelled stream is reset while the session carries on.
+    co_await accept_cancellation(boost::asio::enable_partial_cancellation());
+    h2_response response = co_await boost::asio::co_spawn(session->strand(), session->exchange(request, deadline, trace),
+        boost::asio::use_awaitable);
+    meta = ::cppai::utility::read_response_meta(response.header);
+    if (trace != nullptr) {
+        trace->bytes_in += response.body.size();
+    }
+    const phase_timer timer{ trace, phase::decode };
+    co_return decode(meta.status, std::string_view{ static_cast<const char*>(response.body.data().data()), response.body.size() });
+}
+
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::delayed_attempt(api_request<RequestBody>& request, const Decoder& decode,
+    ::cppai::utility::response_meta& meta, std::chrono::steady_clock::duration delay, std::chrono::steady_clock::time_point deadline,
+    request_trace* trace) const {
+    boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+    co_await timer.async_wait(boost::asio::use_awaitable);
+    co_return co_await attempt(request, decode, meta, deadline, trace);
+}
+
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::hedged_attempt(const api_request<RequestBody>& request, const Decoder& decode,
+    ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const {
+    using namespace boost::asio::experimental::awaitable_operators;
+    const std::string_view target{ request.target().data(), request.target().size() };
+    std::chrono::steady_clock::duration delay = policy.hedging.delay.value_or(std::chrono::steady_clock::duration::max());
+    if (!policy.hedging.delay.has_value()) {
+        const auto observed = latencies->quantile(target, policy.hedging.quantile, policy.hedging.min_samples);
+        if (!observed.has_value()) {
+            api_request<RequestBody> only_req{ request };
+            co_return co_await attempt(only_req, decode, meta, deadline, trace);
+        }
+        delay = std::max(observed.value(), policy.hedging.min_delay);
+    }
+
+    // Whichever copy finishes first wins; the || operator cancels the other, which closes its socket.
+    api_request<RequestBody> primary_req{ request };
+    api_request<RequestBody> hedge_req{ request };
+    ::cppai::utility::response_meta primary_meta;
+    ::cppai::utility::response_meta hedge_meta;
+    std::optional<request_trace> primary_trace;
+    std::optional<request_trace> hedge_trace;
+    if (trace != nullptr) {
+        primary_trace.emplace(*trace);
+        hedge_trace.emplace(*trace);
     }
+    auto winner = co_await (attempt(primary_req, decode, primary_meta, deadline, primary_trace ? &*primary_trace : nullptr)
+        || delayed_attempt(hedge_req, decode, hedge_meta, delay, deadline, hedge_trace ? &*hedge_trace : nullptr));
+    if (winner.index() == 0) {
+        meta = primary_meta;
+        if (trace != nullptr) {
+            *trace = *primary_trace;
+        }
+        co_return std::get<0>(std::move(winner));
+    }
+    meta = hedge_meta;
+    if (trace != nullptr) {
+        *trace = *hedge_trace;
+    }
+    co_return std::get<1>(std::move(winner));
+}
+
+template <class RequestBody, class Decoder>
+boost::asio::awaitable<typename Decoder::result_type> cppai::openAI::client(api_request<RequestBody>&& request, Decoder decode,
+    ::cppai::utility::response_meta* meta, const retry_policy* retry_override) const {
+    const retry_policy& retries = retry_override != nullptr ? *retry_override : policy.retries;
+    const std::string target{ request.target().data(), request.target().size() };
+    // Two copies of an incremental decode would both feed its sink.
+    bool hedge = policy.hedging.enabled && hedgeable(request.method(), target);
+    if constexpr (requires { decode.begin(std::uint32_t{}); }) {
+        hedge = false;
+    }
+    const auto deadline = deadline_after(policy.timeouts.total);
+    // Nothing has reached the server while the call waits for a connection, so until send() narrows it any
+    // cancellation type ends the call.
+    co_await accept_cancellation(boost::asio::enable_total_cancellation());
+
+    for (std::uint16_t attempt_no = 1;; ++attempt_no) {
+        ::cppai::utility::response_meta attempt_meta;
+        typename Decoder::result_type result;
+        std::exception_ptr error;
+        boost::system::error_code error_code;
+        bool cancelled = false;
+        std::optional<request_trace> trace;
+        if (metrics_sink) {
+            trace.emplace();
+            trace->bytes_out = request.payload_size().value_or(0);
+        }
+        const auto started = std::chrono::steady_clock::now();
+        try {
+            const phase_timer timer{ trace ? &*trace : nullptr, phase::total };
+            if (hedge) {
+                result = co_await hedged_attempt(request, decode, attempt_meta, deadline, trace ? &*trace : nullptr);
+            }
+            else {
+                result = co_await attempt(request, decode, attempt_meta, deadline, trace ? &*trace : nullptr);
+            }
+        }
+        catch (const boost::system::system_error& e) {
+            error = std::current_exception();
+            error_code = e.code();
+            cancelled = e.code() == boost::asio::error::operation_aborted;
+        }
+        catch (...) {
+            error = std::current_exception();
+            error_code = boost::system::errc::make_error_code(boost::system::errc::io_error);
+        }
+
+        if (hedge && !error && attempt_meta.status < 400) {
+            latencies->record(target, std::chrono::steady_clock::now() - started);
+        }
+        if (metrics_sink) {
+            const auto method = request.method_string();
+            metrics_sink->record(target, std::string_view{ method.data(), method.size() }, *trace, attempt_meta.status, attempt_no, error_code);
+        }
+
+        const bool retry_status = std::find(retries.statuses.begin(), retries.statuses.end(), attempt_meta.status) != retries.statuses.end();
+        const bool transport_error = error && !cancelled && attempt_meta.status == 0 && retries.retry_transport_errors
+            && (idempotent(request.method()) || retries.retry_non_idempotent);
+        std::chrono::steady_clock::duration delay = jittered_backoff(attempt_no, retries.base_delay, retries.max_delay);
+        if (retries.honor_retry_after && attempt_meta.retry_after.has_value()) {
+            delay = attempt_meta.retry_after.value();
+        }
+
+        if (attempt_no >= retries.max_attempts || !(retry_status || transport_error) || std::chrono::steady_clock::now() + delay >= deadline) {
+            if (meta != nullptr) {
+                *meta = attempt_meta;
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            co_return result;
+        }
+
+        if (metrics_sink) {
+            metrics_sink->record_retry(target);
+        }
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+        co_await timer.async_wait(boost::asio::use_awaitable);
+    }
+}
 
-    co_return boost::json::parse(boost::beast::buffers_to_string(response.body().data()));
-}
\ No newline at end of file
+boost::asio::awaitable<boost::json::value> cppai::openAI::cached_client(api_request<json_body>&& request,
+    const boost::json::value& request_body, bool deterministic) const {
+    if (!cache || !deterministic) {
+        co_return co_await client(std::move(request));
+    }
+    // Only hashed, so the key itself never reaches the disk tier.
+    const std::string scope = current_backends()->identity() + '\n' + organization_id + '\n' + key;
+    const cache_key cached = response_cache::key(scope, std::string_view{ request.method_string().data(), request.method_string().size() },
+        std::string_view{ request.target().data(), request.target().size() }, request_body);
+    co_return co_await cache->get_or_fetch(cached, [this, &request]() {
+        return client(std::move(request));
+    });
+}
+
+boost::asio::awaitable<void> cppai::openAI::stream_client(api_request<json_body>&& request,
+    const sse_parser::event_handler& on_event) const {
+    const auto deadline = deadline_after(policy.timeouts.total);
+    co_await accept_cancellation(boost::asio::enable_total_cancellation());
+    request.set(boost::beast::http::field::accept, "text/event-stream");
+    std::optional<request_trace> trace;
+    if (metrics_sink) {
+        trace.emplace();
+        trace->bytes_out = request.body().size();
+    }
+    request_trace* const tracing = trace ? &*trace : nullptr;
+    std::uint32_t status = 0;
+    backend_lease lease = current_backends()->pick();
+    request.set(boost::beast::http::field::host, lease.authority());
+
+    try {
+        const phase_timer total_timer{ tracing, phase::total };
+        std::optional<api_response_parser<boost::beast::http::buffer_body>> parser;
+        connection_pool::connection_ptr conn = co_await send(request, lease.target(), parser, deadline, tracing);
+        parser->body_limit(boost::none);
+        status = parser->get().result_int();
+        // Only the time to the response header feeds the latency average; a stream runs as long as the model talks.
+        if (status >= 500) {
+            lease.failed();
+        }
+        else {
+            lease.succeeded();
+        }
+
+        // Error replies come back as a plain JSON document rather than an event stream.
+        const auto content_type = parser->get()[boost::beast::http::field::content_type];
+        const bool event_stream = boost::beast::iequals(content_type.substr(0, 17), "text/event-stream");
+        sse_parser events{ on_event };
+        boost::json::stream_parser plain;
+        std::optional<gzip_inflater> inflater;
+        boost::beast::flat_buffer inflated;
+        if (gzip_encoded(parser->get().base())) {
+            inflater.emplace();
+        }
+
+        std::array<char, 8192> chunk;
+        const phase_timer body_timer{ tracing, phase::body };
+        while (!parser->is_done()) {
+            parser->get().body().data = chunk.data();
+            parser->get().body().size = chunk.size();
+            boost::beast::get_lowest_layer(conn->stream).expires_after(phase_budget(policy.timeouts.read, deadline));
+            boost::system::error_code error_code;
+            std::tie(error_code, std::ignore) = co_await boost::beast::http::async_read(conn->stream, conn->buffer, *parser,
+                boost::asio::as_tuple(boost::asio::use_awaitable));
+            if (error_code == boost::beast::http::error::need_buffer) {
+                error_code = {};
+            }
+            if (error_code) {
+                throw boost::system::system_error(error_code);
+            }
+
+            std::string_view received{ chunk.data(), chunk.size() - parser->get().body().size };
+            if (tracing != nullptr) {
+                tracing->bytes_in += received.size();
+            }
+            if (inflater) {
+                inflated.clear();
+                inflater->write(received, inflated);
+                received = std::string_view{ static_cast<const char*>(inflated.data().data()), inflated.size() };
+            }
+            if (event_stream) {
+                events.write(received);
+            }
+            else {
+                plain.write(received.data(), received.size());
+            }
+        }
+
+        if (inflater) {
+            inflater->finish();
+        }
+        if (!event_stream) {
+            plain.finish();
+            on_event(plain.release());
+        }
+        co_await finish(std::move(conn), parser->get().keep_alive());
+    }
+    catch (const boost::system::system_error& e) {
+        if (e.code() != boost::asio::error::operation_aborted) {
+            lease.failed();
+        }
+        if (metrics_sink) {
+            metrics_sink->record(std::string_view{ request.target().data(), request.target().size() },
+                std::string_view{ request.method_string().data(), request.method_string().size() }, *trace, status, 1, e.code());
+        }
+        throw;
+    }
+    if (metrics_sink) {
+        metrics_sink->record(std::string_view{ request.target().data(), request.target().size() },
+            std::string_view{ request.method_string().data(), request.method_string().size() }, *trace, status, 1, {});
+    }
+}
+
+boost::asio::awaitable<cppai::download_result> cppai::openAI::download_client(api_request<json_body>&& request, const download_sink& sink,
+    const download_options& opts) const {
+    const retry_policy& retries = policy.retries;
+    const std::string target{ request.target().data(), request.target().size() };
+    // Byte offsets only line up with the stored representation, so the body is never asked for compressed.
+    request.set(boost::beast::http::field::accept_encoding, "identity");
+    // However long a multi-gigabyte body takes, only each read is bounded, by timeouts.read.
+    const auto deadline = std::chrono::steady_clock::time_point::max();
+    co_await accept_cancellation(boost::asio::enable_total_cancellation());
+
+    download_result result;
+    std::vector<char> chunk(std::max<std::size_t>(opts.buffer_size, 4096));
+    std::string validator;
+
+    for (std::uint16_t attempt_no = 1;; ++attempt_no) {
+        result.attempts = attempt_no;
+        const std::uint64_t position = opts.offset + result.bytes;
+        if (position != 0) {
+            request.set(boost::beast::http::field::range, "bytes=" + std::to_string(position) + "-");
+            if (!validator.empty()) {
+                request.set(boost::beast::http::field::if_range, validator);
+            }
+        }
+        backend_lease lease = current_backends()->pick();
+        request.set(boost::beast::http::field::host, lease.authority());
+        std::optional<request_trace> trace;
+        if (metrics_sink) {
+            trace.emplace();
+        }
+        request_trace* const tracing = trace ? &*trace : nullptr;
+
+        ::cppai::utility::response_meta meta;
+        std::string error_body;
+        std::exception_ptr error;
+        boost::system::error_code error_code;
+        bool in_sink = false;
+        bool replaced = false;
+        try {
+            const phase_timer total_timer{ tracing, phase::total };
+            std::optional<api_response_parser<boost::beast::http::buffer_body>> parser;
+            connection_pool::connection_ptr conn = co_await send(request, lease.target(), parser, deadline, tracing);
+            parser->body_limit(boost::none);
+            meta = ::cppai::utility::read_response_meta(parser->get().base());
+            result.status = meta.status;
+            if (meta.status >= 500) {
+                lease.failed();
+            }
+            else {
+                lease.succeeded();
+            }
+
+            // A server that ignored the Range header sends the whole file again; what was delivered is skipped.
+            // A 200 is also the answer to an If-Range that no longer matches, so once bytes have reached the sink
+            // the skip needs the same strong ETag they came with.
+            std::uint64_t skip = meta.status == 200 ? position : 0;
+            const auto etag = parser->get()[boost::beast::http::field::etag];
+            const bool strong = !etag.empty() && !etag.starts_with("W/");
+            if (skip != 0 && result.bytes != 0 && (validator.empty() || !strong || std::string_view{ etag.data(), etag.size() } != validator)) {
+                replaced = true;
+                throw download_error("the file changed after " + std::to_string(position) + " bytes were downloaded");
+            }
+            if (strong) {
+                validator.assign(etag.data(), etag.size());
+            }
+
+            const phase_timer body_timer{ tracing, phase::body };
+            while (!parser->is_done()) {
+                parser->get().body().data = chunk.data();
+                parser->get().body().size = chunk.size();
+                boost::beast::get_lowest_layer(conn->stream).expires_after(phase_budget(policy.timeouts.read, deadline));
+                boost::system::error_code read_error;
+                std::tie(read_error, std::ignore) = co_await boost::beast::http::async_read(conn->stream, conn->buffer, *parser,
+                    boost::asio::as_tuple(boost::asio::use_awaitable));
+                if (read_error == boost::beast::http::error::need_buffer) {
+                    read_error = {};
+                }
+                if (read_error) {
+                    throw boost::system::system_error(read_error);
+                }
+
+                std::string_view received{ chunk.data(), chunk.size() - parser->get().body().size };
+                if (tracing != nullptr) {
+                    tracing->bytes_in += received.size();
+                }
+                if (meta.status >= 400) {
+                    error_body.append(received);
+                    continue;
+                }
+                const auto skipped = static_cast<std::size_t>(std::min<std::uint64_t>(skip, received.size()));
+                received.remove_prefix(skipped);
+                skip -= skipped;
+                if (!received.empty()) {
+                    in_sink = true;
+                    sink(received);
+                    in_sink = false;
+                    result.bytes += received.size();
+                }
+            }
+            co_await finish(std::move(conn), parser->get().keep_alive());
+        }
+        catch (const boost::system::system_error& e) {
+            error = std::current_exception();
+            error_code = e.code();
+            if (!in_sink && e.code() != boost::asio::error::operation_aborted) {
+                lease.failed();
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+            error_code = boost::system::errc::make_error_code(boost::system::errc::io_error);
+        }
+
+        if (metrics_sink) {
+            const auto method = request.method_string();
+            metrics_sink->record(target, std::string_view{ method.data(), method.size() }, *trace, result.status, attempt_no, error_code);
+        }
+
+        const bool retry_status = !error && std::find(retries.statuses.begin(), retries.statuses.end(), meta.status) != retries.statuses.end();
+        const bool transport_error = error && !in_sink && !replaced && error_code != boost::asio::error::operation_aborted && opts.resume;
+        if (attempt_no >= retries.max_attempts || !(retry_status || transport_error)) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            if (meta.status >= 400) {
+                boost::json::error_code parse_error;
+                result.error = boost::json::parse(error_body, parse_error);
+                if (parse_error) {
+                    result.error = boost::json::string{ error_body };
+                }
+            }
+            co_return result;
+        }
+
+        std::chrono::steady_clock::duration delay = jittered_backoff(attempt_no, retries.base_delay, retries.max_delay);
+        if (retries.honor_retry_after && meta.retry_after.has_value()) {
+            delay = meta.retry_after.value();
+        }
+        if (metrics_sink) {
+            metrics_sink->record_retry(target);
+        }
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+        co_await timer.async_wait(boost::asio::use_awaitable);
+    }
+}
+
+bool cppai::openAI::idempotent(boost::beast::http::verb method) {
+    using boost::beast::http::verb;
+    return method == verb::get || method == verb::head || method == verb::put || method == verb::delete_ || method == verb::options;
+}
+
+bool cppai::openAI::hedgeable(boost::beast::http::verb method, std::string_view target) const {
+    if (method == boost::beast::http::verb::get || method == boost::beast::http::verb::head) {
+        return true;
+    }
+    return std::find(policy.hedging.targets.begin(), policy.hedging.targets.end(), target) != policy.hedging.targets.end();
+}
+
+bool cppai::openAI::deterministic(const boost::json::value& request_body) {
+    // Only greedy, single-choice, non-streaming completions return the same answer for the same body.
+    const boost::json::object* fields = request_body.if_object();
+    if (fields == nullptr) {
+        return false;
+    }
+    const boost::json::value* temperature = fields->if_contains("temperature");
+    if (temperature == nullptr || !temperature->is_number() || temperature->to_number<double>() != 0.0) {
+        return false;
+    }
+    if (const boost::json::value* n = fields->if_contains("n"); n != nullptr && !(n->is_number() && n->to_number<double>() == 1.0)) {
+        return false;
+    }
+    const boost::json::value* stream = fields->if_contains("stream");
+    return stream == nullptr || (stream->is_bool() && !stream->get_bool());
+}
@@ -6,11 +6,51 @@
 #include <boost/beast/ssl.hpp>
 #include <boost/json.hpp>
 #include <boost/nowide/fstream.hpp>
+#include <algorithm>
+#include <array>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string_view>
+#include "api_types.h"
+#include "audio.h"
+#include "balancer.h"
+#include "compression.h"
+#include "connection_pool.h"
+#include "download.h"
+#include "embedding.h"
+#include "endpoints.h"
+#include "http2.h"
+#include "images.h"
+#include "metrics.h"
+#include "multipart_body.h"
+#include "policy.h"
+#include "response_cache.h"
+#include "response_decoder.h"
+#include "sse.h"
 #include "utility.h"
 
 namespace cppai {
+    // http2 multiplexes concurrent calls as streams over a few connections per io_context. Servers that do
+    // not negotiate h2 through ALPN are reached over HTTP/1.1 instead; streaming calls always use HTTP/1.1.
+    enum class transport {
+        http1,
+        http2
+    };
+
+    // Calls may run concurrently from any number of threads and io_contexts. The set_* functions are
+    // not synchronized with calls in flight; use runtime::configure to change a running client.
+    //
+    // Every call honours the cancellation slot it runs under, whether through co_spawn, bind_cancellation_slot,
+    // cancel_after or the awaitable || operator, and fails with operation_aborted. Total cancellation ends a
+    // call only while nothing has been sent, such as while it waits for a pooled connection; partial and
+    // terminal cancellation end it at any point. A cancelled HTTP/1.1 connection is closed rather than pooled
+    // and a cancelled HTTP/2 stream is reset, leaving its session to other calls. A call changes the
+    // cancellation filter of the coroutine awaiting it to match. with_timeout and with_deadline give a single
+    // call a deadline, failing it with beast::error::timeout. Policy timeouts.total bounds every call except the
+    // download_* ones, whose reads are each bounded by timeouts.read however long the whole file takes.
     class openAI {
     public:
         openAI();
@@ -19,26 +59,85 @@ namespace cppai {
 
         void set_organization_id(std::string_view org_id);
 
+        void set_pool_options(pool_options opts);
+
+        void set_policy(request_policy new_policy);
+
+        void set_cache(std::shared_ptr<response_cache> new_cache);
+
+        void set_transport(transport mode);
+
+        // Every attempt's phase timings, sizes and status are recorded into sink; null turns tracing off.
+        void set_metrics(std::shared_ptr<metrics> sink);
+
+        // Shared with other clients by default; a private cache or a pinned one points this client elsewhere.
+        void set_dns_cache(std::shared_ptr<dns_cache> cache);
+
+        // Replaces the backends calls are spread over; the default is api.openai.com:443 alone. Safe while calls
+        // are in flight, which finish on the backend they picked; verify_peer and ca_file change the shared TLS
+        // context, though, so set those before the first call.
+        void set_endpoints(endpoint_config config);
+
+        std::vector<backend_stats> endpoint_stats() const;
+
         boost::asio::awaitable<boost::json::value> model_list() const;
 
         boost::asio::awaitable<boost::json::value> completion(const boost::json::value& request_body) const;
 
         boost::asio::awaitable<boost::json::value> chat_completion(const boost::json::value& request_body) const;
 
+        // Written and parsed through the described structs, without a JSON tree either way.
+        boost::asio::awaitable<chat_response> chat_completion(const chat_request& request_body) const;
+
+        boost::asio::awaitable<extracted_fields> chat_completion_fields(const boost::json::value& request_body,
+            std::vector<std::string> pointers) const;
+
+        boost::asio::awaitable<void> completion_stream(const boost::json::value& request_body, sse_parser::event_handler on_chunk) const;
+
+        boost::asio::awaitable<void> chat_completion_stream(const boost::json::value& request_body, sse_parser::event_handler on_chunk) const;
+
         boost::asio::awaitable<boost::json::value> edit(const boost::json::value& request_body) const;
 
         boost::asio::awaitable<boost::json::value> create_image(const boost::json::value& request_body) const;
 
+        // The image overloads taking a sink or a directory ask for b64_json unless the request names a
+        // response_format, and decode each image as it is read instead of building the response first. A
+        // directory gets one file per image, named by image_files.
+        boost::asio::awaitable<image_result> create_image(const boost::json::value& request_body, image_sink sink) const;
+
+        // The files take the request's output_format as their extension, png by default.
+        boost::asio::awaitable<image_result> create_image(const boost::json::value& request_body, const boost::filesystem::path& directory) const;
+
         boost::asio::awaitable<boost::json::value> image_edit(boost::filesystem::path image, std::string_view prompt,
             ::cppai::utility::img_req_builder&& opt_params = {}) const;
 
+        boost::asio::awaitable<image_result> image_edit(boost::filesystem::path image, std::string_view prompt, image_sink sink,
+            ::cppai::utility::img_req_builder&& opt_params = {}) const;
+
+        boost::asio::awaitable<image_result> image_edit(boost::filesystem::path image, std::string_view prompt,
+            const boost::filesystem::path& directory, ::cppai::utility::img_req_builder&& opt_params = {}) const;
+
         boost::asio::awaitable<boost::json::value> create_img_variation(boost::filesystem::path image, ::cppai::utility::img_req_builder&& opt_params = {}) const;
 
+        boost::asio::awaitable<image_result> create_img_variation(boost::filesystem::path image, image_sink sink,
+            ::cppai::utility::img_req_builder&& opt_params = {}) const;
+
+        boost::asio::awaitable<image_result> create_img_variation(boost::filesystem::path image, const boost::filesystem::path& directory,
+            ::cppai::utility::img_req_builder&& opt_params = {}) const;
+
         boost::asio::awaitable<boost::json::value> create_embedding(const boost::json::value& request_body) const;
 
+        boost::asio::awaitable<embedding_response> create_embedding(const embedding_request& request_body) const;
+
+        boost::asio::awaitable<embedding_result> create_embedding_matrix(const boost::json::value& request_body) const;
+
         boost::asio::awaitable<boost::json::value> create_transcription(boost::filesystem::path file, std::string_view model,
             ::cppai::utility::audio_req_builder&& opt_params = {}) const;
 
+        // Uploads only the slice, e.g. one segment of a recording planned with plan_segments.
+        boost::asio::awaitable<boost::json::value> create_transcription(const audio_slice& audio, std::string_view model,
+            ::cppai::utility::audio_req_builder&& opt_params = {}) const;
+
         boost::asio::awaitable<boost::json::value> create_translation(boost::filesystem::path file, std::string_view model,
             ::cppai::utility::audio_req_builder&& opt_params = {}) const;
 
@@ -48,6 +147,17 @@ namespace cppai {
 
         boost::asio::awaitable<boost::json::value> retrieve_file(std::string_view id) const;
 
+        // Streams a file's content to sink as it arrives, so JSONL and binary files of any size download in
+        // constant memory.
+        boost::asio::awaitable<download_result> download_file(std::string_view id, download_sink sink, download_options opts = {}) const;
+
+        boost::asio::awaitable<download_result> download_file(std::string_view id, const boost::filesystem::path& path,
+            download_options opts = {}) const;
+
+        // Calls on_line with each record of a JSON Lines file, e.g. fine-tune results, as it is received.
+        boost::asio::awaitable<download_result> download_jsonl(std::string_view id, jsonl_parser::line_handler on_line,
+            download_options opts = {}) const;
+
         boost::asio::awaitable<boost::json::value> create_fine_tune(const boost::json::value& request_body) const;
 
         boost::asio::awaitable<boost::json::value> list_fine_tunes() const;
@@ -62,21 +172,117 @@ namespace cppai {
 
         boost::asio::awaitable<boost::json::value> create_moderations(const boost::json::value& request_body) const;
 
+        boost::asio::awaitable<boost::json::value> post(std::string_view target, const boost::json::value& request_body,
+            ::cppai::utility::response_meta* meta = nullptr) const;
+
+        // With retries in place of the client's retry policy for this call, e.g. a single attempt for a caller
+        // that schedules its own retries.
+        boost::asio::awaitable<boost::json::value> post(std::string_view target, const boost::json::value& request_body,
+            const retry_policy& retries, ::cppai::utility::response_meta* meta = nullptr) const;
+
+        // The response is built on storage, which must outlive the returned value.
+        boost::asio::awaitable<boost::json::value> post(std::string_view target, const boost::json::value& request_body,
+            boost::json::storage_ptr storage, ::cppai::utility::response_meta* meta = nullptr) const;
+
+        boost::asio::awaitable<extracted_fields> post_fields(std::string_view target, const boost::json::value& request_body,
+            std::vector<std::string> pointers, ::cppai::utility::response_meta* meta = nullptr) const;
+
     private:
         std::string key;
         std::string organization_id;
 
         mutable boost::asio::ssl::context ssl_ctx;
-
-        static inline std::string host = "api.openai.com";
-        static inline std::string port = "443";
+        std::unique_ptr<connection_pool> pool;
+        std::unique_ptr<h2_pool> h2;
+        // Swapped whole by set_endpoints under backends_mtx; leases keep the one they came from alive.
+        std::shared_ptr<balancer> backends;
+        std::unique_ptr<std::mutex> backends_mtx;
+        transport transport_mode = transport::http1;
+        request_policy policy;
+        std::unique_ptr<latency_tracker> latencies;
+        std::shared_ptr<response_cache> cache;
+        std::shared_ptr<metrics> metrics_sink;
+        boost::beast::http::request_header<pooled_fields> header_block;
 
         static constexpr std::uint16_t http_ver = 11;
 
-        using default_executor = boost::asio::use_awaitable_t<>::executor_with_default<boost::asio::any_io_executor>;
-        using tcp_stream = typename boost::beast::tcp_stream::rebind_executor<default_executor>::other;
+        void rebuild_header_block();
+
+        std::shared_ptr<balancer> current_backends() const;
+
+        // The shared header block plus the endpoint's method, target and JSON content type.
+        template <class Body, class... BodyArgs>
+        api_request<Body> request_for(const endpoint& target, std::string_view id = {}, BodyArgs&&... body) const;
+
+        // The one path every public call takes to the transport; the public functions only build bodies.
+        template <class Decoder = json_decoder>
+        boost::asio::awaitable<typename Decoder::result_type> call(endpoint target, std::string_view id = {}, Decoder decode = {}) const;
+
+        // Payload is a boost::json::value, which may be answered from the response cache, or a described struct.
+        template <class Payload, class Decoder = json_decoder>
+        boost::asio::awaitable<typename Decoder::result_type> call_json(endpoint target, const Payload& payload, Decoder decode = {},
+            ::cppai::utility::response_meta* meta = nullptr, const retry_policy* retries = nullptr) const;
+
+        // Closes the form and sends it with its boundary.
+        template <class Decoder = json_decoder>
+        boost::asio::awaitable<typename Decoder::result_type> call_form(endpoint target, multipart_body::value_type form,
+            Decoder decode = {}) const;
+
+        boost::asio::awaitable<void> call_stream(endpoint target, const boost::json::value& payload, sse_parser::event_handler on_chunk) const;
+
+        template <class RequestBody, class ResponseBody>
+        boost::asio::awaitable<connection_pool::connection_ptr> send(api_request<RequestBody>& request, const backend& target,
+            std::optional<api_response_parser<ResponseBody>>& parser, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace) const;
+
+        boost::asio::awaitable<void> finish(connection_pool::connection_ptr conn, bool keep_alive) const;
+
+        template <class RequestBody, class Decoder>
+        boost::asio::awaitable<typename Decoder::result_type> attempt(api_request<RequestBody>& request, const Decoder& decode,
+            ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const;
+
+        template <class RequestBody, class Decoder>
+        boost::asio::awaitable<typename Decoder::result_type> transport_attempt(api_request<RequestBody>& request, const backend& target,
+            const Decoder& decode, ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace) const;
+
+        template <class RequestBody, class Decoder>
+        boost::asio::awaitable<typename Decoder::result_type> http1_attempt(api_request<RequestBody>& request, const backend& target,
+            const Decoder& decode, ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace) const;
+
+        template <class RequestBody, class Decoder>
+        boost::asio::awaitable<typename Decoder::result_type> h2_attempt(std::shared_ptr<h2_session> session, api_request<RequestBody>& request,
+            const Decoder& decode, ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const;
+
+        template <class RequestBody, class Decoder>
+        boost::asio::awaitable<typename Decoder::result_type> delayed_attempt(api_request<RequestBody>& request, const Decoder& decode,
+            ::cppai::utility::response_meta& meta, std::chrono::steady_clock::duration delay, std::chrono::steady_clock::time_point deadline,
+            request_trace* trace) const;
+
+        template <class RequestBody, class Decoder>
+        boost::asio::awaitable<typename Decoder::result_type> hedged_attempt(const api_request<RequestBody>& request, const Decoder& decode,
+            ::cppai::utility::response_meta& meta, std::chrono::steady_clock::time_point deadline, request_trace* trace) const;
+
+        template <class RequestBody, class Decoder = json_decoder>
+        boost::asio::awaitable<typename Decoder::result_type> client(api_request<RequestBody>&& request, Decoder decode = {},
+            ::cppai::utility::response_meta* meta = nullptr, const retry_policy* retries = nullptr) const;
+
+        boost::asio::awaitable<boost::json::value> cached_client(api_request<json_body>&& request,
+            const boost::json::value& request_body, bool deterministic) const;
+
+        boost::asio::awaitable<download_result> download_client(api_request<json_body>&& request, const download_sink& sink,
+            const download_options& opts) const;
+
+        boost::asio::awaitable<void> stream_client(api_request<json_body>&& request,
+            const sse_parser::event_handler& on_event) const;
+
+        // RFC 9110 section 9.2.2: sending one of these twice has the effect of sending it once.
+        static bool idempotent(boost::beast::http::verb method);
+
+        bool hedgeable(boost::beast::http::verb method, std::string_view target) const;
 
-        boost::asio::awaitable<boost::json::value> client(boost::beast::http::request<boost::beast::http::string_body>&& request) const;
+        static bool deterministic(const boost::json::value& request_body);
     };
 }
 
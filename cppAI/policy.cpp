@@ -0,0 +1,54 @@
+#include "policy.h"
+#include <algorithm>
+#include <random>
+
+void cppai::latency_tracker::record(std::string_view target, std::chrono::steady_clock::duration elapsed) {
+    std::lock_guard lock{ mtx };
+    auto found = windows.find(std::string{ target });
+    if (found == windows.end()) {
+        found = windows.emplace(std::string{ target }, window{}).first;
+    }
+    window& samples = found->second;
+    samples.samples[samples.next] = elapsed;
+    samples.next = (samples.next + 1) % samples.samples.size();
+    samples.count = std::min(samples.count + 1, samples.samples.size());
+}
+
+std::optional<std::chrono::steady_clock::duration> cppai::latency_tracker::quantile(std::string_view target, double q,
+    std::size_t min_samples) const {
+    std::array<std::chrono::steady_clock::duration, 256> sorted;
+    std::size_t count = 0;
+    {
+        std::lock_guard lock{ mtx };
+        const auto found = windows.find(std::string{ target });
+        if (found == windows.end() || found->second.count < std::max<std::size_t>(min_samples, 1)) {
+            return std::nullopt;
+        }
+        count = found->second.count;
+        std::copy_n(found->second.samples.begin(), count, sorted.begin());
+    }
+    const auto rank = static_cast<std::size_t>(std::clamp(q, 0.0, 1.0) * static_cast<double>(count - 1));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + count);
+    return sorted[rank];
+}
+
+std::chrono::steady_clock::duration cppai::phase_budget(std::chrono::steady_clock::duration phase, std::chrono::steady_clock::time_point deadline) {
+    const auto remaining = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero()) {
+        throw boost::system::system_error(boost::beast::error::timeout);
+    }
+    return std::min(phase, remaining);
+}
+
+std::chrono::steady_clock::time_point cppai::deadline_after(std::chrono::steady_clock::duration timeout) {
+    const auto now = std::chrono::steady_clock::now();
+    return now + std::min(timeout, std::chrono::steady_clock::time_point::max() - now);
+}
+
+std::chrono::milliseconds cppai::jittered_backoff(std::uint16_t attempt, std::chrono::milliseconds base, std::chrono::milliseconds cap) {
+    thread_local std::mt19937 engine{ std::random_device{}() };
+    const auto exponent = std::min<std::uint16_t>(static_cast<std::uint16_t>(std::max<std::uint16_t>(attempt, 1) - 1), 16);
+    const auto ceiling = std::min(cap, base * (std::int64_t{ 1 } << exponent));
+    std::uniform_int_distribution<std::int64_t> jitter{ ceiling.count() / 2, ceiling.count() };
+    return std::chrono::milliseconds{ jitter(engine) };
+}
@@ -0,0 +1,134 @@
+#ifndef CPPAI_POLICY_H
+#define CPPAI_POLICY_H
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/beast/core/error.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace cppai {
+    struct timeout_policy {
+        std::chrono::steady_clock::duration resolve = std::chrono::seconds(10);
+        std::chrono::steady_clock::duration connect = std::chrono::seconds(10);
+        // Head start each address gets before the next one is tried alongside it.
+        std::chrono::steady_clock::duration connect_stagger = std::chrono::milliseconds(250);
+        std::chrono::steady_clock::duration handshake = std::chrono::seconds(10);
+        std::chrono::steady_clock::duration write = std::chrono::seconds(60);
+        std::chrono::steady_clock::duration read = std::chrono::seconds(600);
+        std::chrono::steady_clock::duration total = std::chrono::seconds(600);
+    };
+
+    struct retry_policy {
+        std::uint16_t max_attempts = 3;
+        std::chrono::milliseconds base_delay{ 500 };
+        std::chrono::milliseconds max_delay{ 20000 };
+        std::vector<std::uint32_t> statuses = { 408, 409, 429, 500, 502, 503, 504 };
+        bool retry_transport_errors = true;
+        // A POST that failed after it was written may already have run on the server, so retrying it after a
+        // transport error can bill a completion or an upload twice. Only idempotent methods are retried then
+        // unless this is set.
+        bool retry_non_idempotent = false;
+        bool honor_retry_after = true;
+    };
+
+    struct hedge_policy {
+        bool enabled = false;
+        std::optional<std::chrono::steady_clock::duration> delay;
+        std::chrono::steady_clock::duration min_delay = std::chrono::milliseconds(50);
+        double quantile = 0.95;
+        std::size_t min_samples = 20;
+        std::vector<std::string> targets = { "/v1/embeddings", "/v1/moderations" };
+    };
+
+    struct compression_policy {
+        // Advertise Accept-Encoding: gzip and inflate such responses as they are read.
+        bool accept_gzip = true;
+        // JSON bodies at least this large are gzipped for backends with gzip_requests set; smaller ones
+        // cost more CPU than they save on the wire.
+        std::size_t min_size = 16 * 1024;
+        // zlib level, 1 (fastest) to 9 (smallest).
+        int level = 6;
+    };
+
+    struct request_policy {
+        timeout_policy timeouts;
+        retry_policy retries;
+        hedge_policy hedging;
+        compression_policy compression;
+    };
+
+    class latency_tracker {
+    public:
+        void record(std::string_view target, std::chrono::steady_clock::duration elapsed);
+
+        std::optional<std::chrono::steady_clock::duration> quantile(std::string_view target, double q, std::size_t min_samples) const;
+
+    private:
+        struct window {
+            std::array<std::chrono::steady_clock::duration, 256> samples{};
+            std::size_t count = 0;
+            std::size_t next = 0;
+        };
+
+        mutable std::mutex mtx;
+        std::unordered_map<std::string, window> windows;
+    };
+
+    std::chrono::steady_clock::duration phase_budget(std::chrono::steady_clock::duration phase, std::chrono::steady_clock::time_point deadline);
+
+    // now() + timeout, saturating at time_point::max(), so a duration::max() timeout means none at all.
+    std::chrono::steady_clock::time_point deadline_after(std::chrono::steady_clock::duration timeout);
+
+    std::chrono::milliseconds jittered_backoff(std::uint16_t attempt, std::chrono::milliseconds base, std::chrono::milliseconds cap);
+
+    // Sets which cancellation types the calling coroutine passes on to what it awaits. Resetting the state
+    // forgets a request that arrived since the last suspension, so such a request is acted on first.
+    template <class Filter>
+    boost::asio::awaitable<void> accept_cancellation(Filter filter) {
+        const boost::asio::cancellation_state state = co_await boost::asio::this_coro::cancellation_state;
+        if (state.cancelled() != boost::asio::cancellation_type::none) {
+            throw boost::system::system_error(boost::asio::error::operation_aborted);
+        }
+        co_await boost::asio::this_coro::reset_cancellation_state(filter);
+    }
+
+    // A branch of || starts out accepting terminal cancellation only; it takes whatever the awaiting
+    // coroutine's own filter let through instead.
+    template <class T>
+    boost::asio::awaitable<T> forward_cancellation(boost::asio::awaitable<T> op) {
+        co_await accept_cancellation(boost::asio::enable_total_cancellation());
+        co_return co_await std::move(op);
+    }
+
+    // Fails op with beast::error::timeout at deadline. op is cancelled and has released what it held, e.g. its
+    // connection, by the time this throws.
+    template <class T>
+    boost::asio::awaitable<T> with_deadline(boost::asio::awaitable<T> op, std::chrono::steady_clock::time_point deadline) {
+        using namespace boost::asio::experimental::awaitable_operators;
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, deadline };
+        auto result = co_await (forward_cancellation(std::move(op)) || timer.async_wait(boost::asio::use_awaitable));
+        if (result.index() == 1) {
+            throw boost::system::system_error(boost::beast::error::timeout);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            co_return std::get<0>(std::move(result));
+        }
+    }
+
+    // A per-call deadline, e.g. co_await with_timeout(client.chat_completion(body), std::chrono::seconds(20)).
+    template <class T>
+    boost::asio::awaitable<T> with_timeout(boost::asio::awaitable<T> op, std::chrono::steady_clock::duration timeout) {
+        co_return co_await with_deadline(std::move(op), deadline_after(timeout));
+    }
+}
+
+#endif
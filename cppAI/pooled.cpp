@@ -0,0 +1,19 @@
+#include "pooled.h"
+#include <algorithm>
+
+std::pmr::memory_resource* cppai::pooled_resource() {
+    static std::pmr::synchronized_pool_resource pool{ std::pmr::pool_options{ 0, 64 * 1024 } };
+    return &pool;
+}
+
+void cppai::serialize_into(const boost::json::value& value, pooled_string& out) {
+    thread_local boost::json::serializer serializer;
+    serializer.reset(&value);
+    out.clear();
+    while (!serializer.done()) {
+        const std::size_t used = out.size();
+        out.resize(std::max(out.capacity(), used + 512));
+        const boost::json::string_view written = serializer.read(out.data() + used, out.size() - used);
+        out.resize(used + written.size());
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef CPPAI_POOLED_H
+#define CPPAI_POOLED_H
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/json.hpp>
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+
+namespace cppai {
+    // Process-wide, thread-safe pool that request headers and bodies are carved from. Blocks return to the
+    // pool's free lists instead of the heap, so steady-state requests do not touch the global allocator.
+    std::pmr::memory_resource* pooled_resource();
+
+    template <class T>
+    struct pooled_allocator {
+        using value_type = T;
+
+        pooled_allocator() = default;
+
+        template <class U>
+        pooled_allocator(const pooled_allocator<U>&) noexcept {}
+
+        T* allocate(std::size_t n) {
+            return static_cast<T*>(pooled_resource()->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* p, std::size_t n) noexcept {
+            pooled_resource()->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        template <class U>
+        bool operator==(const pooled_allocator<U>&) const noexcept {
+            return true;
+        }
+    };
+
+    using pooled_fields = boost::beast::http::basic_fields<pooled_allocator<char>>;
+
+    using pooled_string = std::basic_string<char, std::char_traits<char>, pooled_allocator<char>>;
+
+    using json_body = boost::beast::http::basic_string_body<char, std::char_traits<char>, pooled_allocator<char>>;
+
+    using flat_body = boost::beast::http::basic_dynamic_body<boost::beast::flat_buffer>;
+
+    template <class Body>
+    using api_request = boost::beast::http::request<Body, pooled_fields>;
+
+    template <class Body>
+    using api_response_parser = boost::beast::http::response_parser<Body, pooled_allocator<char>>;
+
+    // Serializes through a reused per-thread boost::json::serializer straight into out's existing capacity.
+    void serialize_into(const boost::json::value& value, pooled_string& out);
+}
+
+#endif
@@ -0,0 +1,390 @@
+#include "response_cache.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+namespace {
+    // FNV-1a over a canonical walk of the body: object members are visited in key order and integral
+    // doubles hash like integers, so semantically equal bodies share a key however they were built. A second
+    // lane with its own multiplier and rotation gives the digest, which does not collide along with the id.
+    class canonical_hasher {
+    public:
+        void bytes(std::string_view data) {
+            for (const unsigned char c : data) {
+                state ^= c;
+                state *= 0x100000001b3ull;
+                check = std::rotl((check ^ c) * 0x9e3779b97f4a7c15ull, 23);
+            }
+        }
+
+        void tag(char kind) {
+            bytes(std::string_view{ &kind, 1 });
+        }
+
+        void length(std::size_t size) {
+            const std::uint64_t wide = size;
+            char raw[sizeof(wide)];
+            std::memcpy(raw, &wide, sizeof(wide));
+            bytes(std::string_view{ raw, sizeof(raw) });
+        }
+
+        template <class Number>
+        void number(Number value) {
+            std::array<char, 32> digits;
+            const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+            tag('#');
+            bytes(std::string_view{ digits.data(), static_cast<std::size_t>(result.ptr - digits.data()) });
+        }
+
+        void value(const boost::json::value& current) {
+            switch (current.kind()) {
+            case boost::json::kind::null:
+                tag('n');
+                break;
+            case boost::json::kind::bool_:
+                tag(current.get_bool() ? 't' : 'f');
+                break;
+            case boost::json::kind::int64:
+                number(current.get_int64());
+                break;
+            case boost::json::kind::uint64:
+                number(current.get_uint64());
+                break;
+            case boost::json::kind::double_: {
+                const double real = current.get_double();
+                if (std::trunc(real) == real && std::abs(real) < 9.0e15) {
+                    number(static_cast<std::int64_t>(real));
+                }
+                else {
+                    number(real);
+                }
+                break;
+            }
+            case boost::json::kind::string:
+                tag('s');
+                length(current.get_string().size());
+                bytes(std::string_view{ current.get_string().data(), current.get_string().size() });
+                break;
+            case boost::json::kind::array:
+                tag('[');
+                length(current.get_array().size());
+                for (const boost::json::value& element : current.get_array()) {
+                    value(element);
+                }
+                break;
+            case boost::json::kind::object: {
+                const boost::json::object& members = current.get_object();
+                std::vector<const boost::json::key_value_pair*> sorted;
+                sorted.reserve(members.size());
+                for (const boost::json::key_value_pair& member : members) {
+                    sorted.push_back(&member);
+                }
+                std::sort(sorted.begin(), sorted.end(), [](const auto* lhs, const auto* rhs) {
+                    return lhs->key() < rhs->key();
+                });
+                tag('{');
+                length(sorted.size());
+                for (const boost::json::key_value_pair* member : sorted) {
+                    length(member->key().size());
+                    bytes(std::string_view{ member->key().data(), member->key().size() });
+                    value(member->value());
+                }
+                break;
+            }
+            }
+        }
+
+        cppai::cache_key finish() const {
+            return { mix(state), mix(check) };
+        }
+
+    private:
+        std::uint64_t state = 0xcbf29ce484222325ull;
+        std::uint64_t check = 0x6a09e667f3bcc909ull;
+
+        static std::uint64_t mix(std::uint64_t mixed) {
+            mixed ^= mixed >> 33;
+            mixed *= 0xff51afd7ed558ccdull;
+            mixed ^= mixed >> 33;
+            mixed *= 0xc4ceb9fe1a85ec53ull;
+            mixed ^= mixed >> 33;
+            return mixed;
+        }
+    };
+
+    std::string hex(std::uint64_t value) {
+        std::array<char, 16> digits;
+        const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value, 16);
+        return std::string{ digits.data(), static_cast<std::size_t>(result.ptr - digits.data()) };
+    }
+
+    bool cacheable(const boost::json::value& response) {
+        const boost::json::object* object = response.if_object();
+        return object != nullptr && !object->contains("error");
+    }
+}
+
+cppai::response_cache::response_cache(cache_options opts) : opts{ std::move(opts) } {
+    const std::size_t count = std::max<std::size_t>(this->opts.shards, 1);
+    shard_capacity = this->opts.max_bytes / count;
+    shards.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        shards.push_back(std::make_unique<shard>());
+    }
+}
+
+cppai::cache_key cppai::response_cache::key(std::string_view scope, std::string_view method, std::string_view target,
+    const boost::json::value& body) {
+    canonical_hasher hasher;
+    hasher.length(scope.size());
+    hasher.bytes(scope);
+    hasher.length(method.size());
+    hasher.bytes(method);
+    hasher.length(target.size());
+    hasher.bytes(target);
+    hasher.value(body);
+    return hasher.finish();
+}
+
+boost::asio::awaitable<boost::json::value> cppai::response_cache::get_or_fetch(cache_key key, fetcher fetch) {
+    if (std::optional<boost::json::value> cached = lookup(key)) {
+        co_return std::move(cached.value());
+    }
+
+    std::shared_ptr<flight> current;
+    std::shared_ptr<waiter_channel> waiter;
+    {
+        std::lock_guard lock{ flights_mtx };
+        std::shared_ptr<flight>& slot = flights[key.id];
+        if (!slot) {
+            slot = std::make_shared<flight>();
+            slot->digest = key.digest;
+            current = slot;
+        }
+        else if (slot->digest == key.digest) {
+            waiter = std::make_shared<waiter_channel>(co_await boost::asio::this_coro::executor, 1);
+            slot->waiters.push_back(waiter);
+            current = slot;
+        }
+    }
+    // A different request is in flight under the same id: this one is fetched on its own and not cached.
+    if (!current) {
+        co_return co_await fetch();
+    }
+
+    if (waiter) {
+        coalesced.fetch_add(1, std::memory_order_relaxed);
+        co_await waiter->async_receive(boost::asio::use_awaitable);
+        {
+            std::lock_guard lock{ flights_mtx };
+            // A cancelled fetch is no answer for the callers that were waiting on it: they start over.
+            if (!current->abandoned) {
+                if (current->error) {
+                    std::rethrow_exception(current->error);
+                }
+                co_return current->result.value();
+            }
+        }
+        co_return co_await get_or_fetch(key, std::move(fetch));
+    }
+
+    misses.fetch_add(1, std::memory_order_relaxed);
+    boost::json::value result;
+    std::exception_ptr error;
+    bool abandoned = false;
+    try {
+        result = co_await fetch();
+    }
+    catch (const boost::system::system_error& e) {
+        error = std::current_exception();
+        abandoned = e.code() == boost::asio::error::operation_aborted;
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    if (!error && cacheable(result)) {
+        store(key, result);
+    }
+
+    std::vector<std::shared_ptr<waiter_channel>> waiters;
+    {
+        std::lock_guard lock{ flights_mtx };
+        current->done = true;
+        current->error = error;
+        current->abandoned = abandoned;
+        if (!error) {
+            current->result = result;
+        }
+        waiters = std::move(current->waiters);
+        flights.erase(key.id);
+    }
+    for (const std::shared_ptr<waiter_channel>& waiting : waiters) {
+        waiting->try_send(boost::system::error_code{});
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    co_return result;
+}
+
+std::optional<boost::json::value> cppai::response_cache::lookup(cache_key key) {
+    if (entry_value cached = memory_lookup(key)) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return *cached;
+    }
+    if (std::optional<boost::json::value> stored = disk_lookup(key)) {
+        disk_hits.fetch_add(1, std::memory_order_relaxed);
+        memory_store(key, std::make_shared<const boost::json::value>(stored.value()));
+        return stored;
+    }
+    return std::nullopt;
+}
+
+void cppai::response_cache::store(cache_key key, const boost::json::value& response) {
+    // Copied onto the default resource so a cached entry does not pin the arena its response was parsed into.
+    memory_store(key, std::make_shared<const boost::json::value>(response, boost::json::storage_ptr{}));
+    disk_store(key, response);
+}
+
+cppai::cache_counters cppai::response_cache::counters() const {
+    cache_counters snapshot;
+    snapshot.hits = hits.load(std::memory_order_relaxed);
+    snapshot.disk_hits = disk_hits.load(std::memory_order_relaxed);
+    snapshot.misses = misses.load(std::memory_order_relaxed);
+    snapshot.coalesced = coalesced.load(std::memory_order_relaxed);
+    snapshot.evictions = evictions.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+cppai::response_cache::shard& cppai::response_cache::shard_for(std::uint64_t key) {
+    return *shards[key % shards.size()];
+}
+
+cppai::response_cache::entry_value cppai::response_cache::memory_lookup(cache_key key) {
+    shard& current = shard_for(key.id);
+    std::lock_guard lock{ current.mtx };
+    const auto found = current.index.find(key.id);
+    if (found == current.index.end() || found->second->digest != key.digest) {
+        return nullptr;
+    }
+    current.lru.splice(current.lru.begin(), current.lru, found->second);
+    return found->second->value;
+}
+
+void cppai::response_cache::memory_store(cache_key key, entry_value value) {
+    const std::size_t bytes = approximate_size(*value);
+    if (bytes > shard_capacity) {
+        return;
+    }
+
+    shard& current = shard_for(key.id);
+    std::lock_guard lock{ current.mtx };
+    if (const auto found = current.index.find(key.id); found != current.index.end()) {
+        current.bytes -= found->second->bytes;
+        current.lru.erase(found->second);
+        current.index.erase(found);
+    }
+    current.lru.push_front(entry{ key.id, key.digest, std::move(value), bytes });
+    current.index[key.id] = current.lru.begin();
+    current.bytes += bytes;
+
+    while (current.bytes > shard_capacity && current.lru.size() > 1) {
+        const entry& oldest = current.lru.back();
+        current.bytes -= oldest.bytes;
+        current.index.erase(oldest.key);
+        current.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::optional<boost::json::value> cppai::response_cache::disk_lookup(cache_key key) const {
+    if (!opts.disk_dir.has_value()) {
+        return std::nullopt;
+    }
+
+    const boost::filesystem::path file = disk_file(key.id);
+    boost::system::error_code error_code;
+    if (!boost::filesystem::exists(file, error_code)) {
+        return std::nullopt;
+    }
+    try {
+        boost::interprocess::file_mapping mapping{ file.string().c_str(), boost::interprocess::read_only };
+        boost::interprocess::mapped_region region{ mapping, boost::interprocess::read_only };
+        // The first line is the digest of the request the response answered.
+        std::string_view stored{ static_cast<const char*>(region.get_address()), region.get_size() };
+        const std::size_t line_end = stored.find('\n');
+        if (line_end == std::string_view::npos || stored.substr(0, line_end) != hex(key.digest)) {
+            return std::nullopt;
+        }
+        stored.remove_prefix(line_end + 1);
+        return boost::json::parse(boost::json::string_view{ stored.data(), stored.size() });
+    }
+    catch (...) {
+        return std::nullopt;
+    }
+}
+
+void cppai::response_cache::disk_store(cache_key key, const boost::json::value& response) const {
+    if (!opts.disk_dir.has_value()) {
+        return;
+    }
+
+    // Written under a temporary name and renamed, so a concurrent reader never maps a half-written file. The
+    // name is unique to this write: two writers of one key, in this process or another sharing disk_dir, each
+    // fill their own file, and whichever rename comes last publishes a whole entry.
+    boost::system::error_code error_code;
+    boost::filesystem::create_directories(opts.disk_dir.value(), error_code);
+    const boost::filesystem::path file = disk_file(key.id);
+    const boost::filesystem::path staging = opts.disk_dir.value() / boost::filesystem::unique_path(hex(key.id) + "-%%%%-%%%%-%%%%.tmp");
+    bool written = false;
+    {
+        boost::nowide::ofstream out{ staging, std::ios_base::binary | std::ios_base::trunc };
+        out << hex(key.digest) << '\n' << boost::json::serialize(response);
+        out.close();
+        written = !out.fail();
+    }
+    if (written) {
+        boost::filesystem::rename(staging, file, error_code);
+    }
+    if (!written || error_code) {
+        boost::filesystem::remove(staging, error_code);
+    }
+}
+
+boost::filesystem::path cppai::response_cache::disk_file(std::uint64_t key) const {
+    return opts.disk_dir.value() / (hex(key) + ".json");
+}
+
+std::size_t cppai::response_cache::approximate_size(const boost::json::value& value) {
+    std::size_t total = 0;
+    std::vector<const boost::json::value*> pending{ &value };
+    while (!pending.empty()) {
+        const boost::json::value* current = pending.back();
+        pending.pop_back();
+        total += sizeof(boost::json::value);
+        if (current->is_string()) {
+            total += current->get_string().size();
+        }
+        else if (current->is_array()) {
+            for (const boost::json::value& element : current->get_array()) {
+                pending.push_back(&element);
+            }
+        }
+        else if (current->is_object()) {
+            for (const boost::json::key_value_pair& member : current->get_object()) {
+                total += member.key().size();
+                pending.push_back(&member.value());
+            }
+        }
+    }
+    return total;
+}
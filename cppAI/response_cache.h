@@ -0,0 +1,120 @@
+#ifndef CPPAI_RESPONSE_CACHE_H
+#define CPPAI_RESPONSE_CACHE_H
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <boost/json.hpp>
+#include <boost/nowide/filesystem.hpp>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cppai {
+    struct cache_options {
+        std::size_t shards = 16;
+        std::size_t max_bytes = 64 * 1024 * 1024;
+        std::optional<boost::filesystem::path> disk_dir;
+    };
+
+    struct cache_counters {
+        std::uint64_t hits = 0;
+        std::uint64_t disk_hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t coalesced = 0;
+        std::uint64_t evictions = 0;
+    };
+
+    struct cache_key {
+        // Picks the shard, the in-flight slot and the disk file.
+        std::uint64_t id = 0;
+        // A second, independent hash of the same request, stored with the entry; an entry under the same id
+        // with another digest belongs to a different request and is a miss.
+        std::uint64_t digest = 0;
+
+        bool operator==(const cache_key&) const = default;
+    };
+
+    // Content-addressed cache for deterministic responses: a sharded in-memory LRU bounded by bytes, an
+    // optional memory-mapped on-disk tier, and coalescing of identical requests that are already in flight.
+    class response_cache {
+    public:
+        using fetcher = std::function<boost::asio::awaitable<boost::json::value>()>;
+
+        explicit response_cache(cache_options opts = {});
+
+        // scope names whoever answers, e.g. the backends and the credentials a client calls them with, so a
+        // cache or disk_dir shared between clients never hands one tenant's or backend's response to another.
+        static cache_key key(std::string_view scope, std::string_view method, std::string_view target, const boost::json::value& body);
+
+        boost::asio::awaitable<boost::json::value> get_or_fetch(cache_key key, fetcher fetch);
+
+        std::optional<boost::json::value> lookup(cache_key key);
+
+        void store(cache_key key, const boost::json::value& response);
+
+        cache_counters counters() const;
+
+    private:
+        using waiter_channel = boost::asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+        using entry_value = std::shared_ptr<const boost::json::value>;
+
+        struct entry {
+            std::uint64_t key;
+            std::uint64_t digest;
+            entry_value value;
+            std::size_t bytes;
+        };
+
+        struct shard {
+            std::mutex mtx;
+            std::list<entry> lru;
+            std::unordered_map<std::uint64_t, std::list<entry>::iterator> index;
+            std::size_t bytes = 0;
+        };
+
+        struct flight {
+            std::uint64_t digest = 0;
+            std::vector<std::shared_ptr<waiter_channel>> waiters;
+            std::optional<boost::json::value> result;
+            std::exception_ptr error;
+            bool done = false;
+            bool abandoned = false;
+        };
+
+        cache_options opts;
+        std::size_t shard_capacity;
+        std::vector<std::unique_ptr<shard>> shards;
+
+        std::mutex flights_mtx;
+        std::unordered_map<std::uint64_t, std::shared_ptr<flight>> flights;
+
+        std::atomic<std::uint64_t> hits{ 0 };
+        std::atomic<std::uint64_t> disk_hits{ 0 };
+        std::atomic<std::uint64_t> misses{ 0 };
+        std::atomic<std::uint64_t> coalesced{ 0 };
+        std::atomic<std::uint64_t> evictions{ 0 };
+
+        shard& shard_for(std::uint64_t key);
+
+        entry_value memory_lookup(cache_key key);
+
+        void memory_store(cache_key key, entry_value value);
+
+        std::optional<boost::json::value> disk_lookup(cache_key key) const;
+
+        void disk_store(cache_key key, const boost::json::value& response) const;
+
+        boost::filesystem::path disk_file(std::uint64_t key) const;
+
+        static std::size_t approximate_size(const boost::json::value& value);
+    };
+}
+
+#endif
@@ -0,0 +1,335 @@
+#include "response_decoder.h"
+#include <boost/json/basic_parser_impl.hpp>
+#include <algorithm>
+#include <charconv>
+
+namespace {
+    struct pointer_token {
+        std::string key;
+        std::optional<std::size_t> index;
+    };
+
+    std::vector<pointer_token> split_pointer(std::string_view pointer) {
+        std::vector<pointer_token> tokens;
+        if (pointer.empty()) {
+            return tokens;
+        }
+        if (pointer.front() != '/') {
+            throw std::invalid_argument("JSON Pointer must be empty or start with '/'");
+        }
+        pointer.remove_prefix(1);
+        for (;;) {
+            const std::size_t slash = pointer.find('/');
+            const std::string_view raw = pointer.substr(0, slash);
+            pointer_token token;
+            for (std::size_t i = 0; i < raw.size(); ++i) {
+                if (raw[i] == '~' && i + 1 < raw.size() && (raw[i + 1] == '0' || raw[i + 1] == '1')) {
+                    token.key.push_back(raw[i + 1] == '0' ? '~' : '/');
+                    ++i;
+                }
+                else {
+                    token.key.push_back(raw[i]);
+                }
+            }
+            std::size_t index = 0;
+            const auto [end, error] = std::from_chars(token.key.data(), token.key.data() + token.key.size(), index);
+            if (error == std::errc{} && end == token.key.data() + token.key.size() && !token.key.empty()) {
+                token.index = index;
+            }
+            tokens.push_back(std::move(token));
+            if (slash == std::string_view::npos) {
+                break;
+            }
+            pointer.remove_prefix(slash + 1);
+        }
+        return tokens;
+    }
+}
+
+struct cppai::field_extractor::state {
+    struct handler {
+        static constexpr std::size_t max_object_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_array_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_key_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_string_size = static_cast<std::size_t>(-1);
+
+        struct frame {
+            bool object;
+            std::string key;
+            std::size_t index = 0;
+        };
+
+        std::vector<std::vector<pointer_token>> pointers;
+        std::vector<std::optional<boost::json::value>> results;
+        std::size_t remaining;
+        boost::json::storage_ptr storage;
+        boost::json::value_stack captured;
+        std::vector<frame> frames;
+        std::string key_text;
+        std::vector<std::size_t> targets;
+        std::size_t capture_depth = 0;
+        bool in_string = false;
+        bool complete = false;
+
+        handler(const std::vector<std::string>& sources, boost::json::storage_ptr storage)
+            : results(sources.size()), remaining{ sources.size() }, storage{ std::move(storage) } {
+            pointers.reserve(sources.size());
+            for (const std::string& source : sources) {
+                pointers.push_back(split_pointer(source));
+            }
+        }
+
+        bool capturing() const {
+            return !targets.empty();
+        }
+
+        bool matches(const std::vector<pointer_token>& pointer) const {
+            if (pointer.size() != frames.size()) {
+                return false;
+            }
+            for (std::size_t i = 0; i < frames.size(); ++i) {
+                if (frames[i].object ? frames[i].key != pointer[i].key : pointer[i].index != frames[i].index) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void begin_value() {
+            if (capturing()) {
+                return;
+            }
+            for (std::size_t i = 0; i < pointers.size(); ++i) {
+                if (!results[i].has_value() && matches(pointers[i])) {
+                    targets.push_back(i);
+                }
+            }
+            if (capturing()) {
+                capture_depth = frames.size();
+                captured.reset(storage);
+            }
+        }
+
+        bool end_value(boost::json::error_code& ec) {
+            if (capturing() && frames.size() == capture_depth) {
+                boost::json::value value = captured.release();
+                for (const std::size_t target : targets) {
+                    results[target] = value;
+                }
+                remaining -= targets.size();
+                targets.clear();
+            }
+            if (!frames.empty() && !frames.back().object) {
+                ++frames.back().index;
+            }
+            if (remaining == 0) {
+                // Everything asked for is in hand; abandon the rest of the document.
+                complete = true;
+                ec = boost::system::errc::make_error_code(boost::system::errc::operation_canceled);
+                return false;
+            }
+            return true;
+        }
+
+        bool on_document_begin(boost::json::error_code& ec) {
+            if (pointers.empty()) {
+                complete = true;
+                ec = boost::system::errc::make_error_code(boost::system::errc::operation_canceled);
+                return false;
+            }
+            return true;
+        }
+
+        bool on_document_end(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_object_begin(boost::json::error_code&) {
+            begin_value();
+            frames.push_back(frame{ true, {} });
+            return true;
+        }
+
+        bool on_object_end(std::size_t n, boost::json::error_code& ec) {
+            frames.pop_back();
+            if (capturing()) {
+                captured.push_object(n);
+            }
+            return end_value(ec);
+        }
+
+        bool on_array_begin(boost::json::error_code&) {
+            begin_value();
+            frames.push_back(frame{ false, {} });
+            return true;
+        }
+
+        bool on_array_end(std::size_t n, boost::json::error_code& ec) {
+            frames.pop_back();
+            if (capturing()) {
+                captured.push_array(n);
+            }
+            return end_value(ec);
+        }
+
+        bool on_key_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            key_text.append(part.data(), part.size());
+            if (capturing()) {
+                captured.push_chars(part);
+            }
+            return true;
+        }
+
+        bool on_key(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            key_text.append(part.data(), part.size());
+            frames.back().key.swap(key_text);
+            key_text.clear();
+            if (capturing()) {
+                captured.push_key(part);
+            }
+            return true;
+        }
+
+        bool on_string_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            if (!in_string) {
+                in_string = true;
+                begin_value();
+            }
+            if (capturing()) {
+                captured.push_chars(part);
+            }
+            return true;
+        }
+
+        bool on_string(boost::json::string_view part, std::size_t, boost::json::error_code& ec) {
+            if (!in_string) {
+                begin_value();
+            }
+            in_string = false;
+            if (capturing()) {
+                captured.push_string(part);
+            }
+            return end_value(ec);
+        }
+
+        bool on_number_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_int64(std::int64_t value, boost::json::string_view, boost::json::error_code& ec) {
+            begin_value();
+            if (capturing()) {
+                captured.push_int64(value);
+            }
+            return end_value(ec);
+        }
+
+        bool on_uint64(std::uint64_t value, boost::json::string_view, boost::json::error_code& ec) {
+            begin_value();
+            if (capturing()) {
+                captured.push_uint64(value);
+            }
+            return end_value(ec);
+        }
+
+        bool on_double(double value, boost::json::string_view, boost::json::error_code& ec) {
+            begin_value();
+            if (capturing()) {
+                captured.push_double(value);
+            }
+            return end_value(ec);
+        }
+
+        bool on_bool(bool value, boost::json::error_code& ec) {
+            begin_value();
+            if (capturing()) {
+                captured.push_bool(value);
+            }
+            return end_value(ec);
+        }
+
+        bool on_null(boost::json::error_code& ec) {
+            begin_value();
+            if (capturing()) {
+                captured.push_null();
+            }
+            return end_value(ec);
+        }
+
+        bool on_comment_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_comment(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+    };
+
+    boost::json::basic_parser<handler> parser;
+
+    state(const std::vector<std::string>& pointers, boost::json::storage_ptr storage)
+        : parser{ boost::json::parse_options{}, pointers, std::move(storage) } {}
+};
+
+boost::json::value cppai::json_decoder::operator()(std::uint32_t, std::string_view body) const {
+    // The parser's scratch space is per thread and the tree is built straight from the connection's buffer.
+    thread_local unsigned char scratch[4096];
+    boost::json::parser parser{ {}, {}, scratch, sizeof(scratch) };
+    parser.reset(storage.has_value() ? storage.value()
+        : boost::json::make_shared_resource<boost::json::monotonic_resource>(std::max<std::size_t>(body.size(), 1024)));
+    parser.write(body.data(), body.size());
+    return parser.release();
+}
+
+cppai::embedding_result cppai::embedding_decoder::operator()(std::uint32_t status, std::string_view body) const {
+    return parse_embeddings(body, 0, status);
+}
+
+cppai::field_extractor::field_extractor(const std::vector<std::string>& pointers, boost::json::storage_ptr storage)
+    : impl{ std::make_unique<state>(pointers, std::move(storage)) } {
+}
+
+cppai::field_extractor::~field_extractor() = default;
+
+bool cppai::field_extractor::write(std::string_view chunk) {
+    if (impl->parser.handler().complete) {
+        return false;
+    }
+    boost::json::error_code error_code;
+    impl->parser.write_some(true, chunk.data(), chunk.size(), error_code);
+    if (impl->parser.handler().complete) {
+        return false;
+    }
+    if (error_code) {
+        throw boost::system::system_error(error_code);
+    }
+    return true;
+}
+
+std::vector<std::optional<boost::json::value>> cppai::field_extractor::finish() {
+    if (!impl->parser.handler().complete) {
+        boost::json::error_code error_code;
+        impl->parser.write_some(false, nullptr, 0, error_code);
+        if (error_code && !impl->parser.handler().complete) {
+            throw boost::system::system_error(error_code);
+        }
+    }
+    return std::move(impl->parser.handler().results);
+}
+
+cppai::extracted_fields cppai::field_decoder::operator()(std::uint32_t status, std::string_view body) const {
+    extracted_fields fields;
+    if (status >= 400) {
+        // Error bodies are small and the caller needs all of them, so they take the ordinary path.
+        boost::json::value document = json_decoder{}(status, body);
+        fields.values.resize(pointers.size());
+        const boost::json::object* object = document.if_object();
+        fields.error = object != nullptr && object->contains("error") ? object->at("error") : document;
+        return fields;
+    }
+
+    field_extractor extractor{ pointers };
+    extractor.write(body);
+    fields.values = extractor.finish();
+    return fields;
+}
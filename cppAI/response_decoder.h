@@ -0,0 +1,68 @@
+#ifndef CPPAI_RESPONSE_DECODER_H
+#define CPPAI_RESPONSE_DECODER_H
+#include <boost/json.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "embedding.h"
+
+namespace cppai {
+    // Decoders turn a complete response body, already contiguous in the connection's read buffer, into the
+    // value a call returns. The request pipeline is generic over them.
+    struct json_decoder {
+        using result_type = boost::json::value;
+
+        // Without a caller-supplied resource every response gets its own monotonic arena, sized from the body
+        // and released together with the returned value.
+        std::optional<boost::json::storage_ptr> storage;
+
+        result_type operator()(std::uint32_t status, std::string_view body) const;
+    };
+
+    struct embedding_decoder {
+        using result_type = embedding_result;
+
+        result_type operator()(std::uint32_t status, std::string_view body) const;
+    };
+
+    struct extracted_fields {
+        std::vector<std::optional<boost::json::value>> values;
+        std::optional<boost::json::value> error;
+    };
+
+    // Pulls the values at a set of JSON Pointers (RFC 6901, e.g. "/choices/0/message/content") out of a
+    // document without building the rest of it. Parsing stops as soon as every requested value is complete.
+    class field_extractor {
+    public:
+        explicit field_extractor(const std::vector<std::string>& pointers, boost::json::storage_ptr storage = {});
+
+        ~field_extractor();
+
+        field_extractor(const field_extractor&) = delete;
+
+        field_extractor& operator=(const field_extractor&) = delete;
+
+        // Returns false once every requested value has been found and the rest of the input can be skipped.
+        bool write(std::string_view chunk);
+
+        std::vector<std::optional<boost::json::value>> finish();
+
+    private:
+        struct state;
+
+        std::unique_ptr<state> impl;
+    };
+
+    struct field_decoder {
+        using result_type = extracted_fields;
+
+        std::vector<std::string> pointers;
+
+        result_type operator()(std::uint32_t status, std::string_view body) const;
+    };
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "runtime.h"
+#include <future>
+#include <random>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+cppai::runtime::runtime(runtime_options opts) {
+    const std::size_t count = std::max<std::size_t>(opts.shards, 1);
+    const std::size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+    shards.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        auto created = std::make_unique<shard>();
+        shard& current = *created;
+        current.thread = std::thread{ [&current]() {
+            current.ctx.run();
+        } };
+        if (opts.pin_threads) {
+            pin(current.thread, i % cpus);
+        }
+        shards.push_back(std::move(created));
+    }
+}
+
+cppai::runtime::~runtime() {
+    stop();
+}
+
+void cppai::runtime::configure(const std::function<void(openAI&)>& setup) {
+    // Runs on each shard's own thread so the setters never race with calls in flight on that shard.
+    for (const std::unique_ptr<shard>& current : shards) {
+        std::packaged_task<void()> task{ [&]() {
+            setup(current->client);
+        } };
+        std::future<void> applied = task.get_future();
+        boost::asio::post(current->ctx, std::move(task));
+        applied.get();
+    }
+}
+
+std::size_t cppai::runtime::size() const {
+    return shards.size();
+}
+
+std::size_t cppai::runtime::outstanding() const {
+    std::size_t total = 0;
+    for (const std::unique_ptr<shard>& current : shards) {
+        total += current->outstanding.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void cppai::runtime::stop() {
+    for (const std::unique_ptr<shard>& current : shards) {
+        current->work.reset();
+    }
+    for (const std::unique_ptr<shard>& current : shards) {
+        if (current->thread.joinable()) {
+            current->thread.join();
+        }
+    }
+}
+
+cppai::runtime::shard& cppai::runtime::pick() {
+    if (shards.size() == 1) {
+        return *shards.front();
+    }
+
+    // Power of two choices: sample two shards and take the one with fewer calls in flight.
+    thread_local std::minstd_rand engine{ std::random_device{}() };
+    std::uniform_int_distribution<std::size_t> index{ 0, shards.size() - 1 };
+    const std::size_t first = index(engine);
+    std::size_t second = index(engine);
+    if (second == first) {
+        second = (first + 1) % shards.size();
+    }
+    return shards[first]->outstanding.load(std::memory_order_relaxed) <= shards[second]->outstanding.load(std::memory_order_relaxed)
+        ? *shards[first] : *shards[second];
+}
+
+void cppai::runtime::pin(std::thread& thread, std::size_t cpu) {
+#if defined(_WIN32)
+    SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << (cpu % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % CPU_SETSIZE, &set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+    static_cast<void>(thread);
+    static_cast<void>(cpu);
+#endif
+}
@@ -0,0 +1,76 @@
+#ifndef CPPAI_RUNTIME_H
+#define CPPAI_RUNTIME_H
+#include <boost/asio.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "openai.h"
+
+namespace cppai {
+    struct runtime_options {
+        std::size_t shards = std::max(1u, std::thread::hardware_concurrency());
+        bool pin_threads = false;
+    };
+
+    // Owns one single-threaded io_context per shard. Every shard has its own openAI instance, so its
+    // connection pool, TLS sessions and buffers are only ever touched by the shard's thread.
+    class runtime {
+    public:
+        explicit runtime(runtime_options opts = {});
+
+        ~runtime();
+
+        runtime(const runtime&) = delete;
+
+        runtime& operator=(const runtime&) = delete;
+
+        void configure(const std::function<void(openAI&)>& setup);
+
+        template <class F>
+        boost::asio::awaitable<typename std::invoke_result_t<F&, const openAI&>::value_type> submit(F fn) {
+            shard& target = pick();
+            const outstanding_guard guard{ target.outstanding };
+            co_return co_await boost::asio::co_spawn(target.ctx,
+                [&target, fn = std::move(fn)]() mutable { return fn(static_cast<const openAI&>(target.client)); },
+                boost::asio::use_awaitable);
+        }
+
+        std::size_t size() const;
+
+        std::size_t outstanding() const;
+
+        void stop();
+
+    private:
+        struct shard {
+            boost::asio::io_context ctx{ 1 };
+            boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{ ctx.get_executor() };
+            openAI client;
+            std::atomic<std::size_t> outstanding{ 0 };
+            std::thread thread;
+        };
+
+        struct outstanding_guard {
+            std::atomic<std::size_t>& counter;
+
+            explicit outstanding_guard(std::atomic<std::size_t>& counter) : counter{ counter } {
+                counter.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            ~outstanding_guard() {
+                counter.fetch_sub(1, std::memory_order_relaxed);
+            }
+        };
+
+        std::vector<std::unique_ptr<shard>> shards;
+
+        shard& pick();
+
+        static void pin(std::thread& thread, std::size_t cpu);
+    };
+}
+
+#endif
@@ -0,0 +1,255 @@
+#include "schema.h"
+#include <boost/json/basic_parser_impl.hpp>
+
+struct cppai::schema::document_parser::state {
+    struct handler {
+        static constexpr std::size_t max_object_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_array_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_key_size = static_cast<std::size_t>(-1);
+        static constexpr std::size_t max_string_size = static_cast<std::size_t>(-1);
+
+        struct frame {
+            slot target;
+            bool object;
+            std::string key;
+            slot pending;
+        };
+
+        slot root;
+        std::vector<frame> frames;
+        // Depth inside a value the schema does not name, which is parsed but not stored.
+        std::size_t skipping = 0;
+        std::string key_text;
+        std::string string_text;
+        std::string failure;
+
+        explicit handler(slot root) : root{ root } {}
+
+        slot next() {
+            if (frames.empty()) {
+                return std::exchange(root, slot{});
+            }
+            frame& top = frames.back();
+            if (top.object) {
+                return std::exchange(top.pending, slot{});
+            }
+            return top.target.ops->element(top.target.target);
+        }
+
+        bool unexpected(const char* what, boost::json::error_code& ec) {
+            failure.assign("unexpected ").append(what).append(" at ");
+            for (const frame& level : frames) {
+                failure.append("/").append(level.object ? level.key : "-");
+            }
+            ec = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+            return false;
+        }
+
+        bool begin(bool object, boost::json::error_code& ec) {
+            if (skipping != 0) {
+                ++skipping;
+                return true;
+            }
+            slot target = next();
+            if (target.ops == nullptr) {
+                skipping = 1;
+                return true;
+            }
+            target = target.ops->resolve(target.target);
+            if (target.ops->kind != (object ? type_ops::shape::object : type_ops::shape::array)) {
+                return unexpected(object ? "object" : "array", ec);
+            }
+            frames.push_back(frame{ target, object, {}, {} });
+            return true;
+        }
+
+        bool end() {
+            if (skipping != 0) {
+                --skipping;
+            }
+            else {
+                frames.pop_back();
+            }
+            return true;
+        }
+
+        template <class Apply>
+        bool scalar(const char* what, Apply apply, boost::json::error_code& ec) {
+            if (skipping != 0) {
+                return true;
+            }
+            slot target = next();
+            if (target.ops == nullptr) {
+                return true;
+            }
+            target = target.ops->resolve(target.target);
+            return apply(target) ? true : unexpected(what, ec);
+        }
+
+        bool on_document_begin(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_document_end(boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_object_begin(boost::json::error_code& ec) {
+            return begin(true, ec);
+        }
+
+        bool on_object_end(std::size_t, boost::json::error_code&) {
+            return end();
+        }
+
+        bool on_array_begin(boost::json::error_code& ec) {
+            return begin(false, ec);
+        }
+
+        bool on_array_end(std::size_t, boost::json::error_code&) {
+            return end();
+        }
+
+        bool on_key_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            if (skipping == 0) {
+                key_text.append(part.data(), part.size());
+            }
+            return true;
+        }
+
+        bool on_key(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            if (skipping != 0) {
+                return true;
+            }
+            key_text.append(part.data(), part.size());
+            frame& top = frames.back();
+            top.key.swap(key_text);
+            key_text.clear();
+            top.pending = top.target.ops->member(top.target.target, top.key);
+            return true;
+        }
+
+        bool on_string_part(boost::json::string_view part, std::size_t, boost::json::error_code&) {
+            if (skipping == 0) {
+                string_text.append(part.data(), part.size());
+            }
+            return true;
+        }
+
+        bool on_string(boost::json::string_view part, std::size_t, boost::json::error_code& ec) {
+            std::string_view text{ part.data(), part.size() };
+            if (!string_text.empty()) {
+                string_text.append(part.data(), part.size());
+                text = string_text;
+            }
+            const bool ok = scalar("string", [&](slot target) { return target.ops->on_string(target.target, text); }, ec);
+            string_text.clear();
+            return ok;
+        }
+
+        bool on_number_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_int64(std::int64_t value, boost::json::string_view, boost::json::error_code& ec) {
+            return scalar("number", [&](slot target) { return target.ops->on_int64(target.target, value); }, ec);
+        }
+
+        bool on_uint64(std::uint64_t value, boost::json::string_view, boost::json::error_code& ec) {
+            return scalar("number", [&](slot target) { return target.ops->on_uint64(target.target, value); }, ec);
+        }
+
+        bool on_double(double value, boost::json::string_view, boost::json::error_code& ec) {
+            return scalar("number", [&](slot target) { return target.ops->on_double(target.target, value); }, ec);
+        }
+
+        bool on_bool(bool value, boost::json::error_code& ec) {
+            return scalar("boolean", [&](slot target) { return target.ops->on_bool(target.target, value); }, ec);
+        }
+
+        bool on_null(boost::json::error_code&) {
+            if (skipping == 0) {
+                const slot target = next();
+                if (target.ops != nullptr) {
+                    target.ops->on_null(target.target);
+                }
+            }
+            return true;
+        }
+
+        bool on_comment_part(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+
+        bool on_comment(boost::json::string_view, boost::json::error_code&) {
+            return true;
+        }
+    };
+
+    boost::json::basic_parser<handler> parser;
+
+    explicit state(slot root) : parser{ boost::json::parse_options{}, root } {}
+
+    [[noreturn]] void raise(boost::json::error_code error_code) {
+        if (!parser.handler().failure.empty()) {
+            throw boost::system::system_error(error_code, parser.handler().failure);
+        }
+        throw boost::system::system_error(error_code);
+    }
+};
+
+cppai::schema::document_parser::document_parser(slot root) : impl{ std::make_unique<state>(root) } {
+}
+
+cppai::schema::document_parser::~document_parser() = default;
+
+void cppai::schema::document_parser::write(std::string_view chunk) {
+    boost::json::error_code error_code;
+    impl->parser.write_some(true, chunk.data(), chunk.size(), error_code);
+    if (error_code) {
+        impl->raise(error_code);
+    }
+}
+
+void cppai::schema::document_parser::finish() {
+    boost::json::error_code error_code;
+    impl->parser.write_some(false, nullptr, 0, error_code);
+    if (error_code) {
+        impl->raise(error_code);
+    }
+}
+
+namespace {
+    boost::json::value error_document(std::string_view body) {
+        boost::json::error_code error_code;
+        boost::json::value document = boost::json::parse(body, error_code);
+        if (error_code) {
+            return boost::json::string{ body };
+        }
+        return document;
+    }
+
+    std::string error_message(std::uint32_t status, const boost::json::value& document) {
+        if (const boost::json::object* fields = document.if_object()) {
+            const boost::json::value* error = fields->if_contains("error");
+            const boost::json::value* message = error != nullptr && error->is_object() ? error->get_object().if_contains("message") : nullptr;
+            if (message != nullptr && message->is_string()) {
+                return std::string{ message->get_string() };
+            }
+        }
+        return "request failed with status " + std::to_string(status);
+    }
+}
+
+// Error bodies are small, so parsing one twice keeps the message and the document independent.
+cppai::api_error::api_error(std::uint32_t status, std::string_view body)
+    : std::runtime_error{ error_message(status, error_document(body)) }, code{ status }, document{ error_document(body) } {
+}
+
+std::uint32_t cppai::api_error::status() const {
+    return code;
+}
+
+const boost::json::value& cppai::api_error::body() const {
+    return document;
+}
@@ -0,0 +1,395 @@
+#ifndef CPPAI_SCHEMA_H
+#define CPPAI_SCHEMA_H
+#include <boost/describe.hpp>
+#include <boost/json.hpp>
+#include <boost/mp11/algorithm.hpp>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cppai {
+    // Typed request and response structs are plain aggregates described with BOOST_DESCRIBE_STRUCT. Their
+    // JSON writers and parsers are generated from the description at compile time: a request is written
+    // straight into the request body, and a response is parsed straight from the bytes into the struct
+    // through a boost::json::basic_parser, without building a DOM in between.
+    //
+    // Supported members: bool, arithmetic types, std::string, std::optional (absent when empty, and null
+    // resets it), std::vector, std::map<std::string, T>, other described structs, and boost::json::value
+    // for free-form request fields. Response members the struct does not name are skipped.
+    namespace schema {
+        template <class T>
+        struct is_optional : std::false_type {};
+
+        template <class T>
+        struct is_optional<std::optional<T>> : std::true_type {};
+
+        template <class T>
+        struct is_vector : std::false_type {};
+
+        template <class T, class Allocator>
+        struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+        template <class T>
+        struct is_string_map : std::false_type {};
+
+        template <class T, class Compare, class Allocator>
+        struct is_string_map<std::map<std::string, T, Compare, Allocator>> : std::true_type {};
+
+        template <class T>
+        using members = boost::describe::describe_members<T, boost::describe::mod_public>;
+
+        template <class Out>
+        void write_escaped(std::string_view text, Out& out) {
+            static constexpr char hex[] = "0123456789abcdef";
+            out.push_back('"');
+            std::size_t plain = 0;
+            for (std::size_t i = 0; i < text.size(); ++i) {
+                const unsigned char c = static_cast<unsigned char>(text[i]);
+                if (c >= 0x20 && c != '"' && c != '\\') {
+                    continue;
+                }
+                out.append(text.data() + plain, i - plain);
+                plain = i + 1;
+                switch (c) {
+                case '"':
+                    out.append("\\\"", 2);
+                    break;
+                case '\\':
+                    out.append("\\\\", 2);
+                    break;
+                case '\n':
+                    out.append("\\n", 2);
+                    break;
+                case '\r':
+                    out.append("\\r", 2);
+                    break;
+                case '\t':
+                    out.append("\\t", 2);
+                    break;
+                default: {
+                    const char escape[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+                    out.append(escape, sizeof(escape));
+                }
+                }
+            }
+            out.append(text.data() + plain, text.size() - plain);
+            out.push_back('"');
+        }
+
+        template <class T, class Out>
+        void write(const T& value, Out& out) {
+            if constexpr (std::is_same_v<T, bool>) {
+                out.append(value ? "true" : "false");
+            }
+            else if constexpr (std::is_arithmetic_v<T>) {
+                if constexpr (std::is_floating_point_v<T>) {
+                    // JSON has no spelling for these.
+                    if (!std::isfinite(value)) {
+                        out.append("null");
+                        return;
+                    }
+                }
+                std::array<char, 32> digits;
+                const auto result = std::to_chars(digits.data(), digits.data() + digits.size(), value);
+                out.append(digits.data(), static_cast<std::size_t>(result.ptr - digits.data()));
+            }
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                write_escaped(std::string_view{ value }, out);
+            }
+            else if constexpr (is_optional<T>::value) {
+                if (value.has_value()) {
+                    write(value.value(), out);
+                }
+                else {
+                    out.append("null");
+                }
+            }
+            else if constexpr (is_vector<T>::value) {
+                out.push_back('[');
+                for (std::size_t i = 0; i < value.size(); ++i) {
+                    if (i != 0) {
+                        out.push_back(',');
+                    }
+                    write(value[i], out);
+                }
+                out.push_back(']');
+            }
+            else if constexpr (is_string_map<T>::value) {
+                out.push_back('{');
+                bool first = true;
+                for (const auto& [key, mapped] : value) {
+                    if (!first) {
+                        out.push_back(',');
+                    }
+                    first = false;
+                    write_escaped(key, out);
+                    out.push_back(':');
+                    write(mapped, out);
+                }
+                out.push_back('}');
+            }
+            else if constexpr (std::is_same_v<T, boost::json::value>) {
+                const std::string text = boost::json::serialize(value);
+                out.append(text.data(), text.size());
+            }
+            else {
+                static_assert(boost::describe::has_describe_members<T>::value, "schema types need BOOST_DESCRIBE_STRUCT");
+                out.push_back('{');
+                bool first = true;
+                boost::mp11::mp_for_each<members<T>>([&](auto member) {
+                    const auto& field = value.*member.pointer;
+                    if constexpr (is_optional<std::remove_cvref_t<decltype(field)>>::value) {
+                        if (!field.has_value()) {
+                            return;
+                        }
+                    }
+                    if (!first) {
+                        out.push_back(',');
+                    }
+                    first = false;
+                    write_escaped(member.name, out);
+                    out.push_back(':');
+                    write(field, out);
+                });
+                out.push_back('}');
+            }
+        }
+
+        struct type_ops;
+
+        // Where the next value goes; ops is null for values the schema does not name.
+        struct slot {
+            void* target = nullptr;
+            const type_ops* ops = nullptr;
+        };
+
+        // What a parser may do with one C++ type, erased to function pointers so a single basic_parser
+        // handler serves every schema. The scalar setters return false for a JSON type that does not fit.
+        struct type_ops {
+            enum class shape {
+                scalar,
+                object,
+                array
+            };
+
+            shape kind = shape::scalar;
+            // Gives the storage for a non-null value, e.g. emplacing an optional.
+            slot (*resolve)(void* target) = nullptr;
+            bool (*on_string)(void* target, std::string_view text) = nullptr;
+            bool (*on_int64)(void* target, std::int64_t value) = nullptr;
+            bool (*on_uint64)(void* target, std::uint64_t value) = nullptr;
+            bool (*on_double)(void* target, double value) = nullptr;
+            bool (*on_bool)(void* target, bool value) = nullptr;
+            void (*on_null)(void* target) = nullptr;
+            slot (*member)(void* target, std::string_view key) = nullptr;
+            slot (*element)(void* target) = nullptr;
+        };
+
+        template <class T>
+        const type_ops* ops_for();
+
+        template <class T>
+        type_ops make_ops() {
+            type_ops ops;
+            ops.resolve = [](void* target) { return slot{ target, ops_for<T>() }; };
+            ops.on_string = [](void*, std::string_view) { return false; };
+            ops.on_int64 = [](void*, std::int64_t) { return false; };
+            ops.on_uint64 = [](void*, std::uint64_t) { return false; };
+            ops.on_double = [](void*, double) { return false; };
+            ops.on_bool = [](void*, bool) { return false; };
+            // A null where the type has no room for one leaves the default, as the API sends null for
+            // many fields that are merely not applicable.
+            ops.on_null = [](void*) {};
+            ops.member = [](void*, std::string_view) { return slot{}; };
+            ops.element = [](void*) { return slot{}; };
+
+            if constexpr (std::is_same_v<T, bool>) {
+                ops.on_bool = [](void* target, bool value) {
+                    *static_cast<T*>(target) = value;
+                    return true;
+                };
+            }
+            else if constexpr (std::is_integral_v<T>) {
+                ops.on_int64 = [](void* target, std::int64_t value) {
+                    if (!std::in_range<T>(value)) {
+                        return false;
+                    }
+                    *static_cast<T*>(target) = static_cast<T>(value);
+                    return true;
+                };
+                ops.on_uint64 = [](void* target, std::uint64_t value) {
+                    if (!std::in_range<T>(value)) {
+                        return false;
+                    }
+                    *static_cast<T*>(target) = static_cast<T>(value);
+                    return true;
+                };
+            }
+            else if constexpr (std::is_floating_point_v<T>) {
+                ops.on_int64 = [](void* target, std::int64_t value) {
+                    *static_cast<T*>(target) = static_cast<T>(value);
+                    return true;
+                };
+                ops.on_uint64 = [](void* target, std::uint64_t value) {
+                    *static_cast<T*>(target) = static_cast<T>(value);
+                    return true;
+                };
+                ops.on_double = [](void* target, double value) {
+                    *static_cast<T*>(target) = static_cast<T>(value);
+                    return true;
+                };
+            }
+            else if constexpr (std::is_same_v<T, std::string>) {
+                ops.on_string = [](void* target, std::string_view text) {
+                    static_cast<T*>(target)->assign(text);
+                    return true;
+                };
+            }
+            else if constexpr (is_optional<T>::value) {
+                ops.resolve = [](void* target) {
+                    T& optional = *static_cast<T*>(target);
+                    optional.emplace();
+                    return ops_for<typename T::value_type>()->resolve(&optional.value());
+                };
+                ops.on_null = [](void* target) { static_cast<T*>(target)->reset(); };
+            }
+            else if constexpr (is_vector<T>::value) {
+                static_assert(!std::is_same_v<typename T::value_type, bool>, "use std::vector<std::uint8_t> for arrays of booleans");
+                ops.kind = type_ops::shape::array;
+                ops.element = [](void* target) {
+                    T& elements = *static_cast<T*>(target);
+                    elements.emplace_back();
+                    return slot{ &elements.back(), ops_for<typename T::value_type>() };
+                };
+            }
+            else if constexpr (is_string_map<T>::value) {
+                ops.kind = type_ops::shape::object;
+                ops.member = [](void* target, std::string_view key) {
+                    T& entries = *static_cast<T*>(target);
+                    return slot{ &entries[std::string{ key }], ops_for<typename T::mapped_type>() };
+                };
+            }
+            else {
+                static_assert(boost::describe::has_describe_members<T>::value, "schema types need BOOST_DESCRIBE_STRUCT");
+                ops.kind = type_ops::shape::object;
+                ops.member = [](void* target, std::string_view key) {
+                    slot found;
+                    boost::mp11::mp_for_each<members<T>>([&](auto member) {
+                        if (found.ops == nullptr && key == member.name) {
+                            auto& field = static_cast<T*>(target)->*member.pointer;
+                            found = slot{ &field, ops_for<std::remove_cvref_t<decltype(field)>>() };
+                        }
+                    });
+                    return found;
+                };
+            }
+            return ops;
+        }
+
+        template <class T>
+        const type_ops* ops_for() {
+            static const type_ops ops = make_ops<T>();
+            return &ops;
+        }
+
+        // Feeds JSON text into the object at root as it arrives. A value of the wrong JSON type throws a
+        // system_error naming the member.
+        class document_parser {
+        public:
+            explicit document_parser(slot root);
+
+            ~document_parser();
+
+            document_parser(const document_parser&) = delete;
+
+            document_parser& operator=(const document_parser&) = delete;
+
+            void write(std::string_view chunk);
+
+            void finish();
+
+        private:
+            struct state;
+
+            std::unique_ptr<state> impl;
+        };
+    }
+
+    template <class T, class Out>
+    void write_json(const T& value, Out& out) {
+        schema::write(value, out);
+    }
+
+    template <class T>
+    std::string to_json(const T& value) {
+        std::string out;
+        schema::write(value, out);
+        return out;
+    }
+
+    template <class T>
+    class typed_parser {
+    public:
+        typed_parser() : parser{ schema::slot{ &value, schema::ops_for<T>() } } {}
+
+        void write(std::string_view chunk) {
+            parser.write(chunk);
+        }
+
+        T finish() {
+            parser.finish();
+            return std::move(value);
+        }
+
+    private:
+        T value{};
+        schema::document_parser parser;
+    };
+
+    template <class T>
+    T parse_typed(std::string_view body) {
+        typed_parser<T> parser;
+        parser.write(body);
+        return parser.finish();
+    }
+
+    // An error reply to a typed call, which has no field to carry it in.
+    class api_error : public std::runtime_error {
+    public:
+        // Keeps body as parsed JSON, or as a string when it is not JSON, e.g. a gateway's HTML page.
+        api_error(std::uint32_t status, std::string_view body);
+
+        std::uint32_t status() const;
+
+        const boost::json::value& body() const;
+
+    private:
+        std::uint32_t code;
+        boost::json::value document;
+    };
+
+    // Decodes a response body into T; error statuses throw api_error.
+    template <class T>
+    struct typed_decoder {
+        using result_type = T;
+
+        result_type operator()(std::uint32_t status, std::string_view body) const {
+            if (status >= 400) {
+                throw api_error(status, body);
+            }
+            return parse_typed<T>(body);
+        }
+    };
+}
+
+#endif
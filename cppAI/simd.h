@@ -0,0 +1,17 @@
+#ifndef CPPAI_SIMD_H
+#define CPPAI_SIMD_H
+
+// Kernels are compiled per instruction set with CPPAI_TARGET and picked at run time, so the library builds
+// for the baseline ISA. MSVC needs no target attribute to emit AVX intrinsics.
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPPAI_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define CPPAI_TARGET(isa)
+#else
+#define CPPAI_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+#endif
@@ -0,0 +1,122 @@
+#include "sse.h"
+
+cppai::sse_parser::sse_parser(event_handler on_event) : on_event{ std::move(on_event) } {
+}
+
+void cppai::sse_parser::write(std::string_view chunk) {
+    std::size_t pos = 0;
+    while (pos < chunk.size() && !finished) {
+        if (state == line_state::field) {
+            const char c = chunk[pos++];
+            if (c == '\n') {
+                end_line();
+            }
+            else if (c == ':') {
+                if (field == "data") {
+                    state = line_state::data;
+                    skip_space = true;
+                    if (has_data) {
+                        data_bytes("\n");
+                    }
+                    else {
+                        has_data = true;
+                        probing = true;
+                        probe.clear();
+                    }
+                }
+                else {
+                    state = line_state::skip;
+                }
+            }
+            else if (c != '\r') {
+                field.push_back(c);
+            }
+            continue;
+        }
+
+        const std::size_t end = chunk.find('\n', pos);
+        std::string_view line = chunk.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+        if (state == line_state::data) {
+            if (skip_space && !line.empty()) {
+                skip_space = false;
+                if (line.front() == ' ') {
+                    line.remove_prefix(1);
+                }
+            }
+            if (end != std::string_view::npos && !line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            data_bytes(line);
+        }
+
+        if (end == std::string_view::npos) {
+            pos = chunk.size();
+        }
+        else {
+            pos = end + 1;
+            end_line();
+        }
+    }
+}
+
+bool cppai::sse_parser::done() const {
+    return finished;
+}
+
+void cppai::sse_parser::end_line() {
+    if (state == line_state::field && field.empty()) {
+        dispatch();
+    }
+    else if (state == line_state::data && probing) {
+        flush_probe();
+    }
+    state = line_state::field;
+    field.clear();
+}
+
+void cppai::sse_parser::data_bytes(std::string_view bytes) {
+    if (probing) {
+        const std::size_t take = std::min(bytes.size(), done_marker.size() - probe.size());
+        probe.append(bytes.substr(0, take));
+        bytes.remove_prefix(take);
+        if (probe.size() < done_marker.size()) {
+            return;
+        }
+        flush_probe();
+    }
+    if (!finished && !bytes.empty()) {
+        json_parser.write(bytes.data(), bytes.size());
+        json_started = true;
+    }
+}
+
+void cppai::sse_parser::flush_probe() {
+    probing = false;
+    if (probe == done_marker) {
+        finished = true;
+        return;
+    }
+    if (!probe.empty()) {
+        json_parser.write(probe.data(), probe.size());
+        json_started = true;
+    }
+}
+
+void cppai::sse_parser::dispatch() {
+    if (!has_data) {
+        return;
+    }
+    has_data = false;
+    if (probing) {
+        flush_probe();
+    }
+    if (finished || !json_started) {
+        return;
+    }
+
+    json_parser.finish();
+    boost::json::value event = json_parser.release();
+    json_parser.reset();
+    json_started = false;
+    on_event(event);
+}
@@ -0,0 +1,47 @@
+#ifndef CPPAI_SSE_H
+#define CPPAI_SSE_H
+#include <boost/json.hpp>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace cppai {
+    // Incremental text/event-stream decoder: each event's data lines are fed straight into a
+    // boost::json::stream_parser, so only the event being decoded is ever held in memory.
+    class sse_parser {
+    public:
+        using event_handler = std::function<void(const boost::json::value&)>;
+
+        explicit sse_parser(event_handler on_event);
+
+        void write(std::string_view chunk);
+
+        bool done() const;
+
+    private:
+        enum class line_state { field, data, skip };
+
+        static constexpr std::string_view done_marker = "[DONE]";
+
+        event_handler on_event;
+        boost::json::stream_parser json_parser;
+        line_state state = line_state::field;
+        std::string field;
+        std::string probe;
+        bool probing = false;
+        bool skip_space = false;
+        bool has_data = false;
+        bool json_started = false;
+        bool finished = false;
+
+        void end_line();
+
+        void data_bytes(std::string_view bytes);
+
+        void flush_probe();
+
+        void dispatch();
+    };
+}
+
+#endif
@@ -0,0 +1,1089 @@
+#include "tokenizer.h"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <thread>
+#include "utility.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPPAI_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+    enum char_class : std::uint8_t {
+        other,
+        letter,
+        number,
+        // Whitespace other than \r and \n.
+        space,
+        newline
+    };
+
+    struct unicode_range {
+        char32_t first;
+        char32_t last;
+        char_class kind;
+    };
+
+    // \p{L} and \p{N} above ASCII, generated from the Unicode 14 character database.
+    constexpr unicode_range unicode_classes[] = {
+        { 0x00AA, 0x00AA, letter }, { 0x00B2, 0x00B3, number }, { 0x00B5, 0x00B5, letter }, { 0x00B9, 0x00B9, number },
+        { 0x00BA, 0x00BA, letter }, { 0x00BC, 0x00BE, number }, { 0x00C0, 0x00D6, letter }, { 0x00D8, 0x00F6, letter },
+        { 0x00F8, 0x02C1, letter }, { 0x02C6, 0x02D1, letter }, { 0x02E0, 0x02E4, letter }, { 0x02EC, 0x02EC, letter },
+        { 0x02EE, 0x02EE, letter }, { 0x0370, 0x0374, letter }, { 0x0376, 0x0377, letter }, { 0x037A, 0x037D, letter },
+        { 0x037F, 0x037F, letter }, { 0x0386, 0x0386, letter }, { 0x0388, 0x038A, letter }, { 0x038C, 0x038C, letter },
+        { 0x038E, 0x03A1, letter }, { 0x03A3, 0x03F5, letter }, { 0x03F7, 0x0481, letter }, { 0x048A, 0x052F, letter },
+        { 0x0531, 0x0556, letter }, { 0x0559, 0x0559, letter }, { 0x0560, 0x0588, letter }, { 0x05D0, 0x05EA, letter },
+        { 0x05EF, 0x05F2, letter }, { 0x0620, 0x064A, letter }, { 0x0660, 0x0669, number }, { 0x066E, 0x066F, letter },
+        { 0x0671, 0x06D3, letter }, { 0x06D5, 0x06D5, letter }, { 0x06E5, 0x06E6, letter }, { 0x06EE, 0x06EF, letter },
+        { 0x06F0, 0x06F9, number }, { 0x06FA, 0x06FC, letter }, { 0x06FF, 0x06FF, letter }, { 0x0710, 0x0710, letter },
+        { 0x0712, 0x072F, letter }, { 0x074D, 0x07A5, letter }, { 0x07B1, 0x07B1, letter }, { 0x07C0, 0x07C9, number },
+        { 0x07CA, 0x07EA, letter }, { 0x07F4, 0x07F5, letter }, { 0x07FA, 0x07FA, letter }, { 0x0800, 0x0815, letter },
+        { 0x081A, 0x081A, letter }, { 0x0824, 0x0824, letter }, { 0x0828, 0x0828, letter }, { 0x0840, 0x0858, letter },
+        { 0x0860, 0x086A, letter }, { 0x0870, 0x0887, letter }, { 0x0889, 0x088E, letter }, { 0x08A0, 0x08C9, letter },
+        { 0x0904, 0x0939, letter }, { 0x093D, 0x093D, letter }, { 0x0950, 0x0950, letter }, { 0x0958, 0x0961, letter },
+        { 0x0966, 0x096F, number }, { 0x0971, 0x0980, letter }, { 0x0985, 0x098C, letter }, { 0x098F, 0x0990, letter },
+        { 0x0993, 0x09A8, letter }, { 0x09AA, 0x09B0, letter }, { 0x09B2, 0x09B2, letter }, { 0x09B6, 0x09B9, letter },
+        { 0x09BD, 0x09BD, letter }, { 0x09CE, 0x09CE, letter }, { 0x09DC, 0x09DD, letter }, { 0x09DF, 0x09E1, letter },
+        { 0x09E6, 0x09EF, number }, { 0x09F0, 0x09F1, letter }, { 0x09F4, 0x09F9, number }, { 0x09FC, 0x09FC, letter },
+        { 0x0A05, 0x0A0A, letter }, { 0x0A0F, 0x0A10, letter }, { 0x0A13, 0x0A28, letter }, { 0x0A2A, 0x0A30, letter },
+        { 0x0A32, 0x0A33, letter }, { 0x0A35, 0x0A36, letter }, { 0x0A38, 0x0A39, letter }, { 0x0A59, 0x0A5C, letter },
+        { 0x0A5E, 0x0A5E, letter }, { 0x0A66, 0x0A6F, number }, { 0x0A72, 0x0A74, letter }, { 0x0A85, 0x0A8D, letter },
+        { 0x0A8F, 0x0A91, letter }, { 0x0A93, 0x0AA8, letter }, { 0x0AAA, 0x0AB0, letter }, { 0x0AB2, 0x0AB3, letter },
+        { 0x0AB5, 0x0AB9, letter }, { 0x0ABD, 0x0ABD, letter }, { 0x0AD0, 0x0AD0, letter }, { 0x0AE0, 0x0AE1, letter },
+        { 0x0AE6, 0x0AEF, number }, { 0x0AF9, 0x0AF9, letter }, { 0x0B05, 0x0B0C, letter }, { 0x0B0F, 0x0B10, letter },
+        { 0x0B13, 0x0B28, letter }, { 0x0B2A, 0x0B30, letter }, { 0x0B32, 0x0B33, letter }, { 0x0B35, 0x0B39, letter },
+        { 0x0B3D, 0x0B3D, letter }, { 0x0B5C, 0x0B5D, letter }, { 0x0B5F, 0x0B61, letter }, { 0x0B66, 0x0B6F, number },
+        { 0x0B71, 0x0B71, letter }, { 0x0B72, 0x0B77, number }, { 0x0B83, 0x0B83, letter }, { 0x0B85, 0x0B8A, letter },
+        { 0x0B8E, 0x0B90, letter }, { 0x0B92, 0x0B95, letter }, { 0x0B99, 0x0B9A, letter }, { 0x0B9C, 0x0B9C, letter },
+        { 0x0B9E, 0x0B9F, letter }, { 0x0BA3, 0x0BA4, letter }, { 0x0BA8, 0x0BAA, letter }, { 0x0BAE, 0x0BB9, letter },
+        { 0x0BD0, 0x0BD0, letter }, { 0x0BE6, 0x0BF2, number }, { 0x0C05, 0x0C0C, letter }, { 0x0C0E, 0x0C10, letter },
+        { 0x0C12, 0x0C28, letter }, { 0x0C2A, 0x0C39, letter }, { 0x0C3D, 0x0C3D, letter }, { 0x0C58, 0x0C5A, letter },
+        { 0x0C5D, 0x0C5D, letter }, { 0x0C60, 0x0C61, letter }, { 0x0C66, 0x0C6F, number }, { 0x0C78, 0x0C7E, number },
+        { 0x0C80, 0x0C80, letter }, { 0x0C85, 0x0C8C, letter }, { 0x0C8E, 0x0C90, letter }, { 0x0C92, 0x0CA8, letter },
+        { 0x0CAA, 0x0CB3, letter }, { 0x0CB5, 0x0CB9, letter }, { 0x0CBD, 0x0CBD, letter }, { 0x0CDD, 0x0CDE, letter },
+        { 0x0CE0, 0x0CE1, letter }, { 0x0CE6, 0x0CEF, number }, { 0x0CF1, 0x0CF2, letter }, { 0x0D04, 0x0D0C, letter },
+        { 0x0D0E, 0x0D10, letter }, { 0x0D12, 0x0D3A, letter }, { 0x0D3D, 0x0D3D, letter }, { 0x0D4E, 0x0D4E, letter },
+        { 0x0D54, 0x0D56, letter }, { 0x0D58, 0x0D5E, number }, { 0x0D5F, 0x0D61, letter }, { 0x0D66, 0x0D78, number },
+        { 0x0D7A, 0x0D7F, letter }, { 0x0D85, 0x0D96, letter }, { 0x0D9A, 0x0DB1, letter }, { 0x0DB3, 0x0DBB, letter },
+        { 0x0DBD, 0x0DBD, letter }, { 0x0DC0, 0x0DC6, letter }, { 0x0DE6, 0x0DEF, number }, { 0x0E01, 0x0E30, letter },
+        { 0x0E32, 0x0E33, letter }, { 0x0E40, 0x0E46, letter }, { 0x0E50, 0x0E59, number }, { 0x0E81, 0x0E82, letter },
+        { 0x0E84, 0x0E84, letter }, { 0x0E86, 0x0E8A, letter }, { 0x0E8C, 0x0EA3, letter }, { 0x0EA5, 0x0EA5, letter },
+        { 0x0EA7, 0x0EB0, letter }, { 0x0EB2, 0x0EB3, letter }, { 0x0EBD, 0x0EBD, letter }, { 0x0EC0, 0x0EC4, letter },
+        { 0x0EC6, 0x0EC6, letter }, { 0x0ED0, 0x0ED9, number }, { 0x0EDC, 0x0EDF, letter }, { 0x0F00, 0x0F00, letter },
+        { 0x0F20, 0x0F33, number }, { 0x0F40, 0x0F47, letter }, { 0x0F49, 0x0F6C, letter }, { 0x0F88, 0x0F8C, letter },
+        { 0x1000, 0x102A, letter }, { 0x103F, 0x103F, letter }, { 0x1040, 0x1049, number }, { 0x1050, 0x1055, letter },
+        { 0x105A, 0x105D, letter }, { 0x1061, 0x1061, letter }, { 0x1065, 0x1066, letter }, { 0x106E, 0x1070, letter },
+        { 0x1075, 0x1081, letter }, { 0x108E, 0x108E, letter }, { 0x1090, 0x1099, number }, { 0x10A0, 0x10C5, letter },
+        { 0x10C7, 0x10C7, letter }, { 0x10CD, 0x10CD, letter }, { 0x10D0, 0x10FA, letter }, { 0x10FC, 0x1248, letter },
+        { 0x124A, 0x124D, letter }, { 0x1250, 0x1256, letter }, { 0x1258, 0x1258, letter }, { 0x125A, 0x125D, letter },
+        { 0x1260, 0x1288, letter }, { 0x128A, 0x128D, letter }, { 0x1290, 0x12B0, letter }, { 0x12B2, 0x12B5, letter },
+        { 0x12B8, 0x12BE, letter }, { 0x12C0, 0x12C0, letter }, { 0x12C2, 0x12C5, letter }, { 0x12C8, 0x12D6, letter },
+        { 0x12D8, 0x1310, letter }, { 0x1312, 0x1315, letter }, { 0x1318, 0x135A, letter }, { 0x1369, 0x137C, number },
+        { 0x1380, 0x138F, letter }, { 0x13A0, 0x13F5, letter }, { 0x13F8, 0x13FD, letter }, { 0x1401, 0x166C, letter },
+        { 0x166F, 0x167F, letter }, { 0x1681, 0x169A, letter }, { 0x16A0, 0x16EA, letter }, { 0x16EE, 0x16F0, number },
+        { 0x16F1, 0x16F8, letter }, { 0x1700, 0x1711, letter }, { 0x171F, 0x1731, letter }, { 0x1740, 0x1751, letter },
+        { 0x1760, 0x176C, letter }, { 0x176E, 0x1770, letter }, { 0x1780, 0x17B3, letter }, { 0x17D7, 0x17D7, letter },
+        { 0x17DC, 0x17DC, letter }, { 0x17E0, 0x17E9, number }, { 0x17F0, 0x17F9, number }, { 0x1810, 0x1819, number },
+        { 0x1820, 0x1878, letter }, { 0x1880, 0x1884, letter }, { 0x1887, 0x18A8, letter }, { 0x18AA, 0x18AA, letter },
+        { 0x18B0, 0x18F5, letter }, { 0x1900, 0x191E, letter }, { 0x1946, 0x194F, number }, { 0x1950, 0x196D, letter },
+        { 0x1970, 0x1974, letter }, { 0x1980, 0x19AB, letter }, { 0x19B0, 0x19C9, letter }, { 0x19D0, 0x19DA, number },
+        { 0x1A00, 0x1A16, letter }, { 0x1A20, 0x1A54, letter }, { 0x1A80, 0x1A89, number }, { 0x1A90, 0x1A99, number },
+        { 0x1AA7, 0x1AA7, letter }, { 0x1B05, 0x1B33, letter }, { 0x1B45, 0x1B4C, letter }, { 0x1B50, 0x1B59, number },
+        { 0x1B83, 0x1BA0, letter }, { 0x1BAE, 0x1BAF, letter }, { 0x1BB0, 0x1BB9, number }, { 0x1BBA, 0x1BE5, letter },
+        { 0x1C00, 0x1C23, letter }, { 0x1C40, 0x1C49, number }, { 0x1C4D, 0x1C4F, letter }, { 0x1C50, 0x1C59, number },
+        { 0x1C5A, 0x1C7D, letter }, { 0x1C80, 0x1C88, letter }, { 0x1C90, 0x1CBA, letter }, { 0x1CBD, 0x1CBF, letter },
+        { 0x1CE9, 0x1CEC, letter }, { 0x1CEE, 0x1CF3, letter }, { 0x1CF5, 0x1CF6, letter }, { 0x1CFA, 0x1CFA, letter },
+        { 0x1D00, 0x1DBF, letter }, { 0x1E00, 0x1F15, letter }, { 0x1F18, 0x1F1D, letter }, { 0x1F20, 0x1F45, letter },
+        { 0x1F48, 0x1F4D, letter }, { 0x1F50, 0x1F57, letter }, { 0x1F59, 0x1F59, letter }, { 0x1F5B, 0x1F5B, letter },
+        { 0x1F5D, 0x1F5D, letter }, { 0x1F5F, 0x1F7D, letter }, { 0x1F80, 0x1FB4, letter }, { 0x1FB6, 0x1FBC, letter },
+        { 0x1FBE, 0x1FBE, letter }, { 0x1FC2, 0x1FC4, letter }, { 0x1FC6, 0x1FCC, letter }, { 0x1FD0, 0x1FD3, letter },
+        { 0x1FD6, 0x1FDB, letter }, { 0x1FE0, 0x1FEC, letter }, { 0x1FF2, 0x1FF4, letter }, { 0x1FF6, 0x1FFC, letter },
+        { 0x2070, 0x2070, number }, { 0x2071, 0x2071, letter }, { 0x2074, 0x2079, number }, { 0x207F, 0x207F, letter },
+        { 0x2080, 0x2089, number }, { 0x2090, 0x209C, letter }, { 0x2102, 0x2102, letter }, { 0x2107, 0x2107, letter },
+        { 0x210A, 0x2113, letter }, { 0x2115, 0x2115, letter }, { 0x2119, 0x211D, letter }, { 0x2124, 0x2124, letter },
+        { 0x2126, 0x2126, letter }, { 0x2128, 0x2128, letter }, { 0x212A, 0x212D, letter }, { 0x212F, 0x2139, letter },
+        { 0x213C, 0x213F, letter }, { 0x2145, 0x2149, letter }, { 0x214E, 0x214E, letter }, { 0x2150, 0x2182, number },
+        { 0x2183, 0x2184, letter }, { 0x2185, 0x2189, number }, { 0x2460, 0x249B, number }, { 0x24EA, 0x24FF, number },
+        { 0x2776, 0x2793, number }, { 0x2C00, 0x2CE4, letter }, { 0x2CEB, 0x2CEE, letter }, { 0x2CF2, 0x2CF3, letter },
+        { 0x2CFD, 0x2CFD, number }, { 0x2D00, 0x2D25, letter }, { 0x2D27, 0x2D27, letter }, { 0x2D2D, 0x2D2D, letter },
+        { 0x2D30, 0x2D67, letter }, { 0x2D6F, 0x2D6F, letter }, { 0x2D80, 0x2D96, letter }, { 0x2DA0, 0x2DA6, letter },
+        { 0x2DA8, 0x2DAE, letter }, { 0x2DB0, 0x2DB6, letter }, { 0x2DB8, 0x2DBE, letter }, { 0x2DC0, 0x2DC6, letter },
+        { 0x2DC8, 0x2DCE, letter }, { 0x2DD0, 0x2DD6, letter }, { 0x2DD8, 0x2DDE, letter }, { 0x2E2F, 0x2E2F, letter },
+        { 0x3005, 0x3006, letter }, { 0x3007, 0x3007, number }, { 0x3021, 0x3029, number }, { 0x3031, 0x3035, letter },
+        { 0x3038, 0x303A, number }, { 0x303B, 0x303C, letter }, { 0x3041, 0x3096, letter }, { 0x309D, 0x309F, letter },
+        { 0x30A1, 0x30FA, letter }, { 0x30FC, 0x30FF, letter }, { 0x3105, 0x312F, letter }, { 0x3131, 0x318E, letter },
+        { 0x3192, 0x3195, number }, { 0x31A0, 0x31BF, letter }, { 0x31F0, 0x31FF, letter }, { 0x3220, 0x3229, number },
+        { 0x3248, 0x324F, number }, { 0x3251, 0x325F, number }, { 0x3280, 0x3289, number }, { 0x32B1, 0x32BF, number },
+        { 0x3400, 0x4DBF, letter }, { 0x4E00, 0xA48C, letter }, { 0xA4D0, 0xA4FD, letter }, { 0xA500, 0xA60C, letter },
+        { 0xA610, 0xA61F, letter }, { 0xA620, 0xA629, number }, { 0xA62A, 0xA62B, letter }, { 0xA640, 0xA66E, letter },
+        { 0xA67F, 0xA69D, letter }, { 0xA6A0, 0xA6E5, letter }, { 0xA6E6, 0xA6EF, number }, { 0xA717, 0xA71F, letter },
+        { 0xA722, 0xA788, letter }, { 0xA78B, 0xA7CA, letter }, { 0xA7D0, 0xA7D1, letter }, { 0xA7D3, 0xA7D3, letter },
+        { 0xA7D5, 0xA7D9, letter }, { 0xA7F2, 0xA801, letter }, { 0xA803, 0xA805, letter }, { 0xA807, 0xA80A, letter },
+        { 0xA80C, 0xA822, letter }, { 0xA830, 0xA835, number }, { 0xA840, 0xA873, letter }, { 0xA882, 0xA8B3, letter },
+        { 0xA8D0, 0xA8D9, number }, { 0xA8F2, 0xA8F7, letter }, { 0xA8FB, 0xA8FB, letter }, { 0xA8FD, 0xA8FE, letter },
+        { 0xA900, 0xA909, number }, { 0xA90A, 0xA925, letter }, { 0xA930, 0xA946, letter }, { 0xA960, 0xA97C, letter },
+        { 0xA984, 0xA9B2, letter }, { 0xA9CF, 0xA9CF, letter }, { 0xA9D0, 0xA9D9, number }, { 0xA9E0, 0xA9E4, letter },
+        { 0xA9E6, 0xA9EF, letter }, { 0xA9F0, 0xA9F9, number }, { 0xA9FA, 0xA9FE, letter }, { 0xAA00, 0xAA28, letter },
+        { 0xAA40, 0xAA42, letter }, { 0xAA44, 0xAA4B, letter }, { 0xAA50, 0xAA59, number }, { 0xAA60, 0xAA76, letter },
+        { 0xAA7A, 0xAA7A, letter }, { 0xAA7E, 0xAAAF, letter }, { 0xAAB1, 0xAAB1, letter }, { 0xAAB5, 0xAAB6, letter },
+        { 0xAAB9, 0xAABD, letter }, { 0xAAC0, 0xAAC0, letter }, { 0xAAC2, 0xAAC2, letter }, { 0xAADB, 0xAADD, letter },
+        { 0xAAE0, 0xAAEA, letter }, { 0xAAF2, 0xAAF4, letter }, { 0xAB01, 0xAB06, letter }, { 0xAB09, 0xAB0E, letter },
+        { 0xAB11, 0xAB16, letter }, { 0xAB20, 0xAB26, letter }, { 0xAB28, 0xAB2E, letter }, { 0xAB30, 0xAB5A, letter },
+        { 0xAB5C, 0xAB69, letter }, { 0xAB70, 0xABE2, letter }, { 0xABF0, 0xABF9, number }, { 0xAC00, 0xD7A3, letter },
+        { 0xD7B0, 0xD7C6, letter }, { 0xD7CB, 0xD7FB, letter }, { 0xF900, 0xFA6D, letter }, { 0xFA70, 0xFAD9, letter },
+        { 0xFB00, 0xFB06, letter }, { 0xFB13, 0xFB17, letter }, { 0xFB1D, 0xFB1D, letter }, { 0xFB1F, 0xFB28, letter },
+        { 0xFB2A, 0xFB36, letter }, { 0xFB38, 0xFB3C, letter }, { 0xFB3E, 0xFB3E, letter }, { 0xFB40, 0xFB41, letter },
+        { 0xFB43, 0xFB44, letter }, { 0xFB46, 0xFBB1, letter }, { 0xFBD3, 0xFD3D, letter }, { 0xFD50, 0xFD8F, letter },
+        { 0xFD92, 0xFDC7, letter }, { 0xFDF0, 0xFDFB, letter }, { 0xFE70, 0xFE74, letter }, { 0xFE76, 0xFEFC, letter },
+        { 0xFF10, 0xFF19, number }, { 0xFF21, 0xFF3A, letter }, { 0xFF41, 0xFF5A, letter }, { 0xFF66, 0xFFBE, letter },
+        { 0xFFC2, 0xFFC7, letter }, { 0xFFCA, 0xFFCF, letter }, { 0xFFD2, 0xFFD7, letter }, { 0xFFDA, 0xFFDC, letter },
+        { 0x10000, 0x1000B, letter }, { 0x1000D, 0x10026, letter }, { 0x10028, 0x1003A, letter }, { 0x1003C, 0x1003D, letter },
+        { 0x1003F, 0x1004D, letter }, { 0x10050, 0x1005D, letter }, { 0x10080, 0x100FA, letter }, { 0x10107, 0x10133, number },
+        { 0x10140, 0x10178, number }, { 0x1018A, 0x1018B, number }, { 0x10280, 0x1029C, letter }, { 0x102A0, 0x102D0, letter },
+        { 0x102E1, 0x102FB, number }, { 0x10300, 0x1031F, letter }, { 0x10320, 0x10323, number }, { 0x1032D, 0x10340, letter },
+        { 0x10341, 0x10341, number }, { 0x10342, 0x10349, letter }, { 0x1034A, 0x1034A, number }, { 0x10350, 0x10375, letter },
+        { 0x10380, 0x1039D, letter }, { 0x103A0, 0x103C3, letter }, { 0x103C8, 0x103CF, letter }, { 0x103D1, 0x103D5, number },
+        { 0x10400, 0x1049D, letter }, { 0x104A0, 0x104A9, number }, { 0x104B0, 0x104D3, letter }, { 0x104D8, 0x104FB, letter },
+        { 0x10500, 0x10527, letter }, { 0x10530, 0x10563, letter }, { 0x10570, 0x1057A, letter }, { 0x1057C, 0x1058A, letter },
+        { 0x1058C, 0x10592, letter }, { 0x10594, 0x10595, letter }, { 0x10597, 0x105A1, letter }, { 0x105A3, 0x105B1, letter },
+        { 0x105B3, 0x105B9, letter }, { 0x105BB, 0x105BC, letter }, { 0x10600, 0x10736, letter }, { 0x10740, 0x10755, letter },
+        { 0x10760, 0x10767, letter }, { 0x10780, 0x10785, letter }, { 0x10787, 0x107B0, letter }, { 0x107B2, 0x107BA, letter },
+        { 0x10800, 0x10805, letter }, { 0x10808, 0x10808, letter }, { 0x1080A, 0x10835, letter }, { 0x10837, 0x10838, letter },
+        { 0x1083C, 0x1083C, letter }, { 0x1083F, 0x10855, letter }, { 0x10858, 0x1085F, number }, { 0x10860, 0x10876, letter },
+        { 0x10879, 0x1087F, number }, { 0x10880, 0x1089E, letter }, { 0x108A7, 0x108AF, number }, { 0x108E0, 0x108F2, letter },
+        { 0x108F4, 0x108F5, letter }, { 0x108FB, 0x108FF, number }, { 0x10900, 0x10915, letter }, { 0x10916, 0x1091B, number },
+        { 0x10920, 0x10939, letter }, { 0x10980, 0x109B7, letter }, { 0x109BC, 0x109BD, number }, { 0x109BE, 0x109BF, letter },
+        { 0x109C0, 0x109CF, number }, { 0x109D2, 0x109FF, number }, { 0x10A00, 0x10A00, letter }, { 0x10A10, 0x10A13, letter },
+        { 0x10A15, 0x10A17, letter }, { 0x10A19, 0x10A35, letter }, { 0x10A40, 0x10A48, number }, { 0x10A60, 0x10A7C, letter },
+        { 0x10A7D, 0x10A7E, number }, { 0x10A80, 0x10A9C, letter }, { 0x10A9D, 0x10A9F, number }, { 0x10AC0, 0x10AC7, letter },
+        { 0x10AC9, 0x10AE4, letter }, { 0x10AEB, 0x10AEF, number }, { 0x10B00, 0x10B35, letter }, { 0x10B40, 0x10B55, letter },
+        { 0x10B58, 0x10B5F, number }, { 0x10B60, 0x10B72, letter }, { 0x10B78, 0x10B7F, number }, { 0x10B80, 0x10B91, letter },
+        { 0x10BA9, 0x10BAF, number }, { 0x10C00, 0x10C48, letter }, { 0x10C80, 0x10CB2, letter }, { 0x10CC0, 0x10CF2, letter },
+        { 0x10CFA, 0x10CFF, number }, { 0x10D00, 0x10D23, letter }, { 0x10D30, 0x10D39, number }, { 0x10E60, 0x10E7E, number },
+        { 0x10E80, 0x10EA9, letter }, { 0x10EB0, 0x10EB1, letter }, { 0x10F00, 0x10F1C, letter }, { 0x10F1D, 0x10F26, number },
+        { 0x10F27, 0x10F27, letter }, { 0x10F30, 0x10F45, letter }, { 0x10F51, 0x10F54, number }, { 0x10F70, 0x10F81, letter },
+        { 0x10FB0, 0x10FC4, letter }, { 0x10FC5, 0x10FCB, number }, { 0x10FE0, 0x10FF6, letter }, { 0x11003, 0x11037, letter },
+        { 0x11052, 0x1106F, number }, { 0x11071, 0x11072, letter }, { 0x11075, 0x11075, letter }, { 0x11083, 0x110AF, letter },
+        { 0x110D0, 0x110E8, letter }, { 0x110F0, 0x110F9, number }, { 0x11103, 0x11126, letter }, { 0x11136, 0x1113F, number },
+        { 0x11144, 0x11144, letter }, { 0x11147, 0x11147, letter }, { 0x11150, 0x11172, letter }, { 0x11176, 0x11176, letter },
+        { 0x11183, 0x111B2, letter }, { 0x111C1, 0x111C4, letter }, { 0x111D0, 0x111D9, number }, { 0x111DA, 0x111DA, letter },
+        { 0x111DC, 0x111DC, letter }, { 0x111E1, 0x111F4, number }, { 0x11200, 0x11211, letter }, { 0x11213, 0x1122B, letter },
+        { 0x11280, 0x11286, letter }, { 0x11288, 0x11288, letter }, { 0x1128A, 0x1128D, letter }, { 0x1128F, 0x1129D, letter },
+        { 0x1129F, 0x112A8, letter }, { 0x112B0, 0x112DE, letter }, { 0x112F0, 0x112F9, number }, { 0x11305, 0x1130C, letter },
+        { 0x1130F, 0x11310, letter }, { 0x11313, 0x11328, letter }, { 0x1132A, 0x11330, letter }, { 0x11332, 0x11333, letter },
+        { 0x11335, 0x11339, letter }, { 0x1133D, 0x1133D, letter }, { 0x11350, 0x11350, letter }, { 0x1135D, 0x11361, letter },
+        { 0x11400, 0x11434, letter }, { 0x11447, 0x1144A, letter }, { 0x11450, 0x11459, number }, { 0x1145F, 0x11461, letter },
+        { 0x11480, 0x114AF, letter }, { 0x114C4, 0x114C5, letter }, { 0x114C7, 0x114C7, letter }, { 0x114D0, 0x114D9, number },
+        { 0x11580, 0x115AE, letter }, { 0x115D8, 0x115DB, letter }, { 0x11600, 0x1162F, letter }, { 0x11644, 0x11644, letter },
+        { 0x11650, 0x11659, number }, { 0x11680, 0x116AA, letter }, { 0x116B8, 0x116B8, letter }, { 0x116C0, 0x116C9, number },
+        { 0x11700, 0x1171A, letter }, { 0x11730, 0x1173B, number }, { 0x11740, 0x11746, letter }, { 0x11800, 0x1182B, letter },
+        { 0x118A0, 0x118DF, letter }, { 0x118E0, 0x118F2, number }, { 0x118FF, 0x11906, letter }, { 0x11909, 0x11909, letter },
+        { 0x1190C, 0x11913, letter }, { 0x11915, 0x11916, letter }, { 0x11918, 0x1192F, letter }, { 0x1193F, 0x1193F, letter },
+        { 0x11941, 0x11941, letter }, { 0x11950, 0x11959, number }, { 0x119A0, 0x119A7, letter }, { 0x119AA, 0x119D0, letter },
+        { 0x119E1, 0x119E1, letter }, { 0x119E3, 0x119E3, letter }, { 0x11A00, 0x11A00, letter }, { 0x11A0B, 0x11A32, letter },
+        { 0x11A3A, 0x11A3A, letter }, { 0x11A50, 0x11A50, letter }, { 0x11A5C, 0x11A89, letter }, { 0x11A9D, 0x11A9D, letter },
+        { 0x11AB0, 0x11AF8, letter }, { 0x11C00, 0x11C08, letter }, { 0x11C0A, 0x11C2E, letter }, { 0x11C40, 0x11C40, letter },
+        { 0x11C50, 0x11C6C, number }, { 0x11C72, 0x11C8F, letter }, { 0x11D00, 0x11D06, letter }, { 0x11D08, 0x11D09, letter },
+        { 0x11D0B, 0x11D30, letter }, { 0x11D46, 0x11D46, letter }, { 0x11D50, 0x11D59, number }, { 0x11D60, 0x11D65, letter },
+        { 0x11D67, 0x11D68, letter }, { 0x11D6A, 0x11D89, letter }, { 0x11D98, 0x11D98, letter }, { 0x11DA0, 0x11DA9, number },
+        { 0x11EE0, 0x11EF2, letter }, { 0x11FB0, 0x11FB0, letter }, { 0x11FC0, 0x11FD4, number }, { 0x12000, 0x12399, letter },
+        { 0x12400, 0x1246E, number }, { 0x12480, 0x12543, letter }, { 0x12F90, 0x12FF0, letter }, { 0x13000, 0x1342E, letter },
+        { 0x14400, 0x14646, letter }, { 0x16800, 0x16A38, letter }, { 0x16A40, 0x16A5E, letter }, { 0x16A60, 0x16A69, number },
+        { 0x16A70, 0x16ABE, letter }, { 0x16AC0, 0x16AC9, number }, { 0x16AD0, 0x16AED, letter }, { 0x16B00, 0x16B2F, letter },
+        { 0x16B40, 0x16B43, letter }, { 0x16B50, 0x16B59, number }, { 0x16B5B, 0x16B61, number }, { 0x16B63, 0x16B77, letter },
+        { 0x16B7D, 0x16B8F, letter }, { 0x16E40, 0x16E7F, letter }, { 0x16E80, 0x16E96, number }, { 0x16F00, 0x16F4A, letter },
+        { 0x16F50, 0x16F50, letter }, { 0x16F93, 0x16F9F, letter }, { 0x16FE0, 0x16FE1, letter }, { 0x16FE3, 0x16FE3, letter },
+        { 0x17000, 0x187F7, letter }, { 0x18800, 0x18CD5, letter }, { 0x18D00, 0x18D08, letter }, { 0x1AFF0, 0x1AFF3, letter },
+        { 0x1AFF5, 0x1AFFB, letter }, { 0x1AFFD, 0x1AFFE, letter }, { 0x1B000, 0x1B122, letter }, { 0x1B150, 0x1B152, letter },
+        { 0x1B164, 0x1B167, letter }, { 0x1B170, 0x1B2FB, letter }, { 0x1BC00, 0x1BC6A, letter }, { 0x1BC70, 0x1BC7C, letter },
+        { 0x1BC80, 0x1BC88, letter }, { 0x1BC90, 0x1BC99, letter }, { 0x1D2E0, 0x1D2F3, number }, { 0x1D360, 0x1D378, number },
+        { 0x1D400, 0x1D454, letter }, { 0x1D456, 0x1D49C, letter }, { 0x1D49E, 0x1D49F, letter }, { 0x1D4A2, 0x1D4A2, letter },
+        { 0x1D4A5, 0x1D4A6, letter }, { 0x1D4A9, 0x1D4AC, letter }, { 0x1D4AE, 0x1D4B9, letter }, { 0x1D4BB, 0x1D4BB, letter },
+        { 0x1D4BD, 0x1D4C3, letter }, { 0x1D4C5, 0x1D505, letter }, { 0x1D507, 0x1D50A, letter }, { 0x1D50D, 0x1D514, letter },
+        { 0x1D516, 0x1D51C, letter }, { 0x1D51E, 0x1D539, letter }, { 0x1D53B, 0x1D53E, letter }, { 0x1D540, 0x1D544, letter },
+        { 0x1D546, 0x1D546, letter }, { 0x1D54A, 0x1D550, letter }, { 0x1D552, 0x1D6A5, letter }, { 0x1D6A8, 0x1D6C0, letter },
+        { 0x1D6C2, 0x1D6DA, letter }, { 0x1D6DC, 0x1D6FA, letter }, { 0x1D6FC, 0x1D714, letter }, { 0x1D716, 0x1D734, letter },
+        { 0x1D736, 0x1D74E, letter }, { 0x1D750, 0x1D76E, letter }, { 0x1D770, 0x1D788, letter }, { 0x1D78A, 0x1D7A8, letter },
+        { 0x1D7AA, 0x1D7C2, letter }, { 0x1D7C4, 0x1D7CB, letter }, { 0x1D7CE, 0x1D7FF, number }, { 0x1DF00, 0x1DF1E, letter },
+        { 0x1E100, 0x1E12C, letter }, { 0x1E137, 0x1E13D, letter }, { 0x1E140, 0x1E149, number }, { 0x1E14E, 0x1E14E, letter },
+        { 0x1E290, 0x1E2AD, letter }, { 0x1E2C0, 0x1E2EB, letter }, { 0x1E2F0, 0x1E2F9, number }, { 0x1E7E0, 0x1E7E6, letter },
+        { 0x1E7E8, 0x1E7EB, letter }, { 0x1E7ED, 0x1E7EE, letter }, { 0x1E7F0, 0x1E7FE, letter }, { 0x1E800, 0x1E8C4, letter },
+        { 0x1E8C7, 0x1E8CF, number }, { 0x1E900, 0x1E943, letter }, { 0x1E94B, 0x1E94B, letter }, { 0x1E950, 0x1E959, number },
+        { 0x1EC71, 0x1ECAB, number }, { 0x1ECAD, 0x1ECAF, number }, { 0x1ECB1, 0x1ECB4, number }, { 0x1ED01, 0x1ED2D, number },
+        { 0x1ED2F, 0x1ED3D, number }, { 0x1EE00, 0x1EE03, letter }, { 0x1EE05, 0x1EE1F, letter }, { 0x1EE21, 0x1EE22, letter },
+        { 0x1EE24, 0x1EE24, letter }, { 0x1EE27, 0x1EE27, letter }, { 0x1EE29, 0x1EE32, letter }, { 0x1EE34, 0x1EE37, letter },
+        { 0x1EE39, 0x1EE39, letter }, { 0x1EE3B, 0x1EE3B, letter }, { 0x1EE42, 0x1EE42, letter }, { 0x1EE47, 0x1EE47, letter },
+        { 0x1EE49, 0x1EE49, letter }, { 0x1EE4B, 0x1EE4B, letter }, { 0x1EE4D, 0x1EE4F, letter }, { 0x1EE51, 0x1EE52, letter },
+        { 0x1EE54, 0x1EE54, letter }, { 0x1EE57, 0x1EE57, letter }, { 0x1EE59, 0x1EE59, letter }, { 0x1EE5B, 0x1EE5B, letter },
+        { 0x1EE5D, 0x1EE5D, letter }, { 0x1EE5F, 0x1EE5F, letter }, { 0x1EE61, 0x1EE62, letter }, { 0x1EE64, 0x1EE64, letter },
+        { 0x1EE67, 0x1EE6A, letter }, { 0x1EE6C, 0x1EE72, letter }, { 0x1EE74, 0x1EE77, letter }, { 0x1EE79, 0x1EE7C, letter },
+        { 0x1EE7E, 0x1EE7E, letter }, { 0x1EE80, 0x1EE89, letter }, { 0x1EE8B, 0x1EE9B, letter }, { 0x1EEA1, 0x1EEA3, letter },
+        { 0x1EEA5, 0x1EEA9, letter }, { 0x1EEAB, 0x1EEBB, letter }, { 0x1F100, 0x1F10C, number }, { 0x1FBF0, 0x1FBF9, number },
+        { 0x20000, 0x2A6DF, letter }, { 0x2A700, 0x2B738, letter }, { 0x2B740, 0x2B81D, letter }, { 0x2B820, 0x2CEA1, letter },
+        { 0x2CEB0, 0x2EBE0, letter }, { 0x2F800, 0x2FA1D, letter }, { 0x30000, 0x3134A, letter }
+    };
+
+    constexpr std::array<char_class, 128> ascii_classes = []() {
+        std::array<char_class, 128> classes{};
+        for (int c = 0; c < 128; ++c) {
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                classes[c] = letter;
+            }
+            else if (c >= '0' && c <= '9') {
+                classes[c] = number;
+            }
+            else if (c == '\r' || c == '\n') {
+                classes[c] = newline;
+            }
+            else if (c == ' ' || (c >= '\t' && c <= '\f')) {
+                classes[c] = space;
+            }
+        }
+        return classes;
+    }();
+
+    char_class classify(char32_t c) {
+        switch (c) {
+        case 0x85:
+        case 0xA0:
+        case 0x1680:
+        case 0x2028:
+        case 0x2029:
+        case 0x202F:
+        case 0x205F:
+        case 0x3000:
+            return space;
+        default:
+            break;
+        }
+        if (c >= 0x2000 && c <= 0x200A) {
+            return space;
+        }
+        const auto* found = std::upper_bound(std::begin(unicode_classes), std::end(unicode_classes), c,
+            [](char32_t value, const unicode_range& range) { return value < range.first; });
+        if (found == std::begin(unicode_classes)) {
+            return other;
+        }
+        --found;
+        return c <= found->last ? found->kind : other;
+    }
+
+    struct code_point {
+        char_class kind;
+        std::uint8_t size;
+    };
+
+    // Bytes that are not valid UTF-8 count as one "other" character each.
+    code_point next_char(const char* p, const char* end) {
+        const auto lead = static_cast<unsigned char>(*p);
+        if (lead < 0x80) {
+            return { ascii_classes[lead], 1 };
+        }
+        std::uint8_t size = 0;
+        char32_t value = 0;
+        if ((lead & 0xE0) == 0xC0 && lead >= 0xC2) {
+            size = 2;
+            value = lead & 0x1F;
+        }
+        else if ((lead & 0xF0) == 0xE0) {
+            size = 3;
+            value = lead & 0x0F;
+        }
+        else if ((lead & 0xF8) == 0xF0 && lead <= 0xF4) {
+            size = 4;
+            value = lead & 0x07;
+        }
+        if (size == 0 || end - p < size) {
+            return { other, 1 };
+        }
+        for (std::uint8_t i = 1; i < size; ++i) {
+            const auto continuation = static_cast<unsigned char>(p[i]);
+            if ((continuation & 0xC0) != 0x80) {
+                return { other, 1 };
+            }
+            value = (value << 6) | (continuation & 0x3F);
+        }
+        if ((size == 3 && (value < 0x800 || (value >= 0xD800 && value <= 0xDFFF))) || (size == 4 && (value < 0x10000 || value > 0x10FFFF))) {
+            return { other, 1 };
+        }
+        return { classify(value), size };
+    }
+
+    // Length of the run of ASCII letters at p.
+    std::size_t ascii_letters(const char* p, const char* end) {
+        const char* q = p;
+#if defined(CPPAI_SSE2)
+        const __m128i case_bit = _mm_set1_epi8(0x20);
+        const __m128i before_a = _mm_set1_epi8('a' - 1);
+        const __m128i after_z = _mm_set1_epi8('z' + 1);
+        while (end - q >= 16) {
+            // Bytes of multi-byte characters are negative as signed chars and fail the first comparison.
+            const __m128i folded = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q)), case_bit);
+            const __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(folded, before_a), _mm_cmplt_epi8(folded, after_z));
+            const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(letters));
+            if (mask != 0xFFFF) {
+                return static_cast<std::size_t>(q - p) + static_cast<std::size_t>(std::countr_one(mask));
+            }
+            q += 16;
+        }
+#endif
+        while (q < end && static_cast<unsigned char>(*q) < 0x80 && ascii_classes[static_cast<unsigned char>(*q)] == letter) {
+            ++q;
+        }
+        return static_cast<std::size_t>(q - p);
+    }
+
+    const char* letters_end(const char* p, const char* end) {
+        while (p < end) {
+            p += ascii_letters(p, end);
+            if (p == end || static_cast<unsigned char>(*p) < 0x80) {
+                break;
+            }
+            const code_point c = next_char(p, end);
+            if (c.kind != letter) {
+                break;
+            }
+            p += c.size;
+        }
+        return p;
+    }
+
+    char lower(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    // The end of the piece starting at p, following cl100k_base's pattern alternative by alternative:
+    //   (?i:'s|'t|'re|'ve|'m|'ll|'d) | [^\r\n\p{L}\p{N}]?\p{L}+ | \p{N}{1,3} | ?[^\s\p{L}\p{N}]+[\r\n]*
+    //   | \s*[\r\n]+ | \s+(?!\S) | \s+
+    const char* piece_end(const char* p, const char* end) {
+        if (*p == '\'' && end - p >= 2) {
+            const char second = lower(p[1]);
+            if (second == 's' || second == 't' || second == 'm' || second == 'd') {
+                return p + 2;
+            }
+            if (end - p >= 3) {
+                const char third = lower(p[2]);
+                if ((second == 'r' && third == 'e') || (second == 'v' && third == 'e') || (second == 'l' && third == 'l')) {
+                    return p + 3;
+                }
+            }
+        }
+
+        const code_point first = next_char(p, end);
+        if (first.kind == letter) {
+            return letters_end(p + first.size, end);
+        }
+        if ((first.kind == other || first.kind == space) && end - p > first.size && next_char(p + first.size, end).kind == letter) {
+            return letters_end(p + first.size, end);
+        }
+
+        if (first.kind == number) {
+            const char* q = p + first.size;
+            for (int digits = 1; digits < 3 && q < end; ++digits) {
+                const code_point c = next_char(q, end);
+                if (c.kind != number) {
+                    break;
+                }
+                q += c.size;
+            }
+            return q;
+        }
+
+        const char* symbols = *p == ' ' && end - p > 1 && next_char(p + 1, end).kind == other ? p + 1 : p;
+        if (next_char(symbols, end).kind == other) {
+            const char* q = symbols;
+            while (q < end) {
+                const code_point c = next_char(q, end);
+                if (c.kind != other) {
+                    break;
+                }
+                q += c.size;
+            }
+            while (q < end && (*q == '\r' || *q == '\n')) {
+                ++q;
+            }
+            return q;
+        }
+
+        // Whitespace: up to the last line break of the run if it has one, else all of it at the end of the text,
+        // else all but its last character, which then leads the next piece.
+        const char* q = p;
+        const char* last_char = p;
+        const char* last_newline = nullptr;
+        while (q < end) {
+            const code_point c = next_char(q, end);
+            if (c.kind != space && c.kind != newline) {
+                break;
+            }
+            if (c.kind == newline) {
+                last_newline = q;
+            }
+            last_char = q;
+            q += c.size;
+        }
+        if (last_newline != nullptr) {
+            return last_newline + 1;
+        }
+        if (q == end || last_char == p) {
+            return q;
+        }
+        return last_char;
+    }
+
+    template <class F>
+    void for_each_piece(std::string_view text, F&& piece) {
+        const char* p = text.data();
+        const char* const end = p + text.size();
+        while (p < end) {
+            const char* next = piece_end(p, end);
+            piece(std::string_view{ p, static_cast<std::size_t>(next - p) });
+            p = next;
+        }
+    }
+
+    constexpr std::array<char, 8> file_magic = { 'C', 'P', 'P', 'A', 'I', 'B', 'P', 'E' };
+    constexpr std::uint32_t file_version = 1;
+
+    // The layout of a saved vocabulary, little-endian, and of the table built in memory:
+    //   file_header
+    //   std::uint32_t offsets[token_count + 1]  token r is bytes[offsets[r], offsets[r + 1]); empty for unused ranks
+    //   table_slot slots[slot_count]           linear probing from hash & (slot_count - 1)
+    //   char bytes[byte_count]
+    struct file_header {
+        std::array<char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t token_count;
+        std::uint32_t slot_count;
+        std::uint32_t byte_count;
+    };
+
+    // The upper half of the hash rules out nearly every mismatch without touching the token's bytes.
+    struct table_slot {
+        std::uint32_t tag;
+        std::uint32_t rank;
+    };
+
+    constexpr std::uint32_t no_rank = 0xFFFFFFFF;
+
+    static_assert(sizeof(file_header) == 24 && sizeof(table_slot) == 8);
+
+    std::size_t image_size(const file_header& header) {
+        return sizeof(file_header) + (static_cast<std::size_t>(header.token_count) + 1) * sizeof(std::uint32_t)
+            + static_cast<std::size_t>(header.slot_count) * sizeof(table_slot) + header.byte_count;
+    }
+
+    // Part of the file format; changing it invalidates saved vocabularies.
+    std::uint64_t hash_bytes(const char* p, std::size_t n) {
+        constexpr std::uint64_t multiplier = 0xBF58476D1CE4E5B9ULL;
+        std::uint64_t h = 0x9E3779B97F4A7C15ULL ^ (n * 0xFF51AFD7ED558CCDULL);
+        while (n >= 8) {
+            std::uint64_t word;
+            std::memcpy(&word, p, 8);
+            h = (h ^ word) * multiplier;
+            h ^= h >> 31;
+            p += 8;
+            n -= 8;
+        }
+        if (n > 0) {
+            std::uint64_t word = 0;
+            std::memcpy(&word, p, n);
+            h = (h ^ word) * multiplier;
+            h ^= h >> 31;
+        }
+        h *= 0x94D049BB133111EBULL;
+        return h ^ (h >> 29);
+    }
+
+    void require_little_endian() {
+        if constexpr (std::endian::native != std::endian::little) {
+            throw cppai::tokenizer_error("Vocabulary files are little-endian only");
+        }
+    }
+
+    // Pieces longer than this merge through a heap instead of rescanning every pair after each merge.
+    constexpr std::size_t long_piece = 128;
+
+    // Only worth starting threads for.
+    constexpr std::size_t parallel_bytes = 64 * 1024;
+
+    template <class F>
+    void parallel_for(const std::vector<std::string_view>& texts, std::size_t threads, F&& body) {
+        std::size_t bytes = 0;
+        for (const std::string_view text : texts) {
+            bytes += text.size();
+        }
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, texts.size());
+        if (threads <= 1 || bytes < parallel_bytes) {
+            for (std::size_t i = 0; i < texts.size(); ++i) {
+                body(i);
+            }
+            return;
+        }
+
+        std::atomic<std::size_t> next{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr failure;
+        const auto work = [&]() {
+            for (std::size_t i = next.fetch_add(1, std::memory_order_relaxed); i < texts.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+                try {
+                    body(i);
+                }
+                catch (...) {
+                    if (!failed.exchange(true)) {
+                        failure = std::current_exception();
+                    }
+                    next.store(texts.size(), std::memory_order_relaxed);
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (std::size_t i = 1; i < threads; ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+    }
+
+    // Every member of a message counts, including content parts and tool calls.
+    std::uint64_t value_tokens(const cppai::bpe_tokenizer& tokenizer, const boost::json::value& value) {
+        std::uint64_t tokens = 0;
+        std::vector<const boost::json::value*> pending{ &value };
+        while (!pending.empty()) {
+            const boost::json::value* current = pending.back();
+            pending.pop_back();
+            if (current->is_string()) {
+                tokens += tokenizer.count(current->get_string());
+            }
+            else if (current->is_array()) {
+                for (const boost::json::value& element : current->get_array()) {
+                    pending.push_back(&element);
+                }
+            }
+            else if (current->is_object()) {
+                for (const auto& member : current->get_object()) {
+                    pending.push_back(&member.value());
+                }
+            }
+        }
+        return tokens;
+    }
+
+    std::uint64_t message_tokens(const cppai::bpe_tokenizer& tokenizer, const boost::json::value& message) {
+        constexpr std::uint64_t per_message = 3;
+        std::uint64_t tokens = per_message + value_tokens(tokenizer, message);
+        if (const boost::json::object* fields = message.if_object(); fields != nullptr && fields->contains("name")) {
+            ++tokens;
+        }
+        return tokens;
+    }
+
+    std::string_view role_of(const boost::json::value& message) {
+        const boost::json::object* fields = message.if_object();
+        const boost::json::value* role = fields != nullptr ? fields->if_contains("role") : nullptr;
+        return role != nullptr && role->is_string() ? std::string_view{ role->get_string() } : std::string_view{};
+    }
+
+    constexpr std::uint64_t reply_priming = 3;
+}
+
+struct cppai::bpe_tokenizer::state {
+    // Exactly one of these holds the image.
+    std::vector<std::uint32_t> owned;
+    boost::interprocess::mapped_region region;
+
+    std::string_view image;
+    const std::uint32_t* offsets = nullptr;
+    const table_slot* slots = nullptr;
+    const char* bytes = nullptr;
+    std::uint32_t token_count = 0;
+    std::uint32_t mask = 0;
+    std::vector<special_token> specials;
+
+    // Points the views into image, checking every offset and rank so a damaged file cannot make lookups read
+    // outside it.
+    void attach(std::string_view whole) {
+        file_header header;
+        if (whole.size() < sizeof(header)) {
+            throw tokenizer_error("Vocabulary file is truncated");
+        }
+        std::memcpy(&header, whole.data(), sizeof(header));
+        if (header.magic != file_magic || header.version != file_version) {
+            throw tokenizer_error("Not a vocabulary file of this version");
+        }
+        if (header.slot_count == 0 || !std::has_single_bit(header.slot_count) || header.token_count == no_rank || image_size(header) != whole.size()) {
+            throw tokenizer_error("Vocabulary file is damaged");
+        }
+        image = whole;
+        token_count = header.token_count;
+        mask = header.slot_count - 1;
+        offsets = reinterpret_cast<const std::uint32_t*>(whole.data() + sizeof(header));
+        slots = reinterpret_cast<const table_slot*>(offsets + token_count + 1);
+        bytes = reinterpret_cast<const char*>(slots + header.slot_count);
+
+        if (offsets[0] != 0 || offsets[token_count] != header.byte_count) {
+            throw tokenizer_error("Vocabulary file is damaged");
+        }
+        for (std::uint32_t rank = 0; rank < token_count; ++rank) {
+            if (offsets[rank + 1] < offsets[rank]) {
+                throw tokenizer_error("Vocabulary file is damaged");
+            }
+        }
+        // rank_of probes until it meets an empty slot, so a full table would make a missing lookup spin forever.
+        bool has_empty = false;
+        for (std::uint32_t i = 0; i <= mask; ++i) {
+            if (slots[i].rank == no_rank) {
+                has_empty = true;
+            }
+            else if (slots[i].rank >= token_count) {
+                throw tokenizer_error("Vocabulary file is damaged");
+            }
+        }
+        if (!has_empty) {
+            throw tokenizer_error("Vocabulary file is damaged");
+        }
+    }
+
+    std::string_view bytes_of(std::uint32_t rank) const {
+        return { bytes + offsets[rank], offsets[rank + 1] - offsets[rank] };
+    }
+
+    std::uint32_t rank_of(const char* p, std::size_t n) const {
+        const std::uint64_t h = hash_bytes(p, n);
+        const auto tag = static_cast<std::uint32_t>(h >> 32);
+        for (std::uint32_t i = static_cast<std::uint32_t>(h) & mask;; i = (i + 1) & mask) {
+            const table_slot& slot = slots[i];
+            if (slot.rank == no_rank) {
+                return no_rank;
+            }
+            if (slot.tag == tag) {
+                const std::string_view candidate = bytes_of(slot.rank);
+                if (candidate.size() == n && std::memcmp(candidate.data(), p, n) == 0) {
+                    return slot.rank;
+                }
+            }
+        }
+    }
+
+    std::uint32_t byte_rank(const char* p, std::size_t n) const {
+        const std::uint32_t rank = rank_of(p, n);
+        if (rank == no_rank) {
+            throw tokenizer_error("Vocabulary has no token for byte " + std::to_string(static_cast<unsigned char>(*p)));
+        }
+        return rank;
+    }
+
+    void encode_piece(std::string_view piece, std::vector<token>& out) const {
+        if (const std::uint32_t whole = rank_of(piece.data(), piece.size()); whole != no_rank) {
+            out.push_back(whole);
+            return;
+        }
+        if (piece.size() < long_piece) {
+            merge_short(piece, out);
+        }
+        else {
+            merge_long(piece, out);
+        }
+    }
+
+    // tiktoken's merge loop: the ranks of all adjacent pairs, the lowest (leftmost on ties) merged until no
+    // pair is a token.
+    void merge_short(std::string_view piece, std::vector<token>& out) const {
+        struct part {
+            std::uint32_t start;
+            std::uint32_t rank;
+        };
+        thread_local std::vector<part> parts;
+        parts.clear();
+        const auto n = static_cast<std::uint32_t>(piece.size());
+        for (std::uint32_t i = 0; i + 1 < n; ++i) {
+            parts.push_back({ i, rank_of(piece.data() + i, 2) });
+        }
+        parts.push_back({ n - 1, no_rank });
+        parts.push_back({ n, no_rank });
+
+        // The rank of the token parts[i] would become when merged with the part after it.
+        const auto merged_rank = [&](std::size_t i) {
+            if (i + 3 >= parts.size()) {
+                return no_rank;
+            }
+            return rank_of(piece.data() + parts[i].start, parts[i + 3].start - parts[i].start);
+        };
+        for (;;) {
+            std::uint32_t lowest = no_rank;
+            std::size_t at = 0;
+            for (std::size_t i = 0; i + 1 < parts.size(); ++i) {
+                if (parts[i].rank < lowest) {
+                    lowest = parts[i].rank;
+                    at = i;
+                }
+            }
+            if (lowest == no_rank) {
+                break;
+            }
+            parts[at].rank = merged_rank(at);
+            if (at > 0) {
+                parts[at - 1].rank = merged_rank(at - 1);
+            }
+            parts.erase(parts.begin() + static_cast<std::ptrdiff_t>(at) + 1);
+        }
+        for (std::size_t i = 0; i + 1 < parts.size(); ++i) {
+            out.push_back(byte_rank(piece.data() + parts[i].start, parts[i + 1].start - parts[i].start));
+        }
+    }
+
+    // The same merges in the same order for long pieces, e.g. runs of spaces or base64, in O(n log n): parts
+    // are a linked list and pairs wait in a heap ordered by rank, then position.
+    void merge_long(std::string_view piece, std::vector<token>& out) const {
+        struct part {
+            std::uint32_t end;
+            std::uint32_t next;
+            std::uint32_t previous;
+            // Of this part merged with the next one.
+            std::uint32_t rank;
+        };
+        using candidate = std::pair<std::uint32_t, std::uint32_t>;
+        thread_local std::vector<part> parts;
+        thread_local std::vector<candidate> heap;
+        const auto n = static_cast<std::uint32_t>(piece.size());
+        parts.resize(n);
+        heap.clear();
+
+        const auto pair_rank = [&](std::uint32_t start) {
+            const std::uint32_t next = parts[start].next;
+            return next == n ? no_rank : rank_of(piece.data() + start, parts[next].end - start);
+        };
+        const auto push = [](std::uint32_t rank, std::uint32_t start) {
+            if (rank != no_rank) {
+                heap.emplace_back(rank, start);
+                std::push_heap(heap.begin(), heap.end(), std::greater<>{});
+            }
+        };
+        for (std::uint32_t i = 0; i < n; ++i) {
+            parts[i] = { i + 1, i + 1, i == 0 ? n : i - 1, no_rank };
+        }
+        for (std::uint32_t i = 0; i + 1 < n; ++i) {
+            parts[i].rank = pair_rank(i);
+            push(parts[i].rank, i);
+        }
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>{});
+            const auto [rank, start] = heap.back();
+            heap.pop_back();
+            // Stale unless the same pair still begins at start: merged parts have no rank, and a part that grew
+            // pairs up into longer bytes with a different rank.
+            if (parts[start].rank != rank) {
+                continue;
+            }
+            const std::uint32_t absorbed = parts[start].next;
+            parts[start].end = parts[absorbed].end;
+            parts[start].next = parts[absorbed].next;
+            if (parts[start].next != n) {
+                parts[parts[start].next].previous = start;
+            }
+            parts[absorbed].rank = no_rank;
+
+            parts[start].rank = pair_rank(start);
+            push(parts[start].rank, start);
+            if (const std::uint32_t previous = parts[start].previous; previous != n) {
+                parts[previous].rank = pair_rank(previous);
+                push(parts[previous].rank, previous);
+            }
+        }
+        for (std::uint32_t start = 0; start != n; start = parts[start].next) {
+            out.push_back(byte_rank(piece.data() + start, parts[start].end - start));
+        }
+    }
+
+    void encode_ordinary(std::string_view text, std::vector<token>& out) const {
+        for_each_piece(text, [&](std::string_view piece) { encode_piece(piece, out); });
+    }
+
+    void encode(std::string_view text, std::vector<token>& out, bool allow_special) const {
+        if (!allow_special || specials.empty()) {
+            encode_ordinary(text, out);
+            return;
+        }
+        while (!text.empty()) {
+            std::size_t found = std::string_view::npos;
+            const special_token* match = nullptr;
+            for (const special_token& special : specials) {
+                const std::size_t at = text.find(special.text);
+                if (at < found || (at == found && at != std::string_view::npos && special.text.size() > match->text.size())) {
+                    found = at;
+                    match = &special;
+                }
+            }
+            if (match == nullptr) {
+                encode_ordinary(text, out);
+                return;
+            }
+            encode_ordinary(text.substr(0, found), out);
+            out.push_back(match->rank);
+            text.remove_prefix(found + match->text.size());
+        }
+    }
+};
+
+std::vector<cppai::special_token> cppai::cl100k_special_tokens() {
+    return { { "<|endoftext|>", 100257 }, { "<|fim_prefix|>", 100258 }, { "<|fim_middle|>", 100259 }, { "<|fim_suffix|>", 100260 },
+        { "<|endofprompt|>", 100276 } };
+}
+
+cppai::bpe_tokenizer::bpe_tokenizer(std::unique_ptr<const state> impl)
+    : impl{ std::move(impl) } {
+}
+
+cppai::bpe_tokenizer::bpe_tokenizer(bpe_tokenizer&& other) noexcept = default;
+
+cppai::bpe_tokenizer& cppai::bpe_tokenizer::operator=(bpe_tokenizer&& other) noexcept = default;
+
+cppai::bpe_tokenizer::~bpe_tokenizer() = default;
+
+cppai::bpe_tokenizer cppai::bpe_tokenizer::from_tiktoken(const boost::filesystem::path& file, std::vector<special_token> specials) {
+    require_little_endian();
+    boost::nowide::ifstream in{ file };
+    if (!in) {
+        throw tokenizer_error("Cannot open vocabulary " + file.string());
+    }
+    std::vector<std::string> tokens;
+    std::string line;
+    std::size_t entries = 0;
+    std::size_t byte_count = 0;
+    for (std::size_t number = 1; std::getline(in, line); ++number) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        const std::size_t separator = line.find(' ');
+        const std::string_view encoded = std::string_view{ line }.substr(0, separator);
+        const std::string_view rank_text = separator == std::string::npos ? std::string_view{} : std::string_view{ line }.substr(separator + 1);
+        std::uint32_t rank = 0;
+        const auto [end, error] = std::from_chars(rank_text.data(), rank_text.data() + rank_text.size(), rank);
+        std::string decoded(utility::base64_decoded_size(encoded), '\0');
+        const std::optional<std::size_t> size = utility::base64_decode(encoded, reinterpret_cast<unsigned char*>(decoded.data()));
+        if (error != std::errc{} || end != rank_text.data() + rank_text.size() || rank == no_rank || !size.has_value() || size.value() == 0) {
+            throw tokenizer_error(file.string() + ':' + std::to_string(number) + ": expected a base64 token and its rank");
+        }
+        decoded.resize(size.value());
+        if (rank >= tokens.size()) {
+            tokens.resize(static_cast<std::size_t>(rank) + 1);
+        }
+        if (!tokens[rank].empty()) {
+            throw tokenizer_error(file.string() + ':' + std::to_string(number) + ": rank " + std::to_string(rank) + " appears twice");
+        }
+        byte_count += decoded.size();
+        tokens[rank] = std::move(decoded);
+        ++entries;
+    }
+    if (entries == 0) {
+        throw tokenizer_error("Vocabulary " + file.string() + " is empty");
+    }
+
+    file_header header{};
+    header.magic = file_magic;
+    header.version = file_version;
+    header.token_count = static_cast<std::uint32_t>(tokens.size());
+    // At most half full, so a lookup that misses, which most pair lookups do, stops within a probe or two.
+    header.slot_count = std::bit_ceil(static_cast<std::uint32_t>(std::max<std::size_t>(entries * 2, 16)));
+    header.byte_count = static_cast<std::uint32_t>(byte_count);
+
+    auto built = std::make_unique<state>();
+    built->owned.resize((image_size(header) + sizeof(std::uint32_t) - 1) / sizeof(std::uint32_t));
+    char* base = reinterpret_cast<char*>(built->owned.data());
+    std::memcpy(base, &header, sizeof(header));
+    auto* offsets = reinterpret_cast<std::uint32_t*>(base + sizeof(header));
+    auto* slots = reinterpret_cast<table_slot*>(offsets + header.token_count + 1);
+    char* bytes = reinterpret_cast<char*>(slots + header.slot_count);
+    std::fill(slots, slots + header.slot_count, table_slot{ 0, no_rank });
+
+    std::uint32_t offset = 0;
+    const std::uint32_t mask = header.slot_count - 1;
+    for (std::uint32_t rank = 0; rank < header.token_count; ++rank) {
+        offsets[rank] = offset;
+        const std::string& token_bytes = tokens[rank];
+        if (token_bytes.empty()) {
+            continue;
+        }
+        std::memcpy(bytes + offset, token_bytes.data(), token_bytes.size());
+        offset += static_cast<std::uint32_t>(token_bytes.size());
+
+        const std::uint64_t h = hash_bytes(token_bytes.data(), token_bytes.size());
+        std::uint32_t i = static_cast<std::uint32_t>(h) & mask;
+        for (; slots[i].rank != no_rank; i = (i + 1) & mask) {
+            if (tokens[slots[i].rank] == token_bytes) {
+                throw tokenizer_error("Vocabulary " + file.string() + " has ranks " + std::to_string(slots[i].rank) + " and " + std::to_string(rank)
+                    + " for the same bytes");
+            }
+        }
+        slots[i] = { static_cast<std::uint32_t>(h >> 32), rank };
+    }
+    offsets[header.token_count] = offset;
+
+    built->attach({ base, image_size(header) });
+    built->specials = std::move(specials);
+    return bpe_tokenizer{ std::move(built) };
+}
+
+cppai::bpe_tokenizer cppai::bpe_tokenizer::open(const boost::filesystem::path& file, std::vector<special_token> specials) {
+    require_little_endian();
+    auto mapped = std::make_unique<state>();
+    try {
+        boost::interprocess::file_mapping mapping{ file.string().c_str(), boost::interprocess::read_only };
+        mapped->region = boost::interprocess::mapped_region{ mapping, boost::interprocess::read_only };
+    }
+    catch (const boost::interprocess::interprocess_exception& e) {
+        throw tokenizer_error("Cannot map vocabulary " + file.string() + ": " + e.what());
+    }
+    mapped->attach({ static_cast<const char*>(mapped->region.get_address()), mapped->region.get_size() });
+    mapped->specials = std::move(specials);
+    return bpe_tokenizer{ std::move(mapped) };
+}
+
+void cppai::bpe_tokenizer::save(const boost::filesystem::path& file) const {
+    boost::nowide::ofstream out{ file, std::ios_base::binary | std::ios_base::trunc };
+    out.write(impl->image.data(), static_cast<std::streamsize>(impl->image.size()));
+    if (!out) {
+        throw tokenizer_error("Cannot write vocabulary " + file.string());
+    }
+}
+
+std::vector<cppai::bpe_tokenizer::token> cppai::bpe_tokenizer::encode(std::string_view text, bool allow_special) const {
+    std::vector<token> tokens;
+    // Close to the usual four bytes a token, so most texts never reallocate.
+    tokens.reserve(text.size() / 4 + 8);
+    impl->encode(text, tokens, allow_special);
+    return tokens;
+}
+
+void cppai::bpe_tokenizer::encode(std::string_view text, std::vector<token>& out, bool allow_special) const {
+    impl->encode(text, out, allow_special);
+}
+
+std::size_t cppai::bpe_tokenizer::count(std::string_view text, bool allow_special) const {
+    thread_local std::vector<token> scratch;
+    scratch.clear();
+    impl->encode(text, scratch, allow_special);
+    return scratch.size();
+}
+
+std::string cppai::bpe_tokenizer::decode(std::span<const token> tokens) const {
+    std::string text;
+    for (const token rank : tokens) {
+        if (rank < impl->token_count && impl->offsets[rank + 1] != impl->offsets[rank]) {
+            text.append(impl->bytes_of(rank));
+            continue;
+        }
+        const auto special = std::find_if(impl->specials.begin(), impl->specials.end(), [rank](const special_token& s) { return s.rank == rank; });
+        if (special == impl->specials.end()) {
+            throw tokenizer_error("No token has rank " + std::to_string(rank));
+        }
+        text.append(special->text);
+    }
+    return text;
+}
+
+std::vector<std::vector<cppai::bpe_tokenizer::token>> cppai::bpe_tokenizer::encode_batch(const std::vector<std::string_view>& texts,
+    std::size_t threads) const {
+    std::vector<std::vector<token>> results(texts.size());
+    parallel_for(texts, threads, [&](std::size_t i) { results[i] = encode(texts[i]); });
+    return results;
+}
+
+std::vector<std::size_t> cppai::bpe_tokenizer::count_batch(const std::vector<std::string_view>& texts, std::size_t threads) const {
+    std::vector<std::size_t> results(texts.size());
+    parallel_for(texts, threads, [&](std::size_t i) { results[i] = count(texts[i]); });
+    return results;
+}
+
+std::size_t cppai::bpe_tokenizer::vocabulary_size() const {
+    std::size_t tokens = 0;
+    for (std::uint32_t rank = 0; rank < impl->token_count; ++rank) {
+        tokens += impl->offsets[rank + 1] != impl->offsets[rank] ? 1 : 0;
+    }
+    return tokens;
+}
+
+std::vector<std::string_view> cppai::bpe_tokenizer::split(std::string_view text) {
+    std::vector<std::string_view> pieces;
+    for_each_piece(text, [&pieces](std::string_view piece) { pieces.push_back(piece); });
+    return pieces;
+}
+
+std::uint64_t cppai::count_chat_tokens(const bpe_tokenizer& tokenizer, const boost::json::array& messages) {
+    std::uint64_t tokens = reply_priming;
+    for (const boost::json::value& message : messages) {
+        tokens += message_tokens(tokenizer, message);
+    }
+    return tokens;
+}
+
+boost::json::array cppai::truncate_chat(const bpe_tokenizer& tokenizer, const boost::json::array& messages, std::uint64_t budget) {
+    const auto pinned = [](const boost::json::value& message) {
+        const std::string_view role = role_of(message);
+        return role == "system" || role == "developer";
+    };
+
+    std::uint64_t used = reply_priming;
+    std::size_t others = 0;
+    for (const boost::json::value& message : messages) {
+        if (pinned(message)) {
+            used += message_tokens(tokenizer, message);
+        }
+        else {
+            ++others;
+        }
+    }
+    if (used > budget) {
+        throw std::length_error("System messages take " + std::to_string(used) + " tokens, over the budget of " + std::to_string(budget));
+    }
+
+    // The newest messages that fit, back to the first one that does not.
+    std::size_t first_kept = messages.size();
+    for (std::size_t i = messages.size(); i-- > 0;) {
+        if (pinned(messages[i])) {
+            continue;
+        }
+        const std::uint64_t cost = message_tokens(tokenizer, messages[i]);
+        if (used + cost > budget) {
+            break;
+        }
+        used += cost;
+        first_kept = i;
+    }
+    while (first_kept < messages.size() && (pinned(messages[first_kept]) || role_of(messages[first_kept]) == "tool")) {
+        ++first_kept;
+    }
+    if (others > 0 && first_kept == messages.size()) {
+        throw std::length_error("The newest message does not fit the budget of " + std::to_string(budget) + " tokens");
+    }
+
+    boost::json::array kept;
+    for (std::size_t i = 0; i < messages.size(); ++i) {
+        if (pinned(messages[i]) || i >= first_kept) {
+            kept.push_back(messages[i]);
+        }
+    }
+    return kept;
+}
@@ -0,0 +1,92 @@
+#ifndef CPPAI_TOKENIZER_H
+#define CPPAI_TOKENIZER_H
+#include <boost/json.hpp>
+#include <boost/nowide/filesystem.hpp>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cppai {
+    struct special_token {
+        std::string text;
+        std::uint32_t rank = 0;
+    };
+
+    // Those of cl100k_base, the encoding of gpt-4, gpt-3.5-turbo and the text-embedding-3 models.
+    std::vector<special_token> cl100k_special_tokens();
+
+    class tokenizer_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Byte-pair encoding compatible with tiktoken's cl100k_base: text is split into pieces by the encoding's
+    // pattern, and each piece is merged from single bytes, lowest-ranked pair first. Merge ranks and token ranks
+    // are the same table, an open-addressing hash from token bytes to rank. Immutable once built, so one
+    // instance serves any number of threads.
+    class bpe_tokenizer {
+    public:
+        using token = std::uint32_t;
+
+        // Parses a vocabulary in tiktoken's format, one base64 token and its rank per line, e.g.
+        // cl100k_base.tiktoken.
+        static bpe_tokenizer from_tiktoken(const boost::filesystem::path& file, std::vector<special_token> specials = cl100k_special_tokens());
+
+        // Maps a vocabulary written by save(). The hash table is used in place, so opening costs a page fault per
+        // page touched and processes share the pages.
+        static bpe_tokenizer open(const boost::filesystem::path& file, std::vector<special_token> specials = cl100k_special_tokens());
+
+        bpe_tokenizer(bpe_tokenizer&& other) noexcept;
+
+        bpe_tokenizer& operator=(bpe_tokenizer&& other) noexcept;
+
+        ~bpe_tokenizer();
+
+        void save(const boost::filesystem::path& file) const;
+
+        // Special token texts in text are encoded as ordinary text unless allow_special is set.
+        std::vector<token> encode(std::string_view text, bool allow_special = false) const;
+
+        // Appends to out.
+        void encode(std::string_view text, std::vector<token>& out, bool allow_special = false) const;
+
+        std::size_t count(std::string_view text, bool allow_special = false) const;
+
+        // Tokens that split a multi-byte character decode to its bytes, so only whole sequences give valid UTF-8.
+        std::string decode(std::span<const token> tokens) const;
+
+        // Texts are handed out to up to threads threads, hardware concurrency when zero. Small batches are
+        // done on the calling thread.
+        std::vector<std::vector<token>> encode_batch(const std::vector<std::string_view>& texts, std::size_t threads = 0) const;
+
+        std::vector<std::size_t> count_batch(const std::vector<std::string_view>& texts, std::size_t threads = 0) const;
+
+        // Ordinary tokens, without the special ones.
+        std::size_t vocabulary_size() const;
+
+        // The pieces cl100k_base's pattern cuts text into before merging.
+        static std::vector<std::string_view> split(std::string_view text);
+
+    private:
+        struct state;
+
+        std::unique_ptr<const state> impl;
+
+        explicit bpe_tokenizer(std::unique_ptr<const state> impl);
+    };
+
+    // Prompt tokens of a chat completion's messages as the API bills them: each message costs three tokens
+    // beyond its fields, a name one more, and three more prime the reply.
+    std::uint64_t count_chat_tokens(const bpe_tokenizer& tokenizer, const boost::json::array& messages);
+
+    // Drops the oldest messages until the rest fit budget prompt tokens, e.g. the context window less
+    // max_tokens. System and developer messages are always kept, and so is the order; tool results whose
+    // assistant message was dropped go too. Throws std::length_error when not even the newest message fits.
+    boost::json::array truncate_chat(const bpe_tokenizer& tokenizer, const boost::json::array& messages, std::uint64_t budget);
+}
+
+#endif
@@ -0,0 +1,232 @@
+#include "transcriber.h"
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <optional>
+
+namespace {
+    // Longest run of words at a boundary that can be a repeat; a second of overlap holds a handful.
+    constexpr std::size_t max_repeated_words = 24;
+
+    std::vector<std::string_view> split_words(std::string_view text) {
+        std::vector<std::string_view> words;
+        std::size_t pos = 0;
+        while (pos < text.size()) {
+            const std::size_t start = text.find_first_not_of(" \t\r\n", pos);
+            if (start == std::string_view::npos) {
+                break;
+            }
+            const std::size_t end = std::min(text.find_first_of(" \t\r\n", start), text.size());
+            words.push_back(text.substr(start, end - start));
+            pos = end;
+        }
+        return words;
+    }
+
+    // Case and punctuation differ between two transcriptions of the same words.
+    std::string normalize(std::string_view word) {
+        std::string out;
+        for (const char c : word) {
+            if (std::isalnum(static_cast<unsigned char>(c)) || static_cast<unsigned char>(c) >= 0x80) {
+                out.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+            }
+        }
+        return out;
+    }
+
+    std::string segment_text(const boost::json::value& response) {
+        const boost::json::object* fields = response.if_object();
+        const boost::json::value* text = fields != nullptr ? fields->if_contains("text") : nullptr;
+        if (text != nullptr && text->is_string()) {
+            return std::string{ text->get_string() };
+        }
+
+        std::string message = "Transcription failed";
+        if (const boost::json::value* error = fields != nullptr ? fields->if_contains("error") : nullptr) {
+            const boost::json::value* detail = error->is_object() ? error->get_object().if_contains("message") : nullptr;
+            if (detail != nullptr && detail->is_string()) {
+                message.append(": ").append(detail->get_string());
+            }
+        }
+        throw cppai::transcription_error(message);
+    }
+}
+
+struct cppai::chunked_transcriber::run_state {
+    boost::filesystem::path file;
+    wav_format format;
+    std::vector<audio_segment> segments;
+    std::string_view model;
+    ::cppai::utility::audio_req request;
+
+    std::mutex mtx;
+    std::size_t next = 0;
+    bool failed = false;
+    std::vector<std::optional<std::string>> texts;
+};
+
+cppai::chunked_transcriber::chunked_transcriber(const openAI& client, transcription_options opts) : client{ client }, opts{ std::move(opts) } {
+}
+
+boost::asio::awaitable<cppai::transcript> cppai::chunked_transcriber::run(const boost::filesystem::path& file, std::string_view model,
+    ::cppai::utility::audio_req_builder&& opt_params) const {
+    run_state state;
+    state.file = file;
+    state.format = read_wav_format(file);
+    state.segments = plan_segments(file, state.format, opts.segments);
+    state.model = model;
+    state.request = std::move(opt_params.req);
+    state.texts.resize(state.segments.size());
+    if (state.format.frames() == 0) {
+        throw transcription_error("Recording has no samples");
+    }
+
+    // Segments are handed out in order, so a single worker always has the previous text at hand.
+    auto executor = co_await boost::asio::this_coro::executor;
+    const std::size_t workers = std::clamp<std::size_t>(opts.wait_for_prompt ? 1 : opts.concurrency, 1, state.segments.size());
+    boost::asio::experimental::concurrent_channel<void(boost::system::error_code, std::exception_ptr)> done{ executor, workers };
+    // The workers share state with this frame, so a cancelled run stops them and still waits until they are done.
+    std::vector<boost::asio::cancellation_signal> stops(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+        boost::asio::co_spawn(executor, worker(state),
+            boost::asio::bind_cancellation_slot(stops[i].slot(), [&done](std::exception_ptr error) {
+                done.try_send(boost::system::error_code{}, error);
+            }));
+    }
+
+    std::exception_ptr first_error;
+    bool stopped = false;
+    for (std::size_t finished = 0; finished < workers;) {
+        bool cancelled = false;
+        try {
+            std::exception_ptr error = co_await done.async_receive(boost::asio::use_awaitable);
+            if (error && !first_error) {
+                first_error = error;
+            }
+            ++finished;
+        }
+        catch (const boost::system::system_error&) {
+            if (!first_error) {
+                first_error = std::current_exception();
+            }
+            cancelled = true;
+        }
+        if (cancelled) {
+            co_await boost::asio::this_coro::reset_cancellation_state([](boost::asio::cancellation_type) {
+                return boost::asio::cancellation_type::none;
+            });
+        }
+        // The first failure, or the run's own cancellation, also stops the uploads still in flight; their
+        // results could not be used.
+        if ((cancelled || first_error) && !stopped) {
+            stopped = true;
+            for (boost::asio::cancellation_signal& stop : stops) {
+                stop.emit(boost::asio::cancellation_type::terminal);
+            }
+        }
+    }
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+
+    transcript result;
+    result.segments.reserve(state.segments.size());
+    for (std::size_t i = 0; i < state.segments.size(); ++i) {
+        const audio_segment& segment = state.segments[i];
+        transcript_segment part;
+        part.start = state.format.duration(segment.first_frame + segment.overlap_frames);
+        part.end = state.format.duration(segment.first_frame + segment.frames);
+        part.text = std::move(state.texts[i].value());
+        result.text = stitch(result.text, part.text);
+        result.segments.push_back(std::move(part));
+    }
+    co_return result;
+}
+
+std::string cppai::chunked_transcriber::stitch(std::string_view before, std::string_view after) {
+    const std::vector<std::string_view> tail = split_words(before);
+    const std::vector<std::string_view> head = split_words(after);
+
+    std::size_t repeated = 0;
+    for (std::size_t count = std::min({ max_repeated_words, tail.size(), head.size() }); count != 0; --count) {
+        bool same = true;
+        for (std::size_t i = 0; i < count && same; ++i) {
+            same = normalize(tail[tail.size() - count + i]) == normalize(head[i]);
+        }
+        // One short word matching ("a", "the") is as likely chance as a repeat.
+        if (same && (count > 1 || normalize(head[0]).size() > 3)) {
+            repeated = count;
+            break;
+        }
+    }
+
+    std::string out{ before };
+    while (!out.empty() && std::isspace(static_cast<unsigned char>(out.back()))) {
+        out.pop_back();
+    }
+    std::string_view rest = after;
+    if (repeated != 0) {
+        const std::string_view& last = head[repeated - 1];
+        rest.remove_prefix(static_cast<std::size_t>(last.data() + last.size() - after.data()));
+    }
+    const std::size_t start = rest.find_first_not_of(" \t\r\n");
+    rest.remove_prefix(start == std::string_view::npos ? rest.size() : start);
+    if (!out.empty() && !rest.empty()) {
+        out.push_back(' ');
+    }
+    out.append(rest);
+    return out;
+}
+
+std::string cppai::chunked_transcriber::tail_words(std::string_view text, std::size_t words) {
+    const std::vector<std::string_view> all = split_words(text);
+    if (words == 0 || all.empty()) {
+        return {};
+    }
+    const std::string_view& first = all[all.size() - std::min(words, all.size())];
+    std::string_view tail = text.substr(static_cast<std::size_t>(first.data() - text.data()));
+    const std::size_t end = tail.find_last_not_of(" \t\r\n");
+    return std::string{ tail.substr(0, end + 1) };
+}
+
+boost::asio::awaitable<void> cppai::chunked_transcriber::worker(run_state& state) const {
+    for (;;) {
+        std::size_t index = 0;
+        {
+            std::lock_guard lock{ state.mtx };
+            if (state.failed || state.next == state.segments.size()) {
+                co_return;
+            }
+            index = state.next++;
+        }
+
+        ::cppai::utility::audio_req_builder params;
+        params.req = state.request;
+        {
+            std::lock_guard lock{ state.mtx };
+            if (index != 0 && opts.prompt_words != 0 && state.texts[index - 1].has_value()) {
+                params.req.prompt = tail_words(state.texts[index - 1].value(), opts.prompt_words);
+            }
+        }
+
+        std::array<char, 32> filename;
+        std::snprintf(filename.data(), filename.size(), "segment-%04zu.wav", index);
+        const audio_slice slice = make_slice(state.file, state.format, state.segments[index], filename.data());
+        std::string text;
+        try {
+            text = segment_text(co_await client.create_transcription(slice, state.model, std::move(params)));
+        }
+        catch (...) {
+            std::lock_guard lock{ state.mtx };
+            state.failed = true;
+            throw;
+        }
+
+        std::lock_guard lock{ state.mtx };
+        state.texts[index] = std::move(text);
+    }
+}
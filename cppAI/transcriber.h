@@ -0,0 +1,69 @@
+#ifndef CPPAI_TRANSCRIBER_H
+#define CPPAI_TRANSCRIBER_H
+#include <boost/asio.hpp>
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "audio.h"
+#include "openai.h"
+
+namespace cppai {
+    struct transcription_options {
+        segment_options segments;
+        std::size_t concurrency = 4;
+        // Words from the end of the previous segment's text sent as a segment's prompt, so names and
+        // spelling carry over the cut. Zero keeps the caller's prompt for every segment.
+        std::size_t prompt_words = 32;
+        // Send one segment at a time so every prompt is there. Otherwise a segment gets the prompt only when
+        // the previous one happens to be done already, and the caller's prompt when it is not.
+        bool wait_for_prompt = false;
+    };
+
+    struct transcript_segment {
+        // The part of the recording the segment adds, not counting its overlap with the previous one.
+        std::chrono::milliseconds start{ 0 };
+        std::chrono::milliseconds end{ 0 };
+        std::string text;
+    };
+
+    struct transcript {
+        std::string text;
+        std::vector<transcript_segment> segments;
+    };
+
+    class transcription_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    // Transcribes a WAV recording longer than the upload limit by cutting it into segments, ideally at
+    // pauses, and sending up to concurrency of them at once. Each segment is read straight from the source
+    // file behind its own WAV header. The texts are joined in order with the words repeated in the overlap
+    // removed. The first failed segment cancels the uploads in flight, skips the rest and is rethrown.
+    class chunked_transcriber {
+    public:
+        explicit chunked_transcriber(const openAI& client, transcription_options opts = {});
+
+        boost::asio::awaitable<transcript> run(const boost::filesystem::path& file, std::string_view model,
+            ::cppai::utility::audio_req_builder&& opt_params = {}) const;
+
+        // Appends after to before, dropping the words at the start of after that repeat the end of before.
+        static std::string stitch(std::string_view before, std::string_view after);
+
+        static std::string tail_words(std::string_view text, std::size_t words);
+
+    private:
+        struct run_state;
+
+        const openAI& client;
+        transcription_options opts;
+
+        boost::asio::awaitable<void> worker(run_state& state) const;
+    };
+}
+
+#endif
@@ -1,4 +1,7 @@
 #include "utility.h"
+#include <array>
+#include <charconv>
+#include "simd.h"
 
 cppai::utility::img_req_builder&& cppai::utility::img_req_builder::set_mask(std::optional<boost::filesystem::path> _mask) && {
     req.mask = std::move(_mask);
@@ -20,6 +23,11 @@ cppai::utility::img_req_builder&& cppai::utility::img_req_builder::set_user(std:
     return std::move(*this);
 }
 
+cppai::utility::img_req_builder&& cppai::utility::img_req_builder::set_response_format(std::optional<std::string> _response_format)&& {
+    req.response_format = std::move(_response_format);
+    return std::move(*this);
+}
+
 cppai::utility::audio_req_builder&& cppai::utility::audio_req_builder::set_prompt(std::optional<std::string> _prompt)&& {
     req.prompt = std::move(_prompt);
     return std::move(*this);
@@ -33,4 +41,225 @@ cppai::utility::audio_req_builder&& cppai::utility::audio_req_builder::set_tempe
 cppai::utility::audio_req_builder&& cppai::utility::audio_req_builder::set_language(std::optional<std::string> _lang)&& {
     req.lang = std::move(_lang);
     return std::move(*this);
-}
\ No newline at end of file
+}
+
+std::optional<std::chrono::milliseconds> cppai::utility::parse_duration(std::string_view text) {
+    // Accepts the forms used by the x-ratelimit-reset-* headers: "20ms", "1s", "6m0s", "1h2m3.5s".
+    double total_ms = 0.0;
+    bool parsed = false;
+    while (!text.empty()) {
+        double amount = 0.0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), amount);
+        if (error != std::errc{}) {
+            return std::nullopt;
+        }
+        text.remove_prefix(static_cast<std::size_t>(end - text.data()));
+        if (text.starts_with("ms")) {
+            total_ms += amount;
+            text.remove_prefix(2);
+        }
+        else if (text.starts_with("h")) {
+            total_ms += amount * 3600000.0;
+            text.remove_prefix(1);
+        }
+        else if (text.starts_with("m")) {
+            total_ms += amount * 60000.0;
+            text.remove_prefix(1);
+        }
+        else if (text.starts_with("s") || text.empty()) {
+            total_ms += amount * 1000.0;
+            text.remove_prefix(text.empty() ? 0 : 1);
+        }
+        else {
+            return std::nullopt;
+        }
+        parsed = true;
+    }
+    if (!parsed) {
+        return std::nullopt;
+    }
+    return std::chrono::milliseconds{ static_cast<std::int64_t>(total_ms) };
+}
+
+cppai::utility::response_meta cppai::utility::read_response_meta(const boost::beast::http::response_header<pooled_fields>& header) {
+    const auto read_count = [&](std::string_view name) -> std::optional<std::uint64_t> {
+        const auto field = header.find(boost::beast::string_view{ name.data(), name.size() });
+        if (field == header.end()) {
+            return std::nullopt;
+        }
+        std::uint64_t count = 0;
+        const auto value = field->value();
+        if (std::from_chars(value.data(), value.data() + value.size(), count).ec != std::errc{}) {
+            return std::nullopt;
+        }
+        return count;
+    };
+    const auto read_duration = [&](std::string_view name) -> std::optional<std::chrono::milliseconds> {
+        const auto field = header.find(boost::beast::string_view{ name.data(), name.size() });
+        if (field == header.end()) {
+            return std::nullopt;
+        }
+        return parse_duration(std::string_view{ field->value().data(), field->value().size() });
+    };
+
+    response_meta meta;
+    meta.status = header.result_int();
+    meta.remaining_requests = read_count("x-ratelimit-remaining-requests");
+    meta.remaining_tokens = read_count("x-ratelimit-remaining-tokens");
+    meta.reset_requests = read_duration("x-ratelimit-reset-requests");
+    meta.reset_tokens = read_duration("x-ratelimit-reset-tokens");
+    if (const auto retry_ms = read_count("retry-after-ms")) {
+        meta.retry_after = std::chrono::milliseconds{ retry_ms.value() };
+    }
+    else {
+        meta.retry_after = read_duration("retry-after");
+    }
+    return meta;
+}
+
+namespace {
+    constexpr std::array<std::uint8_t, 256> base64_table = []() {
+        std::array<std::uint8_t, 256> table{};
+        table.fill(0xff);
+        constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (std::size_t i = 0; i < alphabet.size(); ++i) {
+            table[static_cast<unsigned char>(alphabet[i])] = static_cast<std::uint8_t>(i);
+        }
+        return table;
+    }();
+
+    // Decodes size characters, a multiple of four, to three bytes per four. False on a character outside the
+    // alphabet, padding included.
+    using quads_fn = bool (*)(const unsigned char* in, std::size_t size, unsigned char* out);
+
+    bool scalar_quads(const unsigned char* in, std::size_t size, unsigned char* out) {
+        for (std::size_t i = 0; i < size; i += 4) {
+            const std::uint32_t a = base64_table[in[i]];
+            const std::uint32_t b = base64_table[in[i + 1]];
+            const std::uint32_t c = base64_table[in[i + 2]];
+            const std::uint32_t d = base64_table[in[i + 3]];
+            if ((a | b | c | d) & 0x80) {
+                return false;
+            }
+            const std::uint32_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+            *out++ = static_cast<unsigned char>(bits >> 16);
+            *out++ = static_cast<unsigned char>(bits >> 8);
+            *out++ = static_cast<unsigned char>(bits);
+        }
+        return true;
+    }
+
+#if defined(CPPAI_X86)
+    // 32 characters to 24 bytes per step (Mula and Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+    // Instructions"): each character's high and low nibble index two tables whose AND is non-zero exactly for
+    // characters outside the alphabet, and a third table gives the offset from ASCII to the sextet.
+    CPPAI_TARGET("avx2") bool avx2_quads(const unsigned char* in, std::size_t size, unsigned char* out) {
+        const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+        const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+        const __m256i pack_pairs = _mm256_set1_epi32(0x01400140);
+        const __m256i pack_quads = _mm256_set1_epi32(0x00011000);
+        const __m256i order = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i gather = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+        std::size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            const __m256i text = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(text, 4), mask_2f);
+            const __m256i lo_nibbles = _mm256_and_si256(text, mask_2f);
+            const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+            const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+            if (!_mm256_testz_si256(lo, hi)) {
+                return false;
+            }
+            const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(text, mask_2f), hi_nibbles));
+            const __m256i sextets = _mm256_add_epi8(text, roll);
+            const __m256i pairs = _mm256_maddubs_epi16(sextets, pack_pairs);
+            const __m256i quads = _mm256_madd_epi16(pairs, pack_quads);
+            const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(quads, order), gather);
+            // Exactly 24 bytes, so out needs no slack beyond the decoded size.
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm256_castsi256_si128(packed));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 16), _mm256_extracti128_si256(packed, 1));
+            out += 24;
+        }
+        return scalar_quads(in + i, size - i, out);
+    }
+
+    bool has_avx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    quads_fn decode_quads() {
+        static const quads_fn chosen = []() {
+#if defined(CPPAI_X86)
+            if (has_avx2()) {
+                return avx2_quads;
+            }
+#endif
+            return scalar_quads;
+        }();
+        return chosen;
+    }
+}
+
+std::size_t cppai::utility::base64_decoded_size(std::string_view encoded) {
+    while (!encoded.empty() && encoded.back() == '=') {
+        encoded.remove_suffix(1);
+    }
+    return encoded.size() / 4 * 3 + (encoded.size() % 4 * 3) / 4;
+}
+
+std::optional<std::size_t> cppai::utility::base64_decode(std::string_view encoded, unsigned char* out) {
+    while (!encoded.empty() && encoded.back() == '=') {
+        encoded.remove_suffix(1);
+    }
+    if (encoded.size() % 4 == 1) {
+        return std::nullopt;
+    }
+
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(encoded.data());
+    const std::size_t whole = encoded.size() / 4 * 4;
+    unsigned char* const begin = out;
+    if (!decode_quads()(in, whole, out)) {
+        return std::nullopt;
+    }
+    out += whole / 4 * 3;
+
+    const std::size_t rest = encoded.size() - whole;
+    if (rest != 0) {
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < rest; ++i) {
+            const std::uint32_t sextet = base64_table[in[whole + i]];
+            if (sextet & 0x80) {
+                return std::nullopt;
+            }
+            bits |= sextet << (18 - 6 * i);
+        }
+        *out++ = static_cast<unsigned char>(bits >> 16);
+        if (rest == 3) {
+            *out++ = static_cast<unsigned char>(bits >> 8);
+        }
+    }
+    return static_cast<std::size_t>(out - begin);
+}
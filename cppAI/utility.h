@@ -1,9 +1,14 @@
 #ifndef CPPAI_UTILITY_H
 #define CPPAI_UTILITY_H
 
+#include <boost/beast/http.hpp>
 #include <boost/nowide/filesystem.hpp>
+#include <chrono>
+#include <cmath>
 #include <optional>
 #include <string>
+#include <string_view>
+#include "pooled.h"
 
 namespace cppai {
     namespace utility {
@@ -12,6 +17,7 @@ namespace cppai {
             std::optional<std::uint16_t> n;
             std::optional<std::string> size;
             std::optional<std::string> user;
+            std::optional<std::string> response_format;
         };
 
         struct audio_req {
@@ -20,6 +26,15 @@ namespace cppai {
             std::optional<std::string> lang;
         };
 
+        struct response_meta {
+            std::uint32_t status = 0;
+            std::optional<std::uint64_t> remaining_requests;
+            std::optional<std::uint64_t> remaining_tokens;
+            std::optional<std::chrono::milliseconds> reset_requests;
+            std::optional<std::chrono::milliseconds> reset_tokens;
+            std::optional<std::chrono::milliseconds> retry_after;
+        };
+
         struct img_req_builder {
             img_req req;
             img_req_builder() = default;
@@ -27,6 +42,7 @@ namespace cppai {
             img_req_builder&& set_n(std::optional<std::uint16_t> _n) &&;
             img_req_builder&& set_size(std::optional<std::string> _size) &&;
             img_req_builder&& set_user(std::optional<std::string> _user) &&;
+            img_req_builder&& set_response_format(std::optional<std::string> _response_format) &&;
         };
 
         struct audio_req_builder {
@@ -36,6 +52,15 @@ namespace cppai {
             audio_req_builder&& set_temperature(std::optional<std::double_t> _temp) &&;
             audio_req_builder&& set_language(std::optional<std::string> _lang) &&;
         };
+
+        std::optional<std::chrono::milliseconds> parse_duration(std::string_view text);
+
+        response_meta read_response_meta(const boost::beast::http::response_header<pooled_fields>& header);
+
+        std::size_t base64_decoded_size(std::string_view encoded);
+
+        // Decodes standard padded or unpadded base64 into out, which must hold base64_decoded_size bytes.
+        std::optional<std::size_t> base64_decode(std::string_view encoded, unsigned char* out);
     }
 }
 #endif
@@ -0,0 +1,195 @@
+#define BOOST_TEST_MODULE cancel
+#include <boost/test/included/unit_test.hpp>
+#include <array>
+#include <future>
+#include <optional>
+#include <random>
+#include "mock_fixture.h"
+
+using namespace std::chrono_literals;
+
+// Thousands of calls, each cancelled at a random moment with a rotating cancellation type, so cancellations land
+// while resolving, connecting, handshaking, waiting for a slot, waiting for the response and reading it. Whatever
+// phase they hit, the pool must end up with its connection count intact: neither leaked slots nor extra ones.
+namespace {
+    constexpr std::array<boost::asio::cancellation_type, 3> types = { boost::asio::cancellation_type::terminal,
+        boost::asio::cancellation_type::partial, boost::asio::cancellation_type::total };
+
+    struct outcomes {
+        std::size_t completed = 0;
+        std::size_t aborted = 0;
+        std::vector<std::string> unexpected;
+
+        void record(std::exception_ptr error) {
+            if (!error) {
+                ++completed;
+                return;
+            }
+            try {
+                std::rethrow_exception(error);
+            }
+            catch (const boost::system::system_error& e) {
+                if (e.code() == boost::asio::error::operation_aborted) {
+                    ++aborted;
+                    return;
+                }
+                unexpected.push_back(e.what());
+            }
+            catch (const std::exception& e) {
+                unexpected.push_back(e.what());
+            }
+        }
+    };
+
+    // Starts op on ctx and cancels it with type after delay unless it has finished by then.
+    template <class Op>
+    void cancel_after(boost::asio::io_context& ctx, Op op, std::chrono::microseconds delay, boost::asio::cancellation_type type, outcomes& seen) {
+        auto signal = std::make_shared<boost::asio::cancellation_signal>();
+        auto timer = std::make_shared<boost::asio::steady_timer>(ctx, delay);
+        // The handler keeps the signal alive for as long as its slot is attached to the operation.
+        boost::asio::co_spawn(ctx, std::move(op), boost::asio::bind_cancellation_slot(signal->slot(), [&seen, signal, timer](std::exception_ptr error, auto&&...) {
+            timer->cancel();
+            seen.record(error);
+        }));
+        timer->async_wait([signal, type](boost::system::error_code error_code) {
+            if (!error_code) {
+                signal->emit(type);
+            }
+        });
+    }
+
+    std::shared_ptr<cppai::dns_cache> slow_resolver(std::uint16_t port) {
+        // Nothing pinned and nothing cached for long, so lookups, and cancellations during them, keep happening.
+        cppai::dns_options opts;
+        opts.ttl = 1ms;
+        opts.min_ttl = 1ms;
+        auto dns = std::make_shared<cppai::dns_cache>(opts);
+        dns->set_resolver([port](const std::string&, const std::string&) -> boost::asio::awaitable<cppai::dns_answer> {
+            boost::asio::steady_timer delay{ co_await boost::asio::this_coro::executor, 500us };
+            co_await delay.async_wait(boost::asio::use_awaitable);
+            co_return cppai::dns_answer{ { boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), port } }, std::nullopt };
+        });
+        return dns;
+    }
+
+    boost::asio::awaitable<void> hold_connection(cppai::connection_pool& pool, boost::asio::ssl::context& ctx, std::string port,
+        const cppai::timeout_policy& timeouts, std::chrono::microseconds hold, bool keep) {
+        cppai::connection_pool::connection_ptr conn = co_await pool.acquire(ctx, "localhost", port, timeouts, std::chrono::steady_clock::time_point::max());
+        boost::asio::steady_timer busy{ co_await boost::asio::this_coro::executor, hold };
+        co_await busy.async_wait(boost::asio::use_awaitable);
+        if (keep) {
+            pool.release(std::move(conn));
+        }
+    }
+
+    boost::asio::awaitable<void> complete(const cppai::openAI& client, const boost::json::value& body) {
+        co_await client.chat_completion(body);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pool_survives_cancellation_at_every_phase) {
+    cppai::test::mock_fixture mock;
+    const std::string port = std::to_string(mock.port());
+    boost::asio::ssl::context ctx{ boost::asio::ssl::context::tls_client };
+    ctx.add_certificate_authority(boost::asio::buffer(mock.server().certificate()));
+    ctx.set_verify_mode(boost::asio::ssl::verify_peer);
+
+    constexpr std::size_t limit = 4;
+    cppai::connection_pool pool{ cppai::pool_options{ true, limit } };
+    pool.set_dns_cache(slow_resolver(mock.port()));
+    const cppai::timeout_policy timeouts;
+
+    boost::asio::io_context io;
+    std::mt19937_64 rng{ 7 };
+    outcomes seen;
+    constexpr std::size_t calls = 4000;
+    for (std::size_t i = 0; i < calls; ++i) {
+        // A third of the connections are dropped instead of returned, as after a failed exchange.
+        const auto hold = std::chrono::microseconds{ rng() % 2000 };
+        cancel_after(io, hold_connection(pool, ctx, port, timeouts, hold, i % 3 != 0), std::chrono::microseconds{ rng() % 20000 },
+            types[i % types.size()], seen);
+    }
+    io.run();
+
+    BOOST_TEST(seen.unexpected.empty(), (seen.unexpected.empty() ? "" : seen.unexpected.front()));
+    BOOST_TEST(seen.completed + seen.aborted == calls);
+    BOOST_TEST(seen.aborted > 0u);
+    BOOST_TEST(pool.idle_count() <= limit);
+
+    // Every slot is free again: limit connections can be held at once, and not one more.
+    io.restart();
+    std::vector<cppai::connection_pool::connection_ptr> held;
+    std::optional<boost::system::error_code> extra;
+    std::future<void> checked = boost::asio::co_spawn(io, [&]() -> boost::asio::awaitable<void> {
+        for (std::size_t i = 0; i < limit; ++i) {
+            held.push_back(co_await pool.acquire(ctx, "localhost", port, timeouts, std::chrono::steady_clock::now() + 5s));
+        }
+        try {
+            cppai::connection_pool::connection_ptr more = co_await pool.acquire(ctx, "localhost", port, timeouts,
+                std::chrono::steady_clock::now() + 200ms);
+            extra.emplace();
+        }
+        catch (const boost::system::system_error& e) {
+            extra = e.code();
+        }
+        for (cppai::connection_pool::connection_ptr& conn : held) {
+            pool.release(std::move(conn));
+        }
+    }, boost::asio::use_future);
+    io.run();
+    BOOST_REQUIRE_NO_THROW(checked.get());
+    BOOST_TEST(held.size() == limit);
+    BOOST_REQUIRE(extra.has_value());
+    BOOST_TEST((extra.value() == boost::beast::error::timeout));
+    BOOST_TEST(pool.idle_count() == limit);
+}
+
+BOOST_AUTO_TEST_CASE(client_survives_cancelled_calls) {
+    cppai::bench::mock_options opts;
+    opts.generation_latency.kind = cppai::bench::latency_distribution::shape::uniform;
+    opts.generation_latency.second = 20ms;
+    opts.stream_events = 8;
+    opts.stream_interval = 2ms;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    constexpr std::size_t limit = 2;
+    client.set_pool_options(cppai::pool_options{ true, limit });
+    client.set_dns_cache(slow_resolver(mock.port()));
+
+    const boost::json::value body = boost::json::object{ { "model", "gpt-4o-mini" },
+        { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", "Say hello." } } } } };
+    boost::json::value stream_body = body;
+    stream_body.as_object()["stream"] = true;
+
+    boost::asio::io_context io;
+    std::mt19937_64 rng{ 11 };
+    outcomes seen;
+    constexpr std::size_t calls = 2000;
+    for (std::size_t i = 0; i < calls; ++i) {
+        const auto delay = std::chrono::microseconds{ rng() % 40000 };
+        if (i % 2 == 0) {
+            cancel_after(io, complete(client, body), delay, types[i % types.size()], seen);
+        }
+        else {
+            cancel_after(io, client.chat_completion_stream(stream_body, [](const boost::json::value&) {}), delay, types[i % types.size()], seen);
+        }
+    }
+    io.run();
+
+    BOOST_TEST(seen.unexpected.empty(), (seen.unexpected.empty() ? "" : seen.unexpected.front()));
+    BOOST_TEST(seen.completed + seen.aborted == calls);
+    BOOST_TEST(seen.aborted > 0u);
+
+    // With a slot leaked, calls would queue behind it until the deadline.
+    io.restart();
+    outcomes after;
+    for (std::size_t i = 0; i < 4 * limit; ++i) {
+        boost::asio::co_spawn(io, cppai::with_timeout(client.chat_completion(body), 10s), [&after](std::exception_ptr error, const boost::json::value&) {
+            after.record(error);
+        });
+    }
+    io.run();
+    BOOST_TEST(after.unexpected.empty(), (after.unexpected.empty() ? "" : after.unexpected.front()));
+    BOOST_TEST(after.completed == 4 * limit);
+}
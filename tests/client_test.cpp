@@ -0,0 +1,126 @@
+#define BOOST_TEST_MODULE client
+#include <boost/test/included/unit_test.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <algorithm>
+#include <chrono>
+#include "mock_fixture.h"
+
+namespace {
+    boost::json::value chat_request(bool stream = false) {
+        return boost::json::object{ { "model", "gpt-4o-mini" }, { "stream", stream },
+            { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", "Say hello." } } } } };
+    }
+
+    boost::asio::awaitable<void> apply_after(std::chrono::milliseconds delay, cppai::openAI& client, const cppai::test::mock_fixture& mock) {
+        boost::asio::steady_timer timer{ co_await boost::asio::this_coro::executor, delay };
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        mock.apply(client);
+    }
+
+    boost::asio::awaitable<boost::json::value> call_while_replacing(cppai::openAI& client, const cppai::test::mock_fixture& mock) {
+        using namespace boost::asio::experimental::awaitable_operators;
+        co_return co_await (client.chat_completion(chat_request()) && apply_after(std::chrono::milliseconds(50), client, mock));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(chat_completion_over_both_transports) {
+    cppai::test::mock_fixture mock;
+    for (const cppai::transport mode : { cppai::transport::http1, cppai::transport::http2 }) {
+        cppai::openAI client;
+        mock.apply(client);
+        client.set_transport(mode);
+        const boost::json::value reply = cppai::test::run(client.chat_completion(chat_request()));
+        BOOST_TEST(reply.at("object").as_string() == "chat.completion");
+        BOOST_TEST(!reply.at("choices").at(0).at("message").at("content").as_string().empty());
+    }
+    const cppai::bench::mock_counters counters = mock.server().counters();
+    BOOST_TEST(counters.requests == 2u);
+    BOOST_TEST(counters.h2_connections >= 1u);
+}
+
+BOOST_AUTO_TEST_CASE(stream_delivers_every_event) {
+    cppai::bench::mock_options opts;
+    opts.stream_events = 8;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    std::size_t events = 0;
+    std::string text;
+    cppai::test::run(client.chat_completion_stream(chat_request(true), [&](const boost::json::value& chunk) {
+        ++events;
+        if (const boost::json::value* content = chunk.at("choices").at(0).at("delta").as_object().if_contains("content")) {
+            text += content->as_string();
+        }
+    }));
+    // The role chunk, the words and the finish chunk; [DONE] is not an event.
+    BOOST_TEST(events == opts.stream_events + 2);
+    BOOST_TEST(std::count(text.begin(), text.end(), ' ') == static_cast<std::ptrdiff_t>(opts.stream_events));
+}
+
+BOOST_AUTO_TEST_CASE(retries_rate_limited_calls) {
+    cppai::bench::mock_options opts;
+    opts.rate_limit_fraction = 0.5;
+    opts.retry_after = std::chrono::milliseconds(1);
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    cppai::request_policy policy;
+    policy.retries.max_attempts = 20;
+    client.set_policy(policy);
+    for (int i = 0; i < 10; ++i) {
+        BOOST_TEST(cppai::test::run(client.chat_completion(chat_request())).at("object").as_string() == "chat.completion");
+    }
+    const cppai::bench::mock_counters counters = mock.server().counters();
+    BOOST_TEST(counters.requests == 10u + counters.rate_limited);
+}
+
+BOOST_AUTO_TEST_CASE(retries_unanswered_posts_only_when_allowed) {
+    cppai::bench::mock_options opts;
+    opts.drop_fraction = 1;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    cppai::request_policy policy;
+    policy.retries.max_attempts = 3;
+    policy.retries.base_delay = std::chrono::milliseconds(1);
+    client.set_policy(policy);
+
+    // The server read the request before the connection went, so it may have run.
+    BOOST_CHECK_THROW(cppai::test::run(client.chat_completion(chat_request())), boost::system::system_error);
+    BOOST_TEST(mock.server().counters().requests == 1u);
+    BOOST_CHECK_THROW(cppai::test::run(client.files_list()), boost::system::system_error);
+    BOOST_TEST(mock.server().counters().requests == 4u);
+
+    policy.retries.retry_non_idempotent = true;
+    client.set_policy(policy);
+    BOOST_CHECK_THROW(cppai::test::run(client.chat_completion(chat_request())), boost::system::system_error);
+    BOOST_TEST(mock.server().counters().requests == 7u);
+}
+
+BOOST_AUTO_TEST_CASE(endpoints_replaced_while_a_call_is_in_flight) {
+    cppai::bench::mock_options opts;
+    opts.latency.first = std::chrono::milliseconds(200);
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    // The call's lease keeps the balancer it was picked from alive after set_endpoints drops it.
+    const boost::json::value reply = cppai::test::run(call_while_replacing(client, mock));
+    BOOST_TEST(reply.at("object").as_string() == "chat.completion");
+    const std::vector<cppai::backend_stats> stats = client.endpoint_stats();
+    BOOST_REQUIRE(stats.size() == 1u);
+    BOOST_TEST(stats[0].outstanding == 0u);
+    BOOST_TEST(cppai::test::run(client.chat_completion(chat_request())).at("object").as_string() == "chat.completion");
+}
+
+BOOST_AUTO_TEST_CASE(unbounded_total_timeout) {
+    cppai::test::mock_fixture mock;
+    cppai::openAI client;
+    mock.apply(client);
+    cppai::request_policy policy;
+    policy.timeouts.total = std::chrono::steady_clock::duration::max();
+    client.set_policy(policy);
+    BOOST_TEST(cppai::test::run(client.chat_completion(chat_request())).at("object").as_string() == "chat.completion");
+    bool done = false;
+    cppai::test::run(client.chat_completion_stream(chat_request(true), [&done](const boost::json::value&) { done = true; }));
+    BOOST_TEST(done);
+}
@@ -0,0 +1,93 @@
+#define BOOST_TEST_MODULE embedding_batcher
+#include <boost/test/included/unit_test.hpp>
+#include <chrono>
+#include <exception>
+#include <string>
+#include <vector>
+#include "embedding_batcher.h"
+#include "mock_fixture.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+    struct outcome {
+        std::vector<float> vector;
+        std::exception_ptr error;
+    };
+
+    // Embeds every input at once, so they all join one batch.
+    std::vector<outcome> embed_all(cppai::embedding_batcher& batcher, const std::vector<std::string>& inputs) {
+        boost::asio::io_context ctx;
+        std::vector<outcome> outcomes(inputs.size());
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            boost::asio::co_spawn(ctx, batcher.embed("text-embedding-3-small", inputs[i]),
+                [&outcomes, i](std::exception_ptr error, std::vector<float> vector) {
+                    outcomes[i] = outcome{ std::move(vector), error };
+                });
+        }
+        ctx.run();
+        return outcomes;
+    }
+
+    cppai::embedding_batch_options one_batch(std::size_t items) {
+        cppai::embedding_batch_options opts;
+        opts.max_items = items;
+        opts.linger = 50ms;
+        return opts;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(invalid_input_fails_alone) {
+    cppai::bench::mock_options opts;
+    opts.max_input_tokens = 100;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    cppai::embedding_batcher batcher{ client, one_batch(8) };
+
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 8; ++i) {
+        inputs.push_back("document " + std::to_string(i));
+    }
+    inputs[5] = std::string(1000, 'x');
+    const std::vector<outcome> outcomes = embed_all(batcher, inputs);
+    for (std::size_t i = 0; i < outcomes.size(); ++i) {
+        BOOST_TEST((outcomes[i].error != nullptr) == (i == 5));
+        BOOST_TEST(outcomes[i].vector.empty() == (i == 5));
+    }
+    try {
+        std::rethrow_exception(outcomes[5].error);
+    }
+    catch (const cppai::embedding_error& e) {
+        BOOST_TEST(e.status() == 400u);
+        BOOST_TEST(e.type() == "invalid_request_error");
+    }
+    BOOST_TEST(batcher.counters().splits > 0u);
+}
+
+BOOST_AUTO_TEST_CASE(refused_batch_is_not_split) {
+    cppai::bench::mock_options opts;
+    opts.rate_limit_fraction = 1;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    cppai::request_policy policy;
+    policy.retries.max_attempts = 1;
+    client.set_policy(policy);
+    cppai::embedding_batcher batcher{ client, one_batch(16) };
+
+    const std::vector<outcome> outcomes = embed_all(batcher, std::vector<std::string>(16, "document"));
+    for (const outcome& result : outcomes) {
+        BOOST_REQUIRE(result.error != nullptr);
+        try {
+            std::rethrow_exception(result.error);
+        }
+        catch (const cppai::embedding_error& e) {
+            BOOST_TEST(e.status() == 429u);
+        }
+    }
+    // One request for the whole batch, however many inputs it held.
+    BOOST_TEST(mock.server().counters().requests == 1u);
+    BOOST_TEST(batcher.counters().splits == 0u);
+    BOOST_TEST(batcher.counters().failed == 16u);
+}
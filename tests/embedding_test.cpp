@@ -0,0 +1,24 @@
+#define BOOST_TEST_MODULE embedding
+#include <boost/test/included/unit_test.hpp>
+#include <string>
+#include "embedding.h"
+
+namespace {
+    std::string body(int first, int second) {
+        return R"({"object":"list","data":[)"
+            R"({"object":"embedding","index":)" + std::to_string(first) + R"(,"embedding":[1.0,0.0]},)"
+            R"({"object":"embedding","index":)" + std::to_string(second) + R"(,"embedding":[0.0,1.0]}],)"
+            R"("model":"text-embedding-3-small","usage":{"prompt_tokens":2,"total_tokens":2}})";
+    }
+}
+
+BOOST_AUTO_TEST_CASE(out_of_order_rows_are_sorted) {
+    const cppai::embedding_result result = cppai::parse_embeddings(body(1, 0), 2);
+    BOOST_REQUIRE(result.vectors.rows() == 2u);
+    BOOST_TEST(result.vectors.row(0)[1] == 1.0f);
+    BOOST_TEST(result.vectors.row(1)[0] == 1.0f);
+}
+
+BOOST_AUTO_TEST_CASE(duplicate_index_is_rejected) {
+    BOOST_CHECK_THROW(cppai::parse_embeddings(body(1, 1), 2), cppai::embedding_error);
+}
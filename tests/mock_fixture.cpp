@@ -0,0 +1,38 @@
+#include "mock_fixture.h"
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+
+cppai::test::mock_fixture::mock_fixture(bench::mock_options opts)
+    : mock{ std::move(opts) }, ca{ boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cppai-test-%%%%%%%%.pem") } {
+    mock.start();
+    std::ofstream{ ca.string() } << mock.certificate();
+}
+
+cppai::test::mock_fixture::~mock_fixture() {
+    mock.stop();
+    boost::system::error_code error_code;
+    boost::filesystem::remove(ca, error_code);
+}
+
+void cppai::test::mock_fixture::apply(openAI& client) const {
+    client.set_api_key("sk-mock");
+    backend local;
+    local.host = "localhost";
+    local.port = std::to_string(mock.port());
+    endpoint_config endpoints;
+    endpoints.backends = { local };
+    endpoints.ca_file = ca.string();
+    client.set_endpoints(std::move(endpoints));
+
+    auto dns = std::make_shared<dns_cache>();
+    dns->pin(local.host, local.port, { boost::asio::ip::tcp::endpoint{ boost::asio::ip::address_v4::loopback(), mock.port() } });
+    client.set_dns_cache(std::move(dns));
+}
+
+std::uint16_t cppai::test::mock_fixture::port() const {
+    return mock.port();
+}
+
+cppai::bench::mock_server& cppai::test::mock_fixture::server() {
+    return mock;
+}
@@ -0,0 +1,46 @@
+#ifndef CPPAI_TESTS_MOCK_FIXTURE_H
+#define CPPAI_TESTS_MOCK_FIXTURE_H
+#include <boost/asio.hpp>
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include "mock_server.h"
+#include "openai.h"
+
+namespace cppai::test {
+    // A mock_server running in the test's own process, and the settings that point a client at it.
+    class mock_fixture {
+    public:
+        explicit mock_fixture(bench::mock_options opts = {});
+
+        ~mock_fixture();
+
+        mock_fixture(const mock_fixture&) = delete;
+
+        mock_fixture& operator=(const mock_fixture&) = delete;
+
+        // Trusts the server's certificate and resolves its host name to the server without DNS.
+        void apply(openAI& client) const;
+
+        std::uint16_t port() const;
+
+        bench::mock_server& server();
+
+    private:
+        bench::mock_server mock;
+        boost::filesystem::path ca;
+    };
+
+    // Runs task on an io_context of its own until it finishes, rethrowing what it threw.
+    template <class T>
+    T run(boost::asio::awaitable<T> task) {
+        boost::asio::io_context ctx;
+        std::future<T> result = boost::asio::co_spawn(ctx, std::move(task), boost::asio::use_future);
+        ctx.run();
+        return result.get();
+    }
+}
+
+#endif
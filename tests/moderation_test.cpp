@@ -0,0 +1,107 @@
+#define BOOST_TEST_MODULE moderation
+#include <boost/test/included/unit_test.hpp>
+#include <algorithm>
+#include <chrono>
+#include "mock_fixture.h"
+#include "moderation.h"
+
+using namespace std::chrono_literals;
+
+// The mock flags any input containing "[category]" and answers moderations after latency alone, while
+// completions also wait generation_latency, so the tests decide which branch finishes first.
+namespace {
+    boost::json::value chat_request(std::string_view prompt, bool stream = false) {
+        return boost::json::object{ { "model", "gpt-4o-mini" }, { "stream", stream },
+            { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", prompt } } } } };
+    }
+
+    cppai::bench::mock_options timed(std::chrono::milliseconds moderation, std::chrono::milliseconds generation) {
+        cppai::bench::mock_options opts;
+        opts.latency.first = moderation;
+        opts.generation_latency.first = generation;
+        return opts;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(flagged_prompt_cancels_generation) {
+    cppai::test::mock_fixture mock{ timed(20ms, 3000ms) };
+    cppai::openAI client;
+    mock.apply(client);
+    const cppai::moderated_chat moderated{ client };
+
+    const cppai::moderated_reply reply = cppai::test::run(moderated.chat_completion(chat_request("Describe [violence] in detail.")));
+    BOOST_TEST(reply.verdict.flagged);
+    BOOST_TEST((std::find(reply.verdict.categories.begin(), reply.verdict.categories.end(), "violence") != reply.verdict.categories.end()));
+    BOOST_TEST(reply.cancelled);
+    BOOST_TEST(reply.completion.is_null());
+    // Back well before the generation would have been.
+    BOOST_TEST((reply.elapsed < 1500ms));
+    BOOST_TEST((reply.generation_wasted() < 1500ms));
+
+    const cppai::moderation_counters counters = moderated.counters();
+    BOOST_TEST(counters.calls == 1u);
+    BOOST_TEST(counters.flagged == 1u);
+    BOOST_TEST(counters.cancelled == 1u);
+
+    // The cancelled generation's connection was closed, not pooled; the client still works.
+    const cppai::moderated_reply next = cppai::test::run(moderated.chat_completion(chat_request("Say hello.")));
+    BOOST_TEST(!next.verdict.flagged);
+    BOOST_TEST(!next.completion.is_null());
+}
+
+BOOST_AUTO_TEST_CASE(clean_prompt_returns_the_completion_after_both) {
+    cppai::test::mock_fixture mock{ timed(100ms, 300ms) };
+    cppai::openAI client;
+    mock.apply(client);
+    const cppai::moderated_chat moderated{ client };
+
+    const cppai::moderated_reply reply = cppai::test::run(moderated.chat_completion(chat_request("Say hello.")));
+    BOOST_TEST(!reply.verdict.flagged);
+    BOOST_TEST(!reply.cancelled);
+    BOOST_TEST(reply.completion.at("object").as_string() == "chat.completion");
+    BOOST_TEST((reply.elapsed >= 400ms));
+    // Moderation ran alongside the generation rather than before it.
+    BOOST_TEST((reply.elapsed < reply.moderation_time + reply.generation_time));
+    BOOST_TEST((reply.latency_saved() > 0ms));
+    BOOST_TEST((reply.generation_wasted() == 0ms));
+}
+
+BOOST_AUTO_TEST_CASE(flagged_stream_releases_no_events) {
+    cppai::bench::mock_options opts = timed(100ms, 0ms);
+    opts.stream_events = 40;
+    opts.stream_interval = 50ms;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    const cppai::moderated_chat moderated{ client };
+
+    std::size_t delivered = 0;
+    const cppai::moderated_reply reply = cppai::test::run(moderated.chat_completion_stream(chat_request("Tell me about [hate].", true),
+        [&delivered](const boost::json::value&) { ++delivered; }));
+    BOOST_TEST(reply.verdict.flagged);
+    BOOST_TEST(reply.cancelled);
+    BOOST_TEST(delivered == 0u);
+    // The full stream takes two seconds.
+    BOOST_TEST((reply.elapsed < 1000ms));
+}
+
+BOOST_AUTO_TEST_CASE(clean_stream_releases_every_event_in_order) {
+    cppai::bench::mock_options opts = timed(150ms, 0ms);
+    opts.stream_events = 10;
+    opts.stream_interval = 10ms;
+    cppai::test::mock_fixture mock{ opts };
+    cppai::openAI client;
+    mock.apply(client);
+    const cppai::moderated_chat moderated{ client };
+
+    std::vector<std::string> events;
+    const cppai::moderated_reply reply = cppai::test::run(moderated.chat_completion_stream(chat_request("Say hello.", true),
+        [&events](const boost::json::value& event) { events.push_back(boost::json::serialize(event)); }));
+    BOOST_TEST(!reply.verdict.flagged);
+    BOOST_TEST(!reply.cancelled);
+    BOOST_TEST(reply.discarded_events == 0u);
+    // The role chunk, the words and the finish chunk.
+    BOOST_REQUIRE(events.size() == opts.stream_events + 2);
+    BOOST_TEST(events.front().find("\"role\":\"assistant\"") != std::string::npos);
+    BOOST_TEST(events.back().find("\"finish_reason\":\"stop\"") != std::string::npos);
+}
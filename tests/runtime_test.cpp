@@ -0,0 +1,145 @@
+#define BOOST_TEST_MODULE runtime
+#include <boost/test/included/unit_test.hpp>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mock_fixture.h"
+#include "runtime.h"
+
+// Built with -DCPPAI_SANITIZE=thread these run under ThreadSanitizer, which is where they earn their keep:
+// the shards share a response cache, a DNS cache and a metrics sink, and are reconfigured mid-load.
+namespace {
+    struct load_shape {
+        std::size_t callers = 8;
+        std::size_t in_flight = 16;
+        std::size_t calls = 40;
+        std::size_t prompts = 32;
+    };
+
+    struct load_result {
+        std::atomic<std::size_t> succeeded{ 0 };
+        std::mutex mtx;
+        std::vector<std::string> failures;
+    };
+
+    boost::json::value chat_request(std::size_t prompt) {
+        return boost::json::object{ { "model", "gpt-4o-mini" }, { "temperature", 0 },
+            { "messages", boost::json::array{ boost::json::object{ { "role", "user" }, { "content", "prompt " + std::to_string(prompt) } } } } };
+    }
+
+    boost::asio::awaitable<void> worker(cppai::runtime& rt, const load_shape& shape, std::size_t first, load_result& result) {
+        for (std::size_t i = 0; i < shape.calls; ++i) {
+            try {
+                const boost::json::value reply = co_await rt.submit([body = chat_request((first + i) % shape.prompts)](const cppai::openAI& client) {
+                    return client.chat_completion(body);
+                });
+                if (reply.at("object").as_string() == "chat.completion") {
+                    result.succeeded.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            catch (const std::exception& e) {
+                std::lock_guard lock{ result.mtx };
+                result.failures.emplace_back(e.what());
+            }
+        }
+    }
+
+    // Every caller thread runs its own io_context and submits from in_flight coroutines at once, while another
+    // thread keeps changing the shards' policy.
+    void drive(cppai::runtime& rt, const load_shape& shape, load_result& result) {
+        std::atomic<bool> loaded{ false };
+        std::thread reconfigure{ [&rt, &loaded]() {
+            for (std::uint16_t attempts = 2; !loaded.load(); attempts = attempts == 2 ? 3 : 2) {
+                rt.configure([attempts](cppai::openAI& client) {
+                    cppai::request_policy policy;
+                    policy.retries.max_attempts = attempts;
+                    client.set_policy(policy);
+                });
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        } };
+        std::vector<std::thread> callers;
+        for (std::size_t c = 0; c < shape.callers; ++c) {
+            callers.emplace_back([&rt, &shape, &result, c]() {
+                boost::asio::io_context ctx;
+                for (std::size_t w = 0; w < shape.in_flight; ++w) {
+                    boost::asio::co_spawn(ctx, worker(rt, shape, c * shape.in_flight + w, result), boost::asio::detached);
+                }
+                ctx.run();
+            });
+        }
+        for (std::thread& caller : callers) {
+            caller.join();
+        }
+        loaded.store(true);
+        reconfigure.join();
+    }
+
+    void stress(cppai::transport mode) {
+        cppai::test::mock_fixture mock;
+        cppai::runtime rt{ cppai::runtime_options{ 4 } };
+        auto cache = std::make_shared<cppai::response_cache>();
+        auto metrics = std::make_shared<cppai::metrics>();
+        rt.configure([&](cppai::openAI& client) {
+            mock.apply(client);
+            client.set_transport(mode);
+            client.set_cache(cache);
+            client.set_metrics(metrics);
+        });
+
+        const load_shape shape;
+        load_result result;
+        drive(rt, shape, result);
+
+        const std::size_t total = shape.callers * shape.in_flight * shape.calls;
+        BOOST_TEST(result.failures.empty(), (result.failures.empty() ? "" : result.failures.front()));
+        BOOST_TEST(result.succeeded.load() == total);
+        BOOST_TEST(rt.outstanding() == 0u);
+
+        // Every call was answered by the cache, by a fetch it was coalesced onto, or by its own request.
+        const cppai::cache_counters counted = cache->counters();
+        BOOST_TEST(counted.hits + counted.coalesced + counted.misses == total);
+        BOOST_TEST(counted.misses >= shape.prompts);
+        const std::uint64_t served = mock.server().counters().requests;
+        BOOST_TEST(served == counted.misses);
+        BOOST_TEST(metrics->snapshot().at("/v1/chat/completions").requests == served);
+        rt.stop();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_callers_over_http1) {
+    stress(cppai::transport::http1);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_callers_over_http2) {
+    stress(cppai::transport::http2);
+}
+
+BOOST_AUTO_TEST_CASE(submit_from_shard_threads) {
+    // Calls submitted from inside another call, i.e. from the shards' own threads.
+    cppai::test::mock_fixture mock;
+    cppai::runtime rt{ cppai::runtime_options{ 3 } };
+    rt.configure([&](cppai::openAI& client) { mock.apply(client); });
+    std::atomic<std::size_t> nested{ 0 };
+    std::vector<std::thread> callers;
+    for (int c = 0; c < 4; ++c) {
+        callers.emplace_back([&]() {
+            for (int i = 0; i < 25; ++i) {
+                cppai::test::run(rt.submit([&rt, &nested](const cppai::openAI& client) -> boost::asio::awaitable<boost::json::value> {
+                    boost::json::value models = co_await client.model_list();
+                    co_await rt.submit([](const cppai::openAI& inner) { return inner.model_list(); });
+                    nested.fetch_add(1, std::memory_order_relaxed);
+                    co_return models;
+                }));
+            }
+        });
+    }
+    for (std::thread& caller : callers) {
+        caller.join();
+    }
+    BOOST_TEST(nested.load() == 100u);
+    BOOST_TEST(rt.outstanding() == 0u);
+    BOOST_TEST(mock.server().counters().requests == 200u);
+}
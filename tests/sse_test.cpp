@@ -0,0 +1,110 @@
+#define BOOST_TEST_MODULE sse
+#include <boost/test/included/unit_test.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "mock_fixture.h"
+#include "sse.h"
+
+namespace {
+    // Comments, other fields, CRLF line ends, a data line without its space, an event spread over several
+    // data lines, values shorter than "[DONE]" and an event after [DONE], which must not be delivered.
+    constexpr std::string_view stream =
+        ": keep-alive\r\n"
+        "event: message\n"
+        "id: 1\n"
+        "data: {\"a\":1}\n"
+        "\n"
+        "retry: 10\r\n"
+        "data:{\"b\":\r\n"
+        "data: [2,3]}\r\n"
+        "\r\n"
+        "data: 7\n"
+        "\n"
+        "data: \"[DONE\"\n"
+        "\n"
+        "data: [\"x\\ny\", null]\n"
+        ": a comment between events\n"
+        "\n"
+        "data: [DONE]\n"
+        "\n"
+        "data: {\"after\":true}\n"
+        "\n";
+
+    const std::vector<std::string> expected = { R"({"a":1})", R"({"b":[2,3]})", "7", R"("[DONE")", R"(["x\ny",null])" };
+
+    struct collected {
+        std::vector<std::string> events;
+        cppai::sse_parser parser{ [this](const boost::json::value& event) { events.push_back(boost::json::serialize(event)); } };
+    };
+
+    void check(const collected& result, const std::string& split) {
+        BOOST_TEST_CONTEXT("split " << split) {
+            BOOST_TEST(result.events == expected, boost::test_tools::per_element());
+            BOOST_TEST(result.parser.done());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(whole_stream) {
+    collected result;
+    result.parser.write(stream);
+    check(result, "none");
+}
+
+BOOST_AUTO_TEST_CASE(split_at_every_byte_boundary) {
+    for (std::size_t at = 0; at <= stream.size(); ++at) {
+        collected result;
+        result.parser.write(stream.substr(0, at));
+        result.parser.write(stream.substr(at));
+        check(result, std::to_string(at));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(split_at_every_pair_of_boundaries) {
+    for (std::size_t first = 0; first <= stream.size(); ++first) {
+        for (std::size_t second = first; second <= stream.size(); ++second) {
+            collected result;
+            result.parser.write(stream.substr(0, first));
+            result.parser.write(stream.substr(first, second - first));
+            result.parser.write(stream.substr(second));
+            check(result, std::to_string(first) + ',' + std::to_string(second));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(one_byte_at_a_time) {
+    collected result;
+    for (const char c : stream) {
+        result.parser.write(std::string_view{ &c, 1 });
+    }
+    check(result, "bytes");
+}
+
+// The same events replayed by the mock server one byte per chunk, each its own TLS record and read.
+BOOST_AUTO_TEST_CASE(replayed_one_byte_per_write) {
+    const boost::filesystem::path replay = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("cppai-sse-%%%%%%%%.jsonl");
+    {
+        // The mock sends each string as "data: <string>\n\n", so the strings carry the rest of the raw stream.
+        const boost::json::array events = { "{\"a\":1}\nid: 1\n: keep-alive\r", "{\"b\":\r\ndata: [2,3]}\r", "7", "\"[DONE\"",
+            "[\"x\\ny\", null]\n: a comment between events", "[DONE]", "{\"after\":true}" };
+        std::ofstream{ replay.string() } << boost::json::serialize(boost::json::object{
+            { "method", "POST" }, { "target", "/v1/chat/completions" }, { "events", events } }) << '\n';
+    }
+    cppai::bench::mock_options opts;
+    opts.replay_file = replay.string();
+    opts.stream_fragment = 1;
+    opts.stream_interval = std::chrono::microseconds(200);
+    cppai::test::mock_fixture mock{ opts };
+    boost::system::error_code error_code;
+    boost::filesystem::remove(replay, error_code);
+
+    cppai::openAI client;
+    mock.apply(client);
+    std::vector<std::string> events;
+    cppai::test::run(client.chat_completion_stream(boost::json::object{ { "model", "gpt-4o-mini" }, { "stream", true } },
+        [&events](const boost::json::value& event) { events.push_back(boost::json::serialize(event)); }));
+    BOOST_TEST(events == expected, boost::test_tools::per_element());
+    BOOST_TEST(mock.server().counters().replayed == 1u);
+}